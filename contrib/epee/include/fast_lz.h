@@ -0,0 +1,202 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+namespace epee
+{
+namespace fast_lz
+{
+  /************************************************************************/
+  /* Byte oriented LZ77 block codec tuned for speed rather than ratio.    */
+  /* A block is a run of sequences: a token (literal length in the high   */
+  /* nibble, match length - 4 in the low one, 15 meaning "more bytes      */
+  /* follow"), the literals, and a 16 bit little endian match offset.     */
+  /* The last sequence carries literals only. The decoded size is not    */
+  /* stored, the caller has to transmit it.                               */
+  /************************************************************************/
+  namespace detail
+  {
+    const size_t min_match = 4;
+    const size_t last_literals = 5;   //a block always ends with at least this many literals
+    const size_t max_offset = 0xffff;
+    const size_t hash_log = 14;
+
+    inline uint32_t read32(const unsigned char* p)
+    {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return v;
+    }
+
+    inline size_t hash(uint32_t v)
+    {
+      return (v * 2654435761U) >> (32 - hash_log);
+    }
+
+    inline void write_length(std::string& out, size_t len)
+    {
+      while(len >= 255)
+      {
+        out.push_back(static_cast<char>(255));
+        len -= 255;
+      }
+      out.push_back(static_cast<char>(len));
+    }
+
+    inline bool read_length(const unsigned char*& ip, const unsigned char* end, size_t limit, size_t& len)
+    {
+      unsigned char b;
+      do
+      {
+        if(ip == end)
+          return false;
+        b = *ip++;
+        len += b;
+        if(len > limit)
+          return false;
+      } while(b == 255);
+      return true;
+    }
+
+    inline void write_sequence(std::string& out, const unsigned char* literals, size_t literals_len, size_t offset, size_t match_len)
+    {
+      size_t match_code = match_len - min_match;
+      out.push_back(static_cast<char>(((literals_len < 15 ? literals_len : 15) << 4) | (match_code < 15 ? match_code : 15)));
+      if(literals_len >= 15)
+        write_length(out, literals_len - 15);
+      out.append(reinterpret_cast<const char*>(literals), literals_len);
+      out.push_back(static_cast<char>(offset & 0xff));
+      out.push_back(static_cast<char>(offset >> 8));
+      if(match_code >= 15)
+        write_length(out, match_code - 15);
+    }
+  }
+
+  inline size_t max_compressed_size(size_t size)
+  {
+    return size + size / 255 + 16;
+  }
+
+  //a match length byte of 255 is the most any input byte can expand to
+  const size_t max_expansion = 255;
+
+  //appends the block to out, so a caller can put its own header in front of it
+  inline void compress(const void* src, size_t size, std::string& out)
+  {
+    using namespace detail;
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    out.reserve(out.size() + max_compressed_size(size));
+
+    size_t anchor = 0;
+    if(size > min_match + last_literals)
+    {
+      //positions are stored +1, so 0 means an empty slot
+      std::vector<uint32_t> table(size_t(1) << hash_log, 0);
+      const size_t match_limit = size - last_literals;
+      size_t ip = 0;
+      while(ip + min_match <= match_limit)
+      {
+        uint32_t seq = read32(in + ip);
+        size_t h = hash(seq);
+        size_t ref = table[h];
+        table[h] = static_cast<uint32_t>(ip + 1);
+        if(!ref || ip + 1 - ref > max_offset || read32(in + ref - 1) != seq)
+        {
+          ++ip;
+          continue;
+        }
+        --ref;
+        size_t len = min_match;
+        while(ip + len < match_limit && in[ref + len] == in[ip + len])
+          ++len;
+        write_sequence(out, in + anchor, ip - anchor, ip - ref, len);
+        ip += len;
+        anchor = ip;
+      }
+    }
+
+    size_t literals_len = size - anchor;
+    out.push_back(static_cast<char>((literals_len < 15 ? literals_len : 15) << 4));
+    if(literals_len >= 15)
+      write_length(out, literals_len - 15);
+    out.append(reinterpret_cast<const char*>(in) + anchor, literals_len);
+  }
+
+  //decompressed_size comes from the sender, everything in the block is checked against it
+  inline bool decompress(const void* src, size_t size, size_t decompressed_size, std::string& out)
+  {
+    using namespace detail;
+    const unsigned char* ip = static_cast<const unsigned char*>(src);
+    const unsigned char* const end = ip + size;
+    out.clear();
+    out.resize(decompressed_size);
+    unsigned char* const dst = reinterpret_cast<unsigned char*>(&out[0]);
+    size_t op = 0;
+
+    while(ip != end)
+    {
+      unsigned char token = *ip++;
+      size_t literals_len = token >> 4;
+      if(literals_len == 15 && !read_length(ip, end, decompressed_size, literals_len))
+        return false;
+      if(literals_len > size_t(end - ip) || literals_len > decompressed_size - op)
+        return false;
+      memcpy(dst + op, ip, literals_len);
+      ip += literals_len;
+      op += literals_len;
+      if(ip == end)
+        break;
+
+      if(end - ip < 2)
+        return false;
+      size_t offset = ip[0] | (size_t(ip[1]) << 8);
+      ip += 2;
+      if(!offset || offset > op)
+        return false;
+      size_t match_len = token & 15;
+      if(match_len == 15 && !read_length(ip, end, decompressed_size, match_len))
+        return false;
+      match_len += min_match;
+      if(match_len > decompressed_size - op)
+        return false;
+      //overlapping copy repeats the last offset bytes, so it has to go forward byte by byte
+      const unsigned char* match = dst + op - offset;
+      for(size_t i = 0; i != match_len; ++i)
+        dst[op + i] = match[i];
+      op += match_len;
+    }
+    return op == decompressed_size;
+  }
+}
+}
@@ -0,0 +1,235 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace epee
+{
+namespace lock_profiler
+{
+  /************************************************************************/
+  /* Wait and hold times of critical regions, per lock and call site.     */
+  /* Only recorded when built with EPEE_PROFILE_LOCKS, see syncobj.h.     */
+  /************************************************************************/
+  inline bool enabled()
+  {
+#if defined(EPEE_PROFILE_LOCKS)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  inline uint64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // bucket i counts durations in [2^i, 2^(i+1)) ns, bucket 0 also takes 0
+  struct duration_histogram
+  {
+    static const size_t buckets_count = 40;
+
+    duration_histogram()
+    {
+      reset();
+    }
+
+    void add(uint64_t ns)
+    {
+      size_t i = 0;
+      while (i + 1 < buckets_count && (ns >> (i + 1)))
+        ++i;
+      m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+      m_count.fetch_add(1, std::memory_order_relaxed);
+      m_total_ns.fetch_add(ns, std::memory_order_relaxed);
+      uint64_t max = m_max_ns.load(std::memory_order_relaxed);
+      while (ns > max && !m_max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+    }
+
+    void reset()
+    {
+      for (auto& b: m_buckets)
+        b = 0;
+      m_count = 0;
+      m_total_ns = 0;
+      m_max_ns = 0;
+    }
+
+    std::atomic<uint64_t> m_buckets[buckets_count];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_total_ns;
+    std::atomic<uint64_t> m_max_ns;
+  };
+
+  // one per CRITICAL_REGION_* use, a function local static registered on first use
+  struct site
+  {
+    site(const char* lock_name, const char* file, int line);
+
+    const char* m_lock_name;
+    const char* m_file;
+    int m_line;
+    duration_histogram m_wait;
+    duration_histogram m_hold;
+    site* m_next;
+  };
+
+  inline std::atomic<site*>& sites()
+  {
+    static std::atomic<site*> head(nullptr);
+    return head;
+  }
+
+  inline site::site(const char* lock_name, const char* file, int line)
+    : m_lock_name(lock_name), m_file(file), m_line(line), m_next(nullptr)
+  {
+    site* head = sites().load(std::memory_order_relaxed);
+    do
+    {
+      m_next = head;
+    } while (!sites().compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  struct times_summary
+  {
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+  };
+
+  struct site_summary
+  {
+    std::string lock_name;
+    std::string file;
+    int line;
+    uint64_t count;
+    times_summary wait;
+    times_summary hold;
+  };
+
+  namespace detail
+  {
+    typedef std::vector<uint64_t> buckets_t;
+
+    inline void accumulate(buckets_t& buckets, uint64_t& total, uint64_t& max, const duration_histogram& h)
+    {
+      buckets.resize(duration_histogram::buckets_count, 0);
+      for (size_t i = 0; i < duration_histogram::buckets_count; ++i)
+        buckets[i] += h.m_buckets[i].load(std::memory_order_relaxed);
+      total += h.m_total_ns.load(std::memory_order_relaxed);
+      max = std::max<uint64_t>(max, h.m_max_ns.load(std::memory_order_relaxed));
+    }
+
+    // upper bound of the bucket holding the given quantile
+    inline uint64_t quantile(const buckets_t& buckets, double q)
+    {
+      uint64_t count = 0;
+      for (uint64_t b: buckets)
+        count += b;
+      if (!count)
+        return 0;
+      uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+      uint64_t seen = 0;
+      for (size_t i = 0; i < buckets.size(); ++i)
+      {
+        seen += buckets[i];
+        if (seen >= rank)
+          return (uint64_t(1) << (i + 1)) - 1;
+      }
+      return (uint64_t(1) << buckets.size()) - 1;
+    }
+
+    inline times_summary summarize(const buckets_t& buckets, uint64_t total, uint64_t max)
+    {
+      times_summary s;
+      s.total_ns = total;
+      s.max_ns = max;
+      s.p50_ns = std::min(quantile(buckets, 0.5), max);
+      s.p99_ns = std::min(quantile(buckets, 0.99), max);
+      return s;
+    }
+  }
+
+  // sites with the same lock, file and line (e.g. template instances) are merged,
+  // the result is sorted by total wait time, longest first
+  inline std::vector<site_summary> get_summary()
+  {
+    struct merged
+    {
+      uint64_t count = 0;
+      detail::buckets_t wait_buckets, hold_buckets;
+      uint64_t wait_total = 0, wait_max = 0, hold_total = 0, hold_max = 0;
+    };
+    std::map<std::tuple<std::string, std::string, int>, merged> by_site;
+    for (site* s = sites().load(std::memory_order_acquire); s; s = s->m_next)
+    {
+      if (!s->m_hold.m_count.load(std::memory_order_relaxed) && !s->m_wait.m_count.load(std::memory_order_relaxed))
+        continue;
+      merged& m = by_site[std::make_tuple(std::string(s->m_lock_name), std::string(s->m_file), s->m_line)];
+      m.count += s->m_wait.m_count.load(std::memory_order_relaxed);
+      detail::accumulate(m.wait_buckets, m.wait_total, m.wait_max, s->m_wait);
+      detail::accumulate(m.hold_buckets, m.hold_total, m.hold_max, s->m_hold);
+    }
+
+    std::vector<site_summary> res;
+    for (const auto& kv: by_site)
+    {
+      site_summary ss;
+      ss.lock_name = std::get<0>(kv.first);
+      ss.file = std::get<1>(kv.first);
+      ss.line = std::get<2>(kv.first);
+      ss.count = kv.second.count;
+      ss.wait = detail::summarize(kv.second.wait_buckets, kv.second.wait_total, kv.second.wait_max);
+      ss.hold = detail::summarize(kv.second.hold_buckets, kv.second.hold_total, kv.second.hold_max);
+      res.push_back(ss);
+    }
+    std::sort(res.begin(), res.end(), [](const site_summary& a, const site_summary& b) { return a.wait.total_ns > b.wait.total_ns; });
+    return res;
+  }
+
+  // racy against concurrent updates, a region in flight may land on either side
+  inline void reset()
+  {
+    for (site* s = sites().load(std::memory_order_acquire); s; s = s->m_next)
+    {
+      s->m_wait.reset();
+      s->m_hold.reset();
+    }
+  }
+}
+}
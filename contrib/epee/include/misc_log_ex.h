@@ -38,6 +38,8 @@
 #include <algorithm>
 #include <list>
 #include <map>
+#include <memory>
+#include <vector>
 #include <time.h>
 #include <boost/cstdint.hpp>
 #include <boost/thread.hpp>
@@ -74,6 +76,9 @@
 #define   LOGGER_CONSOLE    3
 #define   LOGGER_DUMP       4
 
+#define LOG_ASYNC_DEFAULT_RING_SIZE   4096  //records per logging thread
+#define LOG_ASYNC_FLUSH_INTERVAL_MS   50
+
 
 #ifndef LOCAL_ASSERT
 #include <assert.h>
@@ -696,6 +701,80 @@ namespace log_space
   inline bool get_set_need_proc_name(bool is_need_set = false, bool is_need_val = false);
 
 
+  /************************************************************************/
+  /* Bounded queue with one producer (the logging thread) and one         */
+  /* consumer (the flusher). push() never blocks, a full ring drops the   */
+  /* record and counts it.                                                */
+  /************************************************************************/
+  struct log_record
+  {
+    uint64_t seq;
+    std::string message;
+    int log_level;
+    int color;
+    bool add_to_journal;
+    bool has_log_name;
+    std::string log_name;
+  };
+
+  class log_ring
+  {
+  public:
+    log_ring(size_t capacity, uint64_t owner_id):m_records(capacity ? capacity : 1), m_head(0), m_tail(0), m_dropped(0), m_owner_id(owner_id)
+    {}
+
+    bool push(log_record& rec)
+    {
+      size_t tail = m_tail.load(std::memory_order_relaxed);
+      if(tail - m_head.load(std::memory_order_acquire) == m_records.size())
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      std::swap(m_records[tail % m_records.size()], rec);
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(log_record& rec)
+    {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      if(head == m_tail.load(std::memory_order_acquire))
+        return false;
+      std::swap(m_records[head % m_records.size()], rec);
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    size_t size() const {return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);}
+    size_t capacity() const {return m_records.size();}
+    uint64_t take_dropped(){return m_dropped.exchange(0, std::memory_order_relaxed);}
+    uint64_t owner_id() const {return m_owner_id;}
+
+  private:
+    std::vector<log_record> m_records;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    std::atomic<uint64_t> m_dropped;
+    const uint64_t m_owner_id;
+  };
+
+  //per thread logging state, outlives loggers so a stale ring is recognised by its owner id
+  struct thread_log_state
+  {
+    std::string prefix;
+    std::shared_ptr<log_ring> ring;
+  };
+
+  inline thread_log_state& get_thread_log_state()
+  {
+    //never destroyed, logging from static destructors must still work
+    static boost::thread_specific_ptr<thread_log_state>* state = new boost::thread_specific_ptr<thread_log_state>();
+    if(!state->get())
+      state->reset(new thread_log_state());
+    return **state;
+  }
+
   inline std::string get_daytime_string2()
   {
     boost::posix_time::ptime p = boost::posix_time::microsec_clock::local_time();
@@ -742,7 +821,7 @@ namespace log_space
   public:
     friend class log_singletone;
 
-    logger()
+    logger():m_id(next_logger_id()), m_async_running(false), m_async_stop(false), m_ring_capacity(LOG_ASYNC_DEFAULT_RING_SIZE), m_seq(0), m_enqueuers(0)
     {
       CRITICAL_REGION_BEGIN(m_critical_sec);
       init();
@@ -750,6 +829,80 @@ namespace log_space
     }
     ~logger()
     {
+      stop_async();
+    }
+
+    //messages are queued per thread and written by a background thread, ring_capacity records per thread
+    bool start_async(size_t ring_capacity = LOG_ASYNC_DEFAULT_RING_SIZE)
+    {
+      CRITICAL_REGION_LOCAL(m_async_lock);
+      if(m_async_running)
+        return true;
+      m_ring_capacity = ring_capacity;
+      m_async_stop = false;
+      m_flusher = boost::thread(boost::bind(&logger::flusher_thread, this));
+      m_async_running = true;
+      return true;
+    }
+
+    //writes everything still queued and goes back to synchronous writes
+    void stop_async()
+    {
+      CRITICAL_REGION_LOCAL(m_async_lock);
+      if(!m_async_running)
+        return;
+      m_async_running = false;
+      m_async_stop = true;
+      m_flush_cond.notify_one();
+      m_flusher.join();
+      //a thread that saw async mode before it was switched off may still be pushing, pushes never block
+      while(m_enqueuers)
+        boost::this_thread::yield();
+      flush();
+    }
+
+    bool is_async() const {return m_async_running;}
+
+    //writes the queued records of all threads in the order they were logged
+    void flush()
+    {
+      CRITICAL_REGION_LOCAL(m_flush_lock);
+      std::vector<std::shared_ptr<log_ring> > rings;
+      CRITICAL_REGION_BEGIN(m_rings_lock);
+      rings = m_rings;
+      CRITICAL_REGION_END();
+
+      std::vector<log_record> batch;
+      uint64_t dropped = 0;
+      for(const auto& ring: rings)
+      {
+        //bounded, so a thread that keeps logging can not hold the flusher here
+        for(size_t n = ring->capacity(); n; --n)
+        {
+          log_record rec;
+          if(!ring->pop(rec))
+            break;
+          batch.push_back(std::move(rec));
+        }
+        dropped += ring->take_dropped();
+      }
+      std::sort(batch.begin(), batch.end(), [](const log_record& a, const log_record& b) {return a.seq < b.seq;});
+
+      CRITICAL_REGION_BEGIN(m_critical_sec);
+      for(const auto& rec: batch)
+        write_message(rec.message, rec.log_level, rec.color, rec.add_to_journal, rec.has_log_name ? rec.log_name.c_str() : NULL);
+      if(dropped)
+      {
+        std::stringstream ss;
+        ss << get_time_string() << " " << dropped << " log messages dropped, logging queue is full" << std::endl;
+        write_message(ss.str(), LOG_LEVEL_0, console_color_yellow, false, NULL);
+      }
+      CRITICAL_REGION_END();
+
+      //rings of finished threads are only referenced from here
+      CRITICAL_REGION_BEGIN(m_rings_lock);
+      m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<log_ring>& r) {return r.use_count() == 1 && !r->size();}), m_rings.end());
+      CRITICAL_REGION_END();
     }
 
     bool set_max_logfile_size(uint64_t max_size)
@@ -778,12 +931,24 @@ namespace log_space
 
     bool do_log_message(const std::string& rlog_mes, int log_level, int color, bool add_to_journal = false, const char* plog_name = NULL)
     {
-      CRITICAL_REGION_BEGIN(m_critical_sec);
-      m_log_target.do_log_message(rlog_mes, log_level, color, plog_name);
-      if(add_to_journal)
-        m_journal.push_back(rlog_mes);
+      if(m_async_running)
+      {
+        //errors are often the last thing logged before an abort, so they go out right away with everything queued before them
+        if(color == console_color_red)
+          flush();
+        else
+        {
+          ++m_enqueuers;
+          bool queued = m_async_running;
+          bool r = queued && enqueue_message(rlog_mes, log_level, color, add_to_journal, plog_name);
+          --m_enqueuers;
+          if(queued)
+            return r;
+        }
+      }
 
-      return true;
+      CRITICAL_REGION_BEGIN(m_critical_sec);
+      return write_message(rlog_mes, log_level, color, add_to_journal, plog_name);
       CRITICAL_REGION_END();
     }
 
@@ -810,9 +975,7 @@ namespace log_space
 
     bool set_thread_prefix(const std::string& prefix)
     {
-      CRITICAL_REGION_BEGIN(m_critical_sec);
-      m_thr_prefix_strings[misc_utils::get_thread_string_id()] = prefix;
-      CRITICAL_REGION_END();
+      get_thread_log_state().prefix = prefix;
       return true;
     }
 
@@ -829,6 +992,57 @@ namespace log_space
 
   protected:
   private:
+    static uint64_t next_logger_id()
+    {
+      static std::atomic<uint64_t> id(0);
+      return ++id;
+    }
+
+    //m_critical_sec held
+    bool write_message(const std::string& rlog_mes, int log_level, int color, bool add_to_journal, const char* plog_name)
+    {
+      m_log_target.do_log_message(rlog_mes, log_level, color, plog_name);
+      if(add_to_journal)
+        m_journal.push_back(rlog_mes);
+      return true;
+    }
+
+    bool enqueue_message(const std::string& rlog_mes, int log_level, int color, bool add_to_journal, const char* plog_name)
+    {
+      thread_log_state& state = get_thread_log_state();
+      if(!state.ring || state.ring->owner_id() != m_id)
+      {
+        state.ring = std::make_shared<log_ring>(m_ring_capacity, m_id);
+        CRITICAL_REGION_LOCAL(m_rings_lock);
+        m_rings.push_back(state.ring);
+      }
+      log_record rec;
+      rec.seq = m_seq++;
+      rec.message = rlog_mes;
+      rec.log_level = log_level;
+      rec.color = color;
+      rec.add_to_journal = add_to_journal;
+      rec.has_log_name = plog_name != NULL;
+      if(plog_name)
+        rec.log_name = plog_name;
+      bool r = state.ring->push(rec);
+      if(state.ring->size() * 2 >= state.ring->capacity())
+        m_flush_cond.notify_one();
+      return r;
+    }
+
+    void flusher_thread()
+    {
+      while(!m_async_stop)
+      {
+        {
+          boost::unique_lock<boost::mutex> lock(m_flush_mutex);
+          m_flush_cond.timed_wait(lock, boost::posix_time::milliseconds(LOG_ASYNC_FLUSH_INTERVAL_MS));
+        }
+        flush();
+      }
+    }
+
     bool init()
     {
       //
@@ -871,9 +1085,23 @@ namespace log_space
     std::string m_default_log_folder;
     std::string m_default_log_file;
     std::string m_process_name;
-    std::map<std::string, std::string> m_thr_prefix_strings;
     std::list<std::string> m_journal;
     critical_section m_critical_sec;
+
+    //asynchronous mode
+    const uint64_t m_id;
+    std::atomic<bool> m_async_running;
+    std::atomic<bool> m_async_stop;
+    size_t m_ring_capacity;
+    std::atomic<uint64_t> m_seq;
+    std::atomic<unsigned int> m_enqueuers;   //threads inside enqueue_message()
+    std::vector<std::shared_ptr<log_ring> > m_rings;
+    critical_section m_rings_lock;
+    critical_section m_flush_lock;
+    critical_section m_async_lock;
+    boost::mutex m_flush_mutex;
+    boost::condition_variable m_flush_cond;
+    boost::thread m_flusher;
   };
   /************************************************************************/
   /*                                                                      */
@@ -912,6 +1140,26 @@ namespace log_space
       return res;
     }
 
+    //ring_capacity 0 goes back to synchronous writes
+    static bool set_async_logging(size_t ring_capacity)
+    {
+      logger* plogger = get_or_create_instance();
+      if(!plogger) return false;
+      if(!ring_capacity)
+      {
+        plogger->stop_async();
+        return true;
+      }
+      return plogger->start_async(ring_capacity);
+    }
+
+    static void flush()
+    {
+      logger* plogger = get_or_create_instance();
+      if(plogger)
+        plogger->flush();
+    }
+
     static bool take_away_journal(std::list<std::string>& journal)
     {
       logger* plogger = get_or_create_instance();
@@ -1112,16 +1360,7 @@ POP_WARNINGS
         str_prefix << "tid:" << misc_utils::get_thread_string_id() << " ";
 //#endif
 
-      if(plogger->m_thr_prefix_strings.size())
-      {
-        CRITICAL_REGION_LOCAL(plogger->m_critical_sec);
-        std::string thr_str = misc_utils::get_thread_string_id();
-        std::map<std::string, std::string>::iterator it = plogger->m_thr_prefix_strings.find(thr_str);
-        if(it!=plogger->m_thr_prefix_strings.end())
-        {
-          str_prefix << it->second;
-        }
-      }
+      str_prefix << get_thread_log_state().prefix;
 
 
       if(get_set_is_uninitialized())
@@ -112,7 +112,8 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
-    virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
+    virtual bool do_send_shared(const shared_send_buffer& buff); ///< queues the buffer without copying it
+    bool do_send_chunk(const shared_send_buffer& buff, size_t offset, size_t cb); ///< will queue a part of data, m_send_que_lock held
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
@@ -129,6 +130,14 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Start the next read, or wait on the read timer first if the inbound limit is exceeded.
+    void start_read(size_t last_read_size);
+    void handle_read_delay(const boost::system::error_code& e);
+    /// Send the front chunks of m_send_que with one gather write, or wait on the write timer first
+    /// if the outbound limit is exceeded. Must be called with m_send_que_lock held.
+    void start_write();
+    void handle_write_delay(const boost::system::error_code& e);
+
     /// Buffer for incoming data.
     boost::array<char, 8192> buffer_;
     //boost::array<char, 1024> buffer_;
@@ -142,7 +151,6 @@ namespace net_utils
     //typename t_protocol_handler::config_type m_dummy_config;
     std::list<boost::shared_ptr<connection<t_protocol_handler> > > m_self_refs; // add_ref/release support
     critical_section m_self_refs_lock;
-    critical_section m_chunking_lock; // held while we add small chunks of the big do_send() to small do_send_chunk()
     
     t_server_role m_connection_type;
     
@@ -181,6 +189,11 @@ namespace net_utils
     /// Run the server's io_service loop.
     bool run_server(size_t threads_count, bool wait = true, const boost::thread::attributes& attrs = boost::thread::attributes());
 
+    /// Give every worker thread its own io_service and pin each new connection to one of them
+    /// (round robin). Handlers of a connection then always run on the same thread. Has to be
+    /// called before run_server(); the acceptor, idle handlers and async_call() stay on the first one.
+    void set_io_service_per_thread(bool enable){m_io_service_per_thread = enable;}
+
     /// wait for service workers stop
     bool timed_wait_server_stop(uint64_t wait_mseconds);
 
@@ -267,7 +280,11 @@ namespace net_utils
 
   private:
     /// Run the server's io_service loop.
-    bool worker_thread();
+    bool worker_thread(boost::asio::io_service* io_service);
+    /// Create the per-thread io_services, io_service_ is the first one.
+    void init_io_service_shards(size_t threads_count);
+    /// The io_service a new connection should live on.
+    boost::asio::io_service& next_connection_io_service();
     /// Handle completion of an asynchronous accept operation.
     void handle_accept(const boost::system::error_code& e);
 
@@ -277,6 +294,14 @@ namespace net_utils
     std::unique_ptr<boost::asio::io_service> m_io_service_local_instance;
     boost::asio::io_service& io_service_;    
 
+    /// io_service per worker thread, only used with set_io_service_per_thread()
+    bool m_io_service_per_thread;
+    std::vector<std::unique_ptr<boost::asio::io_service> > m_shard_io_services_local;
+    std::vector<std::unique_ptr<boost::asio::io_service::work> > m_shard_works;
+    std::vector<boost::asio::io_service*> m_shards;
+    std::atomic<size_t> m_shards_count; // published after m_shards is filled, never shrinks while running
+    std::atomic<size_t> m_next_shard;
+
     /// Acceptor used to listen for incoming connections.
     boost::asio::ip::tcp::acceptor acceptor_;
 
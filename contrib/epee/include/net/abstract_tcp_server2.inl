@@ -257,21 +257,6 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_in );
 			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred * 1024);
 		}
-		double delay=0; // will be calculated
-		do
-		{
-			{ //_scope_dbg1("CRITICAL_REGION_LOCAL");
-				CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in );
-				delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred ); // decission from global
-			}
-			
-			delay *= 0.5;
-			if (delay > 0) {
-				long int ms = (long int)(delay * 100);
-				epee::net_utils::data_logger::get_instance().add_data("sleep_down", ms);
-				std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-			}
-		} while(delay > 0);
 		
       //_info("[sock " << socket_.native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
@@ -293,11 +278,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
           shutdown();
       }else
       {
-        socket_.async_read_some(boost::asio::buffer(buffer_),
-          strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
-              boost::asio::placeholders::error,
-              boost::asio::placeholders::bytes_transferred)));
+        start_read(bytes_transferred);
         //_info("[sock " << socket_.native_handle() << "]Async read requested.");
       }
     }else
@@ -317,6 +298,37 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_read(size_t last_read_size)
+  {
+    long ms = get_read_delay(last_read_size);
+    if(ms > 0)
+    {
+      m_read_delay_timer.expires_from_now(boost::posix_time::milliseconds(ms));
+      m_read_delay_timer.async_wait(
+        strand_.wrap(
+          boost::bind(&connection<t_protocol_handler>::handle_read_delay, connection<t_protocol_handler>::shared_from_this(),
+            boost::asio::placeholders::error)));
+      return;
+    }
+    socket_.async_read_some(boost::asio::buffer(buffer_),
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
+          boost::asio::placeholders::error,
+          boost::asio::placeholders::bytes_transferred)));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::handle_read_delay(const boost::system::error_code& e)
+  {
+    TRY_ENTRY();
+    if(e || m_was_shutdown)
+      return;
+    //the limit is re-checked against the traffic counted meanwhile
+    start_read(0);
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_read_delay", void());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool connection<t_protocol_handler>::call_run_once_service_io()
   {
     TRY_ENTRY();
@@ -342,16 +354,25 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     CATCH_ENTRY_L0("connection<t_protocol_handler>::call_run_once_service_io", false);
   }
   //---------------------------------------------------------------------------------
-    template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb) {
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb)
+  {
+    TRY_ENTRY();
+    // one copy of the whole packet, its chunks are queued as views into it
+    return do_send_shared(shared_send_buffer(new std::string((const char*)ptr, cb)));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_shared(const shared_send_buffer& buff) {
     TRY_ENTRY();
 
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
     auto self = safe_shared_from_this();
     if (!self) return false;
     if (m_was_shutdown) return false;
-		// TODO avoid copy
 
+    const size_t cb = buff->size();
 		const double factor = 32; // TODO config
 		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
 		const t_safe chunksize_good = (t_safe)( 1024 * std::max(1.0,factor) );
@@ -361,80 +382,51 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         ASRT(! (chunksize_max<0) ); // make sure it is unsigned before removin sign with cast:
         long long unsigned int chunksize_max_unsigned = static_cast<long long unsigned int>( chunksize_max ) ;
 
-        if (allow_split && (cb > chunksize_max_unsigned)) {
-			{ // LOCK: chunking
-    		epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical *** 
-
-				_dbg3_c("net/out/size", "do_send() will SPLIT into small chunks, from packet="<<cb<<" B for ptr="<<ptr);
-				t_safe all = cb; // all bytes to send 
-				t_safe pos = 0; // current sending position
-				// 01234567890 
-				// ^^^^        (pos=0, len=4)     ;   pos:=pos+len, pos=4
-				//     ^^^^    (pos=4, len=4)     ;   pos:=pos+len, pos=8
-				//         ^^^ (pos=8, len=4)    ;   
-
-				// const size_t bufsize = chunksize_good; // TODO safecast
-				// char* buf = new char[ bufsize ];
-
-				bool all_ok = true;
-				while (pos < all) {
-					t_safe lenall = all-pos; // length from here to end
-					t_safe len = std::min( chunksize_good , lenall); // take a smaller part
-					ASRT(len<=chunksize_good);
-					// pos=8; len=4; all=10;	len=3;
-
-                    ASRT(! (len<0) ); // check before we cast away sign:
-                    unsigned long long int len_unsigned = static_cast<long long int>( len );
-                    ASRT(len>0); // (redundand)
-                    ASRT(len_unsigned < std::numeric_limits<size_t>::max());   // yeap we want strong < then max size, to be sure
-					
-					void *chunk_start = ((char*)ptr) + pos;
-					_fact_c("net/out/size","chunk_start="<<chunk_start<<" ptr="<<ptr<<" pos="<<pos);
-					ASRT(chunk_start >= ptr); // not wrapped around address?
-					//std::memcpy( (void*)buf, chunk_start, len);
-
-					_dbg3_c("net/out/size", "part of " << lenall << ": pos="<<pos << " len="<<len);
-
-					bool ok = do_send_chunk(chunk_start, len); // <====== ***
+    // all chunks of the packet go in under one lock, so they stay contiguous in the queue
+    epee::critical_region_t<decltype(m_send_que_lock)> send_guard(m_send_que_lock); // *** critical ***
 
-					all_ok = all_ok && ok;
-					if (!all_ok) {
-						_dbg1_c("net/out/size", "do_send() DONE ***FAILED*** from packet="<<cb<<" B for ptr="<<ptr);
-						_dbg1("do_send() SEND was aborted in middle of big package - this is mostly harmless "
-							<< " (e.g. peer closed connection) but if it causes trouble tell us at #monero-dev. " << cb);
-						return false; // partial failure in sending
-					}
-					pos = pos+len; ASRT(pos >0);
+    //a peer that does not keep reading is dropped instead of blocking our thread until it does
+    if (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    {
+      _erro("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
+      close();
+      return false;
+    }
+    const bool was_idle = m_send_que.empty();
 
-					// (in catch block, or uniq pointer) delete buf;
+        if (allow_split && (cb > chunksize_max_unsigned)) {
+				_dbg3_c("net/out/size", "do_send() will SPLIT into small chunks, from packet="<<cb<<" B");
+				size_t pos = 0; // current sending position
+				while (pos < cb) {
+					size_t len = std::min<size_t>( chunksize_good , cb - pos); // take a smaller part
+					_dbg3_c("net/out/size", "part of " << cb - pos << ": pos="<<pos << " len="<<len);
+					do_send_chunk(buff, pos, len); // <====== ***
+					pos += len;
 				} // each chunk
-
-				_dbg3_c("net/out/size", "do_send() DONE SPLIT from packet="<<cb<<" B for ptr="<<ptr);
-				_dbg3  (                "do_send() DONE SPLIT from packet="<<cb<<" B for ptr="<<ptr);
-
+				_dbg3_c("net/out/size", "do_send() DONE SPLIT from packet="<<cb<<" B");
                 _info_c("net/sleepRPC", "do_send() m_connection_type = " << m_connection_type);
-
-				return all_ok; // done - e.g. queued - all the chunks of current do_send call
-			} // LOCK: chunking
 		} // a big block (to be chunked) - all chunks
 		else { // small block
-			return do_send_chunk(ptr,cb); // just send as 1 big chunk
+			do_send_chunk(buff, 0, cb); // just send as 1 big chunk
 		}
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-	} // do_send()
+    if(was_idle)
+    { // no active operation
+        start_write();
+    }
+    else
+    { // active operation (a write or a rate limit delay) should be in progress, nothing to do, just wait last operation callback
+        _info_c("net/out/size", "do_send() NOW just queues: packet="<<cb<<" B, is added to queue-size="<<m_send_que.size());
+    }
+    return true;
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_shared", false);
+	} // do_send_shared()
 
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
+  bool connection<t_protocol_handler>::do_send_chunk(const shared_send_buffer& buff, size_t offset, size_t cb)
   {
-    TRY_ENTRY();
-    // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
-    auto self = safe_shared_from_this();
-    if(!self)
-      return false;
-    if(m_was_shutdown)
-      return false;
     {
 		CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
 		m_throttle_speed_out.handle_trafic_exact(cb);
@@ -444,76 +436,14 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     //_info("[sock " << socket_.native_handle() << "] SEND " << cb);
     context.m_last_send = time(NULL);
     context.m_send_cnt += cb;
-    //some data should be wrote to stream
-    //request complete
-    
-	sleep_before_packet(cb, 1, 1);
-    epee::critical_region_t<decltype(m_send_que_lock)> send_guard(m_send_que_lock); // *** critical ***
-    long int retry=0;
-    const long int retry_limit = 5*4;
-    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
-    {
-        retry++;
-
-        /* if ( ::cryptonote::core::get_is_stopping() ) { // TODO re-add fast stop
-            _fact("ABORT queue wait due to stopping");
-            return false; // aborted
-        }*/
-
-        long int ms = 250 + (rand()%50);
-        _info_c("net/sleep", "Sleeping because QUEUE is FULL, in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<cb); // XXX debug sleep
-        boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-        _dbg1("sleep for queue: " << ms);
-
-        if (retry > retry_limit) {
-            send_guard.unlock();
-            _erro("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
-            //	_dbg1_c("net/sleep", "send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
-            close();
-            return false;
-        }
-    }
-
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
-    
-    if(m_send_que.size() > 1)
-    { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = cb;
-        _info_c("net/out/size", "do_send() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
-      
-      LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
-    }
-    else
-    { // no active operation
-
-        if(m_send_que.size()!=1)
-        {
-            _erro("Looks like no active operations, but send que size != 1!!");
-            return false;
-        }
-
-        auto size_now = m_send_que.front().size();
-        _dbg1_c("net/out/size", "do_send() NOW SENSD: packet="<<size_now<<" B");
-        do_send_handler_write( ptr , size_now ); // (((H)))
-
-        ASRT( size_now == m_send_que.front().size() );
-        boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 //strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 //)
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
-    }
-    
-    //do_send_handler_stop( ptr , cb ); // empty function
 
+    send_que_chunk chunk;
+    chunk.buffer = buff;
+    chunk.offset = offset;
+    chunk.size = cb;
+    m_send_que.push_back(chunk);
+    LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << cb);
     return true;
-
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
   } // do_send_chunk
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
@@ -523,6 +453,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     boost::system::error_code ignored_ec;
     socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     m_was_shutdown = true;
+    m_read_delay_timer.cancel(ignored_ec);
+    m_write_delay_timer.cancel(ignored_ec);
     m_protocol_handler.release_protocol();
     return true;
   }
@@ -559,7 +491,6 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
     logger_handle_net_write(cb);
-	sleep_before_packet(cb, 1, 1);
     bool do_shutdown = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
     if(m_send_que.empty())
@@ -568,7 +499,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    for(size_t i = 0; i < m_send_que_in_flight && !m_send_que.empty(); ++i)
+      m_send_que.pop_front();
+    m_send_que_in_flight = 0;
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -578,16 +511,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-		auto size_now = m_send_que.front().size();
-		_dbg1_c("net/out/size", "handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
-		do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		ASRT( size_now == m_send_que.front().size() );
-		boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) , 
-        // strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-				// )
-        );
-      //_dbg3("(normal)" << size_now);
+      start_write();
     }
     CRITICAL_REGION_END();
 
@@ -599,6 +523,58 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write()
+  {
+    if(m_send_que.empty())
+      return;
+
+    //gather a packet head with its first chunk, or several small packets, into one write
+    const size_t gather_max = 64 * 1024;
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t size_now = 0;
+    for(const send_que_chunk& chunk: m_send_que)
+    {
+      if(!buffers.empty() && size_now + chunk.size > gather_max)
+        break;
+      buffers.push_back(boost::asio::buffer(chunk.buffer->data() + chunk.offset, chunk.size));
+      size_now += chunk.size;
+    }
+
+    long ms = get_write_delay(size_now);
+    if(ms > 0)
+    {
+      //the chunks stay at the front of the queue, so do_send() keeps just queueing meanwhile
+      m_write_delay_timer.expires_from_now(boost::posix_time::milliseconds(ms));
+      m_write_delay_timer.async_wait(
+        boost::bind(&connection<t_protocol_handler>::handle_write_delay, connection<t_protocol_handler>::shared_from_this(), _1));
+      return;
+    }
+
+    _dbg1_c("net/out/size", "start_write() NOW SENDS: packet="<<size_now<<" B in " << buffers.size() << " chunks, from  queue size="<<m_send_que.size());
+    if(m_send_que.size() == buffers.size())
+      do_send_handler_write( m_send_que.front().buffer->data() + m_send_que.front().offset , size_now ); // (((H)))
+    else
+      do_send_handler_write_from_queue(boost::system::error_code(), size_now , m_send_que.size()); // (((H)))
+    m_send_que_in_flight = buffers.size();
+    boost::asio::async_write(socket_, buffers,
+      // strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
+      // )
+      );
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::handle_write_delay(const boost::system::error_code& e)
+  {
+    TRY_ENTRY();
+    if(e || m_was_shutdown)
+      return;
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    start_write();
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_write_delay", void());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void connection<t_protocol_handler>::setRPcStation()
   {
 	m_connection_type = RPC; 
@@ -611,6 +587,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   boosted_tcp_server<t_protocol_handler>::boosted_tcp_server():
     m_io_service_local_instance(new boost::asio::io_service()),
     io_service_(*m_io_service_local_instance.get()),
+    m_io_service_per_thread(false), m_shards_count(0), m_next_shard(0),
     acceptor_(io_service_),
     m_stop_signal_sent(false), m_port(0), 
 	m_sock_count(0), m_sock_number(0), m_threads_count(0), 
@@ -625,6 +602,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   template<class t_protocol_handler>
   boosted_tcp_server<t_protocol_handler>::boosted_tcp_server(boost::asio::io_service& extarnal_io_service, t_server_role s_type):
     io_service_(extarnal_io_service),
+    m_io_service_per_thread(false), m_shards_count(0), m_next_shard(0),
     acceptor_(io_service_),
     m_stop_signal_sent(false), m_port(0), 
 		m_sock_count(0), m_sock_number(0), m_threads_count(0), 
@@ -692,7 +670,7 @@ DISABLE_GCC_WARNING(maybe-uninitialized)
 POP_WARNINGS
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool boosted_tcp_server<t_protocol_handler>::worker_thread()
+  bool boosted_tcp_server<t_protocol_handler>::worker_thread(boost::asio::io_service* io_service)
   {
     TRY_ENTRY();
     uint32_t local_thr_index = boost::interprocess::ipcdetail::atomic_inc32(&m_thread_index); 
@@ -704,7 +682,7 @@ POP_WARNINGS
     {
       try
       {
-        io_service_.run();
+        io_service->run();
       }
       catch(const std::exception& ex)
       {
@@ -721,6 +699,33 @@ POP_WARNINGS
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void boosted_tcp_server<t_protocol_handler>::init_io_service_shards(size_t threads_count)
+  {
+    if(!m_shards.empty())
+      return;
+    m_shards.reserve(threads_count);
+    m_shards.push_back(&io_service_);
+    for(size_t i = 1; i < threads_count; ++i)
+    {
+      m_shard_io_services_local.emplace_back(new boost::asio::io_service());
+      //keeps run() from returning while the shard has no connections yet
+      m_shard_works.emplace_back(new boost::asio::io_service::work(*m_shard_io_services_local.back()));
+      m_shards.push_back(m_shard_io_services_local.back().get());
+    }
+    m_shards_count = m_shards.size();
+    _note("Using " << m_shards.size() << " io_services, one per thread");
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::next_connection_io_service()
+  {
+    size_t count = m_shards_count;
+    if(!count)
+      return io_service_;
+    return *m_shards[m_next_shard++ % count];
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void boosted_tcp_server<t_protocol_handler>::set_threads_prefix(const std::string& prefix_name)
   {
     m_thread_name_prefix = prefix_name;
@@ -742,6 +747,8 @@ POP_WARNINGS
     m_threads_count = threads_count;
     m_main_thread_id = boost::this_thread::get_id();
     log_space::log_singletone::set_thread_log_prefix("[SRV_MAIN]");
+    if(m_io_service_per_thread)
+      init_io_service_shards(threads_count);
     while(!m_stop_signal_sent)
     {
 
@@ -749,8 +756,9 @@ POP_WARNINGS
       CRITICAL_REGION_BEGIN(m_threads_lock);
       for (std::size_t i = 0; i < threads_count; ++i)
       {
+        boost::asio::io_service* io_service = m_shards.empty() ? &io_service_ : m_shards[i];
         boost::shared_ptr<boost::thread> thread(new boost::thread(
-          attrs, boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this)));
+          attrs, boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this, io_service)));
           _note("Run server thread name: " << m_thread_name_prefix);
         m_threads.push_back(thread);
       }
@@ -833,6 +841,9 @@ POP_WARNINGS
     m_stop_signal_sent = true;
     TRY_ENTRY();
     io_service_.stop();
+    m_shard_works.clear();
+    for(auto& io_service: m_shard_io_services_local)
+      io_service->stop();
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::send_stop_signal()", void());
   }
   //---------------------------------------------------------------------------------
@@ -853,7 +864,8 @@ POP_WARNINGS
 			_note("New server for RPC connections");
 		}
 		connection_ptr conn(std::move(new_connection_));
-      new_connection_.reset(new connection<t_protocol_handler>(io_service_, m_config, m_sock_count, m_sock_number, m_pfilter));
+      //the socket may belong to another io_service than the acceptor, its handlers then run on that thread
+      new_connection_.reset(new connection<t_protocol_handler>(next_connection_io_service(), m_config, m_sock_count, m_sock_number, m_pfilter));
       acceptor_.async_accept(new_connection_->socket(),
         boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept, this,
         boost::asio::placeholders::error));
@@ -873,7 +885,7 @@ POP_WARNINGS
   {
     TRY_ENTRY();
 
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_config, m_sock_count, m_sock_number, m_pfilter) );
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(next_connection_io_service(), m_config, m_sock_count, m_sock_number, m_pfilter) );
     boost::asio::ip::tcp::socket&  sock_ = new_connection_l->socket();
     
     //////////////////////////////////////////////////////////////////////////
@@ -963,7 +975,8 @@ POP_WARNINGS
   bool boosted_tcp_server<t_protocol_handler>::connect_async(const std::string& adr, const std::string& port, uint32_t conn_timeout, t_callback cb, const std::string& bind_ip)
   {
     TRY_ENTRY();    
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_config, m_sock_count, m_sock_number, m_pfilter) );
+    boost::asio::io_service& connection_io_service = next_connection_io_service();
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(connection_io_service, m_config, m_sock_count, m_sock_number, m_pfilter) );
     boost::asio::ip::tcp::socket&  sock_ = new_connection_l->socket();
     
     //////////////////////////////////////////////////////////////////////////
@@ -986,7 +999,7 @@ POP_WARNINGS
       sock_.bind(local_endpoint);
     }
     
-    boost::shared_ptr<boost::asio::deadline_timer> sh_deadline(new boost::asio::deadline_timer(io_service_));
+    boost::shared_ptr<boost::asio::deadline_timer> sh_deadline(new boost::asio::deadline_timer(connection_io_service));
     //start deadline
     sh_deadline->expires_from_now(boost::posix_time::milliseconds(conn_timeout));
     sh_deadline->async_wait([=](const boost::system::error_code& error)
@@ -72,6 +72,9 @@ namespace levin
 
 #define LEVIN_PACKET_REQUEST			0x00000001
 #define LEVIN_PACKET_RESPONSE		0x00000002
+#define LEVIN_PACKET_COMPRESSED		0x00000004    //body is uint32 raw size followed by a fast_lz block
+
+#define LEVIN_COMPRESSION_MIN_SIZE 4096            //smaller bodies are not worth compressing
   
 
 #define LEVIN_PROTOCOL_VER_0         0
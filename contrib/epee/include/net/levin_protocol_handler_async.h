@@ -33,9 +33,12 @@
 
 #include "levin_base.h"
 #include "misc_language.h"
+#include "fast_lz.h"
 
 #include <random>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 
 namespace epee
@@ -53,14 +56,33 @@ template<class t_connection_context>
 class async_protocol_handler_config
 {
   typedef std::map<boost::uuids::uuid, async_protocol_handler<t_connection_context>* > connections_map;
+  struct connections_generation;
+  typedef std::shared_ptr<const connections_generation> connections_snapshot;
+  struct connections_generation
+  {
+    connections_map connects;
+    // every generation keeps the next one alive, so a generation is released only once no reader
+    // holds it or any older one
+    mutable connections_snapshot next;
+  };
+  // Readers don't take m_connects_lock: they hold the current immutable generation while they pin the
+  // connections they need with start_outer_call(). Writers copy the map under m_connects_lock and
+  // publish a new generation. std::atomic_load/atomic_store on a shared_ptr may still take a short
+  // internal lock, but never one held across a reader's work.
   critical_section m_connects_lock;
-  connections_map m_connects;
+  std::mutex m_generations_lock;
+  std::condition_variable m_generation_released;
+  connections_snapshot m_connects;
 
   void add_connection(async_protocol_handler<t_connection_context>* pc);
   void del_connection(async_protocol_handler<t_connection_context>* pc);
 
-  async_protocol_handler<t_connection_context>* find_connection(boost::uuids::uuid connection_id) const;
+  connections_snapshot get_connections_snapshot() const { return std::atomic_load(&m_connects); }
+  connections_snapshot make_generation(const connections_map& connects);
+  void publish_generation(const connections_snapshot& generation);
+  static async_protocol_handler<t_connection_context>* find_connection(const connections_map& connects, boost::uuids::uuid connection_id);
   int find_and_lock_connection(boost::uuids::uuid connection_id, async_protocol_handler<t_connection_context>*& aph);
+  void lock_connections(std::vector<async_protocol_handler<t_connection_context>*>& connections);
 
   friend class async_protocol_handler<t_connection_context>;
 
@@ -75,6 +97,9 @@ public:
   int invoke_async(int command, const std::string& in_buff, boost::uuids::uuid connection_id, callback_t cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const std::string& in_buff, boost::uuids::uuid connection_id);
+  //serializes the packet once and queues the same buffer on every connection
+  void notify(int command, const std::string& in_buff, const std::list<boost::uuids::uuid>& connections);
+  bool enable_compression(boost::uuids::uuid connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -82,7 +107,7 @@ public:
   bool foreach_connection(callback_t cb);
   size_t get_connections_count();
 
-  async_protocol_handler_config():m_pcommands_handler(NULL), m_max_packet_size(LEVIN_DEFAULT_MAX_PACKET_SIZE)
+  async_protocol_handler_config():m_connects(make_generation(connections_map())), m_pcommands_handler(NULL), m_max_packet_size(LEVIN_DEFAULT_MAX_PACKET_SIZE)
   {}
   void del_out_connections(size_t count);
 };
@@ -106,6 +131,7 @@ public:
 
   std::atomic<bool> m_deletion_initiated;
   std::atomic<bool> m_protocol_released;
+  std::atomic<bool> m_compression_enabled;   //set once the peer has advertised it can read compressed bodies
   volatile uint32_t m_invoke_buf_ready;
 
   volatile int m_invoke_result_code;
@@ -225,6 +251,7 @@ public:
     m_close_called = 0;
     m_deletion_initiated = false;
     m_protocol_released = false;
+    m_compression_enabled = false;
     m_wait_count = 0;
     m_oponent_protocol_ver = 0;
     m_connection_initialized = false;
@@ -349,6 +376,8 @@ public:
             buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
             m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
           }
+          if(m_current_head.m_flags&LEVIN_PACKET_COMPRESSED && !decompress_body(buff_to_invoke))
+            return false;
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
@@ -402,14 +431,13 @@ public:
                                                                   buff_to_invoke, 
                                                                   return_buff, 
                                                                   m_connection_context);
-              m_current_head.m_cb = return_buff.size();
               m_current_head.m_have_to_return_data = false;
               m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
               m_current_head.m_flags = LEVIN_PACKET_RESPONSE;
-              std::string send_buff((const char*)&m_current_head, sizeof(m_current_head));
-              send_buff += return_buff;
+              net_utils::shared_send_buffer packet = make_packet(m_current_head, return_buff, m_compression_enabled);
+              m_current_head = *reinterpret_cast<const bucket_head2*>(packet->data());
               CRITICAL_REGION_BEGIN(m_send_lock);
-              if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
+              if(!m_pservice_endpoint->do_send_shared(packet))
                 return false;
               CRITICAL_REGION_END();
               LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_SENT. [len=" << m_current_head.m_cb 
@@ -615,7 +643,92 @@ public:
     return m_invoke_result_code;
   }
 
+  //builds head and body in one buffer, the body is compressed only when it is big enough and actually shrinks
+  static net_utils::shared_send_buffer make_packet(bucket_head2 head, const std::string& body, bool compress)
+  {
+    head.m_signature = LEVIN_SIGNATURE;
+    head.m_cb = body.size();
+
+    std::string* packet = new std::string();
+    net_utils::shared_send_buffer result(packet);
+    if(compress && body.size() >= LEVIN_COMPRESSION_MIN_SIZE && body.size() <= 0xffffffff)
+    {
+      uint32_t raw_size = static_cast<uint32_t>(body.size());
+      packet->append(reinterpret_cast<const char*>(&head), sizeof(head));
+      packet->append(reinterpret_cast<const char*>(&raw_size), sizeof(raw_size));
+      fast_lz::compress(body.data(), body.size(), *packet);
+      if(packet->size() - sizeof(head) < body.size())
+      {
+        bucket_head2* phead = reinterpret_cast<bucket_head2*>(&(*packet)[0]);
+        phead->m_cb = packet->size() - sizeof(head);
+        phead->m_flags |= LEVIN_PACKET_COMPRESSED;
+        return result;
+      }
+      packet->clear();
+    }
+    packet->reserve(sizeof(head) + body.size());
+    packet->append(reinterpret_cast<const char*>(&head), sizeof(head));
+    packet->append(body);
+    return result;
+  }
+
+  bool decompress_body(std::string& body)
+  {
+    uint32_t raw_size = 0;
+    if(body.size() < sizeof(raw_size))
+    {
+      LOG_ERROR_CC(m_connection_context, "Compressed packet is too short, connection will be closed");
+      return false;
+    }
+    memcpy(&raw_size, body.data(), sizeof(raw_size));
+    if(raw_size > m_config.m_max_packet_size)
+    {
+      LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
+        << ", decompressed size " << raw_size 
+        << ", connection will be closed.");
+      return false;
+    }
+    //reject sizes the body can't possibly expand to before allocating for them
+    if(raw_size / fast_lz::max_expansion > body.size() - sizeof(raw_size))
+    {
+      LOG_ERROR_CC(m_connection_context, "Compressed packet body of " << body.size() - sizeof(raw_size)
+        << " bytes can't decompress to " << raw_size << " bytes, connection will be closed.");
+      return false;
+    }
+    std::string raw;
+    if(!fast_lz::decompress(body.data() + sizeof(raw_size), body.size() - sizeof(raw_size), raw_size, raw))
+    {
+      LOG_ERROR_CC(m_connection_context, "Failed to decompress packet body, connection will be closed");
+      return false;
+    }
+    body.swap(raw);
+    return true;
+  }
+
+  static net_utils::shared_send_buffer make_notify_packet(int command, const std::string& in_buff, bool compress)
+  {
+    bucket_head2 head = {0};
+    head.m_have_to_return_data = false;
+    head.m_command = command;
+    head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+    head.m_flags = LEVIN_PACKET_REQUEST;
+    return make_packet(head, in_buff, compress);
+  }
+
   int notify(int command, const std::string& in_buff)
+  {
+    return notify_packet(make_notify_packet(command, in_buff, m_compression_enabled));
+  }
+
+  //called after the handshake when the peer has advertised support for compressed bodies
+  void enable_compression()
+  {
+    m_compression_enabled = true;
+  }
+  bool is_compression_enabled() const { return m_compression_enabled; }
+
+  //sends a packet made by make_notify_packet(), the same packet may be queued on many connections
+  int notify_packet(const net_utils::shared_send_buffer& packet)
   {
     misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
                           boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -628,32 +741,19 @@ public:
     if(m_deletion_initiated)
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-    bucket_head2 head = {0};
-    head.m_signature = LEVIN_SIGNATURE;
-    head.m_have_to_return_data = false;
-    head.m_cb = in_buff.size();
-
-    head.m_command = command;
-    head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-    head.m_flags = LEVIN_PACKET_REQUEST;
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-    {
-      LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
-      return -1;
-    }
-
-    if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+    if(!m_pservice_endpoint->do_send_shared(packet))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
       return -1;
     }
     CRITICAL_REGION_END();
-    LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_SENT. [len=" << head.m_cb << 
-      ", f=" << head.m_flags << 
-      ", r?=" << head.m_have_to_return_data <<
-      ", cmd = " << head.m_command << 
-      ", ver=" << head.m_protocol_version);
+    const bucket_head2* head = reinterpret_cast<const bucket_head2*>(packet->data());
+    LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_SENT. [len=" << head->m_cb << 
+      ", f=" << head->m_flags << 
+      ", r?=" << head->m_have_to_return_data <<
+      ", cmd = " << head->m_command << 
+      ", ver=" << head->m_protocol_version);
 
     return 1;
   }
@@ -664,63 +764,90 @@ public:
 };
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+typename async_protocol_handler_config<t_connection_context>::connections_snapshot async_protocol_handler_config<t_connection_context>::make_generation(const connections_map& connects)
+{
+  connections_generation* generation = new connections_generation();
+  generation->connects = connects;
+  return connections_snapshot(generation, [this](const connections_generation* g)
+  {
+    delete g;
+    std::lock_guard<std::mutex> lock(m_generations_lock);
+    m_generation_released.notify_all();
+  });
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
+void async_protocol_handler_config<t_connection_context>::publish_generation(const connections_snapshot& generation)
+{
+  // called with m_connects_lock held
+  get_connections_snapshot()->next = generation;
+  std::atomic_store(&m_connects, generation);
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 void async_protocol_handler_config<t_connection_context>::del_connection(async_protocol_handler<t_connection_context>* pconn)
 {
+  std::weak_ptr<const connections_generation> replaced;
   CRITICAL_REGION_BEGIN(m_connects_lock);
-  m_connects.erase(pconn->get_connection_id());
+  connections_map connects = get_connections_snapshot()->connects;
+  connects.erase(pconn->get_connection_id());
+  replaced = get_connections_snapshot();
+  publish_generation(make_generation(connects));
   CRITICAL_REGION_END();
+  // a reader that picked pconn from an older generation may still be about to pin it; new readers
+  // only see the generation without it, so this wait always ends
+  {
+    std::unique_lock<std::mutex> lock(m_generations_lock);
+    m_generation_released.wait(lock, [&replaced]() { return replaced.expired(); });
+  }
   m_pcommands_handler->on_connection_close(pconn->m_connection_context);
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
 void async_protocol_handler_config<t_connection_context>::del_out_connections(size_t count)
 {
-	std::vector <boost::uuids::uuid> out_connections;
-	CRITICAL_REGION_BEGIN(m_connects_lock);
-	for (auto& c: m_connects)
-	{
-		if (!c.second->m_connection_context.m_is_income)
-			out_connections.push_back(c.first);
-	}
+	std::vector<async_protocol_handler<t_connection_context>*> out_connections;
+	lock_connections(out_connections);
 	
-	if (out_connections.size() == 0)
-		return;
-
 	// close random out connections
 	// TODO or better just keep removing random elements (performance)
 	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
 	shuffle(out_connections.begin(), out_connections.end(), std::default_random_engine(seed));
-	while (count > 0 && out_connections.size() > 0)
+	for (async_protocol_handler<t_connection_context>* aph: out_connections)
 	{
-		close(*out_connections.begin());
-		del_connection(m_connects.at(*out_connections.begin()));
-		--count;
+		if (count > 0 && !aph->m_connection_context.m_is_income)
+		{
+			aph->close();
+			del_connection(aph);
+			--count;
+		}
+		aph->finish_outer_call();
 	}
-	
-	CRITICAL_REGION_END();
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
 void async_protocol_handler_config<t_connection_context>::add_connection(async_protocol_handler<t_connection_context>* pconn)
 {
   CRITICAL_REGION_BEGIN(m_connects_lock);
-  m_connects[pconn->get_connection_id()] = pconn;
+  connections_map connects = get_connections_snapshot()->connects;
+  connects[pconn->get_connection_id()] = pconn;
+  publish_generation(make_generation(connects));
   CRITICAL_REGION_END();
   m_pcommands_handler->on_connection_new(pconn->m_connection_context);
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
-async_protocol_handler<t_connection_context>* async_protocol_handler_config<t_connection_context>::find_connection(boost::uuids::uuid connection_id) const
+async_protocol_handler<t_connection_context>* async_protocol_handler_config<t_connection_context>::find_connection(const connections_map& connects, boost::uuids::uuid connection_id)
 {
-  auto it = m_connects.find(connection_id);
-  return it == m_connects.end() ? 0 : it->second;
+  auto it = connects.find(connection_id);
+  return it == connects.end() ? 0 : it->second;
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
 int async_protocol_handler_config<t_connection_context>::find_and_lock_connection(boost::uuids::uuid connection_id, async_protocol_handler<t_connection_context>*& aph)
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
-  aph = find_connection(connection_id);
+  connections_snapshot generation = get_connections_snapshot();
+  aph = find_connection(generation->connects, connection_id);
   if(0 == aph)
     return LEVIN_ERROR_CONNECTION_NOT_FOUND;
   if(!aph->start_outer_call())
@@ -729,6 +856,18 @@ int async_protocol_handler_config<t_connection_context>::find_and_lock_connectio
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+void async_protocol_handler_config<t_connection_context>::lock_connections(std::vector<async_protocol_handler<t_connection_context>*>& connections)
+{
+  connections_snapshot generation = get_connections_snapshot();
+  connections.reserve(generation->connects.size());
+  for(const auto& c: generation->connects)
+  {
+    if(c.second->start_outer_call())
+      connections.push_back(c.second);
+  }
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 int async_protocol_handler_config<t_connection_context>::invoke(int command, const std::string& in_buff, std::string& buff_out, boost::uuids::uuid connection_id)
 {
   async_protocol_handler<t_connection_context>* aph;
@@ -747,21 +886,22 @@ int async_protocol_handler_config<t_connection_context>::invoke_async(int comman
 template<class t_connection_context> template<class callback_t>
 bool async_protocol_handler_config<t_connection_context>::foreach_connection(callback_t cb)
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
-  for(auto& c: m_connects)
+  std::vector<async_protocol_handler<t_connection_context>*> connections;
+  lock_connections(connections);
+  bool r = true;
+  for(async_protocol_handler<t_connection_context>* aph: connections)
   {
-    async_protocol_handler<t_connection_context>* aph = c.second;
-    if(!cb(aph->get_context_ref()))
-      return false;
+    if(r && !cb(aph->get_context_ref()))
+      r = false;
+    aph->finish_outer_call();
   }
-  return true;
+  return r;
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
 size_t async_protocol_handler_config<t_connection_context>::get_connections_count()
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
-  return m_connects.size();
+  return get_connections_snapshot()->connects.size();
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
@@ -773,21 +913,63 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+void async_protocol_handler_config<t_connection_context>::notify(int command, const std::string& in_buff, const std::list<boost::uuids::uuid>& connections)
+{
+  std::vector<async_protocol_handler<t_connection_context>*> locked;
+  locked.reserve(connections.size());
+  connections_snapshot generation = get_connections_snapshot();
+  for(const boost::uuids::uuid& connection_id: connections)
+  {
+    async_protocol_handler<t_connection_context>* aph = find_connection(generation->connects, connection_id);
+    if(aph && aph->start_outer_call())
+      locked.push_back(aph);
+  }
+  // sending may close a connection, whose del_connection() waits for this generation
+  generation.reset();
+  // both variants are built at most once and only if some connection needs them
+  net_utils::shared_send_buffer packet, compressed_packet;
+  // notify_packet() finishes the outer call
+  for(async_protocol_handler<t_connection_context>* aph: locked)
+  {
+    //the flag may flip concurrently, the packet has to match the variant it is cached as
+    const bool compress = aph->is_compression_enabled();
+    net_utils::shared_send_buffer& p = compress ? compressed_packet : packet;
+    if(!p)
+      p = async_protocol_handler<t_connection_context>::make_notify_packet(command, in_buff, compress);
+    aph->notify_packet(p);
+  }
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
+bool async_protocol_handler_config<t_connection_context>::enable_compression(boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  if(LEVIN_OK != find_and_lock_connection(connection_id, aph))
+    return false;
+  aph->enable_compression();
+  aph->finish_outer_call();
+  return true;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
-  async_protocol_handler<t_connection_context>* aph = find_connection(connection_id);
-  return 0 != aph ? aph->close() : false;
+  async_protocol_handler<t_connection_context>* aph;
+  if(LEVIN_OK != find_and_lock_connection(connection_id, aph))
+    return false;
+  bool r = aph->close();
+  aph->finish_outer_call();
+  return r;
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::update_connection_context(const t_connection_context& contxt)
 {
-  CRITICAL_REGION_LOCAL(m_connects_lock);
-  async_protocol_handler<t_connection_context>* aph = find_connection(contxt.m_connection_id);
-  if(0 == aph)
+  async_protocol_handler<t_connection_context>* aph;
+  if(LEVIN_OK != find_and_lock_connection(contxt.m_connection_id, aph))
     return false;
   aph->update_connection_context(contxt);
+  aph->finish_outer_call();
   return true;
 }
 //------------------------------------------------------------------------------------------
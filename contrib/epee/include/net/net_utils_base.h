@@ -30,6 +30,7 @@
 #define _NET_UTILS_BASE_H_
 
 #include <boost/uuid/uuid.hpp>
+#include <boost/shared_ptr.hpp>
 #include "string_tools.h"
 
 #ifndef MAKE_IP
@@ -108,9 +109,14 @@ namespace net_utils
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
+	//immutable data that can sit in the send queues of several connections at once
+	typedef boost::shared_ptr<const std::string> shared_send_buffer;
+
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+		//queues the buffer itself when the endpoint can, instead of a copy of it
+		virtual bool do_send_shared(const shared_send_buffer& buff){ return do_send(buff->data(), buff->size()); }
     virtual bool close()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
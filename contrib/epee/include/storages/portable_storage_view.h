@@ -0,0 +1,440 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+
+#pragma once 
+
+#include <vector>
+#include <cstring>
+#include "misc_language.h"
+#include "portable_storage_base.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Read-only storage over a binary portable_storage blob.              */
+    /* Instead of building a section tree of variants and strings, the     */
+    /* blob is indexed once into a flat vector of entries that point into  */
+    /* the buffer, so KV_SERIALIZE maps copy each field straight from the  */
+    /* receive buffer into the target struct. The buffer must outlive the  */
+    /* view.                                                               */
+    /************************************************************************/
+    class portable_storage_view
+    {
+    public:
+      struct entry_view
+      {
+        const char* name;
+        size_t name_len;
+        uint8_t type;           //SERIALIZE_TYPE_*, with SERIALIZE_FLAG_ARRAY for arrays
+        const char* data;       //pod value, string data or pod array items
+        size_t size;            //string length, or count of section entries/array items
+        size_t first;           //first child in m_entries, npos for pod arrays
+        mutable size_t cursor;  //next array item for get_next_value()/get_next_section()
+      };
+
+      typedef const entry_view* hsection;
+      typedef const entry_view* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_view();
+
+      bool load_from_binary(const binarybuffer& source);
+      bool load_from_binary(const void* ptr, size_t size);
+
+      hsection open_section(const char* section_name, hsection hparent_section, bool create_if_notexist = false);
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false) { return open_section(section_name.c_str(), hparent_section, create_if_notexist); }
+      template<class t_value>
+      bool get_value(const char* value_name, t_value& val, hsection hparent_section);
+      template<class t_value>
+      bool get_value(const std::string& value_name, t_value& val, hsection hparent_section) { return get_value(value_name.c_str(), val, hparent_section); }
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray get_first_value(const char* value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target);
+      harray get_first_section(const char* section_name, hsection& h_child_section, hsection hparent_section);
+      bool get_next_section(harray hsec_array, hsection& h_child_section);
+
+    private:
+      static const size_t npos = static_cast<size_t>(-1);
+
+      const entry_view* find_entry(const char* name, hsection hparent_section) const;
+      template<class t_value>
+      static void load_value(const char* data, uint8_t type, size_t size, t_value& target);
+      static void load_value(const char* data, uint8_t type, size_t size, std::string& target);
+      template<class t_pod_type>
+      static t_pod_type read_pod(const char* data);
+      static size_t pod_size(uint8_t type);
+
+      //parser state, only valid inside load_from_binary()
+      void skip(size_t count);
+      uint8_t read_byte();
+      size_t read_varint();
+      void parse_section(size_t idx, size_t depth);
+      void parse_array(size_t idx, uint8_t type, size_t depth);
+      void parse_value(size_t idx, uint8_t type, size_t depth);
+
+      std::vector<entry_view> m_entries;  //m_entries[0] is the root section
+      entry_view m_empty_section;
+      const char* m_ptr;
+      const char* m_end;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_view::portable_storage_view():m_ptr(nullptr), m_end(nullptr)
+    {
+      m_empty_section = AUTO_VAL_INIT(m_empty_section);
+      m_empty_section.type = SERIALIZE_TYPE_OBJECT;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_view::load_from_binary(const binarybuffer& source)
+    {
+      return load_from_binary(source.data(), source.size());
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_view::load_from_binary(const void* ptr, size_t size)
+    {
+      m_entries.clear();
+#pragma pack(push)
+#pragma pack(1)
+      struct storage_block_header
+      {
+        uint32_t m_signature_a;
+        uint32_t m_signature_b;
+        uint8_t  m_ver;
+      };
+#pragma pack(pop)
+      if(size < sizeof(storage_block_header))
+      {
+        LOG_ERROR("portable_storage_view: wrong binary format, packet size = " << size << " less than expected sizeof(storage_block_header)=" << sizeof(storage_block_header));
+        return false;
+      }
+      storage_block_header sbh;
+      memcpy(&sbh, ptr, sizeof(sbh));
+      if(sbh.m_signature_a != PORTABLE_STORAGE_SIGNATUREA || sbh.m_signature_b != PORTABLE_STORAGE_SIGNATUREB)
+      {
+        LOG_ERROR("portable_storage_view: wrong binary format - signature missmatch");
+        return false;
+      }
+      if(sbh.m_ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage_view: wrong binary format - unknown format ver = " << sbh.m_ver);
+        return false;
+      }
+      TRY_ENTRY();
+      m_ptr = static_cast<const char*>(ptr) + sizeof(storage_block_header);
+      m_end = static_cast<const char*>(ptr) + size;
+      m_entries.reserve(64);
+      m_entries.push_back(m_empty_section);
+      parse_section(0, 0);
+      m_ptr = m_end = nullptr;
+      return true;
+      CATCH_ENTRY("portable_storage_view::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::skip(size_t count)
+    {
+      CHECK_AND_ASSERT_THROW_MES(static_cast<size_t>(m_end - m_ptr) >= count, " attempt to read " << count << " bytes from buffer with " << (m_end - m_ptr) << " bytes remained");
+      m_ptr += count;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    uint8_t portable_storage_view::read_byte()
+    {
+      const char* p = m_ptr;
+      skip(1);
+      return static_cast<uint8_t>(*p);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_view::read_varint()
+    {
+      CHECK_AND_ASSERT_THROW_MES(m_ptr != m_end, "empty buff, expected place for varint");
+      const char* p = m_ptr;
+      uint64_t v = 0;
+      switch(static_cast<uint8_t>(*p) & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE:  skip(1); v = read_pod<uint8_t>(p); break;
+      case PORTABLE_RAW_SIZE_MARK_WORD:  skip(2); v = read_pod<uint16_t>(p); break;
+      case PORTABLE_RAW_SIZE_MARK_DWORD: skip(4); v = read_pod<uint32_t>(p); break;
+      case PORTABLE_RAW_SIZE_MARK_INT64: skip(8); v = read_pod<uint64_t>(p); break;
+      }
+      return static_cast<size_t>(v >> 2);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::parse_section(size_t idx, size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      size_t count = read_varint();
+      //every entry takes at least a name length and a type byte
+      CHECK_AND_ASSERT_THROW_MES(count <= static_cast<size_t>(m_end - m_ptr) / 2, "section entries count " << count << " goes out of remain storage len " << (m_end - m_ptr));
+      //children are contiguous, so reserve their slots before descending into any of them
+      size_t first = m_entries.size();
+      m_entries.resize(first + count);
+      m_entries[idx].first = first;
+      m_entries[idx].size = count;
+      for(size_t i = first; i != first + count; ++i)
+      {
+        size_t name_len = read_byte();
+        m_entries[i].name = m_ptr;
+        m_entries[i].name_len = name_len;
+        skip(name_len);
+        parse_value(i, read_byte(), depth);
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::parse_array(size_t idx, uint8_t type, size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      uint8_t item_type = type & ~SERIALIZE_FLAG_ARRAY;
+      size_t count = read_varint();
+      m_entries[idx].type = type;
+      m_entries[idx].size = count;
+
+      size_t item_size = pod_size(item_type);
+      if(item_size)
+      {
+        //pod items are read in place
+        CHECK_AND_ASSERT_THROW_MES(count <= static_cast<size_t>(m_end - m_ptr) / item_size, "array items count " << count << " goes out of remain storage len " << (m_end - m_ptr));
+        m_entries[idx].data = m_ptr;
+        m_entries[idx].first = npos;
+        skip(count * item_size);
+        return;
+      }
+
+      //every other item takes at least one byte
+      CHECK_AND_ASSERT_THROW_MES(count <= static_cast<size_t>(m_end - m_ptr), "array items count " << count << " goes out of remain storage len " << (m_end - m_ptr));
+      size_t first = m_entries.size();
+      m_entries.resize(first + count);
+      m_entries[idx].first = first;
+      for(size_t i = first; i != first + count; ++i)
+        parse_value(i, item_type, depth + 1);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::parse_value(size_t idx, uint8_t type, size_t depth)
+    {
+      if(type & SERIALIZE_FLAG_ARRAY)
+        return parse_array(idx, type, depth + 1);
+
+      m_entries[idx].type = type;
+      size_t item_size = pod_size(type);
+      if(item_size)
+      {
+        m_entries[idx].data = m_ptr;
+        m_entries[idx].size = item_size;
+        skip(item_size);
+        return;
+      }
+      switch(type)
+      {
+      case SERIALIZE_TYPE_STRING:
+        {
+          size_t len = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          m_entries[idx].data = m_ptr;
+          m_entries[idx].size = len;
+          skip(len);
+          return;
+        }
+      case SERIALIZE_TYPE_OBJECT:
+        return parse_section(idx, depth + 1);
+      case SERIALIZE_TYPE_ARRAY:
+        {
+          uint8_t array_type = read_byte();
+          CHECK_AND_ASSERT_THROW_MES(array_type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+          return parse_array(idx, array_type, depth + 1);
+        }
+      default:
+        CHECK_AND_ASSERT_THROW_MES(false, "unknown entry_type code = " << type);
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_view::pod_size(uint8_t type)
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  return sizeof(int64_t);
+      case SERIALIZE_TYPE_INT32:  return sizeof(int32_t);
+      case SERIALIZE_TYPE_INT16:  return sizeof(int16_t);
+      case SERIALIZE_TYPE_INT8:   return sizeof(int8_t);
+      case SERIALIZE_TYPE_UINT64: return sizeof(uint64_t);
+      case SERIALIZE_TYPE_UINT32: return sizeof(uint32_t);
+      case SERIALIZE_TYPE_UINT16: return sizeof(uint16_t);
+      case SERIALIZE_TYPE_UINT8:  return sizeof(uint8_t);
+      case SERIALIZE_TYPE_DUOBLE: return sizeof(double);
+      case SERIALIZE_TYPE_BOOL:   return sizeof(bool);
+      default: return 0;
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type>
+    t_pod_type portable_storage_view::read_pod(const char* data)
+    {
+      t_pod_type v;
+      memcpy(&v, data, sizeof(v));
+      return v;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_view::load_value(const char* data, uint8_t type, size_t size, t_value& target)
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  return convert_t(read_pod<int64_t>(data), target);
+      case SERIALIZE_TYPE_INT32:  return convert_t(read_pod<int32_t>(data), target);
+      case SERIALIZE_TYPE_INT16:  return convert_t(read_pod<int16_t>(data), target);
+      case SERIALIZE_TYPE_INT8:   return convert_t(read_pod<int8_t>(data), target);
+      case SERIALIZE_TYPE_UINT64: return convert_t(read_pod<uint64_t>(data), target);
+      case SERIALIZE_TYPE_UINT32: return convert_t(read_pod<uint32_t>(data), target);
+      case SERIALIZE_TYPE_UINT16: return convert_t(read_pod<uint16_t>(data), target);
+      case SERIALIZE_TYPE_UINT8:  return convert_t(read_pod<uint8_t>(data), target);
+      case SERIALIZE_TYPE_DUOBLE: return convert_t(read_pod<double>(data), target);
+      case SERIALIZE_TYPE_BOOL:   return convert_t(read_pod<bool>(data), target);
+      case SERIALIZE_TYPE_STRING: return convert_t(std::string(data, size), target);
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from entry type " << static_cast<int>(type) << " to type " << typeid(t_value).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::load_value(const char* data, uint8_t type, size_t size, std::string& target)
+    {
+      if(type != SERIALIZE_TYPE_STRING)
+        return load_value<std::string>(data, type, size, target);
+      //the only copy a string field takes: from the receive buffer to its destination
+      target.assign(data, size);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_storage_view::entry_view* portable_storage_view::find_entry(const char* name, hsection hparent_section) const
+    {
+      if(!hparent_section)
+      {
+        if(m_entries.empty())
+          return nullptr;
+        hparent_section = &m_entries[0];
+      }
+      if(hparent_section->type != SERIALIZE_TYPE_OBJECT || !hparent_section->size)
+        return nullptr;
+      size_t name_len = strlen(name);
+      //sections are small and keep their first entry on duplicated names, like portable_storage
+      for(size_t i = hparent_section->first; i != hparent_section->first + hparent_section->size; ++i)
+      {
+        const entry_view& e = m_entries[i];
+        if(e.name_len == name_len && !memcmp(e.name, name, name_len))
+          return &e;
+      }
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_view::hsection portable_storage_view::open_section(const char* section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      const entry_view* pentry = find_entry(section_name, hparent_section);
+      if(pentry && pentry->type == SERIALIZE_TYPE_OBJECT)
+        return pentry;
+      //portable_storage creates a missing section when asked to, loading from it yields defaults
+      return create_if_notexist ? &m_empty_section : nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_view::get_value(const char* value_name, t_value& val, hsection hparent_section)
+    {
+      const entry_view* pentry = find_entry(value_name, hparent_section);
+      if(!pentry)
+        return false;
+      load_value(pentry->data, pentry->type, pentry->size, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_view::harray portable_storage_view::get_first_value(const char* value_name, t_value& target, hsection hparent_section)
+    {
+      const entry_view* pentry = find_entry(value_name, hparent_section);
+      if(!pentry || !(pentry->type & SERIALIZE_FLAG_ARRAY))
+        return nullptr;
+      pentry->cursor = 0;
+      if(!get_next_value(pentry, target))
+        return nullptr;
+      return pentry;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_view::get_next_value(harray hval_array, t_value& target)
+    {
+      CHECK_AND_ASSERT(hval_array, false);
+      if(hval_array->cursor >= hval_array->size)
+        return false;
+      size_t i = hval_array->cursor++;
+      if(hval_array->first == npos)
+      {
+        uint8_t item_type = hval_array->type & ~SERIALIZE_FLAG_ARRAY;
+        size_t item_size = pod_size(item_type);
+        load_value(hval_array->data + i * item_size, item_type, item_size, target);
+        return true;
+      }
+      const entry_view& e = m_entries[hval_array->first + i];
+      load_value(e.data, e.type, e.size, target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_view::harray portable_storage_view::get_first_section(const char* section_name, hsection& h_child_section, hsection hparent_section)
+    {
+      const entry_view* pentry = find_entry(section_name, hparent_section);
+      if(!pentry || pentry->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY))
+        return nullptr;
+      pentry->cursor = 0;
+      if(!get_next_section(pentry, h_child_section))
+        return nullptr;
+      return pentry;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_view::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if(hsec_array->cursor >= hsec_array->size)
+        return false;
+      h_child_section = &m_entries[hsec_array->first + hsec_array->cursor++];
+      return true;
+    }
+  }
+}
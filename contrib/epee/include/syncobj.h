@@ -37,6 +37,7 @@
 #include <boost/thread/recursive_mutex.hpp>
 #include <thread>
 #include <chrono>
+#include "lock_profiler.h"
 
 namespace epee
 {
@@ -128,6 +129,16 @@ namespace epee
       m_locker.lock();
     }
 
+#if defined(EPEE_PROFILE_LOCKS)
+    critical_region_t(t_lock& cs, lock_profiler::site& s): m_locker(cs), m_unlocked(false), m_site(&s)
+    {
+      uint64_t start = lock_profiler::now_ns();
+      m_locker.lock();
+      m_locked_at = lock_profiler::now_ns();
+      m_site->m_wait.add(m_locked_at - start);
+    }
+#endif
+
     ~critical_region_t()
     {
       unlock();
@@ -137,10 +148,20 @@ namespace epee
     {
       if (!m_unlocked)
       {
+#if defined(EPEE_PROFILE_LOCKS)
+        if (m_site)
+          m_site->m_hold.add(lock_profiler::now_ns() - m_locked_at);
+#endif
         m_locker.unlock();
         m_unlocked = true;
       }
     }
+
+#if defined(EPEE_PROFILE_LOCKS)
+  private:
+    lock_profiler::site* m_site = nullptr;
+    uint64_t m_locked_at = 0;
+#endif
   };
 
 
@@ -219,10 +240,18 @@ namespace epee
 #define  SHARED_CRITICAL_REGION_BEGIN(x) { shared_guard   critical_region_var(x)
 #define  EXCLUSIVE_CRITICAL_REGION_BEGIN(x) { exclusive_guard   critical_region_var(x)
 
+#if defined(EPEE_PROFILE_LOCKS)
+// each use gets its own site, named after the lock expression, see lock_profiler.h
+#define  CRITICAL_REGION_LOCAL(x) {std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep));}   static epee::lock_profiler::site critical_region_site(#x, __FILE__, __LINE__); epee::critical_region_t<decltype(x)>   critical_region_var(x, critical_region_site)
+#define  CRITICAL_REGION_BEGIN(x) { std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep)); static epee::lock_profiler::site critical_region_site(#x, __FILE__, __LINE__); epee::critical_region_t<decltype(x)>   critical_region_var(x, critical_region_site)
+#define  CRITICAL_REGION_LOCAL1(x) {std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep));} static epee::lock_profiler::site critical_region_site1(#x, __FILE__, __LINE__); epee::critical_region_t<decltype(x)>   critical_region_var1(x, critical_region_site1)
+#define  CRITICAL_REGION_BEGIN1(x) {  std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep)); static epee::lock_profiler::site critical_region_site1(#x, __FILE__, __LINE__); epee::critical_region_t<decltype(x)>   critical_region_var1(x, critical_region_site1)
+#else
 #define  CRITICAL_REGION_LOCAL(x) {std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep));}   epee::critical_region_t<decltype(x)>   critical_region_var(x)
 #define  CRITICAL_REGION_BEGIN(x) { std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep)); epee::critical_region_t<decltype(x)>   critical_region_var(x)
 #define  CRITICAL_REGION_LOCAL1(x) {std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep));} epee::critical_region_t<decltype(x)>   critical_region_var1(x)
 #define  CRITICAL_REGION_BEGIN1(x) {  std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep)); epee::critical_region_t<decltype(x)>   critical_region_var1(x)
+#endif
 
 #define  CRITICAL_REGION_END() }
 
@@ -0,0 +1,204 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "metrics.h"
+
+namespace tools
+{
+namespace metrics
+{
+  namespace
+  {
+    double bits_to_double(uint64_t bits)
+    {
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      return d;
+    }
+
+    uint64_t double_to_bits(double d)
+    {
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(bits));
+      return bits;
+    }
+
+    std::string with_labels(const std::string& name, const std::string& labels, const std::string& extra = "")
+    {
+      if(labels.empty() && extra.empty())
+        return name;
+      std::string s = name + "{" + labels;
+      if(!labels.empty() && !extra.empty())
+        s += ",";
+      return s + extra + "}";
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  histogram::histogram(const std::vector<double>& bounds)
+    : m_bounds(bounds)
+    , m_buckets(new std::atomic<uint64_t>[bounds.size() + 1])
+    , m_count(0)
+    , m_sum_bits(double_to_bits(0))
+  {
+    for(size_t i = 0; i <= m_bounds.size(); ++i)
+      m_buckets[i] = 0;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void histogram::observe(double v)
+  {
+    size_t i = 0;
+    while(i < m_bounds.size() && v > m_bounds[i])
+      ++i;
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t old_bits = m_sum_bits.load(std::memory_order_relaxed);
+    while(!m_sum_bits.compare_exchange_weak(old_bits, double_to_bits(bits_to_double(old_bits) + v), std::memory_order_relaxed))
+      ;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::vector<uint64_t> histogram::cumulative_counts() const
+  {
+    std::vector<uint64_t> counts(m_bounds.size() + 1);
+    uint64_t total = 0;
+    for(size_t i = 0; i <= m_bounds.size(); ++i)
+    {
+      total += m_buckets[i].load(std::memory_order_relaxed);
+      counts[i] = total;
+    }
+    return counts;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  double histogram::sum() const
+  {
+    return bits_to_double(m_sum_bits.load(std::memory_order_relaxed));
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  const std::vector<double>& default_latency_buckets()
+  {
+    static const std::vector<double> buckets = {0.00001, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10};
+    return buckets;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  registry& registry::instance()
+  {
+    // never destroyed, metrics may still be touched from static destructors
+    static registry* r = new registry();
+    return *r;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  registry::family& registry::get_family(const std::string& name, const std::string& help, metric_type type)
+  {
+    family& f = m_families[name];
+    if(f.metrics.empty())
+    {
+      f.type = type;
+      f.help = help;
+    }
+    else if(f.type != type)
+    {
+      throw std::invalid_argument("metric " + name + " is already registered with another type");
+    }
+    return f;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  counter& registry::get_counter(const std::string& name, const std::string& help, const std::string& labels)
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::shared_ptr<void>& m = get_family(name, help, type_counter).metrics[labels];
+    if(!m)
+      m = std::make_shared<counter>();
+    return *static_cast<counter*>(m.get());
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  gauge& registry::get_gauge(const std::string& name, const std::string& help, const std::string& labels)
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::shared_ptr<void>& m = get_family(name, help, type_gauge).metrics[labels];
+    if(!m)
+      m = std::make_shared<gauge>();
+    return *static_cast<gauge*>(m.get());
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  histogram& registry::get_histogram(const std::string& name, const std::string& help, const std::string& labels, const std::vector<double>& bounds)
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::shared_ptr<void>& m = get_family(name, help, type_histogram).metrics[labels];
+    if(!m)
+      m = std::make_shared<histogram>(bounds);
+    return *static_cast<histogram*>(m.get());
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string registry::to_prometheus() const
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::ostringstream ss;
+    ss.precision(9);
+    for(const auto& nf: m_families)
+    {
+      const std::string& name = nf.first;
+      const family& f = nf.second;
+      static const char* const type_names[] = {"counter", "gauge", "histogram"};
+      ss << "# HELP " << name << " " << f.help << "\n";
+      ss << "# TYPE " << name << " " << type_names[f.type] << "\n";
+      for(const auto& lm: f.metrics)
+      {
+        const std::string& labels = lm.first;
+        switch(f.type)
+        {
+        case type_counter:
+          ss << with_labels(name, labels) << " " << static_cast<const counter*>(lm.second.get())->value() << "\n";
+          break;
+        case type_gauge:
+          ss << with_labels(name, labels) << " " << static_cast<const gauge*>(lm.second.get())->value() << "\n";
+          break;
+        case type_histogram:
+          {
+            const histogram& h = *static_cast<const histogram*>(lm.second.get());
+            std::vector<uint64_t> counts = h.cumulative_counts();
+            for(size_t i = 0; i < h.bounds().size(); ++i)
+            {
+              std::ostringstream le;
+              le << "le=\"" << h.bounds()[i] << "\"";
+              ss << with_labels(name + "_bucket", labels, le.str()) << " " << counts[i] << "\n";
+            }
+            ss << with_labels(name + "_bucket", labels, "le=\"+Inf\"") << " " << counts.back() << "\n";
+            ss << with_labels(name + "_sum", labels) << " " << h.sum() << "\n";
+            ss << with_labels(name + "_count", labels) << " " << counts.back() << "\n";
+          }
+          break;
+        }
+      }
+    }
+    return ss.str();
+  }
+}
+}
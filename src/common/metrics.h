@@ -0,0 +1,169 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "syncobj.h"
+
+/*! \brief Process wide metrics
+ *
+ * Counters, gauges and histograms are updated with atomics only. Looking a
+ * metric up in the registry takes a lock, so hot paths keep the reference:
+ *
+ *   static tools::metrics::histogram& h = tools::metrics::registry::instance().get_histogram("name", "help");
+ *
+ * registry::to_prometheus() renders everything in the Prometheus text format.
+ */
+namespace tools
+{
+namespace metrics
+{
+  /*! \brief Monotonically increasing value */
+  class counter
+  {
+  public:
+    counter(): m_value(0) {}
+    void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> m_value;
+  };
+
+  /*! \brief Value that goes up and down */
+  class gauge
+  {
+  public:
+    gauge(): m_value(0) {}
+    void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> m_value;
+  };
+
+  /*! \brief Distribution over fixed buckets, upper bounds in ascending order */
+  class histogram
+  {
+  public:
+    explicit histogram(const std::vector<double>& bounds);
+
+    void observe(double v);
+
+    const std::vector<double>& bounds() const { return m_bounds; }
+    //! cumulative counts per bound, the last element counts everything (+Inf)
+    std::vector<uint64_t> cumulative_counts() const;
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    double sum() const;
+
+  private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets; // m_bounds.size() + 1
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum_bits; // double, updated with compare and swap
+  };
+
+  //! seconds, from 10us to 10s
+  const std::vector<double>& default_latency_buckets();
+
+  /*! \brief Named metrics, optionally split by a label set such as method="getinfo" */
+  class registry
+  {
+  public:
+    static registry& instance();
+
+    counter& get_counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    gauge& get_gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    histogram& get_histogram(const std::string& name, const std::string& help, const std::string& labels = "",
+      const std::vector<double>& bounds = default_latency_buckets());
+
+    std::string to_prometheus() const;
+
+  private:
+    enum metric_type { type_counter, type_gauge, type_histogram };
+
+    struct family
+    {
+      metric_type type;
+      std::string help;
+      std::map<std::string, std::shared_ptr<void> > metrics; // by label set
+    };
+
+    family& get_family(const std::string& name, const std::string& help, metric_type type);
+
+    mutable std::mutex m_lock;
+    std::map<std::string, family> m_families;
+  };
+
+  /*! \brief Observes the seconds between construction and destruction */
+  class scoped_timer
+  {
+  public:
+    explicit scoped_timer(histogram& h): m_histogram(h), m_start(std::chrono::steady_clock::now()) {}
+    ~scoped_timer() { m_histogram.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count()); }
+
+  private:
+    histogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  /*! \brief critical_section that records how long lock() had to wait
+   *
+   * An uncontended lock is a single try_lock, the clock is only read when
+   * the caller actually has to wait.
+   */
+  class timed_critical_section
+  {
+  public:
+    explicit timed_critical_section(histogram& wait_time): m_wait_time(wait_time) {}
+
+    void lock()
+    {
+      if(m_section.tryLock())
+        return;
+      scoped_timer t(m_wait_time);
+      m_section.lock();
+    }
+    void unlock() { m_section.unlock(); }
+    bool tryLock() { return m_section.tryLock(); }
+
+  private:
+    epee::critical_section m_section;
+    histogram& m_wait_time;
+  };
+}
+}
@@ -0,0 +1,281 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <boost/thread/tss.hpp>
+
+#include "tracing.h"
+
+namespace tools
+{
+namespace tracing
+{
+  namespace detail
+  {
+    std::atomic<bool> g_enabled(false);
+  }
+
+  namespace
+  {
+    struct event
+    {
+      const char* category;
+      const char* name;
+      uint64_t start_us;
+      uint64_t end_us;
+    };
+
+    struct thread_buffer
+    {
+      std::mutex lock; // taken by the owner on every span and by start()/to_chrome_trace()
+      std::vector<event> events;
+      size_t next = 0; // overwrite position once events is full
+      size_t capacity = 0;
+      uint32_t tid = 0;
+    };
+
+    struct exited_event
+    {
+      uint32_t tid;
+      event e;
+    };
+
+    // buffers kept for reuse by new threads, the rest are freed on thread exit
+    const size_t max_free_buffers = 4;
+
+    struct registry
+    {
+      std::mutex lock;
+      std::vector<std::shared_ptr<thread_buffer> > buffers;
+      std::vector<std::shared_ptr<thread_buffer> > free_buffers;
+      // spans of threads that exited, one ring of capacity events shared by all of them
+      std::vector<exited_event> exited_events;
+      size_t exited_next = 0;
+      size_t capacity = TRACE_DEFAULT_BUFFER_SIZE;
+      uint32_t next_tid = 1;
+    };
+
+    // never destroyed, threads may still finish spans while static destructors run
+    registry& get_registry()
+    {
+      static registry* r = new registry();
+      return *r;
+    }
+
+    // moves the spans of an exiting thread into the registry, then recycles or frees its buffer
+    struct thread_buffer_holder
+    {
+      std::shared_ptr<thread_buffer> buffer;
+      ~thread_buffer_holder()
+      {
+        registry& r = get_registry();
+        std::lock_guard<std::mutex> lock(r.lock);
+        {
+          std::lock_guard<std::mutex> buffer_lock(buffer->lock);
+          // oldest first, so the shared ring keeps the newest spans
+          for (size_t i = 0; i < buffer->events.size() && r.capacity; ++i)
+          {
+            exited_event e = {buffer->tid, buffer->events[(buffer->next + i) % buffer->events.size()]};
+            if (r.exited_events.size() < r.capacity)
+            {
+              r.exited_events.push_back(e);
+            }
+            else
+            {
+              r.exited_events[r.exited_next] = e;
+              r.exited_next = (r.exited_next + 1) % r.capacity;
+            }
+          }
+          buffer->events.clear();
+          buffer->next = 0;
+        }
+        for (auto it = r.buffers.begin(); it != r.buffers.end(); ++it)
+        {
+          if (*it == buffer)
+          {
+            r.buffers.erase(it);
+            break;
+          }
+        }
+        if (r.free_buffers.size() < max_free_buffers)
+          r.free_buffers.push_back(buffer);
+      }
+    };
+
+    boost::thread_specific_ptr<thread_buffer_holder>& get_holder()
+    {
+      static boost::thread_specific_ptr<thread_buffer_holder>* holder = new boost::thread_specific_ptr<thread_buffer_holder>();
+      return *holder;
+    }
+
+    thread_buffer& get_thread_buffer()
+    {
+      boost::thread_specific_ptr<thread_buffer_holder>& holder = get_holder();
+      if (!holder.get())
+      {
+        std::unique_ptr<thread_buffer_holder> h(new thread_buffer_holder());
+        registry& r = get_registry();
+        {
+          std::lock_guard<std::mutex> lock(r.lock);
+          if (r.free_buffers.empty())
+          {
+            h->buffer = std::make_shared<thread_buffer>();
+          }
+          else
+          {
+            h->buffer = r.free_buffers.back();
+            r.free_buffers.pop_back();
+          }
+          h->buffer->capacity = r.capacity;
+          h->buffer->tid = r.next_tid++;
+          r.buffers.push_back(h->buffer);
+        }
+        holder.reset(h.release());
+      }
+      return *holder->buffer;
+    }
+
+    void append_json_string(std::ostringstream& ss, const char* s)
+    {
+      ss << '"';
+      for (; *s; ++s)
+      {
+        if (*s == '"' || *s == '\\')
+          ss << '\\';
+        ss << *s;
+      }
+      ss << '"';
+    }
+  }
+
+  namespace detail
+  {
+    void record(const char* category, const char* name, uint64_t start_us, uint64_t end_us)
+    {
+      thread_buffer& b = get_thread_buffer();
+      std::lock_guard<std::mutex> lock(b.lock);
+      if (!b.capacity)
+        return;
+      event e = {category, name, start_us, end_us};
+      if (b.events.size() < b.capacity)
+      {
+        b.events.push_back(e);
+      }
+      else
+      {
+        b.events[b.next] = e;
+        b.next = (b.next + 1) % b.capacity;
+      }
+    }
+  }
+
+  void start(size_t events_per_thread)
+  {
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.lock);
+    r.capacity = events_per_thread;
+    for (const auto& b: r.buffers)
+    {
+      std::lock_guard<std::mutex> buffer_lock(b->lock);
+      b->events.clear();
+      b->next = 0;
+      b->capacity = events_per_thread;
+    }
+    // the ring sizes may have changed, don't hold on to storage sized for the old ones
+    r.free_buffers.clear();
+    std::vector<exited_event>().swap(r.exited_events);
+    r.exited_next = 0;
+    detail::g_enabled = events_per_thread != 0;
+  }
+
+  void stop()
+  {
+    detail::g_enabled = false;
+  }
+
+  bool is_enabled()
+  {
+    return detail::g_enabled;
+  }
+
+  namespace
+  {
+    void append_event(std::ostringstream& ss, bool& first, uint32_t tid, const event& e)
+    {
+      ss << (first ? "" : ",") << "{\"name\":";
+      append_json_string(ss, e.name);
+      ss << ",\"cat\":";
+      append_json_string(ss, e.category);
+      ss << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << e.start_us << ",\"dur\":" << e.end_us - e.start_us << "}";
+      first = false;
+    }
+  }
+
+  std::string to_chrome_trace()
+  {
+    std::ostringstream ss;
+    ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.lock);
+    for (const auto& b: r.buffers)
+    {
+      std::vector<event> events;
+      size_t next;
+      {
+        std::lock_guard<std::mutex> buffer_lock(b->lock);
+        events = b->events;
+        next = b->next;
+      }
+      // oldest first, once the ring wrapped the oldest sits at next
+      for (size_t i = 0; i < events.size(); ++i)
+        append_event(ss, first, b->tid, events[(next + i) % events.size()]);
+    }
+    for (size_t i = 0; i < r.exited_events.size(); ++i)
+    {
+      const exited_event& e = r.exited_events[(r.exited_next + i) % r.exited_events.size()];
+      append_event(ss, first, e.tid, e.e);
+    }
+    ss << "]}";
+    return ss.str();
+  }
+
+  bool write_chrome_trace(const std::string& path)
+  {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f)
+      return false;
+    f << to_chrome_trace();
+    return f.good();
+  }
+}
+}
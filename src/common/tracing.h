@@ -0,0 +1,104 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#define TRACE_DEFAULT_BUFFER_SIZE 65536
+
+/*! \brief Scoped tracing spans, exported in the Chrome trace event format
+ *
+ * Spans are cheap while tracing is off (one relaxed load). While it is on,
+ * each finished span goes into a ring buffer owned by the calling thread,
+ * the oldest spans are overwritten once it is full. When a thread exits its
+ * spans move to one ring of the same size shared by all exited threads and
+ * its buffer is reused by a later thread or freed. Names and categories
+ * must be string literals, only the pointers are stored.
+ *
+ *   TRACE_SPAN("blockchain", "handle_block_to_main_chain");
+ *
+ * to_chrome_trace() renders everything recorded so far as JSON that
+ * chrome://tracing or Perfetto can load.
+ */
+namespace tools
+{
+namespace tracing
+{
+  namespace detail
+  {
+    extern std::atomic<bool> g_enabled;
+    void record(const char* category, const char* name, uint64_t start_us, uint64_t end_us);
+  }
+
+  //! microseconds on the steady clock
+  inline uint64_t now_us()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /*! \brief Records [construction, destruction) as a complete event, if tracing was on at construction */
+  class span
+  {
+  public:
+    span(const char* category, const char* name)
+      : m_category(category), m_name(name), m_start(detail::g_enabled.load(std::memory_order_relaxed) ? now_us() : 0)
+    {
+    }
+
+    ~span()
+    {
+      if (m_start)
+        detail::record(m_category, m_name, m_start, now_us());
+    }
+
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+
+  private:
+    const char* m_category;
+    const char* m_name;
+    uint64_t m_start;
+  };
+
+  //! clears what was recorded and starts recording, keeping up to events_per_thread spans per thread
+  void start(size_t events_per_thread = TRACE_DEFAULT_BUFFER_SIZE);
+  //! stops recording, what was recorded is kept until the next start()
+  void stop();
+  bool is_enabled();
+
+  std::string to_chrome_trace();
+  bool write_chrome_trace(const std::string& path);
+}
+}
+
+#define TRACE_SPAN_CONCAT_(a, b) a##b
+#define TRACE_SPAN_CONCAT(a, b) TRACE_SPAN_CONCAT_(a, b)
+#define TRACE_SPAN(category, name) tools::tracing::span TRACE_SPAN_CONCAT(trace_span_, __LINE__)(category, name)
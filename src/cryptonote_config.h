@@ -81,6 +81,13 @@
 
 #define BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT          10000  //by default, blocks ids count in synchronizing
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT              200    //by default, blocks count in blocks downloading
+#define BLOCKS_SYNCHRONIZING_MIN_COUNT                  20     //fewest blocks asked from a peer in one request
+#define BLOCKS_SYNCHRONIZING_MAX_COUNT                  1000   //most blocks asked from a peer in one request
+#define BLOCKS_SYNCHRONIZING_MAX_SIZE                   (10 * 1024 * 1024) //bytes, estimated size limit of one request
+#define BLOCKS_SYNCHRONIZING_TARGET_TIME                5000   //ms, request size aims at this round trip time
+#define BLOCKS_REORDER_BUFFER_MAX_SIZE                  (100 * 1024 * 1024) //bytes of out of order block spans kept while synchronizing
+#define BLOCKS_SPAN_STALL_TIMEOUT                       30000  //ms, minimum time before a span in flight may be requested from another peer
+#define BLOCKS_SPAN_STALL_FACTOR                        4      //a span stalls after this many times its expected download time
 #define CRYPTONOTE_PROTOCOL_HOP_RELAX_COUNT             3      //value of hop, after which we use only announce of new block
 
 #define CRYPTONOTE_MEMPOOL_TX_LIVETIME                    86400 //seconds, one day
@@ -90,6 +97,7 @@
 
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                  1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                   5000
+#define P2P_PEERLIST_EVICTION_SAMPLES                   8          //entries sampled to pick the stalest one when a peerlist is full
 
 #define P2P_DEFAULT_CONNECTIONS_COUNT                   12
 #define P2P_DEFAULT_HANDSHAKE_INTERVAL                  60           //secondes
@@ -100,6 +108,9 @@
 #define P2P_DEFAULT_INVOKE_TIMEOUT                      60*2*1000  //2 minutes
 #define P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT            5000       //5 seconds
 #define P2P_DEFAULT_WHITELIST_CONNECTIONS_PERCENT       70
+#define P2P_DEFAULT_CONNECT_ATTEMPTS_IN_FLIGHT          8          //outgoing connection attempts running at once
+#define P2P_DEFAULT_CONNECT_BACKOFF                     5          //seconds before retrying a peer that failed once, doubled on every failure
+#define P2P_DEFAULT_CONNECT_BACKOFF_MAX                 60*60      //1 hour
 
 #define ALLOW_DEBUG_COMMANDS
 
@@ -108,6 +119,7 @@
 #define CRYPTONOTE_BLOCKCHAINDATA_FILENAME      "blockchain.bin"
 #define CRYPTONOTE_BLOCKCHAINDATA_TEMP_FILENAME "blockchain.bin.tmp"
 #define P2P_NET_DATA_FILENAME                   "p2pstate.bin"
+#define P2P_NET_DATA_DELTA_FILENAME             "p2pstate.delta"
 #define MINER_CONFIG_FILE_NAME                  "miner_conf.json"
 
 #define THREAD_STACK_SIZE                       5 * 1024 * 1024
@@ -51,6 +51,7 @@
 //#include "serialization/json_archive.h"
 #include "../../contrib/otshell_utils/utils.hpp"
 #include "../../src/p2p/data_logger.hpp"
+#include "common/tracing.h"
 
 using namespace cryptonote;
 
@@ -69,6 +70,14 @@ bool blockchain_storage::have_tx_keyimg_as_spent(const crypto::key_image &key_im
   return  m_spent_keys.find(key_im) != m_spent_keys.end();
 }
 //------------------------------------------------------------------
+void blockchain_storage::have_tx_keyimgs_as_spent(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  spent.resize(key_images.size());
+  for (size_t i = 0; i < key_images.size(); ++i)
+    spent[i] = m_spent_keys.find(key_images[i]) != m_spent_keys.end();
+}
+//------------------------------------------------------------------
 transaction *blockchain_storage::get_tx(const crypto::hash &id)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -94,6 +103,7 @@ bool blockchain_storage::init(const std::string& config_folder, bool testnet)
   const std::string filename = m_config_folder + "/" CRYPTONOTE_BLOCKCHAINDATA_FILENAME;
   if(tools::unserialize_obj_from_file(*this, filename))
   {
+      CHECK_AND_ASSERT_MES(build_output_data_index(), false, "Failed to build outputs index, blockchain.bin invalid");
 
       // checkpoints
       
@@ -247,6 +257,8 @@ bool blockchain_storage::reset_and_set_genesis_block(const block& b)
   m_blocks_index.clear();
   m_alternative_chains.clear();
   m_outputs.clear();
+  m_output_data.clear();
+  m_locked_outputs.clear();
 
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
   add_new_block(b, bvc);
@@ -1019,42 +1031,71 @@ size_t blockchain_storage::get_alternative_blocks_count()
   return m_alternative_chains.size();
 }
 //------------------------------------------------------------------
-bool blockchain_storage::add_out_to_get_random_outs(std::vector<std::pair<crypto::hash, size_t> >& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i)
+bool blockchain_storage::build_output_data_index()
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  transactions_container::iterator tx_it = m_transactions.find(amount_outs[i].first);
-  CHECK_AND_ASSERT_MES(tx_it != m_transactions.end(), false, "internal error: transaction with id " << amount_outs[i].first << ENDL <<
-    ", used in mounts global index for amount=" << amount << ": i=" << i << "not found in transactions index");
-  CHECK_AND_ASSERT_MES(tx_it->second.tx.vout.size() > amount_outs[i].second, false, "internal error: in global outs index, transaction out index="
-    << amount_outs[i].second << " more than transaction outputs = " << tx_it->second.tx.vout.size() << ", for tx id = " << amount_outs[i].first);
-  transaction& tx = tx_it->second.tx;
-  CHECK_AND_ASSERT_MES(tx.vout[amount_outs[i].second].target.type() == typeid(txout_to_key), false, "unknown tx out type");
+  m_output_data.clear();
+  m_locked_outputs.clear();
+  BOOST_FOREACH(const outputs_container::value_type& v, m_outputs)
+  {
+    m_output_data[v.first].reserve(v.second.size());
+    BOOST_FOREACH(const auto& out_entry, v.second)
+    {
+      auto tx_it = m_transactions.find(out_entry.first);
+      CHECK_AND_ASSERT_MES(tx_it != m_transactions.end(), false, "transactions outs global index consistency broken: wrong tx id in index");
+      const transaction& tx = tx_it->second.tx;
+      CHECK_AND_ASSERT_MES(tx.vout.size() > out_entry.second, false, "transactions outs global index consistency broken: index in tx_outx more then size");
+      output_data_t od = AUTO_VAL_INIT(od);
+      od.is_to_key = tx.vout[out_entry.second].target.type() == typeid(txout_to_key);
+      od.pubkey = od.is_to_key ? boost::get<txout_to_key>(tx.vout[out_entry.second].target).key : null_pkey;
+      od.unlock_time = tx.unlock_time;
+      od.height = tx_it->second.m_keeper_block_height;
+      push_output_data(v.first, od);
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------
+void blockchain_storage::push_output_data(uint64_t amount, const output_data_t& od)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  std::vector<output_data_t>& amount_data = m_output_data[amount];
+  //anything below find_end_of_allowed_index() is at least CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW blocks deep,
+  //so only outputs locked past that (or by time) can be refused there; coinbase outs never are
+  bool unlocked_by_depth = od.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER &&
+    od.unlock_time <= od.height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS;
+  if(!od.is_to_key || !unlocked_by_depth)
+    m_locked_outputs[amount].push_back(amount_data.size());
+  amount_data.push_back(od);
+}
+//------------------------------------------------------------------
+bool blockchain_storage::add_out_to_get_random_outs(const std::vector<output_data_t>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  const output_data_t& od = amount_outs[i];
+  CHECK_AND_ASSERT_MES(od.is_to_key, false, "unknown tx out type");
 
   //check if transaction is unlocked
-  if(!is_tx_spendtime_unlocked(tx.unlock_time))
+  if(!is_tx_spendtime_unlocked(od.unlock_time))
     return false;
 
   COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
   oen.global_amount_index = i;
-  oen.out_key = boost::get<txout_to_key>(tx.vout[amount_outs[i].second].target).key;
+  oen.out_key = od.pubkey;
   return true;
 }
 //------------------------------------------------------------------
-size_t blockchain_storage::find_end_of_allowed_index(const std::vector<std::pair<crypto::hash, size_t> >& amount_outs)
+size_t blockchain_storage::find_end_of_allowed_index(const std::vector<output_data_t>& amount_outs)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  if(!amount_outs.size())
+  uint64_t current_height = get_current_blockchain_height();
+  if(current_height < CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW)
     return 0;
-  size_t i = amount_outs.size();
-  do
-  {
-    --i;
-    transactions_container::iterator it = m_transactions.find(amount_outs[i].first);
-    CHECK_AND_ASSERT_MES(it != m_transactions.end(), 0, "internal error: failed to find transaction from outputs index with tx_id=" << amount_outs[i].first);
-    if(it->second.m_keeper_block_height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW <= get_current_blockchain_height() )
-      return i+1;
-  } while (i != 0);
-  return 0;
+  // outputs are appended block by block, so heights never decrease along the index
+  uint64_t max_allowed_height = current_height - CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+  auto it = std::upper_bound(amount_outs.begin(), amount_outs.end(), max_allowed_height,
+    [](uint64_t height, const output_data_t& od) { return height < od.height; });
+  return it - amount_outs.begin();
 }
 //------------------------------------------------------------------
 bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res)
@@ -1064,31 +1105,42 @@ bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDO
   {
     COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
     result_outs.amount = amount;
-    auto it = m_outputs.find(amount);
-    if(it == m_outputs.end())
+    auto it = m_output_data.find(amount);
+    if(it == m_output_data.end())
     {
       LOG_PRINT_L1("COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS: not outs for amount " << amount << ", wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist");
       continue;//actually this is strange situation, wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist
     }
-    std::vector<std::pair<crypto::hash, size_t> >& amount_outs  = it->second;
+    const std::vector<output_data_t>& amount_outs = it->second;
     //it is not good idea to use top fresh outs, because it increases possibility of transaction canceling on split
     //lets find upper bound of not fresh outs
     size_t up_index_limit = find_end_of_allowed_index(amount_outs);
     CHECK_AND_ASSERT_MES(up_index_limit <= amount_outs.size(), false, "internal error: find_end_of_allowed_index returned wrong index=" << up_index_limit << ", with amount_outs.size = " << amount_outs.size());
-    if(amount_outs.size() > req.outs_count)
+    //only outputs from the locked list can be refused below the limit, so count them once up front
+    size_t refused_count = 0;
+    auto locked_it = m_locked_outputs.find(amount);
+    if(locked_it != m_locked_outputs.end())
     {
-      std::set<size_t> used;
-      size_t try_count = 0;
-      for(uint64_t j = 0; j != req.outs_count && try_count < up_index_limit;)
+      BOOST_FOREACH(size_t i, locked_it->second)
+      {
+        if(i >= up_index_limit)
+          break;
+        if(!amount_outs[i].is_to_key || !is_tx_spendtime_unlocked(amount_outs[i].unlock_time))
+          ++refused_count;
+      }
+    }
+    if(up_index_limit - refused_count > req.outs_count)
+    {
+      //enough usable outs are known to exist, so this always terminates
+      std::unordered_set<size_t> used;
+      used.reserve(req.outs_count * 2);
+      for(uint64_t j = 0; j != req.outs_count;)
       {
         size_t i = crypto::rand<size_t>()%up_index_limit;
-        if(used.count(i))
+        if(!used.insert(i).second)
           continue;
-        bool added = add_out_to_get_random_outs(amount_outs, result_outs, amount, i);
-        used.insert(i);
-        if(added)
+        if(add_out_to_get_random_outs(amount_outs, result_outs, amount, i))
           ++j;
-        ++try_count;
       }
     }else
     {
@@ -1270,6 +1322,23 @@ bool blockchain_storage::find_blockchain_supplement(const uint64_t req_start_blo
   return true;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& block_ids, uint64_t& total_height, uint64_t& start_height, size_t max_count)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if(req_start_block > 0) {
+    start_height = req_start_block;
+  } else {
+    if(!find_blockchain_supplement(qblock_ids, start_height))
+      return false;
+  }
+
+  total_height = get_current_blockchain_height();
+  size_t count = 0;
+  for(size_t i = start_height; i < m_blocks.size() && count < max_count; i++, count++)
+    block_ids.push_back(get_block_hash(m_blocks[i].bl));
+  return true;
+}
+//------------------------------------------------------------------
 bool blockchain_storage::add_block_as_invalid(const block& bl, const crypto::hash& h)
 {
   block_extended_info bei = AUTO_VAL_INIT(bei);
@@ -1310,7 +1379,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, block_verif
   return handle_block_to_main_chain(bl, id, bvc);
 }
 //------------------------------------------------------------------
-bool blockchain_storage::push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes)
+bool blockchain_storage::push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, uint64_t bl_height, std::vector<uint64_t>& global_indexes)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   size_t i = 0;
@@ -1319,6 +1388,13 @@ bool blockchain_storage::push_transaction_to_global_outs_index(const transaction
     outputs_container::mapped_type& amount_index = m_outputs[ot.amount];
     amount_index.push_back(std::pair<crypto::hash, size_t>(tx_id, i));
     global_indexes.push_back(amount_index.size()-1);
+
+    output_data_t od = AUTO_VAL_INIT(od);
+    od.is_to_key = ot.target.type() == typeid(txout_to_key);
+    od.pubkey = od.is_to_key ? boost::get<txout_to_key>(ot.target).key : null_pkey;
+    od.unlock_time = tx.unlock_time;
+    od.height = bl_height;
+    push_output_data(ot.amount, od);
     ++i;
   }
   return true;
@@ -1333,17 +1409,14 @@ size_t blockchain_storage::get_total_transactions()
 bool blockchain_storage::get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  auto it = m_outputs.find(amount);
-  if(it == m_outputs.end())
+  auto it = m_output_data.find(amount);
+  if(it == m_output_data.end())
     return true;
 
-  BOOST_FOREACH(const auto& out_entry, it->second)
+  BOOST_FOREACH(const output_data_t& od, it->second)
   {
-    auto tx_it = m_transactions.find(out_entry.first);
-    CHECK_AND_ASSERT_MES(tx_it != m_transactions.end(), false, "transactions outs global index consistency broken: wrong tx id in index");
-    CHECK_AND_ASSERT_MES(tx_it->second.tx.vout.size() > out_entry.second, false, "transactions outs global index consistency broken: index in tx_outx more then size");
-    CHECK_AND_ASSERT_MES(tx_it->second.tx.vout[out_entry.second].target.type() == typeid(txout_to_key), false, "transactions outs global index consistency broken: index in tx_outx more then size");
-    pkeys.push_back(boost::get<txout_to_key>(tx_it->second.tx.vout[out_entry.second].target).key);
+    CHECK_AND_ASSERT_MES(od.is_to_key, false, "transactions outs global index consistency broken: unexpected output type in index");
+    pkeys.push_back(od.pubkey);
   }
 
   return true;
@@ -1361,6 +1434,12 @@ bool blockchain_storage::pop_transaction_from_global_index(const transaction& tx
     CHECK_AND_ASSERT_MES(it->second.back().first == tx_id , false, "transactions outs global index consistency broken: tx id missmatch");
     CHECK_AND_ASSERT_MES(it->second.back().second == i, false, "transactions outs global index consistency broken: in transaction index missmatch");
     it->second.pop_back();
+    auto data_it = m_output_data.find(ot.amount);
+    CHECK_AND_ASSERT_MES(data_it != m_output_data.end() && data_it->second.size() == it->second.size() + 1, false, "transactions outs data index consistency broken");
+    data_it->second.pop_back();
+    auto locked_it = m_locked_outputs.find(ot.amount);
+    if(locked_it != m_locked_outputs.end() && !locked_it->second.empty() && locked_it->second.back() == data_it->second.size())
+      locked_it->second.pop_back();
     --i;
   }
   return true;
@@ -1413,7 +1492,7 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
     LOG_PRINT_L1("tx with id: " << tx_id << " in block id: " << bl_id << " already in blockchain");
     return false;
   }
-  bool r = push_transaction_to_global_outs_index(tx, tx_id, i_r.first->second.m_global_output_indexes);
+  bool r = push_transaction_to_global_outs_index(tx, tx_id, bl_height, i_r.first->second.m_global_output_indexes);
   CHECK_AND_ASSERT_MES(r, false, "failed to return push_transaction_to_global_outs_index tx id " << tx_id);
   LOG_PRINT_L2("Added transaction to blockchain history:" << ENDL
     << "tx_id: " << tx_id << ENDL
@@ -1465,6 +1544,9 @@ bool blockchain_storage::check_tx_inputs(const transaction& tx, uint64_t* pmax_u
 //------------------------------------------------------------------
 bool blockchain_storage::check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height)
 {
+  TRACE_SPAN("blockchain", "check_tx_inputs");
+  static tools::metrics::histogram& validation_time = tools::metrics::registry::instance().get_histogram("tx_inputs_validation_seconds", "Time to check all inputs of a transaction");
+  tools::metrics::scoped_timer validation_timer(validation_time);
   size_t sig_index = 0;
   if(pmax_used_block_height)
     *pmax_used_block_height = 0;
@@ -1526,22 +1608,22 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
     blockchain_storage& m_bch;
     outputs_visitor(std::vector<const crypto::public_key *>& results_collector, blockchain_storage& bch):m_results_collector(results_collector), m_bch(bch)
     {}
-    bool handle_output(const transaction& tx, const tx_out& out)
+    bool handle_output(const output_data_t& od)
     {
       //check tx unlock time
-      if(!m_bch.is_tx_spendtime_unlocked(tx.unlock_time))
+      if(!m_bch.is_tx_spendtime_unlocked(od.unlock_time))
       {
-        LOG_PRINT_L1("One of outputs for one of inputs has wrong tx.unlock_time = " << tx.unlock_time);
+        LOG_PRINT_L1("One of outputs for one of inputs has wrong tx.unlock_time = " << od.unlock_time);
         return false;
       }
 
-      if(out.target.type() != typeid(txout_to_key))
+      if(!od.is_to_key)
       {
-        LOG_PRINT_L1("Output has wrong type id, which=" << out.target.which());
+        LOG_PRINT_L1("Output has wrong type id, expected txout_to_key");
         return false;
       }
 
-      m_results_collector.push_back(&boost::get<txout_to_key>(out.target).key);
+      m_results_collector.push_back(&od.pubkey);
       return true;
     }
   };
@@ -1563,6 +1645,8 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
   CHECK_AND_ASSERT_MES(sig.size() == output_keys.size(), false, "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size());
   if(m_is_in_checkpoint_zone)
     return true;
+  static tools::metrics::histogram& ring_sig_time = tools::metrics::registry::instance().get_histogram("ring_signature_verify_seconds", "Time to verify one ring signature");
+  tools::metrics::scoped_timer ring_sig_timer(ring_sig_time);
   return crypto::check_ring_signature(tx_prefix_hash, txin.k_image, output_keys, sig.data());
 }
 //------------------------------------------------------------------
@@ -1606,8 +1690,11 @@ bool blockchain_storage::check_block_timestamp(std::vector<uint64_t> timestamps,
 //------------------------------------------------------------------
 bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc)
 {
+  TRACE_SPAN("blockchain", "handle_block_to_main_chain");
   TIME_MEASURE_START(block_processing_time);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  static tools::metrics::histogram& block_time = tools::metrics::registry::instance().get_histogram("block_validation_seconds", "Time to validate and add a block to the main chain, lock wait excluded");
+  tools::metrics::scoped_timer block_timer(block_time);
   if(bl.prev_id != get_tail_id())
   {
     LOG_PRINT_L1("Block with id: " << id << ENDL
@@ -1639,7 +1726,11 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   // before checkpoints, which is very dangerous behaviour. We moved the PoW
   // validation out of the next chunk of code to make sure that we correctly
   // check PoW now.
-  proof_of_work = get_block_longhash(bl, m_blocks.size());
+  {
+    static tools::metrics::histogram& pow_time = tools::metrics::registry::instance().get_histogram("block_pow_seconds", "Time to compute the proof of work hash of a block");
+    tools::metrics::scoped_timer pow_timer(pow_time);
+    proof_of_work = get_block_longhash(bl, m_blocks.size());
+  }
 
   if(!check_hash(proof_of_work, current_diffic))
   {
@@ -1772,13 +1863,15 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
     << "), coinbase_blob_size: " << coinbase_blob_size << ", cumulative size: " << cumulative_block_size
     << ", " << block_processing_time << "("<< target_calculating_time << "/" << longhash_calculating_time << ")ms");
 
-	epee::net_utils::data_logger::get_instance().add_data("blockchain_processing_time", block_processing_time);
+  static const epee::net_utils::data_logger::channel processing_time_channel = epee::net_utils::data_logger::get_instance().get_channel("blockchain_processing_time");
+  epee::net_utils::data_logger::get_instance().add_data(processing_time_channel, block_processing_time);
 
   bvc.m_added_to_main_chain = true;
   /*if(!m_orphanes_reorganize_in_work)
     review_orphaned_blocks_with_new_block_id(id, true);*/
 
   m_tx_pool.on_blockchain_inc(bei.height, id);
+  m_tx_pool.get_fee_estimator().add_block(bei.height, bl.tx_hashes);
   //LOG_PRINT_L0("BLOCK: " << ENDL << "" << dump_obj_as_json(bei.bl));
   return true;
 }
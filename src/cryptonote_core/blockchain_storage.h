@@ -44,6 +44,7 @@
 #include "tx_pool.h"
 #include "cryptonote_basic.h"
 #include "common/util.h"
+#include "common/metrics.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "difficulty.h"
@@ -78,7 +79,9 @@ namespace cryptonote
       uint64_t already_generated_coins;
     };
 
-    blockchain_storage(tx_memory_pool& tx_pool):m_tx_pool(tx_pool), m_current_block_cumul_sz_limit(0), m_is_in_checkpoint_zone(false), m_is_blockchain_storing(false), m_enforce_dns_checkpoints(false)
+    blockchain_storage(tx_memory_pool& tx_pool):m_tx_pool(tx_pool),
+      m_blockchain_lock(tools::metrics::registry::instance().get_histogram("blockchain_lock_wait_seconds", "Time spent waiting for the blockchain lock")),
+      m_current_block_cumul_sz_limit(0), m_is_in_checkpoint_zone(false), m_is_blockchain_storing(false), m_enforce_dns_checkpoints(false)
     {};
 
     bool init() { return init(tools::get_default_data_dir(), true); }
@@ -102,6 +105,7 @@ namespace cryptonote
     bool have_tx(const crypto::hash &id);
     bool have_tx_keyimges_as_spent(const transaction &tx);
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im);
+    void have_tx_keyimgs_as_spent(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent);
     transaction *get_tx(const crypto::hash &id);
 
     template<class visitor_t>
@@ -121,6 +125,7 @@ namespace cryptonote
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp);
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset);
     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+    bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& block_ids, uint64_t& total_height, uint64_t& start_height, size_t max_count);
     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp);
     bool handle_get_objects(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
     bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
@@ -194,8 +199,20 @@ namespace cryptonote
     typedef std::unordered_map<crypto::hash, block> blocks_by_hash;
     typedef std::map<uint64_t, std::vector<std::pair<crypto::hash, size_t>>> outputs_container; //crypto::hash - tx hash, size_t - index of out in transaction
 
+    // everything ring member resolution and random output selection need to know
+    // about an output, so they never have to go through m_transactions
+    struct output_data_t
+    {
+      crypto::public_key pubkey;  // null_pkey unless is_to_key
+      uint64_t unlock_time;       // of the owning transaction
+      uint64_t height;            // keeper block height of the owning transaction
+      bool is_to_key;
+    };
+    typedef std::unordered_map<uint64_t, std::vector<output_data_t> > output_data_container; // amount -> outputs by global amount index
+    typedef std::unordered_map<uint64_t, std::vector<size_t> > output_exceptions_container; // amount -> ascending global amount indexes
+
     tx_memory_pool& m_tx_pool;
-    epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
+    tools::metrics::timed_critical_section m_blockchain_lock; // TODO: add here reader/writer lock
 
     // main chain
     blocks_container m_blocks;               // height  -> block_extended_info
@@ -211,6 +228,9 @@ namespace cryptonote
     // some invalid blocks
     blocks_ext_by_hash m_invalid_blocks;     // crypto::hash -> block_extended_info
     outputs_container m_outputs;
+    output_data_container m_output_data;     // mirrors m_outputs, rebuilt on load, not serialized
+    output_exceptions_container m_locked_outputs; // outputs random outs may have to skip even below the unlock window
+    friend class random_outs_test;
 
 
     std::string m_config_folder;
@@ -236,14 +256,16 @@ namespace cryptonote
     bool validate_transaction(const block& b, uint64_t height, const transaction& tx);
     bool rollback_blockchain_switching(std::list<block>& original_chain, size_t rollback_height);
     bool add_transaction_from_block(const transaction& tx, const crypto::hash& tx_id, const crypto::hash& bl_id, uint64_t bl_height, size_t blob_size);
-    bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes);
+    bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, uint64_t bl_height, std::vector<uint64_t>& global_indexes);
     bool pop_transaction_from_global_index(const transaction& tx, const crypto::hash& tx_id);
     bool get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count);
-    bool add_out_to_get_random_outs(std::vector<std::pair<crypto::hash, size_t> >& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i);
+    bool build_output_data_index();
+    void push_output_data(uint64_t amount, const output_data_t& od);
+    bool add_out_to_get_random_outs(const std::vector<output_data_t>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
     bool add_block_as_invalid(const block& bl, const crypto::hash& h);
     bool add_block_as_invalid(const block_extended_info& bei, const crypto::hash& h);
-    size_t find_end_of_allowed_index(const std::vector<std::pair<crypto::hash, size_t> >& amount_outs);
+    size_t find_end_of_allowed_index(const std::vector<output_data_t>& amount_outs);
     bool check_block_timestamp_main(const block& b);
     bool check_block_timestamp(std::vector<uint64_t> timestamps, const block& b);
     uint64_t get_adjusted_time();
@@ -320,14 +342,14 @@ namespace cryptonote
   bool blockchain_storage::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, visitor_t& vis, uint64_t* pmax_related_block_height)
   {
     CRITICAL_REGION_LOCAL(m_blockchain_lock);
-    auto it = m_outputs.find(tx_in_to_key.amount);
-    if(it == m_outputs.end() || !tx_in_to_key.key_offsets.size())
+    auto it = m_output_data.find(tx_in_to_key.amount);
+    if(it == m_output_data.end() || !tx_in_to_key.key_offsets.size())
       return false;
 
     std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.key_offsets);
 
 
-    std::vector<std::pair<crypto::hash, size_t> >& amount_outs_vec = it->second;
+    const std::vector<output_data_t>& amount_outs_vec = it->second;
     size_t count = 0;
     BOOST_FOREACH(uint64_t i, absolute_offsets)
     {
@@ -336,19 +358,16 @@ namespace cryptonote
         LOG_PRINT_L0("Wrong index in transaction inputs: " << i << ", expected maximum " << amount_outs_vec.size() - 1);
         return false;
       }
-      transactions_container::iterator tx_it = m_transactions.find(amount_outs_vec[i].first);
-      CHECK_AND_ASSERT_MES(tx_it != m_transactions.end(), false, "Wrong transaction id in output indexes: " << epee::string_tools::pod_to_hex(amount_outs_vec[i].first));
-      CHECK_AND_ASSERT_MES(amount_outs_vec[i].second < tx_it->second.tx.vout.size(), false,
-        "Wrong index in transaction outputs: " << amount_outs_vec[i].second << ", expected less then " << tx_it->second.tx.vout.size());
-      if(!vis.handle_output(tx_it->second.tx, tx_it->second.tx.vout[amount_outs_vec[i].second]))
+      const output_data_t& od = amount_outs_vec[i];
+      if(!vis.handle_output(od))
       {
         LOG_PRINT_L0("Failed to handle_output for output no = " << count << ", with absolute offset " << i);
         return false;
       }
       if(count++ == absolute_offsets.size()-1 && pmax_related_block_height)
       {
-        if(*pmax_related_block_height < tx_it->second.m_keeper_block_height)
-          *pmax_related_block_height = tx_it->second.m_keeper_block_height;
+        if(*pmax_related_block_height < od.height)
+          *pmax_related_block_height = od.height;
       }
     }
 
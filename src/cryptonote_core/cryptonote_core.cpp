@@ -35,6 +35,7 @@ using namespace epee;
 #include <unordered_set>
 #include "cryptonote_core.h"
 #include "common/command_line.h"
+#include "common/tracing.h"
 #include "common/util.h"
 #include "warnings.h"
 #include "crypto/crypto.h"
@@ -268,6 +269,7 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block)
   {
+    TRACE_SPAN("core", "handle_incoming_tx");
     tvc = boost::value_initialized<tx_verification_context>();
     //want to process all transactions sequentially
     CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
@@ -443,6 +445,11 @@ namespace cryptonote
     return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, blocks, total_height, start_height, max_count);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& block_ids, uint64_t& total_height, uint64_t& start_height, size_t max_count)
+  {
+    return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, block_ids, total_height, start_height, max_count);
+  }
+  //-----------------------------------------------------------------------------------------------
   void core::print_blockchain(uint64_t start_index, uint64_t end_index)
   {
     m_blockchain_storage.print_blockchain(start_index, end_index);
@@ -532,6 +539,7 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate)
   {
+    TRACE_SPAN("core", "handle_incoming_block");
     // load json & DNS checkpoints every 10min/hour respectively,
     // and verify them with respect to what blocks we already have
     CHECK_AND_ASSERT_MES(update_checkpoints(), false, "One or more checkpoints loaded from json or dns conflicted with existing checkpoints.");
@@ -579,6 +587,22 @@ namespace cryptonote
     return m_mempool.get_transactions_count();
   }
   //-----------------------------------------------------------------------------------------------
+  void core::get_pool_changes(uint64_t epoch, uint64_t version, std::vector<tx_memory_pool::tx_pool_entry>& added, std::vector<crypto::hash>& removed, uint64_t& new_epoch, uint64_t& new_version, bool& full)
+  {
+    full = false;
+    new_epoch = epoch;
+    if (m_mempool.get_pool_delta(epoch, version, added, removed, new_version))
+      return;
+    full = true;
+    removed.clear();
+    m_mempool.get_pool_snapshot(added, new_epoch, new_version);
+  }
+  //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_fee_estimate(uint64_t target_blocks)
+  {
+    return std::max(m_mempool.get_fee_estimator().estimate_fee_per_kb(target_blocks), FEE_PER_KB);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id)
   {
     return m_blockchain_storage.have_block(id);
@@ -600,6 +624,28 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::are_key_images_spent(const std::vector<crypto::key_image>& key_images, std::vector<uint8_t>& spent_status)
+  {
+    std::vector<bool> spent_in_chain;
+    std::vector<bool> spent_in_pool;
+    // pool first: a transaction mined in between moves from the pool to the chain,
+    // so the chain check still sees it and a spent key image never reads as unspent
+    m_mempool.have_key_images_as_spent(key_images, spent_in_pool);
+    m_blockchain_storage.have_tx_keyimgs_as_spent(key_images, spent_in_chain);
+
+    spent_status.resize(key_images.size());
+    for (size_t i = 0; i < key_images.size(); ++i)
+    {
+      if (spent_in_chain[i])
+        spent_status[i] = KEY_IMAGE_SPENT_IN_BLOCKCHAIN;
+      else if (spent_in_pool[i])
+        spent_status[i] = KEY_IMAGE_SPENT_IN_POOL;
+      else
+        spent_status[i] = KEY_IMAGE_UNSPENT;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_short_chain_history(std::list<crypto::hash>& ids)
   {
     return m_blockchain_storage.get_short_chain_history(ids);
@@ -54,6 +54,10 @@ namespace cryptonote
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
+   const uint8_t KEY_IMAGE_UNSPENT = 0;
+   const uint8_t KEY_IMAGE_SPENT_IN_BLOCKCHAIN = 1;
+   const uint8_t KEY_IMAGE_SPENT_IN_POOL = 2;
+
    class core: public i_miner_handler
    {
    public:
@@ -104,13 +108,21 @@ namespace cryptonote
      void set_enforce_dns_checkpoints(bool enforce_dns);
 
      bool get_pool_transactions(std::list<transaction>& txs);
+     // spent_status gets one KEY_IMAGE_* value per key image, in request order
+     bool are_key_images_spent(const std::vector<crypto::key_image>& key_images, std::vector<uint8_t>& spent_status);
      size_t get_pool_transactions_count();
+     // changes since (epoch, version), or the whole pool with full set when
+     // that state is unknown or too old to diff against
+     void get_pool_changes(uint64_t epoch, uint64_t version, std::vector<tx_memory_pool::tx_pool_entry>& added, std::vector<crypto::hash>& removed, uint64_t& new_epoch, uint64_t& new_version, bool& full);
+     // fee per kB to get mined within target_blocks, never below FEE_PER_KB
+     uint64_t get_fee_estimate(uint64_t target_blocks);
      size_t get_blockchain_total_transactions();
      //bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
      bool have_block(const crypto::hash& id);
      bool get_short_chain_history(std::list<crypto::hash>& ids);
      bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp);
      bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& block_ids, uint64_t& total_height, uint64_t& start_height, size_t max_count);
      bool get_stat_info(core_stat_info& st_inf);
      //bool get_backward_blocks_sizes(uint64_t from_height, std::vector<size_t>& sizes, size_t count);
      bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs);
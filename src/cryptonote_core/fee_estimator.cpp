@@ -0,0 +1,146 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "fee_estimator.h"
+#include "cryptonote_config.h"
+
+namespace cryptonote
+{
+  namespace
+  {
+    // buckets go from the minimum relay fee up to 1000 times that, 10% apart
+    double const BUCKET_SPACING = 1.1;
+    uint64_t const MAX_BUCKET_FEE = 1000 * FEE_PER_KB;
+    // per block; halves the weight of old data in about 350 blocks
+    double const DECAY = 0.998;
+    // share of transactions that must have made it for a fee to pass
+    double const SUCCESS_RATE = 0.85;
+    // minimum (decayed) number of transactions to judge a fee range by
+    double const SUFFICIENT_TXS = 5.0;
+  }
+
+  const uint64_t fee_estimator::max_target_blocks;
+
+  //---------------------------------------------------------------------------------
+  fee_estimator::fee_estimator(): m_height(0)
+  {
+    for (double fee = FEE_PER_KB; fee <= MAX_BUCKET_FEE; fee *= BUCKET_SPACING)
+      m_bucket_fees.push_back(static_cast<uint64_t>(fee));
+    m_resolved.resize(m_bucket_fees.size(), 0.0);
+    m_confirmed.resize(max_target_blocks, std::vector<double>(m_bucket_fees.size(), 0.0));
+  }
+  //---------------------------------------------------------------------------------
+  size_t fee_estimator::get_bucket(uint64_t fee, size_t blob_size) const
+  {
+    double fee_per_kb = static_cast<double>(fee) * 1024 / blob_size;
+    auto it = std::upper_bound(m_bucket_fees.begin(), m_bucket_fees.end(), fee_per_kb,
+        [](double f, uint64_t bucket_fee) { return f < bucket_fee; });
+    return it - m_bucket_fees.begin() - 1;
+  }
+  //---------------------------------------------------------------------------------
+  void fee_estimator::add_tx(const crypto::hash& id, uint64_t fee, size_t blob_size, uint64_t height)
+  {
+    // below the relay minimum a transaction says nothing about the market
+    if (!blob_size || static_cast<double>(fee) * 1024 / blob_size < m_bucket_fees.front())
+      return;
+
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_pending[id] = pending_tx{get_bucket(fee, blob_size), height};
+    m_height = std::max(m_height, height);
+  }
+  //---------------------------------------------------------------------------------
+  void fee_estimator::remove_tx(const crypto::hash& id)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    auto it = m_pending.find(id);
+    if (it == m_pending.end())
+      return;
+    // counts as a miss for every target
+    m_resolved[it->second.bucket] += 1.0;
+    m_pending.erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  void fee_estimator::add_block(uint64_t height, const std::vector<crypto::hash>& tx_hashes)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    for (auto& count: m_resolved)
+      count *= DECAY;
+    for (auto& target: m_confirmed)
+      for (auto& count: target)
+        count *= DECAY;
+
+    for (const auto& id: tx_hashes)
+    {
+      auto it = m_pending.find(id);
+      if (it == m_pending.end())
+        continue;
+      const pending_tx& ptx = it->second;
+      uint64_t blocks = height >= ptx.height ? height - ptx.height + 1 : 1;
+      m_resolved[ptx.bucket] += 1.0;
+      for (uint64_t target = blocks; target <= max_target_blocks; ++target)
+        m_confirmed[target - 1][ptx.bucket] += 1.0;
+      m_pending.erase(it);
+    }
+    m_height = std::max(m_height, height + 1);
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t fee_estimator::estimate_fee_per_kb(uint64_t target_blocks) const
+  {
+    target_blocks = std::min(std::max<uint64_t>(target_blocks, 1), max_target_blocks);
+
+    CRITICAL_REGION_LOCAL(m_lock);
+    // transactions still in the pool that already waited longer than the
+    // target are misses too, or a fee that stopped working would go unnoticed
+    std::vector<double> overdue(m_bucket_fees.size(), 0.0);
+    for (const auto& ptx: m_pending)
+    {
+      if (m_height - ptx.second.height >= target_blocks)
+        overdue[ptx.second.bucket] += 1.0;
+    }
+
+    // walk down from the highest fees, taking the lowest range that still
+    // passes; ranges are grouped until they hold enough transactions
+    const std::vector<double>& confirmed = m_confirmed[target_blocks - 1];
+    double range_confirmed = 0, range_total = 0;
+    size_t best = m_bucket_fees.size();
+    for (size_t bucket = m_bucket_fees.size(); bucket-- > 0; )
+    {
+      range_confirmed += confirmed[bucket];
+      range_total += m_resolved[bucket] + overdue[bucket];
+      if (range_total < SUFFICIENT_TXS)
+        continue;
+      if (range_confirmed / range_total < SUCCESS_RATE)
+        break;
+      best = bucket;
+      range_confirmed = range_total = 0;
+    }
+    return best < m_bucket_fees.size() ? m_bucket_fees[best] : 0;
+  }
+}
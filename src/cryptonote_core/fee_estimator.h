@@ -0,0 +1,84 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <boost/utility.hpp>
+
+#include "syncobj.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Learns how fast transactions get mined depending on the fee per kB they
+  // pay. Pool transactions are sorted into exponentially spaced fee buckets
+  // when they are received; when a block makes it to the main chain, the
+  // number of blocks each of its transactions waited is recorded against its
+  // bucket. Counts decay with every block so that the estimate follows the
+  // current market.
+  class fee_estimator: boost::noncopyable
+  {
+  public:
+    static const uint64_t max_target_blocks = 48;
+
+    fee_estimator();
+
+    // a transaction entered the pool while the chain was height blocks long
+    void add_tx(const crypto::hash& id, uint64_t fee, size_t blob_size, uint64_t height);
+    // a transaction left the pool without being mined
+    void remove_tx(const crypto::hash& id);
+    // the block at this height was added to the main chain
+    void add_block(uint64_t height, const std::vector<crypto::hash>& tx_hashes);
+
+    // lowest fee per kB that got transactions mined within target_blocks
+    // often enough, or 0 if there is not enough data yet
+    uint64_t estimate_fee_per_kb(uint64_t target_blocks) const;
+
+  private:
+    struct pending_tx
+    {
+      size_t bucket;
+      uint64_t height;
+    };
+
+    size_t get_bucket(uint64_t fee, size_t blob_size) const;
+
+    mutable epee::critical_section m_lock;
+    std::vector<uint64_t> m_bucket_fees;             // lower bound of each bucket, fee per kB
+    std::vector<double> m_resolved;                  // per bucket: transactions mined or dropped
+    std::vector<std::vector<double> > m_confirmed;   // per target, per bucket: mined within target blocks
+    std::unordered_map<crypto::hash, pending_tx> m_pending;
+    uint64_t m_height;
+  };
+}
@@ -40,8 +40,10 @@
 #include "blockchain_storage.h"
 #include "common/boost_serialization_helper.h"
 #include "common/int-util.h"
+#include "common/metrics.h"
 #include "misc_language.h"
 #include "warnings.h"
+#include "crypto/crypto.h"
 #include "crypto/hash.h"
 
 DISABLE_VS_WARNINGS(4244 4345 4503) //'boost::foreach_detail_::or_' : decorated name length exceeded, name was truncated
@@ -51,10 +53,23 @@ namespace cryptonote
   namespace
   {
     size_t const TRANSACTION_SIZE_LIMIT = (((CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE * 125) / 100) - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE);
+    size_t const POOL_JOURNAL_MAX_SIZE = 16384;
+
+    tools::metrics::gauge& pool_size_gauge()
+    {
+      static tools::metrics::gauge& g = tools::metrics::registry::instance().get_gauge("txpool_transactions", "Transactions in the memory pool");
+      return g;
+    }
+
+    tools::metrics::gauge& pool_bytes_gauge()
+    {
+      static tools::metrics::gauge& g = tools::metrics::registry::instance().get_gauge("txpool_bytes", "Sum of the blob sizes of the transactions in the memory pool");
+      return g;
+    }
   }
 
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_blockchain(bchs)
+  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_epoch(crypto::rand<uint64_t>()), m_version(0), m_blockchain(bchs)
   {
 
   }
@@ -118,6 +133,8 @@ namespace cryptonote
     crypto::hash max_used_block_id = null_hash;
     uint64_t max_used_block_height = 0;
     bool ch_inp_res = m_blockchain.check_tx_inputs(tx, max_used_block_height, max_used_block_id);
+    // taken before the pool lock, the blockchain locks the other way round
+    uint64_t chain_height = kept_by_block ? 0 : m_blockchain.get_current_blockchain_height();
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     if(!ch_inp_res)
     {
@@ -133,6 +150,9 @@ namespace cryptonote
         txd_p.first->second.max_used_block_height = 0;
         txd_p.first->second.kept_by_block = kept_by_block;
         txd_p.first->second.receive_time = time(nullptr);
+        pool_size_gauge().set(m_transactions.size());
+        pool_bytes_gauge().add(blob_size);
+        journal_add(id);
         tvc.m_verifivation_impossible = true;
         tvc.m_added_to_pool = true;
       }else
@@ -155,6 +175,11 @@ namespace cryptonote
       txd_p.first->second.last_failed_height = 0;
       txd_p.first->second.last_failed_id = null_hash;
       txd_p.first->second.receive_time = time(nullptr);
+      pool_size_gauge().set(m_transactions.size());
+      pool_bytes_gauge().add(blob_size);
+      journal_add(id);
+      if (!kept_by_block)
+        m_fee_estimator.add_tx(id, txd_p.first->second.fee, blob_size, chain_height);
       tvc.m_added_to_pool = true;
 
       if(txd_p.first->second.fee > 0)
@@ -226,6 +251,9 @@ namespace cryptonote
     fee = it->second.fee;
     remove_transaction_keyimages(it->second.tx);
     m_transactions.erase(it);
+    journal_remove(id);
+    pool_size_gauge().set(m_transactions.size());
+    pool_bytes_gauge().add(-static_cast<int64_t>(blob_size));
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -246,10 +274,14 @@ namespace cryptonote
          (tx_age > CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME && it->second.kept_by_block) )
       {
         LOG_PRINT_L1("Tx " << it->first << " removed from tx pool due to outdated, age: " << tx_age );
+        pool_bytes_gauge().add(-static_cast<int64_t>(it->second.blob_size));
+        journal_remove(it->first);
+        m_fee_estimator.remove_tx(it->first);
         m_transactions.erase(it++);
       }else
         ++it;
     }
+    pool_size_gauge().set(m_transactions.size());
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -276,6 +308,63 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::get_pool_snapshot(std::vector<tx_pool_entry>& entries, uint64_t& epoch, uint64_t& version) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    entries.clear();
+    entries.reserve(m_transactions.size());
+    for (const auto& tx_vt: m_transactions)
+      entries.push_back({tx_vt.first, tx_vt.second.blob_size, tx_vt.second.fee, tx_vt.second.receive_time});
+    epoch = m_epoch;
+    version = m_version;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_pool_delta(uint64_t epoch, uint64_t since_version, std::vector<tx_pool_entry>& added, std::vector<crypto::hash>& removed, uint64_t& version) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    added.clear();
+    removed.clear();
+    version = m_version;
+    if (epoch != m_epoch || since_version > m_version)
+      return false;
+    if (since_version == m_version)
+      return true;
+    // every change after since_version must still be in the journal
+    if (m_journal.empty() || m_journal.front().version > since_version + 1)
+      return false;
+
+    // only the last change of each transaction matters
+    std::unordered_map<crypto::hash, bool> last_change;
+    auto it = std::upper_bound(m_journal.begin(), m_journal.end(), since_version,
+        [](uint64_t v, const journal_entry& e) { return v < e.version; });
+    for (; it != m_journal.end(); ++it)
+      last_change[it->id] = it->added;
+
+    for (const auto& change: last_change)
+    {
+      auto tx_it = m_transactions.find(change.first);
+      if (change.second && tx_it != m_transactions.end())
+        added.push_back({tx_it->first, tx_it->second.blob_size, tx_it->second.fee, tx_it->second.receive_time});
+      else if (!change.second)
+        removed.push_back(change.first);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::journal_add(const crypto::hash& id)
+  {
+    m_journal.push_back({++m_version, id, true});
+    if (m_journal.size() > POOL_JOURNAL_MAX_SIZE)
+      m_journal.pop_front();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::journal_remove(const crypto::hash& id)
+  {
+    m_journal.push_back({++m_version, id, false});
+    if (m_journal.size() > POOL_JOURNAL_MAX_SIZE)
+      m_journal.pop_front();
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
     return true;
@@ -312,6 +401,14 @@ namespace cryptonote
     return m_spent_key_images.end() != m_spent_key_images.find(key_im);
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::have_key_images_as_spent(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    spent.resize(key_images.size());
+    for (size_t i = 0; i < key_images.size(); ++i)
+      spent[i] = m_spent_key_images.end() != m_spent_key_images.find(key_images[i]);
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::lock() const
   {
     m_transactions_lock.lock();
@@ -424,8 +521,24 @@ namespace cryptonote
     size_t max_total_size = (130 * median_size) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     std::unordered_set<crypto::key_image> k_images;
 
-    BOOST_FOREACH(transactions_container::value_type& tx, m_transactions)
+    // Best paying transactions first, by fee per byte, then oldest first
+    std::vector<transactions_container::iterator> sorted;
+    sorted.reserve(m_transactions.size());
+    for (auto it = m_transactions.begin(); it != m_transactions.end(); ++it)
+      sorted.push_back(it);
+    std::sort(sorted.begin(), sorted.end(), [](const transactions_container::iterator& a, const transactions_container::iterator& b) {
+      // a.fee / a.size > b.fee / b.size, without the division
+      uint64_t a_hi, b_hi;
+      uint64_t a_lo = mul128(a->second.fee, b->second.blob_size, &a_hi);
+      uint64_t b_lo = mul128(b->second.fee, a->second.blob_size, &b_hi);
+      if (a_hi != b_hi || a_lo != b_lo)
+        return a_hi > b_hi || (a_hi == b_hi && a_lo > b_lo);
+      return a->second.receive_time < b->second.receive_time;
+    });
+
+    for (auto& it: sorted)
     {
+      transactions_container::value_type& tx = *it;
       // Can not exceed maximum block size
       if (max_total_size < total_size + tx.second.blob_size)
         continue;
@@ -485,6 +598,16 @@ namespace cryptonote
       }
     }
 
+    uint64_t pool_bytes = 0;
+    for (const auto& tx: m_transactions)
+      pool_bytes += tx.second.blob_size;
+    pool_size_gauge().set(m_transactions.size());
+    pool_bytes_gauge().set(pool_bytes);
+
+    // what was loaded is only reachable through a snapshot
+    m_journal.clear();
+    ++m_version;
+
     // Ignore deserialization error
     return true;
   }
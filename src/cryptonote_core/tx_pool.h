@@ -31,6 +31,7 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <deque>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -42,6 +43,7 @@
 #include "math_helper.h"
 #include "cryptonote_basic_impl.h"
 #include "verification_context.h"
+#include "fee_estimator.h"
 #include "crypto/hash.h"
 
 
@@ -55,6 +57,15 @@ namespace cryptonote
   class tx_memory_pool: boost::noncopyable
   {
   public:
+    // summary of a pool transaction, as handed out by the snapshot/delta API
+    struct tx_pool_entry
+    {
+      crypto::hash id;
+      size_t blob_size;
+      uint64_t fee;
+      time_t receive_time;
+    };
+
     tx_memory_pool(blockchain_storage& bchs);
     bool add_tx(const transaction &tx, const crypto::hash &id, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block);
     bool add_tx(const transaction &tx, tx_verification_context& tvc, bool keeped_by_block);
@@ -62,6 +73,7 @@ namespace cryptonote
     bool take_tx(const crypto::hash &id, transaction &tx, size_t& blob_size, uint64_t& fee);
 
     bool have_tx(const crypto::hash &id) const;
+    void have_key_images_as_spent(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const;
     bool on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id);
     bool on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id);
     void on_idle();
@@ -77,6 +89,15 @@ namespace cryptonote
     bool get_transaction(const crypto::hash& h, transaction& tx) const;
     size_t get_transactions_count() const;
     std::string print_pool(bool short_format) const;
+    fee_estimator& get_fee_estimator() { return m_fee_estimator; }
+    const fee_estimator& get_fee_estimator() const { return m_fee_estimator; }
+    // (epoch, version) identifies a pool state; the epoch changes whenever the
+    // version sequence restarts, e.g. on daemon restart
+    void get_pool_snapshot(std::vector<tx_pool_entry>& entries, uint64_t& epoch, uint64_t& version) const;
+    // changes since the given version, coalesced per transaction; returns false
+    // if the delta can not be served (other epoch, or too old) and the caller
+    // must take a new snapshot
+    bool get_pool_delta(uint64_t epoch, uint64_t since_version, std::vector<tx_pool_entry>& added, std::vector<crypto::hash>& removed, uint64_t& version) const;
 
     /*bool flush_pool(const std::strig& folder);
     bool inflate_pool(const std::strig& folder);*/
@@ -116,6 +137,8 @@ namespace cryptonote
     static bool append_key_images(std::unordered_set<crypto::key_image>& kic, const transaction& tx);
 
     bool is_transaction_ready_to_go(tx_details& txd) const;
+    void journal_add(const crypto::hash& id);
+    void journal_remove(const crypto::hash& id);
     typedef std::unordered_map<crypto::hash, tx_details > transactions_container;
     typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
 
@@ -124,6 +147,18 @@ namespace cryptonote
     key_images_container m_spent_key_images;
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
 
+    struct journal_entry
+    {
+      uint64_t version;
+      crypto::hash id;
+      bool added;
+    };
+    // bounded log of pool changes, used to serve deltas
+    std::deque<journal_entry> m_journal;
+    uint64_t m_epoch;
+    uint64_t m_version;
+    fee_estimator m_fee_estimator;
+
     //transactions_container m_alternative_transactions;
 
     std::string m_config_folder;
@@ -173,6 +208,7 @@ namespace cryptonote
 #if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
     friend class blockchain_storage;
 #endif
+    friend class tx_pool_delta_test;
   };
 }
 
@@ -0,0 +1,368 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <vector>
+#include <boost/foreach.hpp>
+
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "block_download_scheduler.h"
+
+namespace cryptonote
+{
+  //------------------------------------------------------------------------------------------------------------------------
+  block_download_scheduler::block_download_scheduler(size_t max_buffered_bytes, uint64_t min_stall_timeout_ms):
+    m_max_buffered_bytes(max_buffered_bytes),
+    m_min_stall_timeout_ms(min_stall_timeout_ms),
+    m_buffered_bytes(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  uint64_t block_download_scheduler::get_stall_timeout_ms(const reservation& r) const
+  {
+    auto it = m_connections.find(r.connection_id);
+    if(it == m_connections.end() || it->second.ms_per_block <= 0)
+      return m_min_stall_timeout_ms;
+    uint64_t expected = static_cast<uint64_t>(it->second.ms_per_block * r.span_size * BLOCKS_SPAN_STALL_FACTOR);
+    return std::max(expected, m_min_stall_timeout_ms);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  bool block_download_scheduler::is_taken(const crypto::hash& id, const connection_id_type& connection_id, clock::time_point now) const
+  {
+    if(m_buffered_ids.count(id))
+      return true;
+    auto it = m_reserved.find(id);
+    if(it == m_reserved.end() || it->second.connection_id == connection_id)
+      return false;
+    uint64_t elapsed = boost::chrono::duration_cast<boost::chrono::milliseconds>(now - it->second.requested_at).count();
+    return elapsed < get_stall_timeout_ms(it->second);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  bool block_download_scheduler::reserve_span(const connection_id_type& connection_id, std::list<crypto::hash>& needed,
+    size_t max_count, const have_block_func& have_block, std::list<crypto::hash>& span)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    clock::time_point now = clock::now();
+    //with a full buffer only a span following blocks we already have can be drained
+    bool buffer_full = m_buffered_bytes >= m_max_buffered_bytes;
+    auto it = needed.begin();
+    while(it != needed.end() && span.size() < max_count)
+    {
+      if(have_block(*it))
+      {
+        needed.erase(it++);
+        continue;
+      }
+      if(is_taken(*it, connection_id, now))
+      {
+        //spans have to stay contiguous, a taken id ends the one we are building
+        if(span.size() || buffer_full)
+          break;
+        ++it;
+        continue;
+      }
+      auto r = m_reserved.find(*it);
+      if(r != m_reserved.end() && r->second.connection_id != connection_id)
+        LOG_PRINT_L1("Block " << *it << " stalled on another connection, requesting it again");
+      span.push_back(*it);
+      needed.erase(it++);
+    }
+
+    BOOST_FOREACH(const crypto::hash& id, span)
+    {
+      reservation& r = m_reserved[id];
+      r.connection_id = connection_id;
+      r.requested_at = now;
+      r.span_size = span.size();
+    }
+
+    connection_stats& stats = m_connections[connection_id];
+    stats.span_limit = max_count;
+    stats.parked = span.empty() && !needed.empty();
+    stats.waiting_for_buffer = false;
+    return !span.empty();
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::on_span_received(const connection_id_type& connection_id, const std::list<crypto::hash>& span, size_t bytes)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    clock::time_point now = clock::now();
+    bool have_time = false;
+    clock::time_point requested_at;
+    BOOST_FOREACH(const crypto::hash& id, span)
+    {
+      auto it = m_reserved.find(id);
+      if(it == m_reserved.end() || it->second.connection_id != connection_id)
+        continue;
+      if(!have_time || it->second.requested_at < requested_at)
+        requested_at = it->second.requested_at;
+      have_time = true;
+      m_reserved.erase(it);
+    }
+    if(!have_time || span.empty())
+      return;
+
+    //smooth the measurements, a single response says little about a peer
+    double ms = std::max<double>(1, boost::chrono::duration_cast<boost::chrono::milliseconds>(now - requested_at).count());
+    double bytes_per_second = bytes * 1000.0 / ms;
+    double ms_per_block = ms / span.size();
+    connection_stats& stats = m_connections[connection_id];
+    if(stats.bytes_per_second <= 0)
+    {
+      stats.bytes_per_second = bytes_per_second;
+      stats.ms_per_block = ms_per_block;
+    }
+    else
+    {
+      stats.bytes_per_second = 0.7 * stats.bytes_per_second + 0.3 * bytes_per_second;
+      stats.ms_per_block = 0.7 * stats.ms_per_block + 0.3 * ms_per_block;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  bool block_download_scheduler::add_buffered_span(const connection_id_type& connection_id, const crypto::hash& prev_id,
+    std::list<block_complete_entry>& blocks, size_t bytes)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if(m_buffered_bytes >= m_max_buffered_bytes || m_buffered.count(prev_id))
+      return false;
+
+    buffered_span& bs = m_buffered[prev_id];
+    bs.connection_id = connection_id;
+    bs.bytes = bytes;
+    bs.buffered_at = clock::now();
+    bs.blocks.swap(blocks);
+    BOOST_FOREACH(const block_complete_entry& be, bs.blocks)
+      m_buffered_ids.insert(get_blob_hash(be.block));
+    m_buffered_bytes += bytes;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  bool block_download_scheduler::pop_ready_span(const have_block_func& have_block, connection_id_type& connection_id,
+    std::list<block_complete_entry>& blocks)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    for(auto it = m_buffered.begin(); it != m_buffered.end(); ++it)
+    {
+      if(!have_block(it->first))
+        continue;
+      connection_id = it->second.connection_id;
+      blocks.swap(it->second.blocks);
+      BOOST_FOREACH(const block_complete_entry& be, blocks)
+        m_buffered_ids.erase(get_blob_hash(be.block));
+      m_buffered_bytes -= it->second.bytes;
+      m_buffered.erase(it);
+      return true;
+    }
+    return false;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::erase_buffered_span(std::unordered_map<crypto::hash, buffered_span>::iterator it)
+  {
+    BOOST_FOREACH(const block_complete_entry& be, it->second.blocks)
+      m_buffered_ids.erase(get_blob_hash(be.block));
+    m_buffered_bytes -= it->second.bytes;
+    m_buffered.erase(it);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  size_t block_download_scheduler::evict_stale_spans()
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    clock::time_point now = clock::now();
+    connection_id_type nobody = connection_id_type();
+    std::vector<crypto::hash> stale;
+    BOOST_FOREACH(const auto& b, m_buffered)
+    {
+      uint64_t elapsed = boost::chrono::duration_cast<boost::chrono::milliseconds>(now - b.second.buffered_at).count();
+      //a parent that is on its way or buffered itself may still arrive
+      if(elapsed >= m_min_stall_timeout_ms && !is_taken(b.first, nobody, now))
+        stale.push_back(b.first);
+    }
+    BOOST_FOREACH(const crypto::hash& prev_id, stale)
+    {
+      auto it = m_buffered.find(prev_id);
+      LOG_PRINT_L1("Evicting " << it->second.blocks.size() << " buffered blocks whose parent " << prev_id << " did not arrive");
+      std::list<evicted_span>& evicted = m_evicted[it->second.connection_id];
+      evicted.push_back(evicted_span());
+      evicted_span& es = evicted.back();
+      es.prev_id = prev_id;
+      BOOST_FOREACH(const block_complete_entry& be, it->second.blocks)
+        es.ids.push_back(get_blob_hash(be.block));
+      m_connections[it->second.connection_id].parked = true;
+      erase_buffered_span(it);
+    }
+    return stale.size();
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::restore_evicted_spans(const connection_id_type& connection_id, std::list<crypto::hash>& needed)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    auto it = m_evicted.find(connection_id);
+    if(it == m_evicted.end())
+      return;
+    BOOST_FOREACH(evicted_span& es, it->second)
+      requeue_span(needed, es.prev_id, es.ids);
+    m_evicted.erase(it);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::requeue_span(std::list<crypto::hash>& needed, const crypto::hash& prev_id, std::list<crypto::hash>& span)
+  {
+    //a parent no longer in needed is in the chain already, the span then goes first
+    auto it = std::find(needed.begin(), needed.end(), prev_id);
+    if(it != needed.end())
+      ++it;
+    else
+      it = needed.begin();
+    needed.splice(it, span);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::park_connection(const connection_id_type& connection_id)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    connection_stats& stats = m_connections[connection_id];
+    stats.parked = true;
+    stats.waiting_for_buffer = true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  bool block_download_scheduler::is_buffer_full() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_buffered_bytes >= m_max_buffered_bytes;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  size_t block_download_scheduler::get_buffered_bytes() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_buffered_bytes;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  size_t block_download_scheduler::get_buffered_spans_count() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_buffered.size();
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::release_reservations(const connection_id_type& connection_id)
+  {
+    for(auto it = m_reserved.begin(); it != m_reserved.end();)
+    {
+      if(it->second.connection_id == connection_id)
+        it = m_reserved.erase(it);
+      else
+        ++it;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::remove_connection(const connection_id_type& connection_id)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    release_reservations(connection_id);
+    m_evicted.erase(connection_id);
+    m_connections.erase(connection_id);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::remove_dead_connections(const std::unordered_set<connection_id_type, boost::hash<connection_id_type> >& live_connections)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    for(auto it = m_reserved.begin(); it != m_reserved.end();)
+    {
+      if(!live_connections.count(it->second.connection_id))
+        it = m_reserved.erase(it);
+      else
+        ++it;
+    }
+    //nobody would fetch the parent of a span from a chain only a dead peer knew about
+    for(auto it = m_buffered.begin(); it != m_buffered.end();)
+    {
+      if(!live_connections.count(it->second.connection_id))
+        erase_buffered_span(it++);
+      else
+        ++it;
+    }
+    //other connections still have those ids in needed
+    for(auto it = m_evicted.begin(); it != m_evicted.end();)
+    {
+      if(!live_connections.count(it->first))
+        it = m_evicted.erase(it);
+      else
+        ++it;
+    }
+    for(auto it = m_connections.begin(); it != m_connections.end();)
+    {
+      if(!live_connections.count(it->first))
+        it = m_connections.erase(it);
+      else
+        ++it;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  void block_download_scheduler::get_parked_connections(std::list<connection_id_type>& connections)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    std::vector<std::pair<double, connection_id_type> > parked;
+    BOOST_FOREACH(connections_container::value_type& c, m_connections)
+    {
+      if(!c.second.parked)
+        continue;
+      //waking it up with nothing to fetch would only ask the peer for its chain again
+      if(c.second.waiting_for_buffer && !m_buffered.empty() && !m_evicted.count(c.first))
+        continue;
+      parked.push_back(std::make_pair(c.second.bytes_per_second, c.first));
+      c.second.parked = false;
+      c.second.waiting_for_buffer = false;
+    }
+    std::sort(parked.begin(), parked.end(), [](const std::pair<double, connection_id_type>& a, const std::pair<double, connection_id_type>& b) {
+      return a.first > b.first;
+    });
+    BOOST_FOREACH(const auto& p, parked)
+      connections.push_back(p.second);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  size_t block_download_scheduler::get_span_size(const connection_id_type& connection_id, double avg_block_size) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    avg_block_size = std::max<double>(avg_block_size, 1);
+    double count = BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+    auto it = m_connections.find(connection_id);
+    if(it != m_connections.end() && it->second.bytes_per_second > 0)
+    {
+      count = it->second.bytes_per_second * BLOCKS_SYNCHRONIZING_TARGET_TIME / 1000 / avg_block_size;
+      if(it->second.span_limit)
+        count = std::min<double>(std::max<double>(count, it->second.span_limit / 2), it->second.span_limit * 2);
+    }
+    count = std::min<double>(count, BLOCKS_SYNCHRONIZING_MAX_SIZE / avg_block_size);
+    count = std::min<double>(std::max<double>(count, BLOCKS_SYNCHRONIZING_MIN_COUNT), BLOCKS_SYNCHRONIZING_MAX_COUNT);
+    return static_cast<size_t>(count);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  double block_download_scheduler::get_connection_speed(const connection_id_type& connection_id) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    auto it = m_connections.find(connection_id);
+    return it == m_connections.end() ? 0 : it->second.bytes_per_second;
+  }
+}
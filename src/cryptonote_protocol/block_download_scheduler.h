@@ -0,0 +1,217 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <boost/chrono.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include "syncobj.h"
+#include "crypto/hash.h"
+#include "cryptonote_config.h"
+#include "cryptonote_protocol_defs.h"
+
+namespace cryptonote
+{
+  /*!
+   * \brief Shares the block download between all synchronizing connections.
+   *
+   * Every connection still learns the needed block ids from its own chain entry,
+   * but takes a contiguous span of them through reserve_span(), which skips ids
+   * that another connection is already fetching or that are waiting here. A span
+   * nobody has delivered within its stall timeout (scaled by the owning peer's
+   * measured speed) may be taken over by any other connection.
+   *
+   * Spans that arrive before their parent block is in the chain are kept in a
+   * bounded reorder buffer until pop_ready_span() finds their parent. A span
+   * whose parent nobody fetches within the stall timeout is evicted by
+   * evict_stale_spans() and handed back to its connection to be fetched again.
+   *
+   * All methods are thread safe.
+   */
+  class block_download_scheduler
+  {
+  public:
+    typedef boost::uuids::uuid connection_id_type;
+    typedef std::function<bool(const crypto::hash&)> have_block_func;
+
+    block_download_scheduler(size_t max_buffered_bytes = BLOCKS_REORDER_BUFFER_MAX_SIZE,
+      uint64_t min_stall_timeout_ms = BLOCKS_SPAN_STALL_TIMEOUT);
+
+    /*!
+     * \brief takes the next span of at most max_count ids for a connection
+     *
+     * Ids the core already has are dropped from needed. Ids fetched by other live
+     * connections or waiting in the reorder buffer are skipped but left in needed,
+     * in case they stall or get discarded later. The span itself is moved out of
+     * needed. While the reorder buffer is full only a span with no skipped id
+     * before it is handed out, so the buffer can always be drained.
+     *
+     * \return false if there was nothing this connection could fetch now; the
+     *         connection is then parked until get_parked_connections() says otherwise
+     */
+    bool reserve_span(const connection_id_type& connection_id, std::list<crypto::hash>& needed,
+      size_t max_count, const have_block_func& have_block, std::list<crypto::hash>& span);
+
+    /*!
+     * \brief releases the span a connection delivered and updates its speed
+     *
+     * \param bytes size of the response carrying the span
+     */
+    void on_span_received(const connection_id_type& connection_id, const std::list<crypto::hash>& span, size_t bytes);
+
+    /*!
+     * \brief keeps a span whose parent is not in the chain yet
+     *
+     * The size limit is soft: a span is accepted as long as the buffer is not full yet.
+     *
+     * \return false if the buffer is full or already holds a span with this parent
+     */
+    bool add_buffered_span(const connection_id_type& connection_id, const crypto::hash& prev_id,
+      std::list<block_complete_entry>& blocks, size_t bytes);
+
+    /*!
+     * \brief removes a buffered span whose parent the core now has
+     *
+     * \return false if no buffered span can be added to the chain yet
+     */
+    bool pop_ready_span(const have_block_func& have_block, connection_id_type& connection_id,
+      std::list<block_complete_entry>& blocks);
+
+    /*!
+     * \brief puts a span the buffer had no room for back into needed, right after its parent
+     *
+     * needed stays in chain order, so reserve_span() with a full buffer hands out the
+     * parent first, or nothing while another connection fetches it, instead of
+     * fetching and dropping the same span over and over.
+     */
+    static void requeue_span(std::list<crypto::hash>& needed, const crypto::hash& prev_id, std::list<crypto::hash>& span);
+
+    //! parks a connection that has to wait for the reorder buffer to drain
+    void park_connection(const connection_id_type& connection_id);
+
+    /*!
+     * \brief drops buffered spans waiting longer than the stall timeout for a parent nobody fetches
+     *
+     * The ids of an evicted span go back to the connection that fetched it, which
+     * is woken up to take them with restore_evicted_spans().
+     *
+     * \return number of spans evicted
+     */
+    size_t evict_stale_spans();
+
+    //! puts the ids of spans evicted from this connection back into its needed
+    void restore_evicted_spans(const connection_id_type& connection_id, std::list<crypto::hash>& needed);
+
+    bool is_buffer_full() const;
+    size_t get_buffered_bytes() const;
+    size_t get_buffered_spans_count() const;
+
+    //! releases everything reserved or buffered by connections not in live_connections
+    void remove_dead_connections(const std::unordered_set<connection_id_type, boost::hash<connection_id_type> >& live_connections);
+    void remove_connection(const connection_id_type& connection_id);
+
+    /*!
+     * \brief parked connections to wake up, fastest first; the parked flag is cleared
+     *
+     * A connection parked with nothing left to fetch is only woken once the reorder
+     * buffer is empty or evicted spans are waiting for it.
+     */
+    void get_parked_connections(std::list<connection_id_type>& connections);
+
+    /*!
+     * \brief number of blocks to ask a connection for in its next request
+     *
+     * Sized so the response takes about BLOCKS_SYNCHRONIZING_TARGET_TIME at the
+     * peer's measured throughput and stays under BLOCKS_SYNCHRONIZING_MAX_SIZE.
+     * The size at most doubles or halves from one request to the next, so a
+     * peer measured on tiny early blocks is not flooded with a huge request.
+     *
+     * \param avg_block_size recent average size of a downloaded block, in bytes
+     */
+    size_t get_span_size(const connection_id_type& connection_id, double avg_block_size) const;
+
+    //! measured throughput of a connection in bytes per second, 0 if unknown
+    double get_connection_speed(const connection_id_type& connection_id) const;
+
+  private:
+    typedef boost::chrono::steady_clock clock;
+
+    struct reservation
+    {
+      connection_id_type connection_id;
+      clock::time_point requested_at;
+      size_t span_size;
+    };
+
+    struct buffered_span
+    {
+      connection_id_type connection_id;
+      std::list<block_complete_entry> blocks;
+      size_t bytes;
+      clock::time_point buffered_at;
+    };
+
+    struct evicted_span
+    {
+      crypto::hash prev_id;
+      std::list<crypto::hash> ids;
+    };
+
+    struct connection_stats
+    {
+      double bytes_per_second;
+      double ms_per_block;
+      size_t span_limit; // max_count of the last reserve_span() call
+      bool parked;
+      bool waiting_for_buffer; // parked by park_connection(), nothing to fetch until the buffer drains
+    };
+
+    typedef std::unordered_map<connection_id_type, connection_stats, boost::hash<connection_id_type> > connections_container;
+
+    bool is_taken(const crypto::hash& id, const connection_id_type& connection_id, clock::time_point now) const;
+    uint64_t get_stall_timeout_ms(const reservation& r) const;
+    void release_reservations(const connection_id_type& connection_id);
+    void erase_buffered_span(std::unordered_map<crypto::hash, buffered_span>::iterator it);
+
+    mutable epee::critical_section m_lock;
+    size_t m_max_buffered_bytes;
+    uint64_t m_min_stall_timeout_ms;
+    std::unordered_map<crypto::hash, reservation> m_reserved;   // block id -> who fetches it
+    std::unordered_map<crypto::hash, buffered_span> m_buffered; // parent block id -> span
+    std::unordered_set<crypto::hash> m_buffered_ids;
+    size_t m_buffered_bytes;
+    std::unordered_map<connection_id_type, std::list<evicted_span>, boost::hash<connection_id_type> > m_evicted;
+    connections_container m_connections;
+  };
+}
@@ -42,6 +42,7 @@
 #include "warnings.h"
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
+#include "block_download_scheduler.h"
 #include "cryptonote_core/connection_context.h"
 #include "cryptonote_core/cryptonote_stat_info.h"
 #include "cryptonote_core/verification_context.h"
@@ -123,6 +124,7 @@ namespace cryptonote
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
     bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks);
+    bool add_blocks(const std::list<block_complete_entry>& blocks, cryptonote_connection_context& context);
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
     t_core& m_core;
@@ -133,6 +135,11 @@ namespace cryptonote
     std::atomic<bool> m_synchronized;
     bool m_one_request = true;
 
+    block_download_scheduler m_scheduler;
+    epee::critical_section m_sync_lock; // blocks from different connections are added one span at a time
+    epee::critical_section m_bad_connections_lock;
+    std::unordered_set<boost::uuids::uuid, boost::hash<boost::uuids::uuid> > m_bad_connections; // delivered a buffered span that failed verification
+
 		// static std::ofstream m_logreq;
     std::mutex m_buffer_mutex;
     double get_avg_block_size();
@@ -39,6 +39,7 @@
 #include <list>
 
 #include "cryptonote_core/cryptonote_format_utils.h"
+#include "common/tracing.h"
 #include "profile_tools.h"
 #include "../../contrib/otshell_utils/utils.hpp"
 #include "../../src/p2p/network_throttle-detail.hpp"
@@ -96,7 +97,13 @@ namespace cryptonote
     CHECK_AND_ASSERT_MES_CC( context.m_callback_request_count > 0, false, "false callback fired, but context.m_callback_request_count=" << context.m_callback_request_count);
     --context.m_callback_request_count;
 
-    if(context.m_state == cryptonote_connection_context::state_synchronizing)
+    if(context.m_state == cryptonote_connection_context::state_synchronizing
+      && context.m_needed_objects.size() && !context.m_requested_objects.size())
+    {
+      //woken up after being parked by the scheduler
+      request_missing_objects(context, true);
+    }
+    else if(context.m_state == cryptonote_connection_context::state_synchronizing)
     {
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       m_core.get_short_chain_history(r.block_ids);
@@ -311,6 +318,7 @@ namespace cryptonote
     template<class t_core> 
     int t_cryptonote_protocol_handler<t_core>::handle_notify_new_block(int command, NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& context)
   {
+    TRACE_SPAN("protocol", "handle_notify_new_block");
     LOG_PRINT_CCONTEXT_L2("NOTIFY_NEW_BLOCK (hop " << arg.hop << ")");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
@@ -358,6 +366,7 @@ namespace cryptonote
   template<class t_core> 
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
+    TRACE_SPAN("protocol", "handle_notify_new_transactions");
     LOG_PRINT_CCONTEXT_L2("NOTIFY_NEW_TRANSACTIONS");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
@@ -390,6 +399,7 @@ namespace cryptonote
   template<class t_core> 
   int t_cryptonote_protocol_handler<t_core>::handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
+    TRACE_SPAN("protocol", "handle_request_get_objects");
     LOG_PRINT_CCONTEXT_L2("NOTIFY_REQUEST_GET_OBJECTS");
     NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
     if(!m_core.handle_get_objects(arg, rsp, context))
@@ -430,6 +440,7 @@ namespace cryptonote
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
+    TRACE_SPAN("protocol", "handle_response_get_objects");
     LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_GET_OBJECTS");
     
     // calculate size of request - mainly for logging/debug
@@ -448,7 +459,8 @@ namespace cryptonote
 	size += sizeof(arg.current_blockchain_height);
 	{
 		CRITICAL_REGION_LOCAL(m_buffer_mutex);
-		m_avg_buffer.push_back(size);
+		if (arg.blocks.size())
+			m_avg_buffer.push_back(size / arg.blocks.size()); // per block, used to size the next requests
 
 		const bool dbg_poke_lock = 0; // debug: try to trigger an error by poking around with locks. TODO: configure option
 		long int dbg_repeat=0;
@@ -474,10 +486,10 @@ namespace cryptonote
 
     context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-    size_t count = 0;
+    std::list<crypto::hash> span;
+    crypto::hash prev_id = null_hash;
     BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
     {
-      ++count;
       block b;
       if(!parse_and_validate_block_from_blob(block_entry.block, b))
       {
@@ -486,19 +498,10 @@ namespace cryptonote
         m_p2p->drop_connection(context);
         return 1;
       }      
-      //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
-      if(count == 2)
-      { 
-        if(m_core.have_block(get_block_hash(b)))
-        {
-          context.m_state = cryptonote_connection_context::state_idle;
-          context.m_needed_objects.clear();
-          context.m_requested_objects.clear();
-          LOG_PRINT_CCONTEXT_L1("Connection set to idle state.");
-          return 1;
-        }
-      }
-      
+      if(span.empty())
+        prev_id = b.prev_id;
+      span.push_back(get_block_hash(b));
+
       auto req_it = context.m_requested_objects.find(get_block_hash(b));
       if(req_it == context.m_requested_objects.end())
       {
@@ -527,73 +530,151 @@ namespace cryptonote
     }
 
 
+    m_scheduler.on_span_received(context.m_connection_id, span, size);
+    if(span.empty())
+    {
+      request_missing_objects(context, true);
+      return 1;
+    }
+
     {
-      m_core.pause_mine();
-      epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler(
-        boost::bind(&t_core::resume_mine, &m_core));
-
-			LOG_PRINT_CCONTEXT_YELLOW( "Got NEW BLOCKS inside of " << __FUNCTION__ << ": size: " << arg.blocks.size() , LOG_LEVEL_0);
-			
-      if (m_core.get_test_drop_download() && m_core.get_test_drop_download_height()) { // DISCARD BLOCKS for testing
-				
-				
-		  BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
-		  {
-			// process transactions
-			TIME_MEASURE_START(transactions_process_time);
-			BOOST_FOREACH(auto& tx_blob, block_entry.txs)
-			{
-			  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-			  m_core.handle_incoming_tx(tx_blob, tvc, true);
-			  if(tvc.m_verifivation_failed)
-			  {
-				LOG_ERROR_CCONTEXT("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = " 
-				  << epee::string_tools::pod_to_hex(get_blob_hash(tx_blob)) << ", dropping connection");
-				m_p2p->drop_connection(context);
-				return 1;
-			  }
-			}
-			TIME_MEASURE_FINISH(transactions_process_time);
-
-			// process block
-			
-				TIME_MEASURE_START(block_process_time);
-				block_verification_context bvc = boost::value_initialized<block_verification_context>();
-			
-				m_core.handle_incoming_block(block_entry.block, bvc, false); // <--- process block
-
-				if(bvc.m_verifivation_failed)
-				{
-				  LOG_PRINT_CCONTEXT_L1("Block verification failed, dropping connection");
-				  m_p2p->drop_connection(context);
-				  return 1;
-				}
-				if(bvc.m_marked_as_orphaned)
-				{
-				  LOG_PRINT_CCONTEXT_L1("Block received at sync phase was marked as orphaned, dropping connection");
-				  m_p2p->drop_connection(context);
-				  return 1;
-				}
-
-				TIME_MEASURE_FINISH(block_process_time);
-				LOG_PRINT_CCONTEXT_L2("Block process time: " << block_process_time + transactions_process_time << "(" << transactions_process_time << "/" << block_process_time << ")ms");
-				
-				epee::net_utils::data_logger::get_instance().add_data("calc_time", block_process_time + transactions_process_time);
-				epee::net_utils::data_logger::get_instance().add_data("block_processing", 1);
-								
-		  } // each download block
-
-		} // if not DISCARD BLOCK
-
-		  
+      //spans from other connections may be waiting in the reorder buffer for this one
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      block_download_scheduler::have_block_func have_block = [this](const crypto::hash& id) { return m_core.have_block(id); };
+      if(have_block(prev_id))
+      {
+        LOG_PRINT_CCONTEXT_YELLOW( "Got NEW BLOCKS inside of " << __FUNCTION__ << ": size: " << arg.blocks.size() , LOG_LEVEL_0);
+        if(!add_blocks(arg.blocks, context))
+        {
+          LOG_PRINT_CCONTEXT_L1("Failed to add received blocks, dropping connection");
+          m_p2p->drop_connection(context);
+          return 1;
+        }
+
+        boost::uuids::uuid buffered_connection_id;
+        std::list<block_complete_entry> buffered_blocks;
+        while(m_scheduler.pop_ready_span(have_block, buffered_connection_id, buffered_blocks))
+        {
+          LOG_PRINT_CCONTEXT_L1("Adding " << buffered_blocks.size() << " buffered blocks from connection " << buffered_connection_id);
+          if(!add_blocks(buffered_blocks, context))
+          {
+            LOG_PRINT_CCONTEXT_L1("Buffered block verification failed, dropping connection " << buffered_connection_id);
+            CRITICAL_REGION_LOCAL1(m_bad_connections_lock);
+            m_bad_connections.insert(buffered_connection_id);
+          }
+          buffered_blocks.clear();
+        }
+      }
+      else if(m_scheduler.add_buffered_span(context.m_connection_id, prev_id, arg.blocks, size))
+      {
+        LOG_PRINT_CCONTEXT_L1("Buffered " << span.size() << " blocks received ahead of their parent, "
+          << m_scheduler.get_buffered_spans_count() << " spans / " << m_scheduler.get_buffered_bytes() << " bytes buffered");
+      }
+      else
+      {
+        //no room to keep them, fetch these blocks again once their parent is in
+        LOG_PRINT_CCONTEXT_L1("Reorder buffer is full, " << span.size() << " blocks will be requested again");
+        block_download_scheduler::requeue_span(context.m_needed_objects, prev_id, span);
+      }
     }
+
     request_missing_objects(context, true);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::add_blocks(const std::list<block_complete_entry>& blocks, cryptonote_connection_context& context)
+  {
+    TRACE_SPAN("protocol", "add_blocks");
+    if (!(m_core.get_test_drop_download() && m_core.get_test_drop_download_height())) // DISCARD BLOCKS for testing
+      return true;
+
+    m_core.pause_mine();
+    epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler(
+      boost::bind(&t_core::resume_mine, &m_core));
+
+    BOOST_FOREACH(const block_complete_entry& block_entry, blocks)
+    {
+      // process transactions
+      TIME_MEASURE_START(transactions_process_time);
+      BOOST_FOREACH(auto& tx_blob, block_entry.txs)
+      {
+        tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        m_core.handle_incoming_tx(tx_blob, tvc, true);
+        if(tvc.m_verifivation_failed)
+        {
+          LOG_ERROR_CCONTEXT("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = " 
+            << epee::string_tools::pod_to_hex(get_blob_hash(tx_blob)));
+          return false;
+        }
+      }
+      TIME_MEASURE_FINISH(transactions_process_time);
+
+      // process block
+      TIME_MEASURE_START(block_process_time);
+      block_verification_context bvc = boost::value_initialized<block_verification_context>();
+
+      m_core.handle_incoming_block(block_entry.block, bvc, false); // <--- process block
+
+      if(bvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L1("Block verification failed");
+        return false;
+      }
+      if(bvc.m_marked_as_orphaned)
+      {
+        LOG_PRINT_CCONTEXT_L1("Block received at sync phase was marked as orphaned");
+        return false;
+      }
+
+      TIME_MEASURE_FINISH(block_process_time);
+      LOG_PRINT_CCONTEXT_L2("Block process time: " << block_process_time + transactions_process_time << "(" << transactions_process_time << "/" << block_process_time << ")ms");
+
+      static const epee::net_utils::data_logger::channel calc_time_channel = epee::net_utils::data_logger::get_instance().get_channel("calc_time");
+      static const epee::net_utils::data_logger::channel block_processing_channel = epee::net_utils::data_logger::get_instance().get_channel("block_processing");
+      epee::net_utils::data_logger::get_instance().add_data(calc_time_channel, block_process_time + transactions_process_time);
+      epee::net_utils::data_logger::get_instance().add_data(block_processing_channel, 1);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_cryptonote_protocol_handler<t_core>::on_idle()
   {
+    std::unordered_set<boost::uuids::uuid, boost::hash<boost::uuids::uuid> > live_connections;
+    std::list<connection_context> bad_connections;
+    {
+      CRITICAL_REGION_LOCAL(m_bad_connections_lock);
+      m_p2p->for_each_connection([&](const connection_context& cntxt, nodetool::peerid_type peer_id)
+      {
+        live_connections.insert(cntxt.m_connection_id);
+        if(m_bad_connections.count(cntxt.m_connection_id))
+          bad_connections.push_back(cntxt);
+        return true;
+      });
+      m_bad_connections.clear();
+    }
+    BOOST_FOREACH(const connection_context& cntxt, bad_connections)
+      m_p2p->drop_connection(cntxt);
+
+    //reservations of closed connections can be taken over right away
+    m_scheduler.remove_dead_connections(live_connections);
+    m_scheduler.evict_stale_spans();
+
+    std::list<boost::uuids::uuid> parked;
+    m_scheduler.get_parked_connections(parked);
+    BOOST_FOREACH(const boost::uuids::uuid& connection_id, parked)
+    {
+      m_p2p->for_each_connection([&](const connection_context& cntxt, nodetool::peerid_type peer_id)
+      {
+        if(cntxt.m_connection_id != connection_id)
+          return true;
+        if(cntxt.m_state == cryptonote_connection_context::state_synchronizing)
+          m_p2p->request_callback(cntxt);
+        return false;
+      });
+    }
+
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -615,6 +696,7 @@ namespace cryptonote
   template<class t_core> 
   bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks)
   {
+    TRACE_SPAN("protocol", "request_missing_objects");
 	//if (!m_one_request == false)
 		//return true;
 	m_one_request = false;
@@ -624,31 +706,32 @@ namespace cryptonote
 		auto time_from_epoh = point.time_since_epoch();
 		auto sec = duration_cast< seconds >( time_from_epoh ).count();*/
 		
+    m_scheduler.restore_evicted_spans(context.m_connection_id, context.m_needed_objects);
     if(context.m_needed_objects.size())
     {
-      //we know objects that we need, request this objects
+      //we know objects that we need, request the ones no other connection is fetching
       NOTIFY_REQUEST_GET_OBJECTS::request req;
-      size_t count = 0;
-      auto it = context.m_needed_objects.begin();
-
-	  size_t count_limit = BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
-	  _note_c("net/req-calc" , "Setting count_limit: " << count_limit);
-      while(it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+      size_t count_limit = m_scheduler.get_span_size(context.m_connection_id, estimate_one_block_size());
+      _note_c("net/req-calc" , "Setting count_limit: " << count_limit << " for " << m_scheduler.get_connection_speed(context.m_connection_id) << " B/s");
+      block_download_scheduler::have_block_func have_block = [this, check_having_blocks](const crypto::hash& id) {
+        return check_having_blocks && m_core.have_block(id);
+      };
+      if(m_scheduler.reserve_span(context.m_connection_id, context.m_needed_objects, count_limit, have_block, req.blocks))
       {
-        if( !(check_having_blocks && m_core.have_block(*it)))
-        {
-          req.blocks.push_back(*it);
-          ++count;
-          context.m_requested_objects.insert(*it);
-        }
-        context.m_needed_objects.erase(it++);
+        context.m_requested_objects.insert(req.blocks.begin(), req.blocks.end());
+        LOG_PRINT_CCONTEXT_L0("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size()
+          << "requested blocks count=" << req.blocks.size() << " / " << count_limit);
+        post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);
+        return true;
       }
-      LOG_PRINT_CCONTEXT_L0("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size()
-				<< "requested blocks count=" << count << " / " << count_limit);
-		//epee::net_utils::network_throttle_manager::get_global_throttle_inreq().logger_handle_net("log/dr-monero/net/req-all.data", sec, get_avg_block_size());
-		
-      post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);    
-    }else if(context.m_last_response_height < context.m_remote_blockchain_height-1)
+      if(context.m_needed_objects.size())
+      {
+        LOG_PRINT_CCONTEXT_L1("All needed blocks are being fetched by other connections, waiting");
+        return true;
+      }
+    }
+
+    if(context.m_last_response_height < context.m_remote_blockchain_height-1)
     {//we have to fetch more objects ids, request blockchain entry
      
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
@@ -662,6 +745,11 @@ namespace cryptonote
 		
       LOG_PRINT_CCONTEXT_L0("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+    }else if(m_scheduler.get_buffered_spans_count())
+    {
+      //blocks other connections fetched ahead are still waiting for their parents
+      LOG_PRINT_CCONTEXT_L1("Waiting for " << m_scheduler.get_buffered_spans_count() << " buffered spans before leaving synchronizing state");
+      m_scheduler.park_connection(context.m_connection_id);
     }else
     { 
       CHECK_AND_ASSERT_MES(context.m_last_response_height == context.m_remote_blockchain_height-1 
@@ -714,6 +802,7 @@ namespace cryptonote
   template<class t_core> 
   int t_cryptonote_protocol_handler<t_core>::handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context)
   {
+    TRACE_SPAN("protocol", "handle_response_chain_entry");
     LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_CHAIN_ENTRY: m_block_ids.size()=" << arg.m_block_ids.size() 
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
     
@@ -31,6 +31,7 @@
 
 #include "common/command_line.h"
 #include "cryptonote_config.h"
+#include "common/tracing.h"
 #include <boost/program_options.hpp>
 
 namespace daemon_args
@@ -52,6 +53,21 @@ namespace daemon_args
   , ""
   , LOG_LEVEL_0
   };
+  const command_line::arg_descriptor<size_t> arg_log_async_queue_size = {
+    "log-async-queue-size"
+  , "Write the log from a background thread, queueing up to this many messages per thread before dropping (0: write synchronously)"
+  , 0
+  };
+  const command_line::arg_descriptor<std::string> arg_trace_file = {
+    "trace-file"
+  , "Record tracing spans and write them to this file in the Chrome trace format when the daemon stops"
+  , ""
+  };
+  const command_line::arg_descriptor<size_t> arg_trace_buffer_size = {
+    "trace-buffer-size"
+  , "Spans kept per thread for --trace-file, older ones are overwritten"
+  , TRACE_DEFAULT_BUFFER_SIZE
+  };
   const command_line::arg_descriptor<std::vector<std::string>> arg_command = {
     "daemon_command"
   , "Hidden"
@@ -332,5 +332,11 @@ bool t_command_parser_executor::stop_save_graph(const std::vector<std::string>&
 	return m_executor.stop_save_graph();
 }
 
+bool t_command_parser_executor::print_lock_profile(const std::vector<std::string>& args)
+{
+	if (args.size() > 1 || (args.size() == 1 && args[0] != "reset")) return false;
+	return m_executor.print_lock_profile(!args.empty());
+}
+
 
 } // namespace daemonize
@@ -100,6 +100,8 @@ public:
   bool start_save_graph(const std::vector<std::string>& args);
   
   bool stop_save_graph(const std::vector<std::string>& args);
+  
+  bool print_lock_profile(const std::vector<std::string>& args);
 };
 
 } // namespace daemonize
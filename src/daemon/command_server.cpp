@@ -179,6 +179,11 @@ t_command_server::t_command_server(
     , std::bind(&t_command_parser_executor::stop_save_graph, &m_parser, p::_1)
     , "Stop save data for dr monero"
     );
+    m_command_lookup.set_handler(
+      "print_lock_profile"
+    , std::bind(&t_command_parser_executor::print_lock_profile, &m_parser, p::_1)
+    , "Print lock wait and hold times (build with PROFILE_LOCKS), print_lock_profile [reset]"
+    );
 }
 
 bool t_command_server::process_command_str(const std::string& cmd)
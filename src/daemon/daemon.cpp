@@ -30,6 +30,7 @@
 
 #include "daemon/daemon.h"
 
+#include "common/tracing.h"
 #include "common/util.h"
 #include "daemon/core.h"
 #include "daemon/p2p.h"
@@ -59,6 +60,7 @@ public:
   t_p2p p2p;
   // t_rpc rpc;
   bool testnet_mode;
+  std::string trace_file;
 
   t_internals(
       boost::program_options::variables_map const & vm
@@ -72,6 +74,7 @@ public:
     protocol.set_p2p_endpoint(p2p.get());
     core.set_protocol(protocol.get());
     testnet_mode = command_line::get_arg(vm, daemon_args::arg_testnet_on);
+    trace_file = command_line::get_arg(vm, daemon_args::arg_trace_file);
   }
 };
 
@@ -86,7 +89,12 @@ t_daemon::t_daemon(
     boost::program_options::variables_map const & vm
   )
   : mp_internals{new t_internals{vm}}
-{}
+{
+  // started here rather than in main() because daemonizing forks after main() and threads do not survive it
+  epee::log_space::log_singletone::set_async_logging(command_line::get_arg(vm, daemon_args::arg_log_async_queue_size));
+  if (!mp_internals->trace_file.empty())
+    tools::tracing::start(command_line::get_arg(vm, daemon_args::arg_trace_buffer_size));
+}
 
 t_daemon::~t_daemon() = default;
 
@@ -143,6 +151,18 @@ bool t_daemon::run(bool interactive)
     }
 
     // mp_internals->rpc.stop();
+    if (!mp_internals->trace_file.empty())
+    {
+      tools::tracing::stop();
+      if (tools::tracing::write_chrome_trace(mp_internals->trace_file))
+      {
+        LOG_PRINT_L0("Trace written to " << mp_internals->trace_file);
+      }
+      else
+      {
+        LOG_ERROR("Failed to write trace to " << mp_internals->trace_file);
+      }
+    }
     LOG_PRINT("Node stopped.", LOG_LEVEL_0);
     return true;
   }
@@ -82,6 +82,9 @@ int main(int argc, char const * argv[])
       bf::path default_log = default_data_dir / std::string(CRYPTONOTE_NAME ".log");
       command_line::add_arg(core_settings, daemon_args::arg_log_file, default_log.string());
       command_line::add_arg(core_settings, daemon_args::arg_log_level);
+      command_line::add_arg(core_settings, daemon_args::arg_log_async_queue_size);
+      command_line::add_arg(core_settings, daemon_args::arg_trace_file);
+      command_line::add_arg(core_settings, daemon_args::arg_trace_buffer_size);
       command_line::add_arg(core_settings, daemon_args::arg_testnet_on);
       command_line::add_arg(core_settings, daemon_args::arg_dns_checkpoints);
       daemonizer::init_options(hidden_options, visible_options);
@@ -817,4 +817,60 @@ bool t_rpc_command_executor::stop_save_graph()
 	return true;
 }
 
+bool t_rpc_command_executor::print_lock_profile(bool reset)
+{
+  cryptonote::COMMAND_RPC_GET_LOCK_PROFILE::request req;
+  cryptonote::COMMAND_RPC_GET_LOCK_PROFILE::response res;
+  std::string fail_message = "Unsuccessful";
+
+  req.reset = reset;
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/get_lock_profile", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_lock_profile(req, res))
+    {
+      tools::fail_msg_writer() << fail_message.c_str();
+      return true;
+    }
+  }
+
+  if (!res.enabled)
+  {
+    tools::fail_msg_writer() << "Lock profiling is not compiled in, rebuild with -DPROFILE_LOCKS=ON";
+    return true;
+  }
+
+  tools::msg_writer() << std::setw(40) << std::left << "Lock"
+      << std::setw(12) << "Count"
+      << std::setw(16) << "Wait total(us)"
+      << std::setw(14) << "Wait p99(us)"
+      << std::setw(14) << "Wait max(us)"
+      << std::setw(16) << "Hold total(us)"
+      << std::setw(14) << "Hold p99(us)"
+      << std::setw(14) << "Hold max(us)"
+      << "Site";
+
+  for (const auto& s : res.sites)
+  {
+    tools::msg_writer() << std::setw(40) << std::left << s.lock
+      << std::setw(12) << s.count
+      << std::setw(16) << s.wait_total_us
+      << std::setw(14) << s.wait_p99_us
+      << std::setw(14) << s.wait_max_us
+      << std::setw(16) << s.hold_total_us
+      << std::setw(14) << s.hold_p99_us
+      << std::setw(14) << s.hold_max_us
+      << s.site;
+  }
+
+  return true;
+}
+
 }// namespace daemonize
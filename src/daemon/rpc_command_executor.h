@@ -112,6 +112,8 @@ public:
   bool start_save_graph();
   
   bool stop_save_graph();
+
+  bool print_lock_profile(bool reset);
 };
 
 } // namespace daemonize
@@ -41,6 +41,8 @@
 
 #include <iostream>
 
+#include "common/tracing.h"
+
 /*!
  * \namespace IPC
  * \brief Anonymous namepsace to keep things in the scope of this file
@@ -152,6 +154,7 @@ namespace IPC
      */
     void start_mining(wap_proto_t *message)
     {
+      TRACE_SPAN("ipc", "start_mining");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -186,6 +189,7 @@ namespace IPC
      */
     void stop_mining(wap_proto_t *message)
     {
+      TRACE_SPAN("ipc", "stop_mining");
       if (!core->get_miner().stop())
       {
         wap_proto_set_status(message, STATUS_MINING_NOT_STOPPED);
@@ -201,6 +205,7 @@ namespace IPC
      */
     void retrieve_blocks(wap_proto_t *message)
     {
+      TRACE_SPAN("ipc", "retrieve_blocks");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -217,9 +222,34 @@ namespace IPC
         block_id = (char*)zlist_next(z_block_ids);
       }
 
-      std::list<std::pair<cryptonote::block, std::list<cryptonote::transaction> > > bs;
       uint64_t result_current_height = 0;
       uint64_t result_start_height = 0;
+
+      // Wallets restoring from a known height only need the ids of the blocks
+      // before it, so send those as a single frame of raw hashes.
+      if (wap_proto_block_ids_only(message))
+      {
+        std::list<crypto::hash> ids;
+        if (!core->find_blockchain_supplement(start_height, block_ids, ids, result_current_height,
+          result_start_height, BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT))
+        {
+          wap_proto_set_status(message, STATUS_INTERNAL_ERROR);
+          return;
+        }
+        std::vector<crypto::hash> ids_array(ids.begin(), ids.end());
+        zmsg_t *block_data = zmsg_new();
+        zframe_t *frame = zframe_new(ids_array.data(), ids_array.size() * sizeof(crypto::hash));
+        zmsg_prepend(block_data, &frame);
+        wap_proto_set_start_height(message, result_start_height);
+        wap_proto_set_curr_height(message, result_current_height);
+        // tells the wallet block_data holds ids, daemons that don't know the flag leave it at 0
+        wap_proto_set_block_ids_only(message, 1);
+        wap_proto_set_status(message, STATUS_OK);
+        wap_proto_set_block_data(message, &block_data);
+        return;
+      }
+
+      std::list<std::pair<cryptonote::block, std::list<cryptonote::transaction> > > bs;
       if (!core->find_blockchain_supplement(start_height, block_ids, bs, result_current_height,
         result_start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
       {
@@ -268,6 +298,7 @@ namespace IPC
       zmsg_prepend(block_data, &frame);
       wap_proto_set_start_height(message, result_start_height);
       wap_proto_set_curr_height(message, result_current_height);
+      wap_proto_set_block_ids_only(message, 0);
       wap_proto_set_status(message, STATUS_OK);
       wap_proto_set_block_data(message, &block_data);
 
@@ -280,6 +311,7 @@ namespace IPC
      */
     void send_raw_transaction(wap_proto_t *message)
     {
+      TRACE_SPAN("ipc", "send_raw_transaction");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -332,6 +364,7 @@ namespace IPC
      */
     void get_output_indexes(wap_proto_t *message)
     {
+      TRACE_SPAN("ipc", "get_output_indexes");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -360,6 +393,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_random_outs(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_random_outs");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -439,6 +473,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_height(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_height");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -453,6 +488,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void save_bc(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "save_bc");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -470,6 +506,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_info(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_info");
       if (!check_core_busy()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -496,6 +533,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_peer_list(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_peer_list");
       std::list<nodetool::peerlist_entry> white_list;
       std::list<nodetool::peerlist_entry> gray_list;
       p2p->get_peerlist_manager().get_peerlist_full(white_list, gray_list);
@@ -559,6 +597,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_mining_status(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_mining_status");
       if (!check_core_ready()) {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
         return;
@@ -584,6 +623,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void set_log_hash_rate(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "set_log_hash_rate");
       if (core->get_miner().is_mining())
       {
         core->get_miner().do_print_hashrate(wap_proto_visible(message));
@@ -601,6 +641,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void set_log_level(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "set_log_level");
       // zproto supports only unsigned integers afaik. so the log level is sent as
       // one and casted to signed int here.
       int8_t level = (int8_t)wap_proto_level(message);
@@ -623,6 +664,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void start_save_graph(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "start_save_graph");
       p2p->set_save_graph(true);
       wap_proto_set_status(message, STATUS_OK);
     }
@@ -633,6 +675,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void stop_save_graph(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "stop_save_graph");
       p2p->set_save_graph(false);
       wap_proto_set_status(message, STATUS_OK);
     }
@@ -643,6 +686,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_block_hash(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_block_hash");
       if (!check_core_busy())
       {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
@@ -666,6 +710,7 @@ namespace IPC
      * \param message 0MQ response object to populate
      */
     void get_block_template(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_block_template");
       if (!check_core_ready())
       {
         wap_proto_set_status(message, STATUS_CORE_BUSY);
@@ -730,5 +775,101 @@ namespace IPC
       wap_proto_set_block_template_blob(message, &blob_chunk);
       wap_proto_set_status(message, STATUS_OK);
     }
+
+    /*!
+     * \brief get_key_image_status IPC
+     *
+     * Key images come in as one chunk of raw 32 byte images; the reply has one
+     * status byte per key image (see cryptonote::KEY_IMAGE_*), in the same order.
+     * \param message 0MQ response object to populate
+     */
+    void get_key_image_status(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_key_image_status");
+      if (!check_core_busy())
+      {
+        wap_proto_set_status(message, STATUS_CORE_BUSY);
+        return;
+      }
+      zchunk_t *key_images_chunk = wap_proto_key_images(message);
+      size_t key_images_size = key_images_chunk ? zchunk_size(key_images_chunk) : 0;
+      if (key_images_size % sizeof(crypto::key_image) != 0)
+      {
+        wap_proto_set_status(message, STATUS_WRONG_KEY_IMAGE_LENGTH);
+        return;
+      }
+      std::vector<crypto::key_image> key_images(key_images_size / sizeof(crypto::key_image));
+      if (!key_images.empty())
+      {
+        memcpy(&key_images[0], zchunk_data(key_images_chunk), key_images_size);
+      }
+      std::vector<uint8_t> spent_status;
+      if (!core->are_key_images_spent(key_images, spent_status))
+      {
+        wap_proto_set_status(message, STATUS_INTERNAL_ERROR);
+        return;
+      }
+      zchunk_t *spent_chunk = zchunk_new(spent_status.empty() ? NULL : &spent_status[0], spent_status.size());
+      wap_proto_set_spent(message, &spent_chunk);
+      wap_proto_set_status(message, STATUS_OK);
+    }
+
+    /*!
+     * \brief get_tx_pool IPC
+     *
+     * pool_epoch/pool_version are the values from a previous reply (0/0 for a
+     * snapshot). pool_added is a run of 56 byte entries: tx hash, then blob
+     * size, fee and receive time as 64 bit integers in host order. pool_removed
+     * is a run of 32 byte tx hashes. pool_full is set when pool_added is the
+     * whole pool rather than a delta.
+     * \param message 0MQ response object to populate
+     */
+    void get_tx_pool(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_tx_pool");
+      if (!check_core_busy())
+      {
+        wap_proto_set_status(message, STATUS_CORE_BUSY);
+        return;
+      }
+      std::vector<cryptonote::tx_memory_pool::tx_pool_entry> added;
+      std::vector<crypto::hash> removed;
+      uint64_t epoch, version;
+      bool full;
+      core->get_pool_changes(wap_proto_pool_epoch(message), wap_proto_pool_version(message),
+        added, removed, epoch, version, full);
+
+      const size_t entry_size = sizeof(crypto::hash) + 3 * sizeof(uint64_t);
+      std::string added_blob;
+      added_blob.reserve(added.size() * entry_size);
+      for (const auto& entry : added)
+      {
+        uint64_t fields[3] = { entry.blob_size, entry.fee, static_cast<uint64_t>(entry.receive_time) };
+        added_blob.append(reinterpret_cast<const char*>(&entry.id), sizeof(entry.id));
+        added_blob.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+      }
+      zchunk_t *added_chunk = zchunk_new(added_blob.data(), added_blob.size());
+      zchunk_t *removed_chunk = zchunk_new(removed.empty() ? NULL : &removed[0], removed.size() * sizeof(crypto::hash));
+      wap_proto_set_pool_epoch(message, epoch);
+      wap_proto_set_pool_version(message, version);
+      wap_proto_set_pool_full(message, full ? 1 : 0);
+      wap_proto_set_pool_added(message, &added_chunk);
+      wap_proto_set_pool_removed(message, &removed_chunk);
+      wap_proto_set_status(message, STATUS_OK);
+    }
+
+    /*!
+     * \brief get_fee_estimate IPC
+     *
+     * \param message 0MQ response object to populate
+     */
+    void get_fee_estimate(wap_proto_t *message) {
+      TRACE_SPAN("ipc", "get_fee_estimate");
+      if (!check_core_busy())
+      {
+        wap_proto_set_status(message, STATUS_CORE_BUSY);
+        return;
+      }
+      wap_proto_set_fee_per_kb(message, core->get_fee_estimate(wap_proto_target_blocks(message)));
+      wap_proto_set_status(message, STATUS_OK);
+    }
   }
 }
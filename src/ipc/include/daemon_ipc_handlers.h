@@ -80,6 +80,7 @@ namespace IPC
   const uint64_t STATUS_ERROR_STORING_BLOCKCHAIN = 13;
   const uint64_t STATUS_HEIGHT_TOO_BIG = 13;
   const uint64_t STATUS_RESERVE_SIZE_TOO_BIG = 14;
+  const uint64_t STATUS_WRONG_KEY_IMAGE_LENGTH = 15;
   /*!
    * \namespace Daemon
    * \brief Namespace pertaining to Daemon IPC.
@@ -98,6 +99,9 @@ namespace IPC
     void stop_save_graph(wap_proto_t *message);
     void get_block_hash(wap_proto_t *message);
     void get_block_template(wap_proto_t *message);
+    void get_key_image_status(wap_proto_t *message);
+    void get_tx_pool(wap_proto_t *message);
+    void get_fee_estimate(wap_proto_t *message);
     void retrieve_blocks(wap_proto_t *message);
     void send_raw_transaction(wap_proto_t *message);
     void get_output_indexes(wap_proto_t *message);
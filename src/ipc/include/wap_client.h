@@ -67,10 +67,11 @@ WAP_EXPORT bool
 WAP_EXPORT int 
     wap_client_connect (wap_client_t *self, const char *endpoint, uint32_t timeout, const char *identity);
 
-//  Request a set of blocks from the server.                                        
+//  Request a set of blocks from the server. With block_ids_only set the server    
+//  returns just the ids of the blocks.                                             
 //  Returns >= 0 if successful, -1 if interrupted.
 WAP_EXPORT int 
-    wap_client_blocks (wap_client_t *self, zlist_t **block_ids_p, uint64_t start_height);
+    wap_client_blocks (wap_client_t *self, zlist_t **block_ids_p, uint64_t start_height, uint8_t block_ids_only);
 
 //  Send a raw transaction to the daemon.                                           
 //  Returns >= 0 if successful, -1 if interrupted.
@@ -157,6 +158,21 @@ WAP_EXPORT int
 WAP_EXPORT int 
     wap_client_get_block_template (wap_client_t *self, uint64_t reserve_size, zchunk_t **address_p);
 
+//  Get key image status                                                            
+//  Returns >= 0 if successful, -1 if interrupted.
+WAP_EXPORT int 
+    wap_client_get_key_image_status (wap_client_t *self, zchunk_t **key_images_p);
+
+//  Get transaction pool snapshot or delta                                          
+//  Returns >= 0 if successful, -1 if interrupted.
+WAP_EXPORT int 
+    wap_client_get_tx_pool (wap_client_t *self, uint64_t pool_epoch, uint64_t pool_version);
+
+//  Get fee estimate                                                                
+//  Returns >= 0 if successful, -1 if interrupted.
+WAP_EXPORT int 
+    wap_client_get_fee_estimate (wap_client_t *self, uint64_t target_blocks);
+
 //  Return last received status
 WAP_EXPORT int 
     wap_client_status (wap_client_t *self);
@@ -173,6 +189,10 @@ WAP_EXPORT uint64_t
 WAP_EXPORT uint64_t 
     wap_client_curr_height (wap_client_t *self);
 
+//  Return last received block_ids_only
+WAP_EXPORT uint8_t 
+    wap_client_block_ids_only (wap_client_t *self);
+
 //  Return last received block_data
 WAP_EXPORT zmsg_t *
     wap_client_block_data (wap_client_t *self);
@@ -269,6 +289,38 @@ WAP_EXPORT zchunk_t *
 WAP_EXPORT zchunk_t *
     wap_client_block_template_blob (wap_client_t *self);
 
+//  Return last received spent
+WAP_EXPORT zchunk_t *
+    wap_client_spent (wap_client_t *self);
+
+//  Return last received pool_epoch
+WAP_EXPORT uint64_t 
+    wap_client_pool_epoch (wap_client_t *self);
+
+//  Return last received pool_version
+WAP_EXPORT uint64_t 
+    wap_client_pool_version (wap_client_t *self);
+
+//  Return last received pool_full
+WAP_EXPORT uint8_t 
+    wap_client_pool_full (wap_client_t *self);
+
+//  Return last received pool_added
+WAP_EXPORT zchunk_t *
+    wap_client_pool_added (wap_client_t *self);
+
+//  Return last received pool_removed
+WAP_EXPORT zchunk_t *
+    wap_client_pool_removed (wap_client_t *self);
+
+//  Return last received target_blocks
+WAP_EXPORT uint64_t 
+    wap_client_target_blocks (wap_client_t *self);
+
+//  Return last received fee_per_kb
+WAP_EXPORT uint64_t 
+    wap_client_fee_per_kb (wap_client_t *self);
+
 //  Self test of this class
 WAP_EXPORT void
     wap_client_test (bool verbose);
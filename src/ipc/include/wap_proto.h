@@ -34,11 +34,13 @@
 BLOCKS-OK, or ERROR if the request is invalid.
         block_ids           strings     
         start_height        number 8    
+        block_ids_only      number 1    Return block ids only, optional, 0 if missing
 
     BLOCKS_OK - Daemon returns a set of blocks to the wallet.
         status              number 8    
         start_height        number 8    
         curr_height         number 8    
+        block_ids_only      number 1    block_data holds block ids only, optional, 0 if missing
         block_data          msg         Frames of block data
 
     PUT - Wallet sends a raw transaction to the daemon. Daemon replies with
@@ -178,6 +180,35 @@ Daemon will reply with CLOSE-OK or ERROR.
     ERROR - Daemon replies with failure status. Status codes tbd.
         status              number 2    Error status
         reason              string      Printable explanation
+
+    GET_KEY_IMAGE_STATUS - get_key_image_status IPC
+        key_images          chunk       Key images
+
+    GET_KEY_IMAGE_STATUS_OK - This is a codec for a Bitcoin Wallet Access Protocol (RFC tbd)
+        status              number 8    Status
+        spent               chunk       Spent status
+
+    GET_TX_POOL - Snapshot of the transaction pool, or what changed since a
+pool version.
+        pool_epoch          number 8    Pool epoch
+        pool_version        number 8    Pool version
+
+    GET_TX_POOL_OK - This is a codec for a Bitcoin Wallet Access Protocol (RFC tbd)
+        status              number 8    Status
+        pool_epoch          number 8    Pool epoch
+        pool_version        number 8    Pool version
+        pool_full           number 1    Pool snapshot rather than delta
+        pool_added          chunk       Pool entries added
+        pool_removed        chunk       Pool ids removed
+
+    GET_FEE_ESTIMATE - Fee per kB a transaction needs to be mined within
+target_blocks blocks.
+        target_blocks       number 8    Blocks to get included within
+
+    GET_FEE_ESTIMATE_OK - This is a codec for a Bitcoin Wallet Access Protocol (RFC tbd)
+        status              number 8    Status
+        target_blocks       number 8    Blocks to get included within
+        fee_per_kb          number 8    Estimated fee per kB
 */
 
 #define WAP_PROTO_SUCCESS                   200
@@ -235,6 +266,12 @@ Daemon will reply with CLOSE-OK or ERROR.
 #define WAP_PROTO_PING                      41
 #define WAP_PROTO_PING_OK                   42
 #define WAP_PROTO_ERROR                     43
+#define WAP_PROTO_GET_KEY_IMAGE_STATUS      44
+#define WAP_PROTO_GET_KEY_IMAGE_STATUS_OK   45
+#define WAP_PROTO_GET_TX_POOL               46
+#define WAP_PROTO_GET_TX_POOL_OK            47
+#define WAP_PROTO_GET_FEE_ESTIMATE          48
+#define WAP_PROTO_GET_FEE_ESTIMATE_OK       49
 
 #include <czmq.h>
 
@@ -536,6 +573,12 @@ uint64_t
 void
     wap_proto_set_reserved_offset (wap_proto_t *self, uint64_t reserved_offset);
 
+//  Get/set the block_ids_only field
+byte
+    wap_proto_block_ids_only (wap_proto_t *self);
+void
+    wap_proto_set_block_ids_only (wap_proto_t *self, byte block_ids_only);
+
 //  Get a copy of the prev_hash field
 zchunk_t *
     wap_proto_prev_hash (wap_proto_t *self);
@@ -556,6 +599,76 @@ zchunk_t *
 void
     wap_proto_set_block_template_blob (wap_proto_t *self, zchunk_t **chunk_p);
 
+//  Get a copy of the key_images field
+zchunk_t *
+    wap_proto_key_images (wap_proto_t *self);
+//  Get the key_images field and transfer ownership to caller
+zchunk_t *
+    wap_proto_get_key_images (wap_proto_t *self);
+//  Set the key_images field, transferring ownership from caller
+void
+    wap_proto_set_key_images (wap_proto_t *self, zchunk_t **chunk_p);
+
+//  Get a copy of the spent field
+zchunk_t *
+    wap_proto_spent (wap_proto_t *self);
+//  Get the spent field and transfer ownership to caller
+zchunk_t *
+    wap_proto_get_spent (wap_proto_t *self);
+//  Set the spent field, transferring ownership from caller
+void
+    wap_proto_set_spent (wap_proto_t *self, zchunk_t **chunk_p);
+
+//  Get/set the pool_epoch field
+uint64_t
+    wap_proto_pool_epoch (wap_proto_t *self);
+void
+    wap_proto_set_pool_epoch (wap_proto_t *self, uint64_t pool_epoch);
+
+//  Get/set the pool_version field
+uint64_t
+    wap_proto_pool_version (wap_proto_t *self);
+void
+    wap_proto_set_pool_version (wap_proto_t *self, uint64_t pool_version);
+
+//  Get/set the pool_full field
+byte
+    wap_proto_pool_full (wap_proto_t *self);
+void
+    wap_proto_set_pool_full (wap_proto_t *self, byte pool_full);
+
+//  Get a copy of the pool_added field
+zchunk_t *
+    wap_proto_pool_added (wap_proto_t *self);
+//  Get the pool_added field and transfer ownership to caller
+zchunk_t *
+    wap_proto_get_pool_added (wap_proto_t *self);
+//  Set the pool_added field, transferring ownership from caller
+void
+    wap_proto_set_pool_added (wap_proto_t *self, zchunk_t **chunk_p);
+
+//  Get a copy of the pool_removed field
+zchunk_t *
+    wap_proto_pool_removed (wap_proto_t *self);
+//  Get the pool_removed field and transfer ownership to caller
+zchunk_t *
+    wap_proto_get_pool_removed (wap_proto_t *self);
+//  Set the pool_removed field, transferring ownership from caller
+void
+    wap_proto_set_pool_removed (wap_proto_t *self, zchunk_t **chunk_p);
+
+//  Get/set the target_blocks field
+uint64_t
+    wap_proto_target_blocks (wap_proto_t *self);
+void
+    wap_proto_set_target_blocks (wap_proto_t *self, uint64_t target_blocks);
+
+//  Get/set the fee_per_kb field
+uint64_t
+    wap_proto_fee_per_kb (wap_proto_t *self);
+void
+    wap_proto_set_fee_per_kb (wap_proto_t *self, uint64_t fee_per_kb);
+
 //  Get/set the reason field
 const char *
     wap_proto_reason (wap_proto_t *self);
@@ -134,6 +134,7 @@ prepare_blocks_command (client_t *self)
 {
     wap_proto_set_block_ids (self->message, &self->args->block_ids);
     wap_proto_set_start_height (self->message, self->args->start_height);
+    wap_proto_set_block_ids_only (self->message, self->args->block_ids_only);
 }
 
 
@@ -147,9 +148,10 @@ signal_have_blocks_ok (client_t *self)
     zmsg_t *msg = wap_proto_get_block_data (self->message);
     assert(msg != 0);
     printf("%p <--\n", (void*)msg);
-    zsock_send (self->cmdpipe, "s888p", "BLOCKS OK", wap_proto_status(self->message),
+    zsock_send (self->cmdpipe, "s8881p", "BLOCKS OK", wap_proto_status(self->message),
                 wap_proto_start_height (self->message),
                 wap_proto_curr_height (self->message),
+                wap_proto_block_ids_only (self->message),
                 msg);
 }
 
@@ -541,3 +543,74 @@ signal_have_get_block_template_ok (client_t *self)
         wap_proto_get_block_template_blob (self->message));
 }
 
+//  ---------------------------------------------------------------------------
+//  prepare_get_key_image_status_command
+//
+
+static void
+prepare_get_key_image_status_command (client_t *self)
+{
+    wap_proto_set_key_images (self->message, &self->args->key_images);
+}
+
+//  ---------------------------------------------------------------------------
+//  signal_have_get_key_image_status_ok
+//
+
+static void
+signal_have_get_key_image_status_ok (client_t *self)
+{
+    zsock_send (self->cmdpipe, "s8p", "GET KEY IMAGE STATUS OK",
+        wap_proto_status (self->message), wap_proto_get_spent (self->message));
+}
+
+//  ---------------------------------------------------------------------------
+//  prepare_get_tx_pool_command
+//
+
+static void
+prepare_get_tx_pool_command (client_t *self)
+{
+    wap_proto_set_pool_epoch (self->message, self->args->pool_epoch);
+    wap_proto_set_pool_version (self->message, self->args->pool_version);
+}
+
+//  ---------------------------------------------------------------------------
+//  signal_have_get_tx_pool_ok
+//
+
+static void
+signal_have_get_tx_pool_ok (client_t *self)
+{
+    zsock_send (self->cmdpipe, "s8881pp", "GET TX POOL OK",
+        wap_proto_status (self->message),
+        wap_proto_pool_epoch (self->message),
+        wap_proto_pool_version (self->message),
+        wap_proto_pool_full (self->message),
+        wap_proto_get_pool_added (self->message),
+        wap_proto_get_pool_removed (self->message));
+}
+
+//  ---------------------------------------------------------------------------
+//  prepare_get_fee_estimate_command
+//
+
+static void
+prepare_get_fee_estimate_command (client_t *self)
+{
+    wap_proto_set_target_blocks (self->message, self->args->target_blocks);
+}
+
+//  ---------------------------------------------------------------------------
+//  signal_have_get_fee_estimate_ok
+//
+
+static void
+signal_have_get_fee_estimate_ok (client_t *self)
+{
+    zsock_send (self->cmdpipe, "s888", "GET FEE ESTIMATE OK",
+        wap_proto_status (self->message),
+        wap_proto_target_blocks (self->message),
+        wap_proto_fee_per_kb (self->message));
+}
+
@@ -70,6 +70,16 @@ struct _wap_proto_t {
     uint64_t reserved_offset;           //  Rservered Offset
     zchunk_t *prev_hash;                //  Previous Hash
     zchunk_t *block_template_blob;      //  Block template blob
+    byte block_ids_only;                //  Return block ids only
+    zchunk_t *key_images;               //  Key images
+    zchunk_t *spent;                    //  Spent status
+    uint64_t pool_epoch;                //  Pool epoch
+    uint64_t pool_version;              //  Pool version
+    byte pool_full;                     //  Pool snapshot rather than delta
+    zchunk_t *pool_added;               //  Pool entries added
+    zchunk_t *pool_removed;             //  Pool ids removed
+    uint64_t target_blocks;             //  Blocks to get included within
+    uint64_t fee_per_kb;                //  Estimated fee per kB
     char reason [256];                  //  Printable explanation
 };
 
@@ -261,6 +271,10 @@ wap_proto_destroy (wap_proto_t **self_p)
         zchunk_destroy (&self->hash);
         zchunk_destroy (&self->prev_hash);
         zchunk_destroy (&self->block_template_blob);
+        zchunk_destroy (&self->key_images);
+        zchunk_destroy (&self->spent);
+        zchunk_destroy (&self->pool_added);
+        zchunk_destroy (&self->pool_removed);
 
         //  Free object itself
         free (self);
@@ -346,12 +360,20 @@ wap_proto_recv (wap_proto_t *self, zsock_t *input)
                 }
             }
             GET_NUMBER8 (self->start_height);
+            //  Optional, wallets built before it was added don't send it
+            self->block_ids_only = 0;
+            if (self->needle < self->ceiling)
+                GET_NUMBER1 (self->block_ids_only);
             break;
 
         case WAP_PROTO_BLOCKS_OK:
             GET_NUMBER8 (self->status);
             GET_NUMBER8 (self->start_height);
             GET_NUMBER8 (self->curr_height);
+            //  Optional, daemons built before it was added don't send it
+            self->block_ids_only = 0;
+            if (self->needle < self->ceiling)
+                GET_NUMBER1 (self->block_ids_only);
             //  Get zero or more remaining frames
             zmsg_destroy (&self->block_data);
             if (zsock_rcvmore (input))
@@ -662,6 +684,79 @@ wap_proto_recv (wap_proto_t *self, zsock_t *input)
             GET_STRING (self->reason);
             break;
 
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS:
+            {
+                size_t chunk_size;
+                GET_NUMBER4 (chunk_size);
+                if (self->needle + chunk_size > (self->ceiling)) {
+                    zsys_warning ("wap_proto: key_images is missing data");
+                    goto malformed;
+                }
+                zchunk_destroy (&self->key_images);
+                self->key_images = zchunk_new (self->needle, chunk_size);
+                self->needle += chunk_size;
+            }
+            break;
+
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS_OK:
+            GET_NUMBER8 (self->status);
+            {
+                size_t chunk_size;
+                GET_NUMBER4 (chunk_size);
+                if (self->needle + chunk_size > (self->ceiling)) {
+                    zsys_warning ("wap_proto: spent is missing data");
+                    goto malformed;
+                }
+                zchunk_destroy (&self->spent);
+                self->spent = zchunk_new (self->needle, chunk_size);
+                self->needle += chunk_size;
+            }
+            break;
+
+        case WAP_PROTO_GET_TX_POOL:
+            GET_NUMBER8 (self->pool_epoch);
+            GET_NUMBER8 (self->pool_version);
+            break;
+
+        case WAP_PROTO_GET_TX_POOL_OK:
+            GET_NUMBER8 (self->status);
+            GET_NUMBER8 (self->pool_epoch);
+            GET_NUMBER8 (self->pool_version);
+            GET_NUMBER1 (self->pool_full);
+            {
+                size_t chunk_size;
+                GET_NUMBER4 (chunk_size);
+                if (self->needle + chunk_size > (self->ceiling)) {
+                    zsys_warning ("wap_proto: pool_added is missing data");
+                    goto malformed;
+                }
+                zchunk_destroy (&self->pool_added);
+                self->pool_added = zchunk_new (self->needle, chunk_size);
+                self->needle += chunk_size;
+            }
+            {
+                size_t chunk_size;
+                GET_NUMBER4 (chunk_size);
+                if (self->needle + chunk_size > (self->ceiling)) {
+                    zsys_warning ("wap_proto: pool_removed is missing data");
+                    goto malformed;
+                }
+                zchunk_destroy (&self->pool_removed);
+                self->pool_removed = zchunk_new (self->needle, chunk_size);
+                self->needle += chunk_size;
+            }
+            break;
+
+        case WAP_PROTO_GET_FEE_ESTIMATE:
+            GET_NUMBER8 (self->target_blocks);
+            break;
+
+        case WAP_PROTO_GET_FEE_ESTIMATE_OK:
+            GET_NUMBER8 (self->status);
+            GET_NUMBER8 (self->target_blocks);
+            GET_NUMBER8 (self->fee_per_kb);
+            break;
+
         default:
             zsys_warning ("wap_proto: bad message ID");
             goto malformed;
@@ -708,11 +803,13 @@ wap_proto_send (wap_proto_t *self, zsock_t *output)
                 }
             }
             frame_size += 8;            //  start_height
+            frame_size += 1;            //  block_ids_only
             break;
         case WAP_PROTO_BLOCKS_OK:
             frame_size += 8;            //  status
             frame_size += 8;            //  start_height
             frame_size += 8;            //  curr_height
+            frame_size += 1;            //  block_ids_only
             break;
         case WAP_PROTO_PUT:
             frame_size += 4;            //  Size is 4 octets
@@ -836,6 +933,41 @@ wap_proto_send (wap_proto_t *self, zsock_t *output)
             frame_size += 2;            //  status
             frame_size += 1 + strlen (self->reason);
             break;
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS:
+            frame_size += 4;            //  Size is 4 octets
+            if (self->key_images)
+                frame_size += zchunk_size (self->key_images);
+            break;
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS_OK:
+            frame_size += 8;            //  status
+            frame_size += 4;            //  Size is 4 octets
+            if (self->spent)
+                frame_size += zchunk_size (self->spent);
+            break;
+        case WAP_PROTO_GET_TX_POOL:
+            frame_size += 8;            //  pool_epoch
+            frame_size += 8;            //  pool_version
+            break;
+        case WAP_PROTO_GET_TX_POOL_OK:
+            frame_size += 8;            //  status
+            frame_size += 8;            //  pool_epoch
+            frame_size += 8;            //  pool_version
+            frame_size += 1;            //  pool_full
+            frame_size += 4;            //  Size is 4 octets
+            if (self->pool_added)
+                frame_size += zchunk_size (self->pool_added);
+            frame_size += 4;            //  Size is 4 octets
+            if (self->pool_removed)
+                frame_size += zchunk_size (self->pool_removed);
+            break;
+        case WAP_PROTO_GET_FEE_ESTIMATE:
+            frame_size += 8;            //  target_blocks
+            break;
+        case WAP_PROTO_GET_FEE_ESTIMATE_OK:
+            frame_size += 8;            //  status
+            frame_size += 8;            //  target_blocks
+            frame_size += 8;            //  fee_per_kb
+            break;
     }
     //  Now serialize message into the frame
     zmq_msg_t frame;
@@ -865,12 +997,14 @@ wap_proto_send (wap_proto_t *self, zsock_t *output)
             else
                 PUT_NUMBER4 (0);    //  Empty string array
             PUT_NUMBER8 (self->start_height);
+            PUT_NUMBER1 (self->block_ids_only);
             break;
 
         case WAP_PROTO_BLOCKS_OK:
             PUT_NUMBER8 (self->status);
             PUT_NUMBER8 (self->start_height);
             PUT_NUMBER8 (self->curr_height);
+            PUT_NUMBER1 (self->block_ids_only);
             nbr_frames += self->block_data? zmsg_size (self->block_data): 1;
             have_block_data = true;
             break;
@@ -1088,6 +1222,71 @@ wap_proto_send (wap_proto_t *self, zsock_t *output)
             PUT_STRING (self->reason);
             break;
 
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS:
+            if (self->key_images) {
+                PUT_NUMBER4 (zchunk_size (self->key_images));
+                memcpy (self->needle,
+                        zchunk_data (self->key_images),
+                        zchunk_size (self->key_images));
+                self->needle += zchunk_size (self->key_images);
+            }
+            else
+                PUT_NUMBER4 (0);    //  Empty chunk
+            break;
+
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS_OK:
+            PUT_NUMBER8 (self->status);
+            if (self->spent) {
+                PUT_NUMBER4 (zchunk_size (self->spent));
+                memcpy (self->needle,
+                        zchunk_data (self->spent),
+                        zchunk_size (self->spent));
+                self->needle += zchunk_size (self->spent);
+            }
+            else
+                PUT_NUMBER4 (0);    //  Empty chunk
+            break;
+
+        case WAP_PROTO_GET_TX_POOL:
+            PUT_NUMBER8 (self->pool_epoch);
+            PUT_NUMBER8 (self->pool_version);
+            break;
+
+        case WAP_PROTO_GET_TX_POOL_OK:
+            PUT_NUMBER8 (self->status);
+            PUT_NUMBER8 (self->pool_epoch);
+            PUT_NUMBER8 (self->pool_version);
+            PUT_NUMBER1 (self->pool_full);
+            if (self->pool_added) {
+                PUT_NUMBER4 (zchunk_size (self->pool_added));
+                memcpy (self->needle,
+                        zchunk_data (self->pool_added),
+                        zchunk_size (self->pool_added));
+                self->needle += zchunk_size (self->pool_added);
+            }
+            else
+                PUT_NUMBER4 (0);    //  Empty chunk
+            if (self->pool_removed) {
+                PUT_NUMBER4 (zchunk_size (self->pool_removed));
+                memcpy (self->needle,
+                        zchunk_data (self->pool_removed),
+                        zchunk_size (self->pool_removed));
+                self->needle += zchunk_size (self->pool_removed);
+            }
+            else
+                PUT_NUMBER4 (0);    //  Empty chunk
+            break;
+
+        case WAP_PROTO_GET_FEE_ESTIMATE:
+            PUT_NUMBER8 (self->target_blocks);
+            break;
+
+        case WAP_PROTO_GET_FEE_ESTIMATE_OK:
+            PUT_NUMBER8 (self->status);
+            PUT_NUMBER8 (self->target_blocks);
+            PUT_NUMBER8 (self->fee_per_kb);
+            break;
+
     }
     //  Now send the data frame
     zmq_msg_send (&frame, zsock_resolve (output), --nbr_frames? ZMQ_SNDMORE: 0);
@@ -1175,6 +1374,7 @@ wap_proto_print (wap_proto_t *self)
                 }
             }
             zsys_debug ("    start_height=%ld", (long) self->start_height);
+            zsys_debug ("    block_ids_only=%ld", (long) self->block_ids_only);
             break;
 
         case WAP_PROTO_BLOCKS_OK:
@@ -1182,6 +1382,7 @@ wap_proto_print (wap_proto_t *self)
             zsys_debug ("    status=%ld", (long) self->status);
             zsys_debug ("    start_height=%ld", (long) self->start_height);
             zsys_debug ("    curr_height=%ld", (long) self->curr_height);
+            zsys_debug ("    block_ids_only=%ld", (long) self->block_ids_only);
             zsys_debug ("    block_data=");
             if (self->block_data)
                 zmsg_print (self->block_data);
@@ -1420,6 +1621,45 @@ wap_proto_print (wap_proto_t *self)
             zsys_debug ("    reason='%s'", self->reason);
             break;
 
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS:
+            zsys_debug ("WAP_PROTO_GET_KEY_IMAGE_STATUS:");
+            zsys_debug ("    key_images=[ ... ]");
+            break;
+
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS_OK:
+            zsys_debug ("WAP_PROTO_GET_KEY_IMAGE_STATUS_OK:");
+            zsys_debug ("    status=%ld", (long) self->status);
+            zsys_debug ("    spent=[ ... ]");
+            break;
+
+        case WAP_PROTO_GET_TX_POOL:
+            zsys_debug ("WAP_PROTO_GET_TX_POOL:");
+            zsys_debug ("    pool_epoch=%ld", (long) self->pool_epoch);
+            zsys_debug ("    pool_version=%ld", (long) self->pool_version);
+            break;
+
+        case WAP_PROTO_GET_TX_POOL_OK:
+            zsys_debug ("WAP_PROTO_GET_TX_POOL_OK:");
+            zsys_debug ("    status=%ld", (long) self->status);
+            zsys_debug ("    pool_epoch=%ld", (long) self->pool_epoch);
+            zsys_debug ("    pool_version=%ld", (long) self->pool_version);
+            zsys_debug ("    pool_full=%ld", (long) self->pool_full);
+            zsys_debug ("    pool_added=[ ... ]");
+            zsys_debug ("    pool_removed=[ ... ]");
+            break;
+
+        case WAP_PROTO_GET_FEE_ESTIMATE:
+            zsys_debug ("WAP_PROTO_GET_FEE_ESTIMATE:");
+            zsys_debug ("    target_blocks=%ld", (long) self->target_blocks);
+            break;
+
+        case WAP_PROTO_GET_FEE_ESTIMATE_OK:
+            zsys_debug ("WAP_PROTO_GET_FEE_ESTIMATE_OK:");
+            zsys_debug ("    status=%ld", (long) self->status);
+            zsys_debug ("    target_blocks=%ld", (long) self->target_blocks);
+            zsys_debug ("    fee_per_kb=%ld", (long) self->fee_per_kb);
+            break;
+
     }
 }
 
@@ -1596,6 +1836,24 @@ wap_proto_command (wap_proto_t *self)
         case WAP_PROTO_ERROR:
             return ("ERROR");
             break;
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS:
+            return ("GET_KEY_IMAGE_STATUS");
+            break;
+        case WAP_PROTO_GET_KEY_IMAGE_STATUS_OK:
+            return ("GET_KEY_IMAGE_STATUS_OK");
+            break;
+        case WAP_PROTO_GET_TX_POOL:
+            return ("GET_TX_POOL");
+            break;
+        case WAP_PROTO_GET_TX_POOL_OK:
+            return ("GET_TX_POOL_OK");
+            break;
+        case WAP_PROTO_GET_FEE_ESTIMATE:
+            return ("GET_FEE_ESTIMATE");
+            break;
+        case WAP_PROTO_GET_FEE_ESTIMATE_OK:
+            return ("GET_FEE_ESTIMATE_OK");
+            break;
     }
     return "?";
 }
@@ -2398,6 +2656,24 @@ wap_proto_set_reserved_offset (wap_proto_t *self, uint64_t reserved_offset)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Get/set the block_ids_only field
+
+byte
+wap_proto_block_ids_only (wap_proto_t *self)
+{
+    assert (self);
+    return self->block_ids_only;
+}
+
+void
+wap_proto_set_block_ids_only (wap_proto_t *self, byte block_ids_only)
+{
+    assert (self);
+    self->block_ids_only = block_ids_only;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Get the prev_hash field without transferring ownership
 
@@ -2464,6 +2740,228 @@ wap_proto_set_block_template_blob (wap_proto_t *self, zchunk_t **chunk_p)
 }
 
 
+//  --------------------------------------------------------------------------
+//  Get the key_images field without transferring ownership
+
+zchunk_t *
+wap_proto_key_images (wap_proto_t *self)
+{
+    assert (self);
+    return self->key_images;
+}
+
+//  Get the key_images field and transfer ownership to caller
+
+zchunk_t *
+wap_proto_get_key_images (wap_proto_t *self)
+{
+    zchunk_t *key_images = self->key_images;
+    self->key_images = NULL;
+    return key_images;
+}
+
+//  Set the key_images field, transferring ownership from caller
+
+void
+wap_proto_set_key_images (wap_proto_t *self, zchunk_t **chunk_p)
+{
+    assert (self);
+    assert (chunk_p);
+    zchunk_destroy (&self->key_images);
+    self->key_images = *chunk_p;
+    *chunk_p = NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get the spent field without transferring ownership
+
+zchunk_t *
+wap_proto_spent (wap_proto_t *self)
+{
+    assert (self);
+    return self->spent;
+}
+
+//  Get the spent field and transfer ownership to caller
+
+zchunk_t *
+wap_proto_get_spent (wap_proto_t *self)
+{
+    zchunk_t *spent = self->spent;
+    self->spent = NULL;
+    return spent;
+}
+
+//  Set the spent field, transferring ownership from caller
+
+void
+wap_proto_set_spent (wap_proto_t *self, zchunk_t **chunk_p)
+{
+    assert (self);
+    assert (chunk_p);
+    zchunk_destroy (&self->spent);
+    self->spent = *chunk_p;
+    *chunk_p = NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get/set the pool_epoch field
+
+uint64_t
+wap_proto_pool_epoch (wap_proto_t *self)
+{
+    assert (self);
+    return self->pool_epoch;
+}
+
+void
+wap_proto_set_pool_epoch (wap_proto_t *self, uint64_t pool_epoch)
+{
+    assert (self);
+    self->pool_epoch = pool_epoch;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get/set the pool_version field
+
+uint64_t
+wap_proto_pool_version (wap_proto_t *self)
+{
+    assert (self);
+    return self->pool_version;
+}
+
+void
+wap_proto_set_pool_version (wap_proto_t *self, uint64_t pool_version)
+{
+    assert (self);
+    self->pool_version = pool_version;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get/set the pool_full field
+
+byte
+wap_proto_pool_full (wap_proto_t *self)
+{
+    assert (self);
+    return self->pool_full;
+}
+
+void
+wap_proto_set_pool_full (wap_proto_t *self, byte pool_full)
+{
+    assert (self);
+    self->pool_full = pool_full;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get the pool_added field without transferring ownership
+
+zchunk_t *
+wap_proto_pool_added (wap_proto_t *self)
+{
+    assert (self);
+    return self->pool_added;
+}
+
+//  Get the pool_added field and transfer ownership to caller
+
+zchunk_t *
+wap_proto_get_pool_added (wap_proto_t *self)
+{
+    zchunk_t *pool_added = self->pool_added;
+    self->pool_added = NULL;
+    return pool_added;
+}
+
+//  Set the pool_added field, transferring ownership from caller
+
+void
+wap_proto_set_pool_added (wap_proto_t *self, zchunk_t **chunk_p)
+{
+    assert (self);
+    assert (chunk_p);
+    zchunk_destroy (&self->pool_added);
+    self->pool_added = *chunk_p;
+    *chunk_p = NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get the pool_removed field without transferring ownership
+
+zchunk_t *
+wap_proto_pool_removed (wap_proto_t *self)
+{
+    assert (self);
+    return self->pool_removed;
+}
+
+//  Get the pool_removed field and transfer ownership to caller
+
+zchunk_t *
+wap_proto_get_pool_removed (wap_proto_t *self)
+{
+    zchunk_t *pool_removed = self->pool_removed;
+    self->pool_removed = NULL;
+    return pool_removed;
+}
+
+//  Set the pool_removed field, transferring ownership from caller
+
+void
+wap_proto_set_pool_removed (wap_proto_t *self, zchunk_t **chunk_p)
+{
+    assert (self);
+    assert (chunk_p);
+    zchunk_destroy (&self->pool_removed);
+    self->pool_removed = *chunk_p;
+    *chunk_p = NULL;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get/set the target_blocks field
+
+uint64_t
+wap_proto_target_blocks (wap_proto_t *self)
+{
+    assert (self);
+    return self->target_blocks;
+}
+
+void
+wap_proto_set_target_blocks (wap_proto_t *self, uint64_t target_blocks)
+{
+    assert (self);
+    self->target_blocks = target_blocks;
+}
+
+
+//  --------------------------------------------------------------------------
+//  Get/set the fee_per_kb field
+
+uint64_t
+wap_proto_fee_per_kb (wap_proto_t *self)
+{
+    assert (self);
+    return self->fee_per_kb;
+}
+
+void
+wap_proto_set_fee_per_kb (wap_proto_t *self, uint64_t fee_per_kb)
+{
+    assert (self);
+    self->fee_per_kb = fee_per_kb;
+}
+
+
 //  --------------------------------------------------------------------------
 //  Get/set the reason field
 
@@ -2548,6 +3046,7 @@ wap_proto_test (bool verbose)
     zlist_append (blocks_block_ids, "Age: 43");
     wap_proto_set_block_ids (self, &blocks_block_ids);
     wap_proto_set_start_height (self, 123);
+    wap_proto_set_block_ids_only (self, 123);
     //  Send twice
     wap_proto_send (self, output);
     wap_proto_send (self, output);
@@ -2562,12 +3061,14 @@ wap_proto_test (bool verbose)
         zlist_destroy (&block_ids);
         zlist_destroy (&blocks_block_ids);
         assert (wap_proto_start_height (self) == 123);
+        assert (wap_proto_block_ids_only (self) == 123);
     }
     wap_proto_set_id (self, WAP_PROTO_BLOCKS_OK);
 
     wap_proto_set_status (self, 123);
     wap_proto_set_start_height (self, 123);
     wap_proto_set_curr_height (self, 123);
+    wap_proto_set_block_ids_only (self, 123);
     zmsg_t *blocks_ok_block_data = zmsg_new ();
     wap_proto_set_block_data (self, &blocks_ok_block_data);
     zmsg_addstr (wap_proto_block_data (self), "Captcha Diem");
@@ -2581,6 +3082,7 @@ wap_proto_test (bool verbose)
         assert (wap_proto_status (self) == 123);
         assert (wap_proto_start_height (self) == 123);
         assert (wap_proto_curr_height (self) == 123);
+        assert (wap_proto_block_ids_only (self) == 123);
         assert (zmsg_size (wap_proto_block_data (self)) == 1);
         char *content = zmsg_popstr (wap_proto_block_data (self));
         assert (streq (content, "Captcha Diem"));
@@ -3117,6 +3619,104 @@ wap_proto_test (bool verbose)
         assert (wap_proto_status (self) == 123);
         assert (streq (wap_proto_reason (self), "Life is short but Now lasts for ever"));
     }
+    wap_proto_set_id (self, WAP_PROTO_GET_KEY_IMAGE_STATUS);
+
+    zchunk_t *get_key_image_status_key_images = zchunk_new ("Captcha Diem", 12);
+    wap_proto_set_key_images (self, &get_key_image_status_key_images);
+    //  Send twice
+    wap_proto_send (self, output);
+    wap_proto_send (self, output);
+
+    for (instance = 0; instance < 2; instance++) {
+        wap_proto_recv (self, input);
+        assert (wap_proto_routing_id (self));
+        assert (memcmp (zchunk_data (wap_proto_key_images (self)), "Captcha Diem", 12) == 0);
+        zchunk_destroy (&get_key_image_status_key_images);
+    }
+    wap_proto_set_id (self, WAP_PROTO_GET_KEY_IMAGE_STATUS_OK);
+
+    wap_proto_set_status (self, 123);
+    zchunk_t *get_key_image_status_ok_spent = zchunk_new ("Captcha Diem", 12);
+    wap_proto_set_spent (self, &get_key_image_status_ok_spent);
+    //  Send twice
+    wap_proto_send (self, output);
+    wap_proto_send (self, output);
+
+    for (instance = 0; instance < 2; instance++) {
+        wap_proto_recv (self, input);
+        assert (wap_proto_routing_id (self));
+        assert (wap_proto_status (self) == 123);
+        assert (memcmp (zchunk_data (wap_proto_spent (self)), "Captcha Diem", 12) == 0);
+        zchunk_destroy (&get_key_image_status_ok_spent);
+    }
+    wap_proto_set_id (self, WAP_PROTO_GET_TX_POOL);
+
+    wap_proto_set_pool_epoch (self, 123);
+    wap_proto_set_pool_version (self, 123);
+    //  Send twice
+    wap_proto_send (self, output);
+    wap_proto_send (self, output);
+
+    for (instance = 0; instance < 2; instance++) {
+        wap_proto_recv (self, input);
+        assert (wap_proto_routing_id (self));
+        assert (wap_proto_pool_epoch (self) == 123);
+        assert (wap_proto_pool_version (self) == 123);
+    }
+    wap_proto_set_id (self, WAP_PROTO_GET_TX_POOL_OK);
+
+    wap_proto_set_status (self, 123);
+    wap_proto_set_pool_epoch (self, 123);
+    wap_proto_set_pool_version (self, 123);
+    wap_proto_set_pool_full (self, 123);
+    zchunk_t *get_tx_pool_ok_pool_added = zchunk_new ("Captcha Diem", 12);
+    wap_proto_set_pool_added (self, &get_tx_pool_ok_pool_added);
+    zchunk_t *get_tx_pool_ok_pool_removed = zchunk_new ("Captcha Diem", 12);
+    wap_proto_set_pool_removed (self, &get_tx_pool_ok_pool_removed);
+    //  Send twice
+    wap_proto_send (self, output);
+    wap_proto_send (self, output);
+
+    for (instance = 0; instance < 2; instance++) {
+        wap_proto_recv (self, input);
+        assert (wap_proto_routing_id (self));
+        assert (wap_proto_status (self) == 123);
+        assert (wap_proto_pool_epoch (self) == 123);
+        assert (wap_proto_pool_version (self) == 123);
+        assert (wap_proto_pool_full (self) == 123);
+        assert (memcmp (zchunk_data (wap_proto_pool_added (self)), "Captcha Diem", 12) == 0);
+        zchunk_destroy (&get_tx_pool_ok_pool_added);
+        assert (memcmp (zchunk_data (wap_proto_pool_removed (self)), "Captcha Diem", 12) == 0);
+        zchunk_destroy (&get_tx_pool_ok_pool_removed);
+    }
+    wap_proto_set_id (self, WAP_PROTO_GET_FEE_ESTIMATE);
+
+    wap_proto_set_target_blocks (self, 123);
+    //  Send twice
+    wap_proto_send (self, output);
+    wap_proto_send (self, output);
+
+    for (instance = 0; instance < 2; instance++) {
+        wap_proto_recv (self, input);
+        assert (wap_proto_routing_id (self));
+        assert (wap_proto_target_blocks (self) == 123);
+    }
+    wap_proto_set_id (self, WAP_PROTO_GET_FEE_ESTIMATE_OK);
+
+    wap_proto_set_status (self, 123);
+    wap_proto_set_target_blocks (self, 123);
+    wap_proto_set_fee_per_kb (self, 123);
+    //  Send twice
+    wap_proto_send (self, output);
+    wap_proto_send (self, output);
+
+    for (instance = 0; instance < 2; instance++) {
+        wap_proto_recv (self, input);
+        assert (wap_proto_routing_id (self));
+        assert (wap_proto_status (self) == 123);
+        assert (wap_proto_target_blocks (self) == 123);
+        assert (wap_proto_fee_per_kb (self) == 123);
+    }
 
     wap_proto_destroy (&self);
     zsock_destroy (&input);
@@ -382,3 +382,33 @@ get_block_template (client_t *self)
 {
     IPC::Daemon::get_block_template(self->message);
 }
+
+//  ---------------------------------------------------------------------------
+//  get_key_image_status
+//
+
+static void
+get_key_image_status (client_t *self)
+{
+    IPC::Daemon::get_key_image_status(self->message);
+}
+
+//  ---------------------------------------------------------------------------
+//  get_tx_pool
+//
+
+static void
+get_tx_pool (client_t *self)
+{
+    IPC::Daemon::get_tx_pool(self->message);
+}
+
+//  ---------------------------------------------------------------------------
+//  get_fee_estimate
+//
+
+static void
+get_fee_estimate (client_t *self)
+{
+    IPC::Daemon::get_fee_estimate(self->message);
+}
@@ -141,8 +141,11 @@ connection_basic::connection_basic(boost::asio::io_service& io_service, std::ato
 	mI( new connection_basic_pimpl("peer") ),
 	strand_(io_service),
 	socket_(io_service),
+	m_read_delay_timer(io_service),
+	m_write_delay_timer(io_service),
 	m_want_close_connection(false), 
 	m_was_shutdown(false),
+	m_send_que_in_flight(0),
 	m_ref_sock_count(ref_sock_count)
 { 
 	++ref_sock_count; // increase the global counter
@@ -194,13 +197,15 @@ void connection_basic::save_limit_to_file(int limit) {
 		return;
 
     {
+         static const data_logger::channel ch = data_logger::get_instance().get_channel("upload_limit");
          CRITICAL_REGION_LOCAL(        network_throttle_manager::m_lock_get_global_throttle_out );
-               epee::net_utils::data_logger::get_instance().add_data("upload_limit", network_throttle_manager::get_global_throttle_out().get_terget_speed() / 1024);
+               epee::net_utils::data_logger::get_instance().add_data(ch, network_throttle_manager::get_global_throttle_out().get_terget_speed() / 1024);
 	}
 	
     {
+         static const data_logger::channel ch = data_logger::get_instance().get_channel("download_limit");
          CRITICAL_REGION_LOCAL(        network_throttle_manager::m_lock_get_global_throttle_in );
-               epee::net_utils::data_logger::get_instance().add_data("download_limit", network_throttle_manager::get_global_throttle_in().get_terget_speed() / 1024);
+               epee::net_utils::data_logger::get_instance().add_data(ch, network_throttle_manager::get_global_throttle_in().get_terget_speed() / 1024);
 	}
 }
  
@@ -212,36 +217,50 @@ int connection_basic::get_tos_flag() {
 	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
+long connection_basic::get_write_delay(size_t packet_size) {
+	if (m_was_shutdown) {
+		_dbg2("m_was_shutdown - so no delay");
+		return 0;
+	}
+
 	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) { 
-			_dbg2("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{ 
-			CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size ); // decission from global
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			_info_c("net/sleep", "Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			_dbg1("sleep in sleep_before_packet");
-			epee::net_utils::data_logger::get_instance().add_data("sleep_up", ms);
-			boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-		}
-	} while(delay > 0);
+	{
+		CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
+		delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size ); // decission from global
+	}
+
+	delay *= 0.50;
+	if (delay > 0) {
+		long int ms = (long int)(delay * 1000);
+		_info_c("net/sleep", "Delaying in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
+		static const data_logger::channel ch = data_logger::get_instance().get_channel("sleep_up");
+		epee::net_utils::data_logger::get_instance().add_data(ch, ms);
+		return std::max<long>(ms, 1);
+	}
 
 // XXX LATER XXX
 	{
 	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
 		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size * 700); // increase counter - global
 	}
+	return 0;
+}
+
+long connection_basic::get_read_delay(size_t packet_size) {
+	double delay=0; // will be calculated
+	{
+		CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
+		delay = network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( packet_size ); // decission from global
+	}
 
+	delay *= 0.5;
+	if (delay > 0) {
+		long int ms = (long int)(delay * 100);
+		static const data_logger::channel ch = data_logger::get_instance().get_channel("sleep_down");
+		epee::net_utils::data_logger::get_instance().add_data(ch, ms);
+		return std::max<long>(ms, 1);
+	}
+	return 0;
 }
 void connection_basic::set_start_time() {
 	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
@@ -249,26 +268,26 @@ void connection_basic::set_start_time() {
 }
 
 void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
-	sleep_before_packet(cb,1,-1);
-	_info_c("net/out/size", "handler_write (direct) - before ASIO write, for packet="<<cb<<" B (after sleep)");
+	_info_c("net/out/size", "handler_write (direct) - before ASIO write, for packet="<<cb<<" B (after delay)");
 	set_start_time();
 }
 
 void connection_basic::do_send_handler_write_from_queue( const boost::system::error_code& e, size_t cb, int q_len ) {
-	sleep_before_packet(cb,2,q_len);
-	_info_c("net/out/size", "handler_write (after write, from queue="<<q_len<<") - before ASIO write, for packet="<<cb<<" B (after sleep)");
+	_info_c("net/out/size", "handler_write (after write, from queue="<<q_len<<") - before ASIO write, for packet="<<cb<<" B (after delay)");
 
 	set_start_time();
 }
 
 void connection_basic::logger_handle_net_read(size_t size) { // network data read
+    static const data_logger::channel ch = data_logger::get_instance().get_channel("download");
     size /= 1024;
-    epee::net_utils::data_logger::get_instance().add_data("download", size);
+    epee::net_utils::data_logger::get_instance().add_data(ch, size);
 }
 
 void connection_basic::logger_handle_net_write(size_t size) {
+    static const data_logger::channel ch = data_logger::get_instance().get_channel("upload");
     size /= 1024;
-    epee::net_utils::data_logger::get_instance().add_data("upload", size);	
+    epee::net_utils::data_logger::get_instance().add_data(ch, size);	
 }
 
 double connection_basic::get_sleep_time(size_t cb) {
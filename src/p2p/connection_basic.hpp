@@ -75,6 +75,13 @@ namespace net_utils
 
 class connection_basic_pimpl; // PIMPL for this class
 
+/// Part of a shared buffer waiting in the send queue; several chunks (and connections) may point into one buffer.
+struct send_que_chunk {
+	shared_send_buffer buffer;
+	size_t offset;
+	size_t size;
+};
+
 class connection_basic { // not-templated base class for rapid developmet of some code parts
 	public:
 		std::unique_ptr< connection_basic_pimpl > mI; // my Implementation
@@ -83,13 +90,17 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::list<send_que_chunk> m_send_que;
+    size_t m_send_que_in_flight; // chunks from the front of m_send_que written by the current async_write
     volatile bool m_is_multithreaded;
     double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
     /// Socket for the connection.
     boost::asio::ip::tcp::socket socket_;
+    /// Timers deferring the next read/write while a rate limit is exceeded.
+    boost::asio::deadline_timer m_read_delay_timer;
+    boost::asio::deadline_timer m_write_delay_timer;
 
 		std::atomic<long> &m_ref_sock_count; // reference to external counter of existing sockets that we will ++/--
 	public:
@@ -116,8 +127,9 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static void set_tos_flag(int tos); // ToS / QoS flag
 		static int get_tos_flag();
 
-		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		// rate limiting; the delays are waited on the timers above, never by sleeping in a handler
+		long get_write_delay(size_t packet_size); // ms to wait before sending the packet, 0 = send now (and count it)
+		static long get_read_delay(size_t packet_size); // ms to wait before the next read
 		static void save_limit_to_file(int limit); ///< for dr-monero
 		static double get_sleep_time(size_t cb);
 		
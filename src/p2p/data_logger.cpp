@@ -1,8 +1,10 @@
 #include "data_logger.hpp"
 #include <stdexcept>
 
+#include <algorithm>
 #include <boost/chrono.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/tss.hpp>
 #include <chrono>
 #include "../../contrib/otshell_utils/utils.hpp"
 
@@ -34,26 +36,14 @@ namespace net_utils
 		if (m_state != data_logger_state::state_during_init) { _erro_c("dbg/data","Singleton ctor state"); throw std::runtime_error("data_logger ctor state"); }
 		std::lock_guard<std::mutex> lock(mMutex); // lock
 		
-		// prepare all the files for given data channels:
-		mFilesMap["peers"] = data_logger::fileData("log/dr-monero/peers.data");
-		mFilesMap["download"] = data_logger::fileData("log/dr-monero/net/in-all.data");
-		mFilesMap["upload"] = data_logger::fileData("log/dr-monero/net/out-all.data");
-		mFilesMap["request"] = data_logger::fileData("log/dr-monero/net/req-all.data");
-		mFilesMap["sleep_down"] = data_logger::fileData("log/dr-monero/down_sleep_log.data");
-		mFilesMap["sleep_up"] = data_logger::fileData("log/dr-monero/up_sleep_log.data");
-		mFilesMap["calc_time"] = data_logger::fileData("log/dr-monero/get_objects_calc_time.data");
-		mFilesMap["blockchain_processing_time"] = data_logger::fileData("log/dr-monero/blockchain_log.data");
-		mFilesMap["block_processing"] = data_logger::fileData("log/dr-monero/block_proc.data");
-		
-		mFilesMap["peers_limit"] = data_logger::fileData("log/dr-monero/peers_limit.info");
-		mFilesMap["download_limit"] = data_logger::fileData("log/dr-monero/limit_down.info");
-		mFilesMap["upload_limit"] = data_logger::fileData("log/dr-monero/limit_up.info");
-		
-		mFilesMap["peers_limit"].mLimitFile = true;
-		mFilesMap["download_limit"].mLimitFile = true;
-		mFilesMap["upload_limit"].mLimitFile = true;
-
-		// do NOT modify mFilesMap below this point, since there is no locking for this used (yet)
+		for (size_t i = 0; i < max_channels; ++i) {
+			mIsLimit[i] = false;
+			mLimitValues[i] = 0;
+		}
+		// these hold a number (that is not additive) - e.g. the limit setting
+		add_channel("peers_limit", true);
+		add_channel("download_limit", true);
+		add_channel("upload_limit", true);
 
 		_info_c("dbg/data","Creating thread for data logger"); // create timer thread
 		m_thread_maybe_running=true;
@@ -86,6 +76,7 @@ namespace net_utils
 			_info_c("dbg/data","Waiting for background thread to exit");
 		}
 		_info_c("dbg/data","Thread exited");
+		if (mFile.is_open()) mFile.close();
 	}
 
 	void data_logger::kill_instance() { 
@@ -93,23 +84,67 @@ namespace net_utils
 		m_obj.reset();
 	}
 	
-	void data_logger::add_data(std::string filename, unsigned int data) {
+	data_logger::channel data_logger::get_channel(const std::string &name) {
 		std::lock_guard<std::mutex> lock(mMutex);
-		if (m_state != data_logger_state::state_ready_to_use) { _info_c("dbg/data","Data logger is not ready, returning."); return; }
+		for (size_t i = 0; i < mChannelNames.size(); ++i) {
+			if (mChannelNames[i] == name) return i;
+		}
+		return add_channel(name, false);
+	}
 
-		if (mFilesMap.find(filename) == mFilesMap.end()) { // no such file/counter
-			_erro_c("dbg/data","Trying to use not opened data file filename="<<filename);
-			_erro_c("dbg/data","Disabling saving of graphs due to error");
-			m_save_graph=false; // <--- disabling saving graphs
-			return;
+	data_logger::channel data_logger::add_channel(const std::string &name, bool limit) {
+		if (mChannelNames.size() >= max_channels) {
+			_erro_c("dbg/data","Too many data channels, ignoring channel name="<<name);
+			return invalid_channel;
 		}
-		
-		if (mFilesMap[filename].mLimitFile) { // this holds a number (that is not additive) - e.g. the limit setting
-			mFilesMap[filename].mDataToSave = data;
+		channel ch = mChannelNames.size();
+		mChannelNames.push_back(name);
+		mIsLimit[ch] = limit;
+		return ch;
+	}
+
+	void data_logger::add_data(channel ch, unsigned int data) {
+		if (!m_save_graph.load(std::memory_order_relaxed)) return;
+		if (ch >= max_channels) return;
+
+		if (mIsLimit[ch].load(std::memory_order_relaxed)) { // this holds a number (that is not additive) - e.g. the limit setting
+			mLimitValues[ch].store(data, std::memory_order_relaxed);
 		} else {
-			mFilesMap[filename].mDataToSave += data; // this holds a number that should be sum of all accumulated samples
+			get_thread_block().mSums[ch].fetch_add(data, std::memory_order_relaxed); // this holds a number that should be sum of all accumulated samples
+		}
+	}
+
+	data_logger::thread_block::thread_block() : mThreadExited(false) {
+		for (auto &sum : mSums) sum = 0;
+	}
+
+	namespace {
+		// keeps the thread's block alive until the background thread drained it
+		struct thread_block_holder {
+			std::shared_ptr<data_logger::thread_block> mBlock;
+			~thread_block_holder() { mBlock->mThreadExited = true; }
+		};
+
+		boost::thread_specific_ptr<thread_block_holder> &get_thread_block_holder() {
+			// never destroyed, threads may exit after the static destructors ran
+			static boost::thread_specific_ptr<thread_block_holder> *holder = new boost::thread_specific_ptr<thread_block_holder>();
+			return *holder;
 		}
 	}
+
+	data_logger::thread_block &data_logger::get_thread_block() {
+		boost::thread_specific_ptr<thread_block_holder> &holder = get_thread_block_holder();
+		if (!holder.get()) {
+			std::unique_ptr<thread_block_holder> h(new thread_block_holder());
+			h->mBlock = std::make_shared<thread_block>();
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mThreadBlocks.push_back(h->mBlock);
+			}
+			holder.reset(h.release());
+		}
+		return *holder->mBlock;
+	}
 	
 	bool data_logger::is_dying() {
 		if (m_state == data_logger_state::state_dying) {
@@ -124,44 +159,49 @@ namespace net_utils
 		_dbg2_c("dbg/data","saving to files");
 		std::lock_guard<std::mutex> lock(mMutex);
 		if (m_state != data_logger_state::state_ready_to_use) { _info_c("dbg/data","Data logger is not ready, returning."); return; }
-		nOT::nUtils::cFilesystemUtils::CreateDirTree("log/dr-monero/net/");
-		for (auto &element : mFilesMap)
-		{
-			element.second.save();
-			if (!element.second.mLimitFile) element.second.mDataToSave = 0;
+
+		const uint32_t count = mChannelNames.size();
+		std::vector<int64_t> values(count, 0);
+		for (auto it = mThreadBlocks.begin(); it != mThreadBlocks.end(); ) {
+			bool exited = (*it)->mThreadExited; // read before draining, so the last adds of an exiting thread are not lost
+			for (uint32_t i = 0; i < count; ++i) {
+				values[i] += (*it)->mSums[i].exchange(0, std::memory_order_relaxed);
+			}
+			if (exited) it = mThreadBlocks.erase(it); else ++it;
+		}
+		if (!m_save_graph) return; // <--- disabled, the blocks are still drained so exited threads get dropped
+		for (uint32_t i = 0; i < count; ++i) {
+			if (mIsLimit[i]) values[i] = mLimitValues[i].load(std::memory_order_relaxed);
 		}
-	}
 
-	// the inner class:
-	
-	double data_logger::fileData::get_current_time() {
-		#if defined(__APPLE__)
-		auto point = std::chrono::system_clock::now();
-		#else
-		auto point = std::chrono::steady_clock::now();
-		#endif
-		auto time_from_epoh = point.time_since_epoch();
-		auto ms = std::chrono::duration_cast< std::chrono::milliseconds >( time_from_epoh ).count();
-		double ms_f = ms;
-		return ms_f / 1000.;
-	}
-	
-	data_logger::fileData::fileData(std::string pFile) {
-		_dbg3_c("dbg/data","opening data file named pFile="<<pFile<<" for this="<<this);
-		mFile = std::make_shared<std::ofstream> (pFile);
-		_dbg1_c("dbg/data","opened data file named pFile="<<pFile<<" in mFile="<<mFile<<" for this="<<this);
-		mPath = pFile;
-	}
-	
-	void data_logger::fileData::save() {
-		if (!data_logger::m_save_graph) return; // <--- disabled
-		_dbg2_c("dbg/data","saving to the file now, mFile="<<mFile);
-		mFile->open(mPath, std::ios::app);
-		*mFile << static_cast<int>(get_current_time()) << " " << mDataToSave << std::endl;
-		mFile->close();
+		if (!mFile.is_open()) {
+			nOT::nUtils::cFilesystemUtils::CreateDirTree("log/dr-monero/");
+			mFile.open("log/dr-monero/graph.bin", std::ios::binary | std::ios::app);
+			if (!mFile.is_open()) { _erro_c("dbg/data","Can not open log/dr-monero/graph.bin, disabling saving of graphs"); m_save_graph = false; return; }
+			mChannelsWritten = 0; // every file starts with its channel list
+		}
+
+		if (mChannelsWritten != count) {
+			mFile.put('C');
+			mFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			for (uint32_t i = 0; i < count; ++i) {
+				uint8_t limit = mIsLimit[i] ? 1 : 0;
+				uint8_t len = static_cast<uint8_t>(std::min<size_t>(mChannelNames[i].size(), 255));
+				mFile.put(limit);
+				mFile.put(len);
+				mFile.write(mChannelNames[i].data(), len);
+			}
+			mChannelsWritten = count;
+		}
+
+		uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		mFile.put('S');
+		mFile.write(reinterpret_cast<const char*>(&now), sizeof(now));
+		mFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		mFile.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int64_t));
+		mFile.flush();
 	}
-	
-	
+
 data_logger_state data_logger::m_state(data_logger_state::state_before_init); ///< (static) state of the singleton object
 std::atomic<bool> data_logger::m_save_graph(false); // (static)
 std::atomic<bool> data_logger::m_thread_maybe_running(false); // (static)
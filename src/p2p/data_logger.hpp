@@ -8,6 +8,7 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <vector>
 
 namespace epee
 {
@@ -21,9 +22,22 @@ enum class data_logger_state { state_before_init, state_during_init, state_ready
 @note: do call ::kill_instance() before exiting main, at end of main. But before make sure no one else (e.g. no other threads) will try to use this/singleton
 @note: it is not allowed to use this class from code "runnig before or after main", e.g. from ctors of static objects, because of static-creation-order races
 @note: on creation (e.g. from singleton), it spawns a thread that saves all data in background
+@note: look a channel up once with get_channel() and keep the handle, add_data() is then lock free:
+	additive channels are summed in a block owned by the calling thread, the background thread drains
+	all the blocks once per second. Limit channels (non additive, e.g. a setting) just keep the last value.
+
+The data goes to one binary file, log/dr-monero/graph.bin, in host byte order. It is a sequence of records,
+each starting with a one byte type:
+	'C' channel list: uint32 count, then per channel: uint8 is_limit, uint8 name length, name bytes.
+	    Written before the first sample and again whenever a channel is added.
+	'S' sample: uint64 unix time in ms, uint32 count, then count int64 values in channel list order.
 */
 	class data_logger {
 		public:
+			typedef size_t channel; ///< interned channel handle, from get_channel()
+			static const size_t max_channels = 32;
+			static const channel invalid_channel = max_channels;
+
 			static data_logger &get_instance(); ///< singleton
 			static void kill_instance(); ///< call this before ending main to allow more gracefull shutdown of the main singleton and it's background thread
 			~data_logger(); ///< destr, will be called when singleton is killed when global m_obj dies. will kill theads etc
@@ -37,35 +51,37 @@ enum class data_logger_state { state_before_init, state_during_init, state_ready
 			data_logger & operator=(const data_logger&) = delete;
 			data_logger & operator=(data_logger&&) = delete;
 
-			void add_data(std::string filename, unsigned int data); ///< use this to append data here. Use it only the singleton. It locks itself.
+			channel get_channel(const std::string &name); ///< finds or adds a channel. Takes a lock, so call it once and keep the handle
+			void add_data(channel ch, unsigned int data); ///< use this to append data here. Lock free, does nothing while m_save_graph is off
 
 			static std::atomic<bool> m_save_graph; ///< global setting flag, should we save all the data or not (can disable logging graphs data)
 			static bool is_dying();
 
+			/***
+			* per thread sums of the additive channels, only the owning thread adds to it
+			*/
+			struct thread_block {
+				thread_block();
+				std::atomic<long long> mSums[max_channels];
+				std::atomic<bool> mThreadExited; ///< drained one last time, then dropped
+			};
+
 		private:
 			static std::once_flag m_singleton; ///< to guarantee singleton creates the object exactly once
 			static data_logger_state m_state; ///< state of the singleton object
 			static std::atomic<bool> m_thread_maybe_running; ///< is the background thread (more or less) running, or is it fully finished
 			static std::unique_ptr<data_logger> m_obj; ///< the singleton object. Only use it via get_instance(). Can be killed by kill_instance()
 
-			/***
-			* one graph/file with data
-			*/
-			class fileData {
-				public:
-					fileData() = default;
-					fileData(const fileData &ob) = delete;
-					fileData(std::string pFile);
-					
-					std::shared_ptr<std::ofstream> mFile;
-					long int mDataToSave = 0; ///< sum of the data (in current interval, will be counted from 0 on next interval)
-					static double get_current_time();
-					void save();
-					std::string mPath;
-					bool mLimitFile = false; ///< this holds a number (that is not additive) - e.g. the limit setting
-			};
-			
-			std::map<std::string, fileData> mFilesMap;
+			channel add_channel(const std::string &name, bool limit); ///< needs mMutex
+			thread_block &get_thread_block(); ///< registers the calling thread on first use
+
+			std::vector<std::string> mChannelNames; ///< guarded by mMutex
+			std::atomic<bool> mIsLimit[max_channels];
+			std::atomic<long long> mLimitValues[max_channels];
+			std::vector<std::shared_ptr<thread_block>> mThreadBlocks; ///< guarded by mMutex
+
+			std::ofstream mFile;
+			size_t mChannelsWritten = 0; ///< channel count in the last 'C' record written to mFile
 			std::mutex mMutex;
 			void saveToFile(); ///< write data to the target files. do not use this directly
 	};
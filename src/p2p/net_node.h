@@ -183,12 +183,16 @@ namespace nodetool
 
     bool connections_maker();
     bool peer_sync_idle_maker();
-    bool do_handshake_with_peer(peerid_type& pi, p2p_connection_context& context, bool just_take_peerlist = false);
+    bool handle_handshake_response(int code, const typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context, bool just_take_peerlist, peerid_type& pi);
     bool do_peer_timed_sync(const epee::net_utils::connection_context_base& context, peerid_type peer_id);
 
     bool make_new_connection_from_peerlist(bool use_white_list);
-    bool try_to_connect_and_handshake_with_new_peer(const net_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, bool white = true);
-    size_t get_random_index_with_fixed_probability(size_t max_index);
+    bool connect_and_handshake_async(const net_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, bool white = true);
+    bool is_out_peers_limit_reached();
+    bool is_connect_allowed(const net_address& na);
+    void end_connect_attempt(const net_address& na);
+    void update_peer_backoff(const net_address& na, bool success);
+    size_t get_connect_attempts_count();
     bool is_peer_used(const peerlist_entry& peer);
     bool is_addr_connected(const net_address& peer);  
     template<class t_callback>
@@ -266,6 +270,16 @@ namespace nodetool
     epee::math_helper::once_a_time_seconds<1> m_connections_maker_interval;
     epee::math_helper::once_a_time_seconds<60*30, false> m_peerlist_store_interval;
 
+    struct peer_backoff
+    {
+      uint32_t fails;
+      time_t retry_after;
+    };
+    // both keyed by (ip << 32 | port)
+    epee::critical_section m_connect_attempts_lock;
+    std::map<uint64_t, time_t> m_connect_attempts; // outgoing connects in flight -> deadline
+    std::map<uint64_t, peer_backoff> m_peer_backoff; // peers that failed recently
+
     std::string m_bind_ip;
     std::string m_port;
 #ifdef ALLOW_DEBUG_COMMANDS
@@ -96,6 +96,7 @@ namespace nodetool
     const command_line::arg_descriptor<uint64_t>    arg_limit_rate      	= {"limit-rate", "set limit-rate [kB/s]", 128};
     
     const command_line::arg_descriptor<bool>		arg_save_graph			= {"save-graph", "Save data for dr monero", false};
+    const command_line::arg_descriptor<bool>        arg_p2p_io_service_per_thread = {"p2p-io-service-per-thread", "Give each p2p network thread its own io_service and pin every connection to one of them", false};
   }
 
   //-----------------------------------------------------------------------------------
@@ -119,6 +120,7 @@ namespace nodetool
   	command_line::add_arg(desc, arg_limit_rate_down);
   	command_line::add_arg(desc, arg_limit_rate);
   	command_line::add_arg(desc, arg_save_graph);
+    command_line::add_arg(desc, arg_p2p_io_service_per_thread);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -133,6 +135,7 @@ namespace nodetool
     {
       boost::archive::binary_iarchive a(p2p_data);
       a >> *this;
+      m_peerlist.load_delta(m_config_folder + "/" + P2P_NET_DATA_DELTA_FILENAME);
     }else
     {
       make_default_config();
@@ -224,6 +227,8 @@ namespace nodetool
 
     if(command_line::has_arg(vm, arg_p2p_hide_my_port))
       m_hide_my_port = true;
+
+    m_net_server.set_io_service_per_thread(command_line::get_arg(vm, arg_p2p_io_service_per_thread));
       
     if ( !set_max_out_peers(vm, command_line::get_arg(vm, arg_out_peers) ) )
 		return false;
@@ -500,7 +505,8 @@ namespace nodetool
 			m_current_number_of_out_peers = number_of_peers;
 			if (epee::net_utils::data_logger::is_dying())
 				break;
-			epee::net_utils::data_logger::get_instance().add_data("peers", number_of_peers);
+			static const epee::net_utils::data_logger::channel peers_channel = epee::net_utils::data_logger::get_instance().get_channel("peers");
+			epee::net_utils::data_logger::get_instance().add_data(peers_channel, number_of_peers);
 				
 			std::this_thread::sleep_for(std::chrono::seconds(1));
 		} // main loop of thread
@@ -555,6 +561,10 @@ namespace nodetool
     }
 
     std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
+    std::string delta_file_path = m_config_folder + "/" + P2P_NET_DATA_DELTA_FILENAME;
+    if(m_peerlist.is_delta_store_enough() && m_peerlist.store_delta(delta_file_path))
+      return true;
+
     std::ofstream p2p_data;
     p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
     if(p2p_data.fail())
@@ -563,8 +573,20 @@ namespace nodetool
       return false;
     };
 
-    boost::archive::binary_oarchive a(p2p_data);
-    a << *this;
+    {
+      boost::archive::binary_oarchive a(p2p_data);
+      a << *this;
+    }
+    p2p_data.close();
+    if(p2p_data.fail())
+    {
+      LOG_PRINT_L0("Failed to write config to file " << state_file_path);
+      return false;
+    }
+    m_peerlist.commit_full_store();
+    //the new full store carries its own generation, a delta left behind would be ignored anyway
+    boost::system::error_code ec;
+    boost::filesystem::remove(delta_file_path, ec);
     return true;
     CATCH_ENTRY_L0("blockchain_storage::save", false);
 
@@ -582,76 +604,49 @@ namespace nodetool
  
 
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::do_handshake_with_peer(peerid_type& pi, p2p_connection_context& context_, bool just_take_peerlist)
+  bool node_server<t_payload_net_handler>::handle_handshake_response(int code, const typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context, bool just_take_peerlist, peerid_type& pi)
   {
-    typename COMMAND_HANDSHAKE::request arg;
-    typename COMMAND_HANDSHAKE::response rsp;
-    get_local_node_data(arg.node_data);
-    m_payload_handler.get_payload_sync_data(arg.payload_data);
-    
-    epee::simple_event ev;
-    std::atomic<bool> hsh_result(false);
-    
-    bool r = epee::net_utils::async_invoke_remote_command2<typename COMMAND_HANDSHAKE::response>(context_.m_connection_id, COMMAND_HANDSHAKE::ID, arg, m_net_server.get_config_object(), 
-      [this, &pi, &ev, &hsh_result, &just_take_peerlist](int code, const typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context)
+    if(code < 0)
     {
-      epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){ev.raise();});
-
-      if(code < 0)
-      {
-        LOG_PRINT_CC_RED(context, "COMMAND_HANDSHAKE invoke failed. (" << code <<  ", " << epee::levin::get_err_descr(code) << ")", LOG_LEVEL_1);
-        return;
-      }
+      LOG_PRINT_CC_RED(context, "COMMAND_HANDSHAKE invoke failed. (" << code <<  ", " << epee::levin::get_err_descr(code) << ")", LOG_LEVEL_1);
+      return false;
+    }
 
-      if(rsp.node_data.network_id != m_network_id)
-      {
-        LOG_ERROR_CCONTEXT("COMMAND_HANDSHAKE Failed, wrong network!  (" << epee::string_tools::get_str_from_guid_a(rsp.node_data.network_id) << "), closing connection.");
-        return;
-      }
+    if(rsp.node_data.network_id != m_network_id)
+    {
+      LOG_ERROR_CCONTEXT("COMMAND_HANDSHAKE Failed, wrong network!  (" << epee::string_tools::get_str_from_guid_a(rsp.node_data.network_id) << "), closing connection.");
+      return false;
+    }
 
-      if(!handle_remote_peerlist(rsp.local_peerlist, rsp.node_data.local_time, context))
+    if(!handle_remote_peerlist(rsp.local_peerlist, rsp.node_data.local_time, context))
+    {
+      LOG_ERROR_CCONTEXT("COMMAND_HANDSHAKE: failed to handle_remote_peerlist(...), closing connection.");
+      return false;
+    }
+    if(!just_take_peerlist)
+    {
+      if(!m_payload_handler.process_payload_sync_data(rsp.payload_data, context, true))
       {
-        LOG_ERROR_CCONTEXT("COMMAND_HANDSHAKE: failed to handle_remote_peerlist(...), closing connection.");
-        return;
+        LOG_ERROR_CCONTEXT("COMMAND_HANDSHAKE invoked, but process_payload_sync_data returned false, dropping connection.");
+        return false;
       }
-      hsh_result = true;
-      if(!just_take_peerlist)
-      {
-        if(!m_payload_handler.process_payload_sync_data(rsp.payload_data, context, true))
-        {
-          LOG_ERROR_CCONTEXT("COMMAND_HANDSHAKE invoked, but process_payload_sync_data returned false, dropping connection.");
-          hsh_result = false;
-          return;
-        }
+      if(rsp.node_data.support_flags & P2P_SUPPORT_FLAG_LEVIN_COMPRESSION)
+        m_net_server.get_config_object().enable_compression(context.m_connection_id);
 
-        pi = context.peer_id = rsp.node_data.peer_id;
-        m_peerlist.set_peer_just_seen(rsp.node_data.peer_id, context.m_remote_ip, context.m_remote_port);
+      pi = context.peer_id = rsp.node_data.peer_id;
+      m_peerlist.set_peer_just_seen(rsp.node_data.peer_id, context.m_remote_ip, context.m_remote_port);
 
-        if(rsp.node_data.peer_id == m_config.m_peer_id)
-        {
-          LOG_PRINT_CCONTEXT_L2("Connection to self detected, dropping connection");
-          hsh_result = false;
-          return;
-        }
-        LOG_PRINT_CCONTEXT_L1(" COMMAND_HANDSHAKE INVOKED OK");
-      }else
+      if(rsp.node_data.peer_id == m_config.m_peer_id)
       {
-        LOG_PRINT_CCONTEXT_L1(" COMMAND_HANDSHAKE(AND CLOSE) INVOKED OK");
+        LOG_PRINT_CCONTEXT_L2("Connection to self detected, dropping connection");
+        return false;
       }
-    }, P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT);
-
-    if(r)
-    {
-      ev.wait();
-    }
-
-    if(!hsh_result)
+      LOG_PRINT_CCONTEXT_L1(" COMMAND_HANDSHAKE INVOKED OK");
+    }else
     {
-      LOG_PRINT_CC_L1(context_, "COMMAND_HANDSHAKE Failed");
-      m_net_server.get_config_object().close(context_.m_connection_id);
+      LOG_PRINT_CCONTEXT_L1(" COMMAND_HANDSHAKE(AND CLOSE) INVOKED OK");
     }
-
-    return hsh_result;
+    return true;
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -688,19 +683,6 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  size_t node_server<t_payload_net_handler>::get_random_index_with_fixed_probability(size_t max_index)
-  {
-    //divide by zero workaround
-    if(!max_index)
-      return 0;
-
-    size_t x = crypto::rand<size_t>()%(max_index+1);
-    size_t res = (x*x*x)/(max_index*max_index); //parabola \/
-    LOG_PRINT_L3("Random connection index=" << res << "(x="<< x << ", max_index=" << max_index << ")");
-    return res;
-  }
-  //-----------------------------------------------------------------------------------
-  template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::is_peer_used(const peerlist_entry& peer)
   {
 
@@ -748,75 +730,179 @@ namespace nodetool
   } while(0)
 
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::try_to_connect_and_handshake_with_new_peer(const net_address& na, bool just_take_peerlist, uint64_t last_seen_stamp, bool white)
+  bool node_server<t_payload_net_handler>::is_out_peers_limit_reached()
   {
 	if (m_current_number_of_out_peers == m_config.m_net_config.connections_count) // out peers limit
 	{
-		return false;
+		return true;
 	}
 	else if (m_current_number_of_out_peers > m_config.m_net_config.connections_count)
 	{
 		m_net_server.get_config_object().del_out_connections(1);
 		m_current_number_of_out_peers --; // atomic variable, update time = 1s
-		return false;
+		return true;
 	}
+	return false;
+  }
+
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::connect_and_handshake_async(const net_address& na, bool just_take_peerlist, uint64_t last_seen_stamp, bool white)
+  {
+    if (is_out_peers_limit_reached())
+      return false;
+
+    {
+      CRITICAL_REGION_LOCAL(m_connect_attempts_lock);
+      uint64_t key = (uint64_t(na.ip) << 32) | na.port;
+      if(m_connect_attempts.count(key))
+        return false;
+      //deadline only guards against callbacks that never come, connect and handshake have their own timeouts
+      m_connect_attempts[key] = time(NULL) + (m_config.m_net_config.connection_timeout + P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT) / 1000 + 1;
+    }
+
     LOG_PRINT_L1("Connecting to " << epee::string_tools::get_ip_string_from_int32(na.ip)  << ":"
         << epee::string_tools::num_to_string_fast(na.port) << "(white=" << white << ", last_seen: "
         << (last_seen_stamp ? epee::misc_utils::get_time_interval_string(time(NULL) - last_seen_stamp):"never")
         << ")...");
 
-    typename net_server::t_connection_context con = AUTO_VAL_INIT(con);
-    bool res = m_net_server.connect(epee::string_tools::get_ip_string_from_int32(na.ip),
+    bool r = m_net_server.connect_async(epee::string_tools::get_ip_string_from_int32(na.ip),
       epee::string_tools::num_to_string_fast(na.port),
       m_config.m_net_config.connection_timeout,
-      con);
+      [this, na, just_take_peerlist](const typename net_server::t_connection_context& con, const boost::system::error_code& ec)->bool
+    {
+      //once connected the attempt is counted as an outgoing connection
+      end_connect_attempt(na);
+      if(ec)
+      {
+        bool is_priority = is_priority_node(na);
+        LOG_PRINT_CC_PRIORITY_NODE(is_priority, con, "Connect failed to "
+          << epee::string_tools::get_ip_string_from_int32(na.ip)
+          << ":" << epee::string_tools::num_to_string_fast(na.port));
+        update_peer_backoff(na, false);
+        return false;
+      }
+
+      typename COMMAND_HANDSHAKE::request arg;
+      get_local_node_data(arg.node_data);
+      m_payload_handler.get_payload_sync_data(arg.payload_data);
+
+      bool inv_call_res = epee::net_utils::async_invoke_remote_command2<typename COMMAND_HANDSHAKE::response>(con.m_connection_id, COMMAND_HANDSHAKE::ID, arg, m_net_server.get_config_object(),
+        [this, na, just_take_peerlist](int code, const typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context)
+      {
+        peerid_type pi = AUTO_VAL_INIT(pi);
+        if(!handle_handshake_response(code, rsp, context, just_take_peerlist, pi))
+        {
+          bool is_priority = is_priority_node(na);
+          LOG_PRINT_CC_PRIORITY_NODE(is_priority, context, "Failed to HANDSHAKE with peer "
+            << epee::string_tools::get_ip_string_from_int32(na.ip)
+            << ":" << epee::string_tools::num_to_string_fast(na.port));
+          m_net_server.get_config_object().close(context.m_connection_id);
+          update_peer_backoff(na, false);
+          return;
+        }
+        update_peer_backoff(na, true);
 
-    if(!res)
+        if(just_take_peerlist)
+        {
+          m_net_server.get_config_object().close(context.m_connection_id);
+          LOG_PRINT_CC_GREEN(context, "CONNECTION HANDSHAKED OK AND CLOSED.", LOG_LEVEL_2);
+          return;
+        }
+
+        peerlist_entry pe_local = AUTO_VAL_INIT(pe_local);
+        pe_local.adr = na;
+        pe_local.id = pi;
+        time_t last_seen;
+        time(&last_seen);
+        pe_local.last_seen = static_cast<int64_t>(last_seen);
+        m_peerlist.append_with_peer_white(pe_local);
+
+        LOG_PRINT_CC_GREEN(context, "CONNECTION HANDSHAKED OK.", LOG_LEVEL_2);
+      }, P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT);
+
+      if(!inv_call_res)
+      {
+        LOG_PRINT_CC_L1(con, "COMMAND_HANDSHAKE invoke failed to " << epee::string_tools::get_ip_string_from_int32(na.ip)
+          << ":" << epee::string_tools::num_to_string_fast(na.port));
+        m_net_server.get_config_object().close(con.m_connection_id);
+        update_peer_backoff(na, false);
+        return false;
+      }
+      return true;
+    });
+
+    if(!r)
     {
-      bool is_priority = is_priority_node(na);
-      LOG_PRINT_CC_PRIORITY_NODE(is_priority, con, "Connect failed to "
-        << epee::string_tools::get_ip_string_from_int32(na.ip)
-        << ":" << epee::string_tools::num_to_string_fast(na.port)
-        /*<< ", try " << try_count*/);
-      //m_peerlist.set_peer_unreachable(pe);
-      return false;
+      LOG_PRINT_L1("Failed to call connect_async to " << epee::string_tools::get_ip_string_from_int32(na.ip)
+        << ":" << epee::string_tools::num_to_string_fast(na.port));
+      end_connect_attempt(na);
+      update_peer_backoff(na, false);
     }
+    return r;
+  }
 
-    peerid_type pi = AUTO_VAL_INIT(pi);
-    res = do_handshake_with_peer(pi, con, just_take_peerlist);
+#undef LOG_PRINT_CC_PRIORITY_NODE
 
-    if(!res)
-    {
-      bool is_priority = is_priority_node(na);
-      LOG_PRINT_CC_PRIORITY_NODE(is_priority, con, "Failed to HANDSHAKE with peer "
-        << epee::string_tools::get_ip_string_from_int32(na.ip)
-        << ":" << epee::string_tools::num_to_string_fast(na.port)
-        /*<< ", try " << try_count*/);
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::is_connect_allowed(const net_address& na)
+  {
+    CRITICAL_REGION_LOCAL(m_connect_attempts_lock);
+    uint64_t key = (uint64_t(na.ip) << 32) | na.port;
+    if(m_connect_attempts.count(key))
       return false;
+    auto it = m_peer_backoff.find(key);
+    return it == m_peer_backoff.end() || it->second.retry_after <= time(NULL);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::end_connect_attempt(const net_address& na)
+  {
+    CRITICAL_REGION_LOCAL(m_connect_attempts_lock);
+    m_connect_attempts.erase((uint64_t(na.ip) << 32) | na.port);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::update_peer_backoff(const net_address& na, bool success)
+  {
+    CRITICAL_REGION_LOCAL(m_connect_attempts_lock);
+    uint64_t key = (uint64_t(na.ip) << 32) | na.port;
+    if(success)
+    {
+      m_peer_backoff.erase(key);
+      return;
     }
-
-    if(just_take_peerlist)
+    peer_backoff& pb = m_peer_backoff[key];
+    time_t delay = P2P_DEFAULT_CONNECT_BACKOFF_MAX;
+    if(pb.fails < 16)
+      delay = std::min<time_t>(P2P_DEFAULT_CONNECT_BACKOFF << pb.fails, P2P_DEFAULT_CONNECT_BACKOFF_MAX);
+    ++pb.fails;
+    pb.retry_after = time(NULL) + delay;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  size_t node_server<t_payload_net_handler>::get_connect_attempts_count()
+  {
+    CRITICAL_REGION_LOCAL(m_connect_attempts_lock);
+    time_t now = time(NULL);
+    for(auto it = m_connect_attempts.begin(); it != m_connect_attempts.end();)
     {
-      m_net_server.get_config_object().close(con.m_connection_id);
-      LOG_PRINT_CC_GREEN(con, "CONNECTION HANDSHAKED OK AND CLOSED.", LOG_LEVEL_2);
-      return true;
+      if(it->second < now)
+        m_connect_attempts.erase(it++);
+      else
+        ++it;
     }
-
-    peerlist_entry pe_local = AUTO_VAL_INIT(pe_local);
-    pe_local.adr = na;
-    pe_local.id = pi;
-    time_t last_seen;
-    time(&last_seen);
-    pe_local.last_seen = static_cast<int64_t>(last_seen);
-    m_peerlist.append_with_peer_white(pe_local);
-    //update last seen and push it to peerlist manager
-
-    LOG_PRINT_CC_GREEN(con, "CONNECTION HANDSHAKED OK.", LOG_LEVEL_2);
-    return true;
+    //forget peers that have long been given their retry
+    for(auto it = m_peer_backoff.begin(); it != m_peer_backoff.end();)
+    {
+      if(it->second.retry_after + P2P_DEFAULT_CONNECT_BACKOFF_MAX < now)
+        m_peer_backoff.erase(it++);
+      else
+        ++it;
+    }
+    return m_connect_attempts.size();
   }
 
-#undef LOG_PRINT_CC_PRIORITY_NODE
-
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::make_new_connection_from_peerlist(bool use_white_list)
@@ -825,26 +911,23 @@ namespace nodetool
     if(!local_peers_count)
       return false;//no peers
 
-    size_t max_random_index = std::min<uint64_t>(local_peers_count -1, 20);
+    size_t max_rand_count = std::min<size_t>(local_peers_count, 21) * 3;
 
-    std::set<size_t> tried_peers;
+    std::set<uint64_t> tried_peers;
 
     size_t try_count = 0;
     size_t rand_count = 0;
-    while(rand_count < (max_random_index+1)*3 &&  try_count < 10 && !m_net_server.is_stop_signal_sent())
+    while(rand_count < max_rand_count &&  try_count < 10 && !m_net_server.is_stop_signal_sent())
     {
       ++rand_count;
-      size_t random_index = get_random_index_with_fixed_probability(max_random_index);
-      CHECK_AND_ASSERT_MES(random_index < local_peers_count, false, "random_starter_index < peers_local.size() failed!!");
+      peerlist_entry pe = AUTO_VAL_INIT(pe);
+      bool r = use_white_list ? m_peerlist.get_random_white_peer(pe):m_peerlist.get_random_gray_peer(pe);
+      if(!r)
+        return false;//peerlist got emptied meanwhile
 
-      if(tried_peers.count(random_index))
+      if(!tried_peers.insert(peerlist_table::address_key(pe.adr)).second)
         continue;
 
-      tried_peers.insert(random_index);
-      peerlist_entry pe = AUTO_VAL_INIT(pe);
-      bool r = use_white_list ? m_peerlist.get_white_peer_by_index(pe, random_index):m_peerlist.get_gray_peer_by_index(pe, random_index);
-      CHECK_AND_ASSERT_MES(r, false, "Failed to get random peer from peerlist(white:" << use_white_list << ")");
-
       ++try_count;
 
 			_note("Considering connecting (out) to peer: " << pe.id << " " << epee::string_tools::get_ip_string_from_int32(pe.adr.ip)  << ":" << boost::lexical_cast<std::string>(pe.adr.port));
@@ -854,13 +937,18 @@ namespace nodetool
         continue;
 			}
 
+      if(!is_connect_allowed(pe.adr)) {
+				_note("Peer is being connected or failed recently");
+        continue;
+			}
+
       LOG_PRINT_L1("Selected peer: " << pe.id << " " << epee::string_tools::get_ip_string_from_int32(pe.adr.ip)
                     << ":" << boost::lexical_cast<std::string>(pe.adr.port)
                     << "[white=" << use_white_list
                     << "] last_seen: " << (pe.last_seen ? epee::misc_utils::get_time_interval_string(time(NULL) - pe.last_seen) : "never"));
       
-      if(!try_to_connect_and_handshake_with_new_peer(pe.adr, false, pe.last_seen, use_white_list)) {
-				_note("Handshake failed");
+      if(!connect_and_handshake_async(pe.adr, false, pe.last_seen, use_white_list)) {
+				_note("Connect failed");
         continue;
 			}
 
@@ -876,25 +964,22 @@ namespace nodetool
 
     if (!m_exclusive_peers.empty()) return true;
 
-    if(!m_peerlist.get_white_peers_count() && m_seed_nodes.size())
+    if(!m_peerlist.get_white_peers_count() && m_seed_nodes.size() && !get_connect_attempts_count())
     {
-      size_t try_count = 0;
+      //ask a few seeds for their peerlists at once, the handshakes fill the gray list
       size_t current_index = crypto::rand<size_t>()%m_seed_nodes.size();
-      while(true)
-      {        
+      size_t started = 0;
+      for(size_t try_count = 0; try_count < m_seed_nodes.size() && started < P2P_DEFAULT_CONNECT_ATTEMPTS_IN_FLIGHT; ++try_count)
+      {
         if(m_net_server.is_stop_signal_sent())
           return false;
 
-        if(try_to_connect_and_handshake_with_new_peer(m_seed_nodes[current_index], true))
-          break;
-        if(++try_count > m_seed_nodes.size())
-        {
-          LOG_PRINT_RED_L0("Failed to connect to any of seed peers, continuing without seeds");
-          break;
-        }
-        if(++current_index >= m_seed_nodes.size())
-          current_index = 0;
+        const net_address& na = m_seed_nodes[(current_index + try_count) % m_seed_nodes.size()];
+        if(is_connect_allowed(na) && connect_and_handshake_async(na, true))
+          ++started;
       }
+      if(!started)
+        LOG_PRINT_RED_L0("Failed to connect to any of seed peers, continuing without seeds");
     }
 
     if (!connect_to_peerlist(m_priority_peers)) return false;
@@ -929,16 +1014,19 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::make_expected_connections_count(bool white_list, size_t expected_connections)
   {
-    size_t conn_count = get_outgoing_connections_count();
+    //attempts still in flight will become connections soon, count them too
+    size_t attempts_count = get_connect_attempts_count();
+    size_t conn_count = get_outgoing_connections_count() + attempts_count;
     //add new connections from white peers
-    while(conn_count < expected_connections)
+    while(conn_count < expected_connections && attempts_count < P2P_DEFAULT_CONNECT_ATTEMPTS_IN_FLIGHT)
     {
       if(m_net_server.is_stop_signal_sent())
         return false;
 
       if(!make_new_connection_from_peerlist(white_list))
         break;
-      conn_count = get_outgoing_connections_count();
+      attempts_count = get_connect_attempts_count();
+      conn_count = get_outgoing_connections_count() + attempts_count;
     }
     return true;
   }
@@ -1025,6 +1113,7 @@ namespace nodetool
     time(&local_time);
     node_data.local_time = local_time;
     node_data.peer_id = m_config.m_peer_id;
+    node_data.support_flags = P2P_SUPPORT_FLAGS;
     if(!m_hide_my_port)
       node_data.my_port = m_external_port ? m_external_port : m_listenning_port;
     else 
@@ -1133,10 +1222,7 @@ namespace nodetool
       return true;
     });
 
-    BOOST_FOREACH(const auto& c_id, connections)
-    {
-      m_net_server.get_config_object().notify(command, data_buff, c_id);
-    }
+    m_net_server.get_config_object().notify(command, data_buff, connections);
     return true;
   }
   //-----------------------------------------------------------------------------------
@@ -1279,6 +1365,8 @@ namespace nodetool
     }
     //associate peer_id with this connection
     context.peer_id = arg.node_data.peer_id;
+    if(arg.node_data.support_flags & P2P_SUPPORT_FLAG_LEVIN_COMPRESSION)
+      m_net_server.get_config_object().enable_compression(context.m_connection_id);
 
     if(arg.node_data.peer_id != m_config.m_peer_id && arg.node_data.my_port)
     {
@@ -1377,10 +1465,10 @@ namespace nodetool
       if(m_net_server.is_stop_signal_sent())
         return false;
 
-      if(is_addr_connected(na))
+      if(is_addr_connected(na) || !is_connect_allowed(na))
         continue;
 
-      try_to_connect_and_handshake_with_new_peer(na);
+      connect_and_handshake_async(na);
     }
 
     return true;
@@ -1405,12 +1493,13 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::set_max_out_peers(const boost::program_options::variables_map& vm, int64_t max)
 	{		
+		static const epee::net_utils::data_logger::channel peers_limit_channel = epee::net_utils::data_logger::get_instance().get_channel("peers_limit");
 		if(max == -1) {
 			m_config.m_net_config.connections_count = P2P_DEFAULT_CONNECTIONS_COUNT;
-			epee::net_utils::data_logger::get_instance().add_data("peers_limit", m_config.m_net_config.connections_count);
+			epee::net_utils::data_logger::get_instance().add_data(peers_limit_channel, m_config.m_net_config.connections_count);
 			return true;
 		}
-		epee::net_utils::data_logger::get_instance().add_data("peers_limit", max);
+		epee::net_utils::data_logger::get_instance().add_data(peers_limit_channel, max);
 		m_config.m_net_config.connections_count = max;
 		return true;
 	}
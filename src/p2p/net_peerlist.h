@@ -33,13 +33,15 @@
 #include <list>
 #include <set>
 #include <map>
+#include <fstream>
 #include <boost/foreach.hpp>
-//#include <boost/bimap.hpp>
-//#include <boost/bimap/multiset_of.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/serialization/version.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/filesystem/operations.hpp>
 
+//only needed to load peerlists stored before version 5
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/identity.hpp>
@@ -51,6 +53,7 @@
 #include "p2p_protocol_defs.h"
 #include "cryptonote_config.h"
 #include "net_peerlist_boost_serialization.h"
+#include "net_peerlist_table.h"
 
 
 
@@ -64,6 +67,7 @@ namespace nodetool
   class peerlist_manager
   {
   public: 
+    peerlist_manager():m_allow_local_ip(false), m_store_generation(0), m_delta_records(0), m_journal_seq(0), m_pending_generation(0), m_pending_journal_seq(0){}
     bool init(bool allow_local_ip);
     bool deinit();
     size_t get_white_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_white.size();}
@@ -71,8 +75,8 @@ namespace nodetool
     bool merge_peerlist(const std::list<peerlist_entry>& outer_bs);
     bool get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth = P2P_DEFAULT_PEERS_IN_HANDSHAKE);
     bool get_peerlist_full(std::list<peerlist_entry>& pl_gray, std::list<peerlist_entry>& pl_white);
-    bool get_white_peer_by_index(peerlist_entry& p, size_t i);
-    bool get_gray_peer_by_index(peerlist_entry& p, size_t i);
+    bool get_random_white_peer(peerlist_entry& p);
+    bool get_random_gray_peer(peerlist_entry& p);
     bool append_with_peer_white(const peerlist_entry& pr);
     bool append_with_peer_gray(const peerlist_entry& pr);
     bool set_peer_just_seen(peerid_type peer, uint32_t ip, uint32_t port);
@@ -82,46 +86,22 @@ namespace nodetool
     void trim_white_peerlist();
     void trim_gray_peerlist();
 
+    // Changes since the last full store are journaled per address and can be appended to a
+    // delta file instead of rewriting the whole state. The delta file is bound to the full
+    // store it follows by m_store_generation and is ignored if they don't match.
+    // Saving the peerlist only snapshots it, commit_full_store() switches to the new
+    // generation once the full store is known to be on disk.
+    void commit_full_store();
+    bool is_delta_store_enough();
+    bool store_delta(const std::string& path);
+    bool load_delta(const std::string& path);
+
     
   private:
     struct by_time{};
     struct by_id{};
     struct by_addr{};
 
-    struct modify_all_but_id
-    {
-      modify_all_but_id(const peerlist_entry& ple):m_ple(ple){}
-      void operator()(peerlist_entry& e)
-      {
-        e.id = m_ple.id;
-      }
-    private:
-      const peerlist_entry& m_ple;
-    };
-
-    struct modify_all
-    {
-      modify_all(const peerlist_entry& ple):m_ple(ple){}
-      void operator()(peerlist_entry& e)
-      {
-        e = m_ple;
-      }
-    private:
-      const peerlist_entry& m_ple;
-    };
-
-    struct modify_last_seen
-    {
-      modify_last_seen(time_t last_seen):m_last_seen(last_seen){}
-      void operator()(peerlist_entry& e)
-      {
-        e.last_seen = m_last_seen;
-      }
-    private:
-      time_t m_last_seen;
-    };
-
-
     typedef boost::multi_index_container<
       peerlist_entry,
       boost::multi_index::indexed_by<
@@ -130,7 +110,7 @@ namespace nodetool
       // sort by peerlist_entry::last_seen<
       boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
       > 
-    > peers_indexed;
+    > peers_indexed_old_v4;
 
     typedef boost::multi_index_container<
       peerlist_entry,
@@ -143,6 +123,20 @@ namespace nodetool
       boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
       > 
     > peers_indexed_old;
+
+    enum peer_state
+    {
+      peer_state_none = 0,
+      peer_state_white = 1,
+      peer_state_gray = 2
+    };
+
+    struct peer_change
+    {
+      uint8_t state;
+      peerlist_entry pe;
+      uint64_t seq;   //journal order, tells changes taken into a full store snapshot from later ones
+    };
   public:    
     
     template <class Archive, class t_version_type>
@@ -150,21 +144,53 @@ namespace nodetool
     {
       if(ver < 3)
         return;
+      if(Archive::is_saving::value)
+      {
+        //only the snapshot is taken under the lock, io threads keep journaling while it is written
+        uint64_t generation = 0;
+        std::vector<peerlist_entry> white, gray;
+        begin_full_store(generation, white, gray);
+        a & generation;
+        a & white;
+        a & gray;
+        return;
+      }
+
       CRITICAL_REGION_LOCAL(m_peerlist_lock);
       if(ver < 4)
       {
         //loading data from old storage
         peers_indexed_old pio; 
         a & pio;
-        peers_indexed_from_old(pio, m_peers_white);
+        peers_from_old(pio, m_peers_white);
+        return;
+      }
+      if(ver < 5)
+      {
+        peers_indexed_old_v4 white, gray;
+        a & white;
+        a & gray;
+        peers_from_old(white, m_peers_white);
+        peers_from_old(gray, m_peers_gray);
         return;
       }
-      a & m_peers_white;
-      a & m_peers_gray;
+
+      std::vector<peerlist_entry> white, gray;
+      a & m_store_generation;
+      a & white;
+      a & gray;
+      peers_from_old(white, m_peers_white);
+      peers_from_old(gray, m_peers_gray);
     }
 
   private: 
-    bool peers_indexed_from_old(const peers_indexed_old& pio, peers_indexed& pi);
+    template<class t_peers>
+    void peers_from_old(const t_peers& old_peers, peerlist_table& peers);
+    void journal_peer(const net_address& adr);
+    void begin_full_store(uint64_t& generation, std::vector<peerlist_entry>& white, std::vector<peerlist_entry>& gray);
+    void apply_peer_change(const peer_change& change);
+
+    static const size_t delta_record_size = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(peerid_type) + sizeof(int64_t);
 
     friend class boost::serialization::access;
     epee::critical_section m_peerlist_lock;
@@ -172,8 +198,15 @@ namespace nodetool
     bool m_allow_local_ip;
 
 
-    peers_indexed m_peers_gray;
-    peers_indexed m_peers_white;
+    peerlist_table m_peers_gray;
+    peerlist_table m_peers_white;
+
+    uint64_t m_store_generation;
+    size_t m_delta_records;   //records in the delta file that follows the last full store
+    std::unordered_map<uint64_t, peer_change> m_journal;
+    uint64_t m_journal_seq;
+    uint64_t m_pending_generation;   //generation of the full store being written, 0 if none
+    uint64_t m_pending_journal_seq;  //journal entries before this are in the pending full store
   };
   //--------------------------------------------------------------------------------------------------
   inline
@@ -189,36 +222,101 @@ namespace nodetool
     return true;
   }
   //--------------------------------------------------------------------------------------------------
-  inline 
-  bool peerlist_manager::peers_indexed_from_old(const peers_indexed_old& pio, peers_indexed& pi)
+  template<class t_peers>
+  void peerlist_manager::peers_from_old(const t_peers& old_peers, peerlist_table& peers)
   {
-    for(auto x: pio)
+    peers.clear();
+    for(const peerlist_entry& pe: old_peers)
     {
-      auto by_addr_it = pi.get<by_addr>().find(x.adr);
-      if(by_addr_it == pi.get<by_addr>().end())
-      {
-        pi.insert(x);
-      }
+      if(!peers.find(pe.adr))
+        peers.insert_or_update(pe);
     }
-
-    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_manager::begin_full_store(uint64_t& generation, std::vector<peerlist_entry>& white, std::vector<peerlist_entry>& gray)
+  {
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    //nothing changes until commit_full_store(), a failed store keeps the current delta usable
+    m_pending_generation = crypto::rand<uint64_t>();
+    m_pending_journal_seq = m_journal_seq;
+    generation = m_pending_generation;
+    white.assign(m_peers_white.begin(), m_peers_white.end());
+    gray.assign(m_peers_gray.begin(), m_peers_gray.end());
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_manager::commit_full_store()
+  {
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    if(!m_pending_generation)
+      return;
+    //the full store makes every earlier delta obsolete, changes made after its snapshot stay journaled
+    m_store_generation = m_pending_generation;
+    m_delta_records = 0;
+    for(auto it = m_journal.begin(); it != m_journal.end(); )
+    {
+      if(it->second.seq < m_pending_journal_seq)
+        it = m_journal.erase(it);
+      else
+        ++it;
+    }
+    m_pending_generation = 0;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_manager::journal_peer(const net_address& adr)
+  {
+    //only the latest state of an address matters, so the journal never outgrows the lists
+    peer_change& change = m_journal[peerlist_table::address_key(adr)];
+    change.seq = m_journal_seq++;
+    if(const peerlist_entry* pe = m_peers_white.find(adr))
+    {
+      change.state = peer_state_white;
+      change.pe = *pe;
+    }else if(const peerlist_entry* pg = m_peers_gray.find(adr))
+    {
+      change.state = peer_state_gray;
+      change.pe = *pg;
+    }else
+    {
+      change.state = peer_state_none;
+      change.pe = AUTO_VAL_INIT(change.pe);
+      change.pe.adr = adr;
+    }
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_manager::apply_peer_change(const peer_change& change)
+  {
+    if(change.state == peer_state_white)
+      m_peers_white.insert_or_update(change.pe);
+    else
+      m_peers_white.erase(change.pe.adr);
+
+    if(change.state == peer_state_gray)
+      m_peers_gray.insert_or_update(change.pe);
+    else
+      m_peers_gray.erase(change.pe.adr);
   }
   //--------------------------------------------------------------------------------------------------
   inline void peerlist_manager::trim_white_peerlist()
   {
-    while(m_peers_gray.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT)
+    net_address adr;
+    while(m_peers_white.size() > P2P_LOCAL_WHITE_PEERLIST_LIMIT && m_peers_white.get_eviction_candidate(adr))
     {
-      peers_indexed::index<by_time>::type& sorted_index=m_peers_gray.get<by_time>();
-      sorted_index.erase(sorted_index.begin());
+      m_peers_white.erase(adr);
+      journal_peer(adr);
     }
   }
   //--------------------------------------------------------------------------------------------------
   inline void peerlist_manager::trim_gray_peerlist()
   {
-    while(m_peers_white.size() > P2P_LOCAL_WHITE_PEERLIST_LIMIT)
+    net_address adr;
+    while(m_peers_gray.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT && m_peers_gray.get_eviction_candidate(adr))
     {
-      peers_indexed::index<by_time>::type& sorted_index=m_peers_white.get<by_time>();
-      sorted_index.erase(sorted_index.begin());
+      m_peers_gray.erase(adr);
+      journal_peer(adr);
     }
   }
   //--------------------------------------------------------------------------------------------------
@@ -236,27 +334,17 @@ namespace nodetool
   }
   //--------------------------------------------------------------------------------------------------
   inline
-  bool peerlist_manager::get_white_peer_by_index(peerlist_entry& p, size_t i)
+  bool peerlist_manager::get_random_white_peer(peerlist_entry& p)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    if(i >= m_peers_white.size())
-      return false;
-
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_white.get<by_time>();
-    p = *epee::misc_utils::move_it_backward(--by_time_index.end(), i);    
-    return true;
+    return m_peers_white.get_random(p);
   }
   //--------------------------------------------------------------------------------------------------
   inline
-    bool peerlist_manager::get_gray_peer_by_index(peerlist_entry& p, size_t i)
+  bool peerlist_manager::get_random_gray_peer(peerlist_entry& p)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    if(i >= m_peers_gray.size())
-      return false;
-
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-    p = *epee::misc_utils::move_it_backward(--by_time_index.end(), i);    
-    return true;
+    return m_peers_gray.get_random(p);
   }
   //--------------------------------------------------------------------------------------------------
   inline 
@@ -275,37 +363,28 @@ namespace nodetool
   inline 
   bool peerlist_manager::get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth)
   {
-    
-    CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index=m_peers_white.get<by_time>();
-    uint32_t cnt = 0;
-    BOOST_REVERSE_FOREACH(const peers_indexed::value_type& vl, by_time_index)
-    {
-      if(!vl.last_seen)
-        continue;
-      bs_head.push_back(vl);      
-      if(cnt++ > depth)
-        break;
-    }
+    std::vector<peerlist_entry> newest;
+    CRITICAL_REGION_BEGIN(m_peerlist_lock);
+    m_peers_white.get_newest(newest, depth);
+    CRITICAL_REGION_END();
+    bs_head.insert(bs_head.end(), newest.begin(), newest.end());
     return true;
   }
   //--------------------------------------------------------------------------------------------------
   inline
   bool peerlist_manager::get_peerlist_full(std::list<peerlist_entry>& pl_gray, std::list<peerlist_entry>& pl_white)
   {    
-    CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index_gr=m_peers_gray.get<by_time>();
-    BOOST_REVERSE_FOREACH(const peers_indexed::value_type& vl, by_time_index_gr)
-    {
-      pl_gray.push_back(vl);      
-    }
-
-    peers_indexed::index<by_time>::type& by_time_index_wt=m_peers_white.get<by_time>();
-    BOOST_REVERSE_FOREACH(const peers_indexed::value_type& vl, by_time_index_wt)
-    {
-      pl_white.push_back(vl);      
-    }
-
+    std::vector<peerlist_entry> gray, white;
+    CRITICAL_REGION_BEGIN(m_peerlist_lock);
+    gray.assign(m_peers_gray.begin(), m_peers_gray.end());
+    white.assign(m_peers_white.begin(), m_peers_white.end());
+    CRITICAL_REGION_END();
+
+    auto by_time_desc = [](const peerlist_entry& a, const peerlist_entry& b) { return a.last_seen > b.last_seen; };
+    std::sort(gray.begin(), gray.end(), by_time_desc);
+    std::sort(white.begin(), white.end(), by_time_desc);
+    pl_gray.insert(pl_gray.end(), gray.begin(), gray.end());
+    pl_white.insert(pl_white.end(), white.begin(), white.end());
     return true;
   }
   //--------------------------------------------------------------------------------------------------
@@ -339,25 +418,13 @@ namespace nodetool
     if(!is_ip_allowed(ple.adr.ip))
       return true;
 
-     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt == m_peers_white.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_white.insert(ple);
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    //put new record into white list or update it, and remove it from gray list
+    bool inserted = m_peers_white.insert_or_update(ple);
+    m_peers_gray.erase(ple.adr);
+    journal_peer(ple.adr);
+    if(inserted)
       trim_white_peerlist();
-    }else
-    {
-      //update record in white list 
-      m_peers_white.replace(by_addr_it_wt, ple);      
-    }
-    //remove from gray list, if need
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr != m_peers_gray.get<by_addr>().end())
-    {
-      m_peers_gray.erase(by_addr_it_gr);
-    }
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_white()", false);
   }
@@ -371,27 +438,121 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
     //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt != m_peers_white.get<by_addr>().end())
+    if(m_peers_white.find(ple.adr))
       return true;
 
     //update gray list
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr == m_peers_gray.get<by_addr>().end())
+    bool inserted = m_peers_gray.insert_or_update(ple);
+    journal_peer(ple.adr);
+    if(inserted)
+      trim_gray_peerlist();
+    return true;
+    CATCH_ENTRY_L0("peerlist_manager::append_with_peer_gray()", false);
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::is_delta_store_enough()
+  {
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    if(!m_store_generation)
+      return false;
+    //once the delta outgrows the state itself a full store is cheaper to load
+    return m_delta_records + m_journal.size() <= m_peers_white.size() + m_peers_gray.size();
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::store_delta(const std::string& path)
+  {
+    TRY_ENTRY();
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    if(m_journal.empty())
+      return true;
+
+    std::ofstream delta;
+    delta.open(path, std::ios_base::binary | std::ios_base::out | (m_delta_records ? std::ios_base::app : std::ios_base::trunc));
+    if(delta.fail())
     {
-      //put new record into white list
-      m_peers_gray.insert(ple);
-      trim_gray_peerlist();    
-    }else
+      LOG_PRINT_L0("Failed to open peerlist delta file " << path);
+      return false;
+    }
+    if(!m_delta_records)
+      delta.write(reinterpret_cast<const char*>(&m_store_generation), sizeof(m_store_generation));
+    for(const auto& j: m_journal)
+    {
+      const peer_change& change = j.second;
+      delta.write(reinterpret_cast<const char*>(&change.state), sizeof(change.state));
+      delta.write(reinterpret_cast<const char*>(&change.pe.adr.ip), sizeof(change.pe.adr.ip));
+      delta.write(reinterpret_cast<const char*>(&change.pe.adr.port), sizeof(change.pe.adr.port));
+      delta.write(reinterpret_cast<const char*>(&change.pe.id), sizeof(change.pe.id));
+      delta.write(reinterpret_cast<const char*>(&change.pe.last_seen), sizeof(change.pe.last_seen));
+    }
+    delta.close();
+    if(delta.fail())
     {
-      //update record in white list 
-      m_peers_gray.replace(by_addr_it_gr, ple);      
+      //the file may end in a torn record now, so don't append to it again and go for a full store
+      LOG_PRINT_L0("Failed to write peerlist delta file " << path);
+      m_delta_records = 0;
+      m_store_generation = 0;
+      return false;
     }
+    m_delta_records += m_journal.size();
+    m_journal.clear();
     return true;
-    CATCH_ENTRY_L0("peerlist_manager::append_with_peer_gray()", false);
+    CATCH_ENTRY_L0("peerlist_manager::store_delta()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::load_delta(const std::string& path)
+  {
+    TRY_ENTRY();
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    m_delta_records = 0;
+    std::ifstream delta;
+    delta.open(path, std::ios_base::binary | std::ios_base::in);
+    if(delta.fail())
+      return true;
+
+    uint64_t generation = 0;
+    delta.read(reinterpret_cast<char*>(&generation), sizeof(generation));
+    if(!delta || !m_store_generation || generation != m_store_generation)
+    {
+      LOG_PRINT_L1("Peerlist delta file " << path << " doesn't belong to the stored peerlist, ignored");
+      return true;
+    }
+
+    //a record torn by a crash is dropped and cut off the file, so later records don't land after it
+    peer_change change = AUTO_VAL_INIT(change);
+    while(delta.read(reinterpret_cast<char*>(&change.state), sizeof(change.state))
+      && delta.read(reinterpret_cast<char*>(&change.pe.adr.ip), sizeof(change.pe.adr.ip))
+      && delta.read(reinterpret_cast<char*>(&change.pe.adr.port), sizeof(change.pe.adr.port))
+      && delta.read(reinterpret_cast<char*>(&change.pe.id), sizeof(change.pe.id))
+      && delta.read(reinterpret_cast<char*>(&change.pe.last_seen), sizeof(change.pe.last_seen)))
+    {
+      apply_peer_change(change);
+      ++m_delta_records;
+    }
+    delta.close();
+    const uint64_t good_size = sizeof(generation) + m_delta_records * delta_record_size;
+    boost::system::error_code ec;
+    if(boost::filesystem::file_size(path, ec) != good_size || ec)
+    {
+      boost::filesystem::resize_file(path, good_size, ec);
+      if(ec)
+      {
+        //can't cut the torn record off, rewrite everything with a full store on the next save
+        LOG_PRINT_L0("Failed to truncate peerlist delta file " << path << ": " << ec.message());
+        m_delta_records = 0;
+        m_store_generation = 0;
+      }
+    }
+    trim_white_peerlist();
+    trim_gray_peerlist();
+    LOG_PRINT_L1("Applied " << m_delta_records << " peerlist changes from " << path);
     return true;
+    CATCH_ENTRY_L0("peerlist_manager::load_delta()", false);
   }
   //--------------------------------------------------------------------------------------------------
 }
 
-BOOST_CLASS_VERSION(nodetool::peerlist_manager, 4)
+BOOST_CLASS_VERSION(nodetool::peerlist_manager, 5)
@@ -0,0 +1,225 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "crypto/crypto.h"
+#include "p2p_protocol_defs.h"
+#include "cryptonote_config.h"
+
+
+namespace nodetool
+{
+  /************************************************************************/
+  /* Peer table with O(1) lookup by address and O(1) random sampling.    */
+  /* Entries are bucketed by address group (/16), sampling picks a group */
+  /* first so that a single subnet can't crowd out the rest of the list. */
+  /************************************************************************/
+  class peerlist_table
+  {
+  public:
+    typedef std::vector<peerlist_entry>::const_iterator const_iterator;
+
+    static uint64_t address_key(const net_address& adr) { return (uint64_t(adr.ip) << 32) | adr.port; }
+    //ip is kept in network byte order, so the low 16 bits are the first two octets
+    static uint32_t address_group(const net_address& adr) { return adr.ip & 0xffff; }
+
+    size_t size() const { return m_peers.size(); }
+    bool empty() const { return m_peers.empty(); }
+    size_t groups_count() const { return m_groups.size(); }
+    const_iterator begin() const { return m_peers.begin(); }
+    const_iterator end() const { return m_peers.end(); }
+
+    const peerlist_entry* find(const net_address& adr) const;
+    //returns true if the address was not in the table yet
+    bool insert_or_update(const peerlist_entry& pe);
+    bool erase(const net_address& adr);
+    void clear();
+
+    bool get_random(peerlist_entry& pe) const;
+    //the least recently seen of a few randomly sampled entries
+    bool get_eviction_candidate(net_address& adr) const;
+    //up to count entries with last_seen set, most recently seen first
+    void get_newest(std::vector<peerlist_entry>& peers, size_t count) const;
+
+  private:
+    struct group_bucket
+    {
+      uint32_t group;
+      std::vector<size_t> peers;
+    };
+
+    void remove_from_group(size_t i);
+
+    std::vector<peerlist_entry> m_peers;
+    std::vector<size_t> m_peer_group_pos;   //position of m_peers[i] in its group bucket
+    std::unordered_map<uint64_t, size_t> m_by_addr;
+    std::vector<group_bucket> m_groups;
+    std::unordered_map<uint32_t, size_t> m_group_index;
+  };
+  //--------------------------------------------------------------------------------------------------
+  inline
+  const peerlist_entry* peerlist_table::find(const net_address& adr) const
+  {
+    auto it = m_by_addr.find(address_key(adr));
+    return it == m_by_addr.end() ? NULL : &m_peers[it->second];
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_table::insert_or_update(const peerlist_entry& pe)
+  {
+    uint64_t key = address_key(pe.adr);
+    auto it = m_by_addr.find(key);
+    if(it != m_by_addr.end())
+    {
+      //same address, so same group
+      m_peers[it->second] = pe;
+      return false;
+    }
+
+    size_t i = m_peers.size();
+    uint32_t group = address_group(pe.adr);
+    auto git = m_group_index.find(group);
+    size_t g;
+    if(git == m_group_index.end())
+    {
+      g = m_groups.size();
+      m_groups.push_back(group_bucket());
+      m_groups.back().group = group;
+      m_group_index[group] = g;
+    }else
+    {
+      g = git->second;
+    }
+    m_peers.push_back(pe);
+    m_peer_group_pos.push_back(m_groups[g].peers.size());
+    m_groups[g].peers.push_back(i);
+    m_by_addr[key] = i;
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_table::remove_from_group(size_t i)
+  {
+    size_t g = m_group_index[address_group(m_peers[i].adr)];
+    std::vector<size_t>& peers = m_groups[g].peers;
+    size_t pos = m_peer_group_pos[i];
+    peers[pos] = peers.back();
+    m_peer_group_pos[peers[pos]] = pos;
+    peers.pop_back();
+    if(!peers.empty())
+      return;
+
+    m_group_index.erase(m_groups[g].group);
+    if(g != m_groups.size() - 1)
+    {
+      m_groups[g] = std::move(m_groups.back());
+      m_group_index[m_groups[g].group] = g;
+    }
+    m_groups.pop_back();
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_table::erase(const net_address& adr)
+  {
+    auto it = m_by_addr.find(address_key(adr));
+    if(it == m_by_addr.end())
+      return false;
+    size_t i = it->second;
+    m_by_addr.erase(it);
+    remove_from_group(i);
+
+    //move the last entry into the freed slot
+    size_t last = m_peers.size() - 1;
+    if(i != last)
+    {
+      m_peers[i] = m_peers[last];
+      m_peer_group_pos[i] = m_peer_group_pos[last];
+      m_by_addr[address_key(m_peers[i].adr)] = i;
+      m_groups[m_group_index[address_group(m_peers[i].adr)]].peers[m_peer_group_pos[i]] = i;
+    }
+    m_peers.pop_back();
+    m_peer_group_pos.pop_back();
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_table::clear()
+  {
+    m_peers.clear();
+    m_peer_group_pos.clear();
+    m_by_addr.clear();
+    m_groups.clear();
+    m_group_index.clear();
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_table::get_random(peerlist_entry& pe) const
+  {
+    if(m_groups.empty())
+      return false;
+    const std::vector<size_t>& peers = m_groups[crypto::rand<size_t>() % m_groups.size()].peers;
+    pe = m_peers[peers[crypto::rand<size_t>() % peers.size()]];
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_table::get_eviction_candidate(net_address& adr) const
+  {
+    if(m_peers.empty())
+      return false;
+    const peerlist_entry* oldest = NULL;
+    for(size_t i = 0; i != P2P_PEERLIST_EVICTION_SAMPLES; ++i)
+    {
+      const peerlist_entry& pe = m_peers[crypto::rand<size_t>() % m_peers.size()];
+      if(!oldest || pe.last_seen < oldest->last_seen)
+        oldest = &pe;
+    }
+    adr = oldest->adr;
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_table::get_newest(std::vector<peerlist_entry>& peers, size_t count) const
+  {
+    std::vector<peerlist_entry> seen;
+    seen.reserve(m_peers.size());
+    for(const peerlist_entry& pe: m_peers)
+    {
+      if(pe.last_seen)
+        seen.push_back(pe);
+    }
+    peers.resize(std::min(count, seen.size()));
+    std::partial_sort_copy(seen.begin(), seen.end(), peers.begin(), peers.end(),
+      [](const peerlist_entry& a, const peerlist_entry& b) { return a.last_seen > b.last_seen; });
+  }
+}
@@ -115,14 +115,19 @@ namespace nodetool
     uint64_t local_time;
     uint32_t my_port;
     peerid_type peer_id;
+    uint32_t support_flags;            //P2P_SUPPORT_FLAG_*, absent (zero) on older nodes
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE_VAL_POD_AS_BLOB(network_id)
       KV_SERIALIZE(peer_id)
       KV_SERIALIZE(local_time)
       KV_SERIALIZE(my_port)
+      KV_SERIALIZE(support_flags)
     END_KV_SERIALIZE_MAP()
   };
+
+#define P2P_SUPPORT_FLAG_LEVIN_COMPRESSION 0x01   //peer reads levin bodies flagged LEVIN_PACKET_COMPRESSED
+#define P2P_SUPPORT_FLAGS                  P2P_SUPPORT_FLAG_LEVIN_COMPRESSION
   
 
 #define P2P_COMMANDS_POOL_BASE 1000
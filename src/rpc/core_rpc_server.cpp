@@ -29,11 +29,15 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <boost/foreach.hpp>
+#include <boost/thread/tss.hpp>
+#include <chrono>
 #include "include_base_utils.h"
 using namespace epee;
 
 #include "core_rpc_server.h"
 #include "common/command_line.h"
+#include "common/metrics.h"
+#include "lock_profiler.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/cryptonote_basic_impl.h"
@@ -44,6 +48,15 @@ using namespace epee;
 
 namespace cryptonote
 {
+  namespace
+  {
+    void keep_histogram(tools::metrics::histogram*)
+    {
+    }
+
+    // rpc_request_seconds histogram of the map entry handling the current request
+    boost::thread_specific_ptr<tools::metrics::histogram> request_histogram(keep_histogram);
+  }
 
   //-----------------------------------------------------------------------------------
   void core_rpc_server::init_options(boost::program_options::options_description& desc)
@@ -51,6 +64,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
     command_line::add_arg(desc, arg_testnet_rpc_bind_port);
+    command_line::add_arg(desc, arg_rpc_io_service_per_thread);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -61,6 +75,37 @@ namespace cryptonote
     , m_p2p(p2p)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::set_request_histogram(tools::metrics::histogram* histogram)
+  {
+    request_histogram.reset(histogram);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(
+      const epee::net_utils::http::http_request_info& query_info
+    , epee::net_utils::http::http_response_info& response
+    , connection_context& m_conn_context
+    )
+  {
+    LOG_PRINT_L2("HTTP [" << epee::string_tools::get_ip_string_from_int32(m_conn_context.m_remote_ip ) << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    auto start = std::chrono::steady_clock::now();
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+    request_histogram.reset();
+    bool handled = handle_http_request_map(query_info, response, m_conn_context);
+    if(!handled)
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    tools::metrics::histogram* histogram = request_histogram.get();
+    if(!histogram)
+      histogram = RPC_REQUEST_HISTOGRAM("other");
+    histogram->observe(elapsed);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::handle_command_line(
       const boost::program_options::variables_map& vm
     )
@@ -69,6 +114,7 @@ namespace cryptonote
 
     m_bind_ip = command_line::get_arg(vm, arg_rpc_bind_ip);
     m_port = command_line::get_arg(vm, p2p_bind_arg);
+    m_net_server.set_io_service_per_thread(command_line::get_arg(vm, arg_rpc_io_service_per_thread));
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -407,6 +453,37 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_transaction_pool_delta(const COMMAND_RPC_GET_TX_POOL_DELTA::request& req, COMMAND_RPC_GET_TX_POOL_DELTA::response& res)
+  {
+    CHECK_CORE_BUSY();
+    std::vector<tx_memory_pool::tx_pool_entry> added;
+    std::vector<crypto::hash> removed;
+    m_core.get_pool_changes(req.epoch, req.version, added, removed, res.epoch, res.version, res.full);
+    res.added.reserve(added.size());
+    for (const auto& entry: added)
+    {
+      tx_pool_entry_info info;
+      info.id_hash = string_tools::pod_to_hex(entry.id);
+      info.blob_size = entry.blob_size;
+      info.fee = entry.fee;
+      info.receive_time = entry.receive_time;
+      res.added.push_back(info);
+    }
+    res.removed.reserve(removed.size());
+    for (const auto& id: removed)
+      res.removed.push_back(string_tools::pod_to_hex(id));
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_fee_estimate(const COMMAND_RPC_GET_FEE_ESTIMATE::request& req, COMMAND_RPC_GET_FEE_ESTIMATE::response& res)
+  {
+    CHECK_CORE_BUSY();
+    res.fee_per_kb = m_core.get_fee_estimate(req.target_blocks);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res)
   {
     // FIXME: replace back to original m_p2p.send_stop_signal() after
@@ -729,6 +806,57 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_lock_profile(const COMMAND_RPC_GET_LOCK_PROFILE::request& req, COMMAND_RPC_GET_LOCK_PROFILE::response& res)
+  {
+    res.enabled = epee::lock_profiler::enabled();
+    for (const auto& s: epee::lock_profiler::get_summary())
+    {
+      lock_site_profile p;
+      p.lock = s.lock_name;
+      p.site = s.file + ":" + std::to_string(s.line);
+      p.count = s.count;
+      p.wait_total_us = s.wait.total_ns / 1000;
+      p.wait_max_us = s.wait.max_ns / 1000;
+      p.wait_p99_us = s.wait.p99_ns / 1000;
+      p.hold_total_us = s.hold.total_ns / 1000;
+      p.hold_max_us = s.hold.max_ns / 1000;
+      p.hold_p99_us = s.hold.p99_ns / 1000;
+      res.sites.push_back(p);
+    }
+    if (req.reset)
+      epee::lock_profiler::reset();
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    std::ostringstream ss;
+    ss << tools::metrics::registry::instance().to_prometheus();
+
+    // peers come and go, so their series are rendered here rather than kept in the registry
+    std::list<connection_info> connections = m_p2p.get_payload_object().get_connections();
+    ss << "# HELP p2p_peers Connected peers\n";
+    ss << "# TYPE p2p_peers gauge\n";
+    ss << "p2p_peers " << connections.size() << "\n";
+    ss << "# HELP p2p_peer_received_bytes Bytes received from a peer\n";
+    ss << "# TYPE p2p_peer_received_bytes counter\n";
+    for(const auto& c: connections)
+      ss << "p2p_peer_received_bytes{peer=\"" << c.ip << ":" << c.port << "\"} " << c.recv_count << "\n";
+    ss << "# HELP p2p_peer_sent_bytes Bytes sent to a peer\n";
+    ss << "# TYPE p2p_peer_sent_bytes counter\n";
+    for(const auto& c: connections)
+      ss << "p2p_peer_sent_bytes{peer=\"" << c.ip << ":" << c.port << "\"} " << c.send_count << "\n";
+    ss << "# HELP p2p_peer_download_rate Current download rate from a peer, kB/s\n";
+    ss << "# TYPE p2p_peer_download_rate gauge\n";
+    for(const auto& c: connections)
+      ss << "p2p_peer_download_rate{peer=\"" << c.ip << ":" << c.port << "\"} " << c.current_download << "\n";
+
+    response.m_body = ss.str();
+    response.m_mime_tipe = "text/plain; version=0.0.4";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info_json(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res, epee::json_rpc::error& error_resp)
   {
     if(!check_core_busy())
@@ -811,4 +939,10 @@ namespace cryptonote
     , std::to_string(config::testnet::RPC_DEFAULT_PORT)
     };
 
+  const command_line::arg_descriptor<bool> core_rpc_server::arg_rpc_io_service_per_thread = {
+      "rpc-io-service-per-thread"
+    , "Give each RPC server thread its own io_service and pin every connection to one of them"
+    , false
+    };
+
 }  // namespace cryptonote
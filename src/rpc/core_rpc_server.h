@@ -32,17 +32,55 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <string>
 
 #include "net/http_server_impl_base.h"
 #include "core_rpc_server_commands_defs.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "common/metrics.h"
 
 // yes, epee doesn't properly use its full namespace when calling its
 // functions from macros.  *sigh*
 using namespace epee;
 
+// rpc_request_seconds histogram for label, looked up in the registry on the
+// first request and cached per expansion
+#define RPC_REQUEST_HISTOGRAM(label) \
+  []() -> tools::metrics::histogram* { \
+    static tools::metrics::histogram* histogram = &tools::metrics::registry::instance().get_histogram( \
+      "rpc_request_seconds", "Time spent handling RPC requests", std::string("method=\"") + (label) + "\""); \
+    return histogram; \
+  }()
+
+// uri map entries that also pick the histogram the request is timed into; the
+// empty branch never runs, it only records the match and falls through to the
+// epee entry below it
+#define MAP_URI_AUTO_JON2_TIMED(s_pattern, callback_f, command_type) \
+    else if(query_info.m_URI == s_pattern && !set_request_histogram(RPC_REQUEST_HISTOGRAM(std::string(s_pattern).substr(1)))) {} \
+    MAP_URI_AUTO_JON2(s_pattern, callback_f, command_type)
+
+#define MAP_URI_AUTO_BIN2_TIMED(s_pattern, callback_f, command_type) \
+    else if(query_info.m_URI == s_pattern && !set_request_histogram(RPC_REQUEST_HISTOGRAM(std::string(s_pattern).substr(1)))) {} \
+    MAP_URI_AUTO_BIN2(s_pattern, callback_f, command_type)
+
+#define MAP_URI2_TIMED(pattern, callback) \
+    else if(std::string::npos != query_info.m_URI.find(pattern) && !set_request_histogram(RPC_REQUEST_HISTOGRAM(std::string(pattern).substr(1)))) {} \
+    MAP_URI2(pattern, callback)
+
+#define BEGIN_JSON_RPC_MAP_TIMED(uri) \
+    else if(query_info.m_URI == uri && !set_request_histogram(RPC_REQUEST_HISTOGRAM("json_rpc:other"))) {} \
+    BEGIN_JSON_RPC_MAP(uri)
+
+#define MAP_JON_RPC_TIMED(method_name, callback_f, command_type) \
+    else if(callback_name == method_name && !set_request_histogram(RPC_REQUEST_HISTOGRAM(std::string("json_rpc:") + method_name))) {} \
+    MAP_JON_RPC(method_name, callback_f, command_type)
+
+#define MAP_JON_RPC_WE_TIMED(method_name, callback_f, command_type) \
+    else if(callback_name == method_name && !set_request_histogram(RPC_REQUEST_HISTOGRAM(std::string("json_rpc:") + method_name))) {} \
+    MAP_JON_RPC_WE(method_name, callback_f, command_type)
+
 namespace cryptonote
 {
   /************************************************************************/
@@ -55,6 +93,7 @@ namespace cryptonote
     static const command_line::arg_descriptor<std::string> arg_rpc_bind_ip;
     static const command_line::arg_descriptor<std::string> arg_rpc_bind_port;
     static const command_line::arg_descriptor<std::string> arg_testnet_rpc_bind_port;
+    static const command_line::arg_descriptor<bool> arg_rpc_io_service_per_thread;
 
     typedef epee::net_utils::connection_context_base connection_context;
 
@@ -68,39 +107,48 @@ namespace cryptonote
         const boost::program_options::variables_map& vm
       );
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //forward http requests to uri map, timing each one into rpc_request_seconds
+    bool handle_http_request(
+        const epee::net_utils::http::http_request_info& query_info
+      , epee::net_utils::http::http_response_info& response
+      , connection_context& m_conn_context
+      );
 
     BEGIN_URI_MAP2()
-      MAP_URI_AUTO_JON2("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
-      MAP_URI_AUTO_BIN2("/getblocks.bin", on_get_blocks, COMMAND_RPC_GET_BLOCKS_FAST)
-      MAP_URI_AUTO_BIN2("/get_o_indexes.bin", on_get_indexes, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES)      
-      MAP_URI_AUTO_BIN2("/getrandom_outs.bin", on_get_random_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS)      
-      MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
-      MAP_URI_AUTO_JON2("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
-      MAP_URI_AUTO_JON2("/start_mining", on_start_mining, COMMAND_RPC_START_MINING)
-      MAP_URI_AUTO_JON2("/stop_mining", on_stop_mining, COMMAND_RPC_STOP_MINING)
-      MAP_URI_AUTO_JON2("/mining_status", on_mining_status, COMMAND_RPC_MINING_STATUS)
-      MAP_URI_AUTO_JON2("/save_bc", on_save_bc, COMMAND_RPC_SAVE_BC)
-      MAP_URI_AUTO_JON2("/get_peer_list", on_get_peer_list, COMMAND_RPC_GET_PEER_LIST)
-      MAP_URI_AUTO_JON2("/set_log_hash_rate", on_set_log_hash_rate, COMMAND_RPC_SET_LOG_HASH_RATE)
-      MAP_URI_AUTO_JON2("/set_log_level", on_set_log_level, COMMAND_RPC_SET_LOG_LEVEL)
-      MAP_URI_AUTO_JON2("/get_transaction_pool", on_get_transaction_pool, COMMAND_RPC_GET_TRANSACTION_POOL)
-      MAP_URI_AUTO_JON2("/stop_daemon", on_stop_daemon, COMMAND_RPC_STOP_DAEMON)
-      MAP_URI_AUTO_JON2("/getinfo", on_get_info, COMMAND_RPC_GET_INFO)
-      MAP_URI_AUTO_JON2("/fast_exit", on_fast_exit, COMMAND_RPC_FAST_EXIT)
-      MAP_URI_AUTO_JON2("/out_peers", on_out_peers, COMMAND_RPC_OUT_PEERS)
-      MAP_URI_AUTO_JON2("/start_save_graph", on_start_save_graph, COMMAND_RPC_START_SAVE_GRAPH)
-      MAP_URI_AUTO_JON2("/stop_save_graph", on_stop_save_graph, COMMAND_RPC_STOP_SAVE_GRAPH)
-      BEGIN_JSON_RPC_MAP("/json_rpc")
-        MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
-        MAP_JON_RPC_WE("on_getblockhash",        on_getblockhash,               COMMAND_RPC_GETBLOCKHASH)
-        MAP_JON_RPC_WE("getblocktemplate",       on_getblocktemplate,           COMMAND_RPC_GETBLOCKTEMPLATE)
-        MAP_JON_RPC_WE("submitblock",            on_submitblock,                COMMAND_RPC_SUBMITBLOCK)
-        MAP_JON_RPC_WE("getlastblockheader",     on_get_last_block_header,      COMMAND_RPC_GET_LAST_BLOCK_HEADER)
-        MAP_JON_RPC_WE("getblockheaderbyhash",   on_get_block_header_by_hash,   COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH)
-        MAP_JON_RPC_WE("getblockheaderbyheight", on_get_block_header_by_height, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT)
-        MAP_JON_RPC_WE("get_connections",        on_get_connections,            COMMAND_RPC_GET_CONNECTIONS)
-        MAP_JON_RPC_WE("get_info",               on_get_info_json,              COMMAND_RPC_GET_INFO)
+      MAP_URI_AUTO_JON2_TIMED("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
+      MAP_URI_AUTO_BIN2_TIMED("/getblocks.bin", on_get_blocks, COMMAND_RPC_GET_BLOCKS_FAST)
+      MAP_URI_AUTO_BIN2_TIMED("/get_o_indexes.bin", on_get_indexes, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES)      
+      MAP_URI_AUTO_BIN2_TIMED("/getrandom_outs.bin", on_get_random_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS)      
+      MAP_URI_AUTO_JON2_TIMED("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
+      MAP_URI_AUTO_JON2_TIMED("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
+      MAP_URI_AUTO_JON2_TIMED("/start_mining", on_start_mining, COMMAND_RPC_START_MINING)
+      MAP_URI_AUTO_JON2_TIMED("/stop_mining", on_stop_mining, COMMAND_RPC_STOP_MINING)
+      MAP_URI_AUTO_JON2_TIMED("/mining_status", on_mining_status, COMMAND_RPC_MINING_STATUS)
+      MAP_URI_AUTO_JON2_TIMED("/save_bc", on_save_bc, COMMAND_RPC_SAVE_BC)
+      MAP_URI_AUTO_JON2_TIMED("/get_peer_list", on_get_peer_list, COMMAND_RPC_GET_PEER_LIST)
+      MAP_URI_AUTO_JON2_TIMED("/set_log_hash_rate", on_set_log_hash_rate, COMMAND_RPC_SET_LOG_HASH_RATE)
+      MAP_URI_AUTO_JON2_TIMED("/set_log_level", on_set_log_level, COMMAND_RPC_SET_LOG_LEVEL)
+      MAP_URI_AUTO_JON2_TIMED("/get_transaction_pool", on_get_transaction_pool, COMMAND_RPC_GET_TRANSACTION_POOL)
+      MAP_URI_AUTO_JON2_TIMED("/get_transaction_pool_delta", on_get_transaction_pool_delta, COMMAND_RPC_GET_TX_POOL_DELTA)
+      MAP_URI_AUTO_JON2_TIMED("/get_fee_estimate", on_get_fee_estimate, COMMAND_RPC_GET_FEE_ESTIMATE)
+      MAP_URI_AUTO_JON2_TIMED("/stop_daemon", on_stop_daemon, COMMAND_RPC_STOP_DAEMON)
+      MAP_URI_AUTO_JON2_TIMED("/getinfo", on_get_info, COMMAND_RPC_GET_INFO)
+      MAP_URI_AUTO_JON2_TIMED("/fast_exit", on_fast_exit, COMMAND_RPC_FAST_EXIT)
+      MAP_URI_AUTO_JON2_TIMED("/out_peers", on_out_peers, COMMAND_RPC_OUT_PEERS)
+      MAP_URI_AUTO_JON2_TIMED("/start_save_graph", on_start_save_graph, COMMAND_RPC_START_SAVE_GRAPH)
+      MAP_URI_AUTO_JON2_TIMED("/stop_save_graph", on_stop_save_graph, COMMAND_RPC_STOP_SAVE_GRAPH)
+      MAP_URI_AUTO_JON2_TIMED("/get_lock_profile", on_get_lock_profile, COMMAND_RPC_GET_LOCK_PROFILE)
+      MAP_URI2_TIMED("/metrics", on_metrics)
+      BEGIN_JSON_RPC_MAP_TIMED("/json_rpc")
+        MAP_JON_RPC_TIMED("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
+        MAP_JON_RPC_WE_TIMED("on_getblockhash",        on_getblockhash,               COMMAND_RPC_GETBLOCKHASH)
+        MAP_JON_RPC_WE_TIMED("getblocktemplate",       on_getblocktemplate,           COMMAND_RPC_GETBLOCKTEMPLATE)
+        MAP_JON_RPC_WE_TIMED("submitblock",            on_submitblock,                COMMAND_RPC_SUBMITBLOCK)
+        MAP_JON_RPC_WE_TIMED("getlastblockheader",     on_get_last_block_header,      COMMAND_RPC_GET_LAST_BLOCK_HEADER)
+        MAP_JON_RPC_WE_TIMED("getblockheaderbyhash",   on_get_block_header_by_hash,   COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH)
+        MAP_JON_RPC_WE_TIMED("getblockheaderbyheight", on_get_block_header_by_height, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT)
+        MAP_JON_RPC_WE_TIMED("get_connections",        on_get_connections,            COMMAND_RPC_GET_CONNECTIONS)
+        MAP_JON_RPC_WE_TIMED("get_info",               on_get_info_json,              COMMAND_RPC_GET_INFO)
       END_JSON_RPC_MAP()
     END_URI_MAP2()
 
@@ -119,11 +167,15 @@ namespace cryptonote
     bool on_set_log_hash_rate(const COMMAND_RPC_SET_LOG_HASH_RATE::request& req, COMMAND_RPC_SET_LOG_HASH_RATE::response& res);
     bool on_set_log_level(const COMMAND_RPC_SET_LOG_LEVEL::request& req, COMMAND_RPC_SET_LOG_LEVEL::response& res);
     bool on_get_transaction_pool(const COMMAND_RPC_GET_TRANSACTION_POOL::request& req, COMMAND_RPC_GET_TRANSACTION_POOL::response& res);
+    bool on_get_transaction_pool_delta(const COMMAND_RPC_GET_TX_POOL_DELTA::request& req, COMMAND_RPC_GET_TX_POOL_DELTA::response& res);
+    bool on_get_fee_estimate(const COMMAND_RPC_GET_FEE_ESTIMATE::request& req, COMMAND_RPC_GET_FEE_ESTIMATE::response& res);
     bool on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res);
     bool on_fast_exit(const COMMAND_RPC_FAST_EXIT::request& req, COMMAND_RPC_FAST_EXIT::response& res);
     bool on_out_peers(const COMMAND_RPC_OUT_PEERS::request& req, COMMAND_RPC_OUT_PEERS::response& res);
     bool on_start_save_graph(const COMMAND_RPC_START_SAVE_GRAPH::request& req, COMMAND_RPC_START_SAVE_GRAPH::response& res);
     bool on_stop_save_graph(const COMMAND_RPC_STOP_SAVE_GRAPH::request& req, COMMAND_RPC_STOP_SAVE_GRAPH::response& res);
+    bool on_get_lock_profile(const COMMAND_RPC_GET_LOCK_PROFILE::request& req, COMMAND_RPC_GET_LOCK_PROFILE::response& res);
+    bool on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
     
     //json_rpc
     bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res);
@@ -144,6 +196,8 @@ private:
       );
     bool check_core_busy();
     bool check_core_ready();
+    //remembers the histogram handle_http_request times the current request into, always true
+    static bool set_request_histogram(tools::metrics::histogram* histogram);
     
     //utils
     uint64_t get_block_reward(const block& blk);
@@ -640,6 +640,79 @@ namespace cryptonote
     };
   };
 
+  struct tx_pool_entry_info
+  {
+    std::string id_hash;
+    uint64_t blob_size;
+    uint64_t fee;
+    uint64_t receive_time;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(id_hash)
+      KV_SERIALIZE(blob_size)
+      KV_SERIALIZE(fee)
+      KV_SERIALIZE(receive_time)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_TX_POOL_DELTA
+  {
+    // epoch and version from a previous response; 0/0 asks for a snapshot
+    struct request
+    {
+      uint64_t epoch;
+      uint64_t version;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(epoch)
+        KV_SERIALIZE(version)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    // if full is set, added is the whole pool and the caller drops its copy
+    struct response
+    {
+      std::string status;
+      uint64_t epoch;
+      uint64_t version;
+      bool full;
+      std::vector<tx_pool_entry_info> added;
+      std::vector<std::string> removed;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(epoch)
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(full)
+        KV_SERIALIZE(added)
+        KV_SERIALIZE(removed)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_GET_FEE_ESTIMATE
+  {
+    struct request
+    {
+      uint64_t target_blocks;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(target_blocks)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t fee_per_kb;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(fee_per_kb)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_GET_CONNECTIONS
   {
     struct request
@@ -777,5 +850,55 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
   };
+
+  struct lock_site_profile
+  {
+    std::string lock;
+    std::string site;
+    uint64_t count;
+    uint64_t wait_total_us;
+    uint64_t wait_max_us;
+    uint64_t wait_p99_us;
+    uint64_t hold_total_us;
+    uint64_t hold_max_us;
+    uint64_t hold_p99_us;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(lock)
+      KV_SERIALIZE(site)
+      KV_SERIALIZE(count)
+      KV_SERIALIZE(wait_total_us)
+      KV_SERIALIZE(wait_max_us)
+      KV_SERIALIZE(wait_p99_us)
+      KV_SERIALIZE(hold_total_us)
+      KV_SERIALIZE(hold_max_us)
+      KV_SERIALIZE(hold_p99_us)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_LOCK_PROFILE
+  {
+    struct request
+    {
+      bool reset; // clear the counters after reading them
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(reset)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      bool enabled; // false unless built with PROFILE_LOCKS
+      std::list<lock_site_profile> sites; // longest total wait first
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(enabled)
+        KV_SERIALIZE(sites)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
 }
 
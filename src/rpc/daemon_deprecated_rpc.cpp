@@ -51,6 +51,7 @@
 #include <stdexcept>
 
 #define MAX_RESPONSE_SIZE 100000
+#define MAX_KEY_IMAGES_PER_REQUEST 10000
 
 /*!
  * \namespace
@@ -839,7 +840,7 @@ namespace
       memcpy(size_prepended_block_id + 1, block_id.c_str(), crypto::HASH_SIZE);
       zlist_append(list, size_prepended_block_id);
     }
-    int rc = wap_client_blocks(ipc_client, &list, start_height);
+    int rc = wap_client_blocks(ipc_client, &list, start_height, 0);
     zlist_destroy(&list);
 
     if (rc < 0) {
@@ -903,6 +904,261 @@ namespace
     return response.length();
   }
 
+  /*!
+   * \brief Implementation of 'iskeyimagespent' method.
+   * \param  buf Buffer to fill in response.
+   * \param  len Max length of response.
+   * \param  req net_skeleton RPC request
+   * \return     Actual response length.
+   */
+  int iskeyimagespent(char *buf, int len, struct ns_rpc_request *req)
+  {
+    if (!connect_to_daemon()) {
+      return ns_rpc_create_error(buf, len, req, daemon_connection_error,
+        "Couldn't connect to daemon.", "{}");
+    }
+    if (req->params == NULL)
+    {
+      return ns_rpc_create_error(buf, len, req, invalid_params,
+        "Parameters missing.", "{}");
+    }
+
+    // A batch of key images easily outgrows the fixed request buffers used above.
+    rapidjson::Document request_json;
+    std::string request_str(req->params[0].ptr, req->params[0].len);
+    if (request_json.Parse(request_str.c_str()).HasParseError())
+    {
+      return ns_rpc_create_error(buf, len, req, parse_error,
+        "Invalid JSON passed", "{}");
+    }
+
+    if (!request_json.HasMember("key_images") || !request_json["key_images"].IsArray())
+    {
+      return ns_rpc_create_error(buf, len, req, invalid_params,
+        "Incorrect 'key_images' field", "{}");
+    }
+
+    const rapidjson::Value &key_images_json = request_json["key_images"];
+    if (key_images_json.Size() > MAX_KEY_IMAGES_PER_REQUEST)
+    {
+      return ns_rpc_create_error(buf, len, req, invalid_params,
+        "Too many key images.", "{}");
+    }
+    std::string key_images;
+    key_images.reserve(key_images_json.Size() * sizeof(crypto::key_image));
+    for (rapidjson::SizeType i = 0; i < key_images_json.Size(); i++)
+    {
+      crypto::key_image key_image;
+      if (!key_images_json[i].IsString() ||
+        !epee::string_tools::hex_to_pod(key_images_json[i].GetString(), key_image))
+      {
+        return ns_rpc_create_error(buf, len, req, invalid_params,
+          "Invalid key image", "{}");
+      }
+      key_images.append(reinterpret_cast<const char*>(&key_image), sizeof(key_image));
+    }
+
+    zchunk_t *key_images_chunk = zchunk_new((void*)key_images.data(), key_images.size());
+    int rc = wap_client_get_key_image_status(ipc_client, &key_images_chunk);
+    if (rc < 0) {
+      return ns_rpc_create_error(buf, len, req, daemon_connection_error,
+        "Couldn't connect to daemon.", "{}");
+    }
+    uint64_t status = wap_client_status(ipc_client);
+    if (status == IPC::STATUS_CORE_BUSY) {
+      return ns_rpc_create_error(buf, len, req, internal_error,
+        "Core busy.", "{}");
+    }
+    if (status != IPC::STATUS_OK) {
+      return ns_rpc_create_error(buf, len, req, internal_error,
+        "Failed to check key images.", "{}");
+    }
+
+    rapidjson::Document response_json;
+    rapidjson::Document::AllocatorType &allocator = response_json.GetAllocator();
+    rapidjson::Value result_json;
+    result_json.SetObject();
+    rapidjson::Value spent_status(rapidjson::kArrayType);
+    zchunk_t *spent_chunk = wap_client_spent(ipc_client);
+    const uint8_t *spent = zchunk_data(spent_chunk);
+    for (size_t i = 0; i < zchunk_size(spent_chunk); i++)
+    {
+      spent_status.PushBack((unsigned)spent[i], allocator);
+    }
+    result_json.AddMember("spent_status", spent_status, allocator);
+    result_json.AddMember("status", "OK", allocator);
+    std::string response;
+    construct_response_string(req, result_json, response_json, response);
+    if (response.length() >= (uint32_t)len)
+    {
+      return ns_rpc_create_error(buf, len, req, internal_error,
+        "Response too large.", "{}");
+    }
+    strncpy(buf, response.c_str(), response.length() + 1);
+    return response.length();
+  }
+
+  /*!
+   * \brief Implementation of 'gettxpooldelta' method.
+   * \param  buf Buffer to fill in response.
+   * \param  len Max length of response.
+   * \param  req net_skeleton RPC request
+   * \return     Actual response length.
+   */
+  int gettxpooldelta(char *buf, int len, struct ns_rpc_request *req)
+  {
+    if (!connect_to_daemon()) {
+      return ns_rpc_create_error(buf, len, req, daemon_connection_error,
+        "Couldn't connect to daemon.", "{}");
+    }
+
+    // No parameters means a full snapshot.
+    uint64_t epoch = 0, version = 0;
+    if (req->params != NULL)
+    {
+      rapidjson::Document request_json;
+      std::string request_str(req->params[0].ptr, req->params[0].len);
+      if (request_json.Parse(request_str.c_str()).HasParseError())
+      {
+        return ns_rpc_create_error(buf, len, req, parse_error,
+          "Invalid JSON passed", "{}");
+      }
+      if (!request_json.HasMember("epoch") || !request_json["epoch"].IsUint64() ||
+        !request_json.HasMember("version") || !request_json["version"].IsUint64())
+      {
+        return ns_rpc_create_error(buf, len, req, invalid_params,
+          "Incorrect 'epoch' or 'version' field", "{}");
+      }
+      epoch = request_json["epoch"].GetUint64();
+      version = request_json["version"].GetUint64();
+    }
+
+    int rc = wap_client_get_tx_pool(ipc_client, epoch, version);
+    if (rc < 0) {
+      return ns_rpc_create_error(buf, len, req, daemon_connection_error,
+        "Couldn't connect to daemon.", "{}");
+    }
+    uint64_t status = wap_client_status(ipc_client);
+    if (status == IPC::STATUS_CORE_BUSY) {
+      return ns_rpc_create_error(buf, len, req, internal_error,
+        "Core busy.", "{}");
+    }
+
+    rapidjson::Document response_json;
+    rapidjson::Document::AllocatorType &allocator = response_json.GetAllocator();
+    rapidjson::Value result_json;
+    result_json.SetObject();
+    result_json.AddMember("epoch", wap_client_pool_epoch(ipc_client), allocator);
+    result_json.AddMember("version", wap_client_pool_version(ipc_client), allocator);
+    result_json.AddMember("full", (wap_client_pool_full(ipc_client) == 1), allocator);
+
+    const size_t entry_size = sizeof(crypto::hash) + 3 * sizeof(uint64_t);
+    rapidjson::Value added_json(rapidjson::kArrayType);
+    zchunk_t *added_chunk = wap_client_pool_added(ipc_client);
+    const char *added = (const char*)zchunk_data(added_chunk);
+    for (size_t offset = 0; offset + entry_size <= zchunk_size(added_chunk); offset += entry_size)
+    {
+      crypto::hash id;
+      uint64_t fields[3];
+      memcpy(&id, added + offset, sizeof(id));
+      memcpy(fields, added + offset + sizeof(id), sizeof(fields));
+      rapidjson::Value entry_json;
+      entry_json.SetObject();
+      rapidjson::Value id_json;
+      std::string id_hex = epee::string_tools::pod_to_hex(id);
+      id_json.SetString(id_hex.c_str(), id_hex.length(), allocator);
+      entry_json.AddMember("id_hash", id_json, allocator);
+      entry_json.AddMember("blob_size", fields[0], allocator);
+      entry_json.AddMember("fee", fields[1], allocator);
+      entry_json.AddMember("receive_time", fields[2], allocator);
+      added_json.PushBack(entry_json, allocator);
+    }
+    result_json.AddMember("added", added_json, allocator);
+
+    rapidjson::Value removed_json(rapidjson::kArrayType);
+    zchunk_t *removed_chunk = wap_client_pool_removed(ipc_client);
+    const char *removed = (const char*)zchunk_data(removed_chunk);
+    for (size_t offset = 0; offset + sizeof(crypto::hash) <= zchunk_size(removed_chunk); offset += sizeof(crypto::hash))
+    {
+      crypto::hash id;
+      memcpy(&id, removed + offset, sizeof(id));
+      rapidjson::Value id_json;
+      std::string id_hex = epee::string_tools::pod_to_hex(id);
+      id_json.SetString(id_hex.c_str(), id_hex.length(), allocator);
+      removed_json.PushBack(id_json, allocator);
+    }
+    result_json.AddMember("removed", removed_json, allocator);
+    result_json.AddMember("status", "OK", allocator);
+
+    std::string response;
+    construct_response_string(req, result_json, response_json, response);
+    // A large snapshot can outgrow the response buffer; better an error than truncated JSON.
+    if (response.length() >= (uint32_t)len)
+    {
+      return ns_rpc_create_error(buf, len, req, internal_error,
+        "Response too large.", "{}");
+    }
+    strncpy(buf, response.c_str(), response.length() + 1);
+    return response.length();
+  }
+
+  /*!
+   * \brief Implementation of 'getfeeestimate' method.
+   * \param  buf Buffer to fill in response.
+   * \param  len Max length of response.
+   * \param  req net_skeleton RPC request
+   * \return     Actual response length.
+   */
+  int getfeeestimate(char *buf, int len, struct ns_rpc_request *req)
+  {
+    if (!connect_to_daemon()) {
+      return ns_rpc_create_error(buf, len, req, daemon_connection_error,
+        "Couldn't connect to daemon.", "{}");
+    }
+    if (req->params == NULL)
+    {
+      return ns_rpc_create_error(buf, len, req, invalid_params,
+        "Parameters missing.", "{}");
+    }
+
+    rapidjson::Document request_json;
+    std::string request_str(req->params[0].ptr, req->params[0].len);
+    if (request_json.Parse(request_str.c_str()).HasParseError())
+    {
+      return ns_rpc_create_error(buf, len, req, parse_error,
+        "Invalid JSON passed", "{}");
+    }
+
+    if (!request_json.HasMember("target_blocks") || !request_json["target_blocks"].IsUint64())
+    {
+      return ns_rpc_create_error(buf, len, req, invalid_params,
+        "Incorrect 'target_blocks' field", "{}");
+    }
+
+    int rc = wap_client_get_fee_estimate(ipc_client, request_json["target_blocks"].GetUint64());
+    if (rc < 0) {
+      return ns_rpc_create_error(buf, len, req, daemon_connection_error,
+        "Couldn't connect to daemon.", "{}");
+    }
+    uint64_t status = wap_client_status(ipc_client);
+    if (status == IPC::STATUS_CORE_BUSY) {
+      return ns_rpc_create_error(buf, len, req, internal_error,
+        "Core busy.", "{}");
+    }
+
+    rapidjson::Document response_json;
+    rapidjson::Document::AllocatorType &allocator = response_json.GetAllocator();
+    rapidjson::Value result_json;
+    result_json.SetObject();
+    result_json.AddMember("fee_per_kb", wap_client_fee_per_kb(ipc_client), allocator);
+    result_json.AddMember("status", "OK", allocator);
+    std::string response;
+    construct_response_string(req, result_json, response_json, response);
+    size_t copy_length = ((uint32_t)len > response.length()) ? response.length() + 1 : (uint32_t)len;
+    strncpy(buf, response.c_str(), copy_length);
+    return response.length();
+  }
+
   // Contains a list of method names.
   const char *method_names[] = {
     "getheight",
@@ -919,6 +1175,9 @@ namespace
     "getblockhash",
     "getblocktemplate",
     "getblocks",
+    "iskeyimagespent",
+    "gettxpooldelta",
+    "getfeeestimate",
     NULL
   };
 
@@ -938,6 +1197,9 @@ namespace
     getblockhash,
     getblocktemplate,
     getblocks,
+    iskeyimagespent,
+    gettxpooldelta,
+    getfeeestimate,
     NULL
   };
 
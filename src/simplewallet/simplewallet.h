@@ -197,6 +197,7 @@ namespace cryptonote
     crypto::secret_key m_recovery_key;  // recovery key (used as random for wallet gen)
     bool m_restore_deterministic_wallet;  // recover flag
     bool m_non_deterministic;  // old 2-random generation
+    uint64_t m_restore_height;  // only block ids are fetched below this height when restoring
 
     std::string m_daemon_address;
     std::string m_daemon_host;
@@ -81,6 +81,7 @@ namespace tools
 {
 // for now, limit to 30 attempts.  TODO: discuss a good number to limit to.
 const size_t MAX_SPLIT_ATTEMPTS = 30;
+const char WALLET_JOURNAL_MAGIC[] = {'M', 'W', 'J', 'R', 'N', 'L', 0, 1};
 
 //----------------------------------------------------------------------------------------------------
 void wallet2::init(const std::string& daemon_address,
@@ -259,6 +260,7 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
     payment.m_block_height = height;
     payment.m_unlock_time  = tx.unlock_time;
     m_payments.emplace(payment_id, payment);
+    m_journal_payments.push_back(std::make_pair(payment_id, payment));
     LOG_PRINT_L2("Payment found: " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
   }
 }
@@ -267,7 +269,10 @@ void wallet2::process_unconfirmed(const cryptonote::transaction& tx)
 {
   auto unconf_it = m_unconfirmed_txs.find(get_transaction_hash(tx));
   if(unconf_it != m_unconfirmed_txs.end())
+  {
     m_unconfirmed_txs.erase(unconf_it);
+    m_journal_unconfirmed_dirty = true;
+  }
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::process_new_blockchain_entry(const cryptonote::block& b, cryptonote::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height)
@@ -356,6 +361,8 @@ void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
   get_short_chain_history(block_ids);
   std::list<char*> size_prepended_block_ids;
   zlist_t *list = zlist_new();
+  // below the restore height we only need block ids to keep our chain history, not block contents
+  bool block_ids_only = m_blockchain.size() < m_refresh_from_block_height;
   for (std::list<crypto::hash>::iterator it = block_ids.begin(); it != block_ids.end(); it++) {
     char *block_id = new char[crypto::HASH_SIZE + 1];
     block_id[0] = crypto::HASH_SIZE;
@@ -365,7 +372,7 @@ void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
   for (std::list<char*>::iterator it = size_prepended_block_ids.begin(); it != size_prepended_block_ids.end(); it++) {
     zlist_append(list, *it);
   }
-  int rc = wap_client_blocks(ipc_client, &list, start_height);
+  int rc = wap_client_blocks(ipc_client, &list, start_height, block_ids_only ? 1 : 0);
   for (std::list<char*>::iterator it = size_prepended_block_ids.begin(); it != size_prepended_block_ids.end(); it++) {
     delete *it;
   }
@@ -376,11 +383,18 @@ void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
   THROW_WALLET_EXCEPTION_IF(status == IPC::STATUS_CORE_BUSY, error::daemon_busy, "get_blocks");
   THROW_WALLET_EXCEPTION_IF(status == IPC::STATUS_INTERNAL_ERROR, error::daemon_internal_error, "get_blocks");
   THROW_WALLET_EXCEPTION_IF(status != IPC::STATUS_OK, error::get_blocks_error, "get_blocks");
-  std::list<block_complete_entry> blocks;
   zmsg_t *msg = wap_client_block_data(ipc_client); 
+  uint64_t current_index = wap_client_start_height(ipc_client);
+  // daemons that don't know the flag send full blocks, only the daemon's answer says what we got
+  if (wap_client_block_ids_only(ipc_client))
+  {
+    process_block_ids(msg, start_height, current_index, blocks_added);
+    return;
+  }
+
+  std::list<block_complete_entry> blocks;
   get_blocks_from_zmq_msg(msg, blocks);
 
-  uint64_t current_index = wap_client_start_height(ipc_client);
   BOOST_FOREACH(auto& bl_entry, blocks)
   {
     cryptonote::block bl;
@@ -413,6 +427,34 @@ void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
   }
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::process_block_ids(zmsg_t *msg, uint64_t start_height, uint64_t current_index, size_t& blocks_added)
+{
+  zframe_t *frame = zmsg_first(msg);
+  THROW_WALLET_EXCEPTION_IF(!frame || zframe_size(frame) % sizeof(crypto::hash), error::get_blocks_error, "get_blocks");
+  const crypto::hash *ids = reinterpret_cast<const crypto::hash*>(zframe_data(frame));
+  size_t ids_count = zframe_size(frame) / sizeof(crypto::hash);
+
+  for (size_t i = 0; i < ids_count && current_index < m_refresh_from_block_height; ++i, ++current_index)
+  {
+    if (current_index < m_blockchain.size())
+    {
+      if (ids[i] == m_blockchain[current_index])
+        continue;
+
+      //split detected here !!!
+      THROW_WALLET_EXCEPTION_IF(current_index == start_height, error::wallet_internal_error,
+        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(ids[i]) +
+        " (height " + std::to_string(start_height) + "), local block id at this height: " +
+        string_tools::pod_to_hex(m_blockchain[current_index]));
+      detach_blockchain(current_index);
+    }
+    m_blockchain.push_back(ids[i]);
+    ++m_local_bc_height;
+    ++blocks_added;
+  }
+  LOG_PRINT_L2("Skipped to height " << m_blockchain.size() << " using block ids only, restore height " << m_refresh_from_block_height);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::refresh()
 {
   size_t blocks_fetched = 0;
@@ -506,6 +548,21 @@ void wallet2::detach_blockchain(uint64_t height)
       ++it;
   }
 
+  // the journal only needs to know about detaching data it has already persisted
+  m_journal_payments.erase(std::remove_if(m_journal_payments.begin(), m_journal_payments.end(),
+    [&](const std::pair<crypto::hash, payment_details>& p){ return height <= p.second.m_block_height; }), m_journal_payments.end());
+  if(height < m_journal_blockchain_size)
+  {
+    m_journal_detach_height = m_journal_detached ? std::min<uint64_t>(m_journal_detach_height, height) : height;
+    m_journal_detached = true;
+    m_journal_blockchain_size = height;
+  }
+  if(i_start < m_journal_transfers_size)
+  {
+    m_journal_transfers_size = i_start;
+    m_journal_spent.resize(i_start);
+  }
+
   LOG_PRINT_L0("Detached blockchain on height " << height << ", transfers detached " << transfers_detached << ", blocks detached " << blocks_detached);
 }
 //----------------------------------------------------------------------------------------------------
@@ -521,6 +578,7 @@ bool wallet2::clear()
   m_blockchain.clear();
   m_transfers.clear();
   m_local_bc_height = 1;
+  reset_journal_state();
   return true;
 }
 
@@ -792,6 +850,8 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
       m_account_public_address.m_spend_public_key != m_account.get_keys().m_account_address.m_spend_public_key ||
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
       error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
+
+    replay_journal();
   }
 
   cryptonote::block genesis;
@@ -808,6 +868,7 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
   }
 
   m_local_bc_height = m_blockchain.size();
+  reset_journal_state();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::check_genesis(const crypto::hash& genesis_hash) {
@@ -818,8 +879,207 @@ void wallet2::check_genesis(const crypto::hash& genesis_hash) {
 //----------------------------------------------------------------------------------------------------
 void wallet2::store()
 {
+  boost::system::error_code e;
+  if(!boost::filesystem::exists(m_wallet_file, e) || e)
+  {
+    store_snapshot();
+    return;
+  }
+
+  // compact once the journal outgrows the cache file, so replaying it never costs more than a full load
+  const std::string journal_file = journal_file_name();
+  if(boost::filesystem::exists(journal_file, e) && !e)
+  {
+    uint64_t journal_size = boost::filesystem::file_size(journal_file, e);
+    if(!e && journal_size > WALLET_JOURNAL_MIN_COMPACT_SIZE && journal_size > boost::filesystem::file_size(m_wallet_file, e))
+    {
+      store_snapshot();
+      return;
+    }
+  }
+
+  journal_entry entry = AUTO_VAL_INIT(entry);
+  make_journal_entry(entry);
+  if(entry.empty())
+    return;
+
+  if(!append_journal_entry(entry))
+  {
+    LOG_PRINT_L0("Failed to append to wallet journal " << journal_file << ", rewriting the whole wallet cache");
+    store_snapshot();
+    return;
+  }
+  reset_journal_state();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::store_snapshot()
+{
+  // a new generation orphans the old journal even if we crash before removing it
+  m_journal_generation = crypto::rand<uint64_t>();
   bool r = tools::serialize_obj_to_file(*this, m_wallet_file);
   THROW_WALLET_EXCEPTION_IF(!r, error::file_save_error, m_wallet_file);
+
+  boost::system::error_code e;
+  boost::filesystem::remove(journal_file_name(), e);
+  reset_journal_state();
+}
+//----------------------------------------------------------------------------------------------------
+std::string wallet2::journal_file_name() const
+{
+  return m_wallet_file + ".journal";
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_journal_state()
+{
+  m_journal_blockchain_size = m_blockchain.size();
+  m_journal_transfers_size = m_transfers.size();
+  m_journal_spent.resize(m_transfers.size());
+  for(size_t i = 0; i < m_transfers.size(); ++i)
+    m_journal_spent[i] = m_transfers[i].m_spent;
+  m_journal_payments.clear();
+  m_journal_detached = false;
+  m_journal_detach_height = 0;
+  m_journal_unconfirmed_dirty = false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::make_journal_entry(journal_entry& entry)
+{
+  entry.m_detached = m_journal_detached;
+  entry.m_detach_height = m_journal_detach_height;
+  entry.m_blocks_start = m_journal_blockchain_size;
+  entry.m_blocks.assign(m_blockchain.begin() + m_journal_blockchain_size, m_blockchain.end());
+  entry.m_transfers_start = m_journal_transfers_size;
+  entry.m_transfers.assign(m_transfers.begin() + m_journal_transfers_size, m_transfers.end());
+  // spent flags of already persisted transfers are the only thing that changes in place
+  for(size_t i = 0; i < m_journal_transfers_size; ++i)
+  {
+    if(m_transfers[i].m_spent != m_journal_spent[i])
+      entry.m_spent.push_back(std::make_pair(i, m_transfers[i].m_spent));
+  }
+  entry.m_payments = m_journal_payments;
+  entry.m_has_unconfirmed = m_journal_unconfirmed_dirty;
+  if(entry.m_has_unconfirmed)
+    entry.m_unconfirmed_txs = m_unconfirmed_txs;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::append_journal_entry(const journal_entry& entry)
+{
+  TRY_ENTRY();
+  std::ostringstream payload_stream;
+  {
+    boost::archive::binary_oarchive a(payload_stream, boost::archive::no_header);
+    a << entry;
+  }
+  const std::string payload = payload_stream.str();
+  const uint32_t payload_size = payload.size();
+  const crypto::hash checksum = crypto::cn_fast_hash(payload.data(), payload.size());
+
+  const std::string journal_file = journal_file_name();
+  boost::system::error_code e;
+  bool new_journal = !boost::filesystem::exists(journal_file, e) || e;
+
+  std::ofstream journal;
+  journal.open(journal_file, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+  if(journal.fail())
+    return false;
+  if(new_journal)
+  {
+    journal.write(WALLET_JOURNAL_MAGIC, sizeof(WALLET_JOURNAL_MAGIC));
+    journal.write(reinterpret_cast<const char*>(&m_journal_generation), sizeof(m_journal_generation));
+  }
+  journal.write(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+  journal.write(checksum.data, sizeof(checksum.data));
+  journal.write(payload.data(), payload.size());
+  journal.flush();
+  return !journal.fail();
+  CATCH_ENTRY_L0("wallet2::append_journal_entry", false);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::apply_journal_entry(const journal_entry& entry)
+{
+  if(entry.m_detached && entry.m_detach_height < m_blockchain.size())
+    detach_blockchain(entry.m_detach_height);
+
+  THROW_WALLET_EXCEPTION_IF(entry.m_blocks_start != m_blockchain.size() || entry.m_transfers_start != m_transfers.size(),
+    error::wallet_internal_error, "wallet journal entry doesn't match wallet cache");
+
+  m_blockchain.insert(m_blockchain.end(), entry.m_blocks.begin(), entry.m_blocks.end());
+  BOOST_FOREACH(const transfer_details& td, entry.m_transfers)
+  {
+    m_transfers.push_back(td);
+    m_key_images[td.m_key_image] = m_transfers.size() - 1;
+  }
+  for(const auto& spent: entry.m_spent)
+  {
+    THROW_WALLET_EXCEPTION_IF(spent.first >= m_transfers.size(), error::wallet_internal_error, "wallet journal refers to unknown transfer");
+    m_transfers[spent.first].m_spent = spent.second;
+  }
+  for(const auto& payment: entry.m_payments)
+    m_payments.emplace(payment.first, payment.second);
+  if(entry.m_has_unconfirmed)
+    m_unconfirmed_txs = entry.m_unconfirmed_txs;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::replay_journal()
+{
+  const std::string journal_file = journal_file_name();
+  boost::system::error_code e;
+  if(!boost::filesystem::exists(journal_file, e) || e)
+    return;
+
+  std::string buf;
+  bool r = epee::file_io_utils::load_file_to_string(journal_file, buf);
+  THROW_WALLET_EXCEPTION_IF(!r, error::file_read_error, journal_file);
+
+  const size_t header_size = sizeof(WALLET_JOURNAL_MAGIC) + sizeof(m_journal_generation);
+  uint64_t generation = 0;
+  if(buf.size() >= header_size)
+    memcpy(&generation, buf.data() + sizeof(WALLET_JOURNAL_MAGIC), sizeof(generation));
+  if(buf.size() < header_size || memcmp(buf.data(), WALLET_JOURNAL_MAGIC, sizeof(WALLET_JOURNAL_MAGIC)) || generation != m_journal_generation)
+  {
+    LOG_PRINT_L0("Wallet journal " << journal_file << " doesn't belong to " << m_wallet_file << ", ignoring it");
+    boost::filesystem::remove(journal_file, e);
+    return;
+  }
+
+  size_t offset = header_size;
+  size_t entries = 0;
+  while(offset < buf.size())
+  {
+    uint32_t payload_size = 0;
+    crypto::hash checksum;
+    if(buf.size() - offset < sizeof(payload_size) + sizeof(checksum.data))
+      break;
+    memcpy(&payload_size, buf.data() + offset, sizeof(payload_size));
+    memcpy(checksum.data, buf.data() + offset + sizeof(payload_size), sizeof(checksum.data));
+    const size_t payload_offset = offset + sizeof(payload_size) + sizeof(checksum.data);
+    if(buf.size() - payload_offset < payload_size || checksum != crypto::cn_fast_hash(buf.data() + payload_offset, payload_size))
+      break;
+
+    journal_entry entry = AUTO_VAL_INIT(entry);
+    try
+    {
+      std::istringstream payload_stream(buf.substr(payload_offset, payload_size));
+      boost::archive::binary_iarchive a(payload_stream, boost::archive::no_header);
+      a >> entry;
+      apply_journal_entry(entry);
+    }
+    catch(const std::exception& ex)
+    {
+      LOG_PRINT_L0("Failed to replay wallet journal entry at offset " << offset << ": " << ex.what());
+      break;
+    }
+    offset = payload_offset + payload_size;
+    ++entries;
+  }
+
+  // a torn write at the tail (crash during store) is dropped, everything before it is kept
+  if(offset != buf.size())
+  {
+    LOG_PRINT_L0("Wallet journal " << journal_file << " is truncated at offset " << offset << ", dropping " << buf.size() - offset << " bytes");
+    boost::filesystem::resize_file(journal_file, offset, e);
+  }
+  LOG_PRINT_L1("Replayed " << entries << " wallet journal entries from " << journal_file);
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::unlocked_balance()
@@ -976,6 +1236,7 @@ void wallet2::add_unconfirmed_tx(const cryptonote::transaction& tx, uint64_t cha
   utd.m_change = change_amount;
   utd.m_sent_time = time(NULL);
   utd.m_tx = tx;
+  m_journal_unconfirmed_dirty = true;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -1151,8 +1412,9 @@ void wallet2::commit_tx(std::vector<pending_tx>& ptx_vector)
 //
 // this function will make multiple calls to wallet2::transfer if multiple
 // transactions will be required
-std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<cryptonote::tx_destination_entry> dsts, const size_t fake_outs_count, const uint64_t unlock_time, const uint64_t fee_UNUSED, const std::vector<uint8_t> extra)
+std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<cryptonote::tx_destination_entry> dsts, const size_t fake_outs_count, const uint64_t unlock_time, const uint64_t fee_per_kb, const std::vector<uint8_t> extra)
 {
+  const uint64_t fee_rate = fee_per_kb ? std::max(fee_per_kb, FEE_PER_KB) : get_fee_per_kb();
 
   // failsafe split attempt counter
   size_t attempt_count = 0;
@@ -1188,7 +1450,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<crypto
 	  {
 	    numKB++;
 	  }
-	  needed_fee = numKB * FEE_PER_KB;
+	  needed_fee = numKB * fee_rate;
 	} while (ptx.fee < needed_fee);
 
         ptx_vector.push_back(ptx);
@@ -1296,6 +1558,18 @@ uint64_t wallet2::get_height(uint64_t &height) {
   return wap_client_status(ipc_client);
 }
 
+uint64_t wallet2::get_fee_per_kb() {
+  if (!ipc_client) {
+    return FEE_PER_KB;
+  }
+  int rc = wap_client_get_fee_estimate(ipc_client, m_fee_target_blocks);
+  if (rc < 0 || wap_client_status(ipc_client) != IPC::STATUS_OK) {
+    LOG_PRINT_L1("Failed to get a fee estimate from the daemon, using the default fee");
+    return FEE_PER_KB;
+  }
+  return std::max(wap_client_fee_per_kb(ipc_client), FEE_PER_KB);
+}
+
 uint64_t wallet2::save_bc() {
   int rc = wap_client_save_bc(ipc_client);
   THROW_WALLET_EXCEPTION_IF(rc < 0, error::no_connection_to_daemon, "save_bc");
@@ -33,6 +33,7 @@
 #include <memory>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/utility.hpp>
 #include <atomic>
 
 #include "include_base_utils.h"
@@ -52,7 +53,9 @@
 
 #include <iostream>
 #define DEFAULT_TX_SPENDABLE_AGE                               10
+#define DEFAULT_FEE_TARGET_BLOCKS                              10 //fee estimates aim to get transactions mined within this many blocks
 #define WALLET_RCP_CONNECTION_TIMEOUT                          200000
+#define WALLET_JOURNAL_MIN_COMPACT_SIZE                        (4 * 1024 * 1024) //journal is folded into the cache file once bigger than this and the cache itself
 
 namespace tools
 {
@@ -83,7 +86,8 @@ namespace tools
   {
     wallet2(const wallet2&) : m_run(true), m_callback(0), m_testnet(false) {};
   public:
-    wallet2(bool testnet = false, bool restricted = false) : m_run(true), m_callback(0), m_testnet(testnet) {
+    wallet2(bool testnet = false, bool restricted = false) : m_run(true), m_callback(0), m_testnet(testnet), m_refresh_from_block_height(0), m_fee_target_blocks(DEFAULT_FEE_TARGET_BLOCKS), m_journal_generation(0) {
+      reset_journal_state();
       ipc_client = NULL;
       connect_to_daemon();
       if (!ipc_client) {
@@ -134,6 +138,28 @@ namespace tools
       std::string key_images;
     };
 
+    /*!
+     * \brief Changes made to the wallet cache since the previous store(), appended to the journal file
+     */
+    struct journal_entry
+    {
+      bool m_detached;
+      uint64_t m_detach_height;
+      uint64_t m_blocks_start;
+      std::vector<crypto::hash> m_blocks;
+      uint64_t m_transfers_start;
+      transfer_container m_transfers;
+      std::vector<std::pair<uint64_t, bool>> m_spent;
+      std::vector<std::pair<crypto::hash, payment_details>> m_payments;
+      bool m_has_unconfirmed;
+      std::unordered_map<crypto::hash, unconfirmed_transfer_details> m_unconfirmed_txs;
+
+      bool empty() const
+      {
+        return !m_detached && m_blocks.empty() && m_transfers.empty() && m_spent.empty() && m_payments.empty() && !m_has_unconfirmed;
+      }
+    };
+
     struct keys_file_data
     {
       crypto::chacha8_iv iv;
@@ -164,7 +190,15 @@ namespace tools
      */
     void rewrite(const std::string& wallet_name, const std::string& password);
     void load(const std::string& wallet, const std::string& password);
+    /*!
+     * \brief Saves the wallet cache, appending only the changes since the last store to the journal
+     *        file and compacting the journal into the cache file once it grows too big
+     */
     void store();
+    /*!
+     * \brief Rewrites the whole wallet cache file and drops the journal
+     */
+    void store_snapshot();
 
     /*!
      * \brief verifies given password is correct for default wallet keys file
@@ -212,6 +246,22 @@ namespace tools
     bool testnet() { return m_testnet; }
     bool restricted() const { return m_restricted; }
 
+    /*!
+     * \brief Blocks below this height are not scanned for transfers, only their ids are fetched
+     */
+    void set_refresh_from_block_height(uint64_t height) { m_refresh_from_block_height = height; }
+    uint64_t get_refresh_from_block_height() const { return m_refresh_from_block_height; }
+
+    /*!
+     * \brief Number of blocks transactions should be mined within, used to pick the fee
+     */
+    void set_fee_target_blocks(uint64_t blocks) { m_fee_target_blocks = blocks; }
+    uint64_t get_fee_target_blocks() const { return m_fee_target_blocks; }
+    /*!
+     * \brief Fee per kB the daemon estimates for the fee target, FEE_PER_KB if it can't tell
+     */
+    uint64_t get_fee_per_kb();
+
     uint64_t balance();
     uint64_t unlocked_balance();
     template<typename T>
@@ -222,7 +272,8 @@ namespace tools
     void transfer(const std::vector<cryptonote::tx_destination_entry>& dsts, size_t fake_outputs_count, uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, cryptonote::transaction& tx, pending_tx& ptx);
     void commit_tx(pending_tx& ptx_vector);
     void commit_tx(std::vector<pending_tx>& ptx_vector);
-    std::vector<pending_tx> create_transactions(std::vector<cryptonote::tx_destination_entry> dsts, const size_t fake_outs_count, const uint64_t unlock_time, const uint64_t fee, const std::vector<uint8_t> extra);
+    // fee_per_kb of 0 asks the daemon for an estimate
+    std::vector<pending_tx> create_transactions(std::vector<cryptonote::tx_destination_entry> dsts, const size_t fake_outs_count, const uint64_t unlock_time, const uint64_t fee_per_kb, const std::vector<uint8_t> extra);
     bool check_connection();
     void get_transfers(wallet2::transfer_container& incoming_transfers) const;
     void get_payments(const crypto::hash& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height = 0) const;
@@ -243,6 +294,12 @@ namespace tools
       if(ver < 7)
         return;
       a & m_payments;
+      if(ver < 8)
+        return;
+      a & m_journal_generation;
+      if(ver < 9)
+        return;
+      a & m_refresh_from_block_height;
     }
 
     void stop_ipc_client();
@@ -293,6 +350,7 @@ namespace tools
     bool clear();
     void get_blocks_from_zmq_msg(zmsg_t *msg, std::list<cryptonote::block_complete_entry> &blocks);
     void pull_blocks(uint64_t start_height, size_t& blocks_added);
+    void process_block_ids(zmsg_t *msg, uint64_t start_height, uint64_t current_index, size_t& blocks_added);
     uint64_t select_transfers(uint64_t needed_money, bool add_dust, uint64_t dust, std::list<transfer_container::iterator>& selected_transfers);
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const cryptonote::transaction& tx);
@@ -300,6 +358,12 @@ namespace tools
     void generate_genesis(cryptonote::block& b);
     void check_genesis(const crypto::hash& genesis_hash); //throws
     void connect_to_daemon();
+    std::string journal_file_name() const;
+    void make_journal_entry(journal_entry& entry);
+    bool append_journal_entry(const journal_entry& entry);
+    void apply_journal_entry(const journal_entry& entry);
+    void replay_journal();
+    void reset_journal_state();
 
     cryptonote::account_base m_account;
     std::string m_daemon_address;
@@ -321,12 +385,26 @@ namespace tools
     i_wallet2_callback* m_callback;
     bool m_testnet;
     bool m_restricted;
+    uint64_t m_refresh_from_block_height;
+    uint64_t m_fee_target_blocks;
     std::string seed_language; /*!< Language of the mnemonics (seed). */
     bool is_old_file_format; /*!< Whether the wallet file is of an old file format */
     wap_client_t *ipc_client;
+
+    // journal bookkeeping: what part of the in-memory state is already persisted
+    uint64_t m_journal_generation; /*!< Ties a journal file to the cache file it was started from */
+    size_t m_journal_blockchain_size;
+    size_t m_journal_transfers_size;
+    std::vector<bool> m_journal_spent;
+    std::vector<std::pair<crypto::hash, payment_details>> m_journal_payments;
+    bool m_journal_detached;
+    uint64_t m_journal_detach_height;
+    bool m_journal_unconfirmed_dirty;
+
+    friend class wallet_journal_test;
   };
 }
-BOOST_CLASS_VERSION(tools::wallet2, 7)
+BOOST_CLASS_VERSION(tools::wallet2, 9)
 
 namespace boost
 {
@@ -359,6 +437,21 @@ namespace boost
       a & x.m_block_height;
       a & x.m_unlock_time;
     }
+
+    template <class Archive>
+    inline void serialize(Archive& a, tools::wallet2::journal_entry& x, const boost::serialization::version_type ver)
+    {
+      a & x.m_detached;
+      a & x.m_detach_height;
+      a & x.m_blocks_start;
+      a & x.m_blocks;
+      a & x.m_transfers_start;
+      a & x.m_transfers;
+      a & x.m_spent;
+      a & x.m_payments;
+      a & x.m_has_unconfirmed;
+      a & x.m_unconfirmed_txs;
+    }
   }
 }
 
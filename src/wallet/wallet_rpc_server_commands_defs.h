@@ -93,7 +93,8 @@ namespace wallet_rpc
     struct request
     {
       std::list<transfer_destination> destinations;
-      uint64_t fee;
+      uint64_t fee; //ignored, the fee is worked out from fee_per_kb
+      uint64_t fee_per_kb; //0, also when missing, asks the daemon for an estimate
       uint64_t mixin;
       uint64_t unlock_time;
       std::string payment_id;
@@ -101,6 +102,7 @@ namespace wallet_rpc
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(destinations)
         KV_SERIALIZE(fee)
+        KV_SERIALIZE(fee_per_kb)
         KV_SERIALIZE(mixin)
         KV_SERIALIZE(unlock_time)
         KV_SERIALIZE(payment_id)
@@ -122,7 +124,8 @@ namespace wallet_rpc
     struct request
     {
       std::list<transfer_destination> destinations;
-      uint64_t fee;
+      uint64_t fee; //ignored, the fee is worked out from fee_per_kb
+      uint64_t fee_per_kb; //0, also when missing, asks the daemon for an estimate
       uint64_t mixin;
       uint64_t unlock_time;
       std::string payment_id;
@@ -130,6 +133,7 @@ namespace wallet_rpc
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(destinations)
         KV_SERIALIZE(fee)
+        KV_SERIALIZE(fee_per_kb)
         KV_SERIALIZE(mixin)
         KV_SERIALIZE(unlock_time)
         KV_SERIALIZE(payment_id)
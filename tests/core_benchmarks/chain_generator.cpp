@@ -0,0 +1,251 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "include_base_utils.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+
+#include "chain_generator.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  // outputs below this are not worth spending, the fee would eat most of them
+  const uint64_t min_spend_amount = 10 * FEE_PER_KB;
+  const size_t max_fee_attempts = 8;
+
+  void split_amount(uint64_t amount, const account_public_address& addr, std::vector<tx_destination_entry>& dsts)
+  {
+    decompose_amount_into_digits(amount, config::DEFAULT_DUST_THRESHOLD,
+      [&](uint64_t chunk) { dsts.push_back(tx_destination_entry(chunk, addr)); },
+      [&](uint64_t dust) { dsts.push_back(tx_destination_entry(dust, addr)); });
+  }
+}
+
+chain_generator::chain_generator(const chain_params& params)
+  : m_params(params)
+  , m_rng(params.seed)
+  , m_height(0)
+{
+  m_miner.generate();
+  m_users.resize(std::max<size_t>(m_params.users, 1));
+  for (account_base& user : m_users)
+    user.generate();
+  if (m_params.mixins.empty())
+    m_params.mixins.push_back(0);
+  m_params.max_inputs = std::max<size_t>(m_params.max_inputs, 1);
+}
+//-----------------------------------------------------------------------------------------------------
+bool chain_generator::generate(generated_chain& chain)
+{
+  chain = generated_chain();
+
+  // the testnet genesis block, so blockchain_storage::init() accepts a stored chain
+  block genesis;
+  CHECK_AND_ASSERT_MES(generate_genesis_block(genesis, config::testnet::GENESIS_TX, config::testnet::GENESIS_NONCE), false, "failed to generate genesis block");
+  std::vector<size_t> block_sizes;
+  m_generator.add_block(genesis, 0, block_sizes, 0);
+  chain.blocks.push_back(genesis);
+  chain.txs.push_back(std::list<transaction>());
+  m_top = genesis;
+  m_height = 1;
+  index_outputs(genesis.miner_tx);
+
+  // nothing is spendable until the first coinbase outputs unlock
+  for (size_t i = 0; i < CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW; ++i)
+  {
+    if (!add_block(std::list<transaction>(), chain))
+      return false;
+  }
+
+  for (size_t i = 0; i < m_params.blocks; ++i)
+  {
+    std::list<transaction> txs;
+    for (size_t j = 0; j < m_params.txs_per_block; ++j)
+    {
+      transaction tx;
+      if (!construct_spend(tx))
+        break;
+      txs.push_back(tx);
+    }
+    chain.tx_count += txs.size();
+    if (!add_block(txs, chain))
+      return false;
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+bool chain_generator::make_tx(transaction& tx)
+{
+  return construct_spend(tx);
+}
+//-----------------------------------------------------------------------------------------------------
+bool chain_generator::add_block(const std::list<transaction>& txs, generated_chain& chain)
+{
+  block blk;
+  CHECK_AND_ASSERT_MES(m_generator.construct_block(blk, m_top, m_miner, txs), false, "failed to construct block " << m_height);
+
+  // global indices follow the order the blockchain stores the outputs in: coinbase first, then tx_hashes
+  index_outputs(blk.miner_tx);
+  std::unordered_map<crypto::hash, const transaction*> by_hash;
+  for (const transaction& tx : txs)
+    by_hash[get_transaction_hash(tx)] = &tx;
+  for (const crypto::hash& h : blk.tx_hashes)
+  {
+    auto it = by_hash.find(h);
+    CHECK_AND_ASSERT_MES(it != by_hash.end(), false, "block references unknown transaction " << h);
+    index_outputs(*it->second);
+  }
+
+  chain.blocks.push_back(blk);
+  chain.txs.push_back(txs);
+  m_top = blk;
+  ++m_height;
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+void chain_generator::index_outputs(const transaction& tx)
+{
+  crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
+  for (size_t i = 0; i < tx.vout.size(); ++i)
+  {
+    const tx_out& out = tx.vout[i];
+    if (out.target.type() != typeid(txout_to_key))
+      continue;
+    const txout_to_key& out_key = boost::get<txout_to_key>(out.target);
+
+    std::vector<global_output>& outputs = m_outputs[out.amount];
+    if (is_out_to_acc(m_miner.get_keys(), out_key, tx_pub_key, i))
+    {
+      owned_output owned = {out.amount, outputs.size(), tx_pub_key, i, tx.unlock_time};
+      m_miner_outputs.push_back(owned);
+    }
+    outputs.push_back(global_output{out_key.key, tx.unlock_time});
+  }
+}
+//-----------------------------------------------------------------------------------------------------
+bool chain_generator::is_unlocked(uint64_t unlock_time) const
+{
+  return unlock_time < m_height;
+}
+//-----------------------------------------------------------------------------------------------------
+bool chain_generator::fill_ring(const owned_output& real, size_t mixin, tx_source_entry& src)
+{
+  const std::vector<global_output>& outputs = m_outputs[real.amount];
+
+  std::vector<uint64_t> candidates;
+  for (uint64_t i = 0; i < outputs.size(); ++i)
+  {
+    if (i != real.global_index && is_unlocked(outputs[i].unlock_time))
+      candidates.push_back(i);
+  }
+  if (candidates.size() < mixin)
+    return false;
+
+  std::shuffle(candidates.begin(), candidates.end(), m_rng);
+  candidates.resize(mixin);
+  candidates.push_back(real.global_index);
+  // construct_tx expects the ring in global index order
+  std::sort(candidates.begin(), candidates.end());
+
+  src = tx_source_entry();
+  for (uint64_t i : candidates)
+  {
+    if (i == real.global_index)
+      src.real_output = src.outputs.size();
+    src.outputs.push_back(tx_source_entry::output_entry(i, outputs[i].key));
+  }
+  src.real_out_tx_key = real.tx_pub_key;
+  src.real_output_in_tx_index = real.out_no;
+  src.amount = real.amount;
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+bool chain_generator::construct_spend(transaction& tx)
+{
+  size_t mixin = m_params.mixins[std::uniform_int_distribution<size_t>(0, m_params.mixins.size() - 1)(m_rng)];
+
+  std::vector<std::list<owned_output>::iterator> spendable;
+  for (auto it = m_miner_outputs.begin(); it != m_miner_outputs.end(); ++it)
+  {
+    if (it->amount >= min_spend_amount && is_unlocked(it->unlock_time))
+      spendable.push_back(it);
+  }
+  std::shuffle(spendable.begin(), spendable.end(), m_rng);
+
+  std::vector<tx_source_entry> sources;
+  std::vector<std::list<owned_output>::iterator> spent;
+  uint64_t inputs_amount = 0;
+  for (auto it : spendable)
+  {
+    if (sources.size() >= m_params.max_inputs)
+      break;
+    tx_source_entry src;
+    if (!fill_ring(*it, mixin, src))
+      continue;
+    sources.push_back(src);
+    spent.push_back(it);
+    inputs_amount += it->amount;
+  }
+  if (sources.empty())
+    return false;
+
+  const account_base& user = m_users[std::uniform_int_distribution<size_t>(0, m_users.size() - 1)(m_rng)];
+  uint64_t fee = FEE_PER_KB;
+  for (size_t attempt = 0; attempt < max_fee_attempts; ++attempt)
+  {
+    if (inputs_amount <= fee)
+      return false;
+    uint64_t sent = std::uniform_int_distribution<uint64_t>(1, inputs_amount - fee)(m_rng);
+    uint64_t change = inputs_amount - fee - sent;
+
+    std::vector<tx_destination_entry> dsts;
+    split_amount(sent, user.get_keys().m_account_address, dsts);
+    split_amount(change, m_miner.get_keys().m_account_address, dsts);
+
+    tx = transaction();
+    CHECK_AND_ASSERT_MES(construct_tx(m_miner.get_keys(), sources, dsts, std::vector<uint8_t>(), tx, 0), false, "failed to construct transaction");
+
+    // same rule as tx_memory_pool::add_tx
+    size_t blob_size = get_object_blobsize(tx);
+    uint64_t needed_fee = (blob_size / 1024 + ((blob_size % 1024) ? 1 : 0)) * FEE_PER_KB;
+    if (fee >= needed_fee)
+    {
+      for (auto it : spent)
+        m_miner_outputs.erase(it);
+      return true;
+    }
+    fee = needed_fee;
+  }
+  return false;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "cryptonote_core/account.h"
+#include "cryptonote_core/cryptonote_basic.h"
+#include "../core_tests/chaingen.h"
+
+struct chain_params
+{
+  size_t blocks = 300;                        //!< blocks carrying transactions, after the unlock window
+  size_t txs_per_block = 4;
+  std::vector<size_t> mixins = {0, 1, 3, 3, 3, 6, 10}; //!< picked uniformly per transaction, repeat a value to weight it
+  size_t max_inputs = 2;
+  size_t users = 4;                           //!< accounts receiving the transfers
+  uint32_t seed = 0;
+};
+
+struct generated_chain
+{
+  std::vector<cryptonote::block> blocks;     //!< blocks[0] is the testnet genesis block
+  std::vector<std::list<cryptonote::transaction> > txs; //!< transactions of blocks[i]
+  size_t tx_count = 0;
+};
+
+/************************************************************************/
+/* Generates a valid chain with a mix of ring sizes on top of           */
+/* test_generator. Only the miner spends, the users just receive, so    */
+/* the generator tracks the miner's outputs and the global output       */
+/* indices itself instead of rescanning the events like chaingen does. */
+/************************************************************************/
+class chain_generator
+{
+public:
+  explicit chain_generator(const chain_params& params);
+
+  bool generate(generated_chain& chain);
+  //! a transaction on top of the generated chain, spending outputs no other transaction made by make_tx() spends
+  bool make_tx(cryptonote::transaction& tx);
+
+  const cryptonote::account_base& miner() const { return m_miner; }
+  const std::vector<cryptonote::account_base>& users() const { return m_users; }
+
+private:
+  struct global_output
+  {
+    crypto::public_key key;
+    uint64_t unlock_time;
+  };
+
+  struct owned_output
+  {
+    uint64_t amount;
+    uint64_t global_index;
+    crypto::public_key tx_pub_key;
+    size_t out_no;
+    uint64_t unlock_time;
+  };
+
+  bool add_block(const std::list<cryptonote::transaction>& txs, generated_chain& chain);
+  void index_outputs(const cryptonote::transaction& tx);
+  bool is_unlocked(uint64_t unlock_time) const;
+  bool fill_ring(const owned_output& real, size_t mixin, cryptonote::tx_source_entry& src);
+  bool construct_spend(cryptonote::transaction& tx);
+
+  chain_params m_params;
+  std::mt19937 m_rng;
+  test_generator m_generator;
+  cryptonote::account_base m_miner;
+  std::vector<cryptonote::account_base> m_users;
+  cryptonote::block m_top;
+  uint64_t m_height;                          //!< of the next block
+  std::map<uint64_t, std::vector<global_output> > m_outputs; //!< by amount, in global index order
+  std::list<owned_output> m_miner_outputs;    //!< unspent
+};
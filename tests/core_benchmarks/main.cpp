@@ -0,0 +1,470 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <set>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "storages/portable_storage_template_helper.h"
+#include "common/command_line.h"
+#include "cryptonote_core/blockchain_storage.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/tx_pool.h"
+
+#include "chain_generator.h"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+namespace
+{
+  const command_line::arg_descriptor<size_t>      arg_blocks        = {"blocks", "Blocks carrying transactions", 300};
+  const command_line::arg_descriptor<size_t>      arg_txs_per_block = {"txs-per-block", "Transactions per block", 4};
+  const command_line::arg_descriptor<std::string> arg_mixins        = {"mixins", "Comma separated mixin counts to pick from, repeat one to weight it", "0,1,3,3,3,6,10"};
+  const command_line::arg_descriptor<size_t>      arg_pool_txs      = {"pool-txs", "Transactions added to the pool for the mempool benchmark", 200};
+  const command_line::arg_descriptor<size_t>      arg_queries       = {"queries", "get_random_outs_for_amounts calls to time", 1000};
+  const command_line::arg_descriptor<uint32_t>    arg_seed          = {"seed", "Seed for the chain shape, keys are always fresh", 0};
+  const command_line::arg_descriptor<std::string> arg_data_dir      = {"data-dir", "Scratch directory for the blockchain, removed afterwards (default: a temporary one)", ""};
+  const command_line::arg_descriptor<std::string> arg_output        = {"output", "Write the JSON report here instead of stdout", ""};
+
+  typedef std::chrono::steady_clock clock_type;
+
+  double seconds_since(const clock_type::time_point& start)
+  {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+  }
+
+  double per_second(uint64_t count, double seconds)
+  {
+    return seconds > 0 ? count / seconds : 0;
+  }
+
+  struct chain_report
+  {
+    uint64_t blocks;
+    uint64_t transactions;
+    std::string mixins;
+    double generate_seconds;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks)
+      KV_SERIALIZE(transactions)
+      KV_SERIALIZE(mixins)
+      KV_SERIALIZE(generate_seconds)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct sync_report
+  {
+    double seconds;
+    double blocks_per_second;
+    double transactions_per_second;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(seconds)
+      KV_SERIALIZE(blocks_per_second)
+      KV_SERIALIZE(transactions_per_second)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct mempool_report
+  {
+    uint64_t transactions;
+    double add_transactions_per_second;
+    uint64_t template_transactions;
+    double template_fill_ms;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(transactions)
+      KV_SERIALIZE(add_transactions_per_second)
+      KV_SERIALIZE(template_transactions)
+      KV_SERIALIZE(template_fill_ms)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct storage_report
+  {
+    double store_seconds;
+    double load_seconds;
+    uint64_t file_bytes;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(store_seconds)
+      KV_SERIALIZE(load_seconds)
+      KV_SERIALIZE(file_bytes)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct latency_report
+  {
+    uint64_t calls;
+    uint64_t outs_count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(calls)
+      KV_SERIALIZE(outs_count)
+      KV_SERIALIZE(mean_us)
+      KV_SERIALIZE(p50_us)
+      KV_SERIALIZE(p99_us)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct wallet_scan_report
+  {
+    double blocks_per_second;
+    double transactions_per_second;
+    uint64_t outputs_found;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks_per_second)
+      KV_SERIALIZE(transactions_per_second)
+      KV_SERIALIZE(outputs_found)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct benchmark_report
+  {
+    chain_report chain;
+    sync_report sync;
+    mempool_report mempool;
+    storage_report storage;
+    latency_report random_outs;
+    wallet_scan_report wallet_scan;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(chain)
+      KV_SERIALIZE(sync)
+      KV_SERIALIZE(mempool)
+      KV_SERIALIZE(storage)
+      KV_SERIALIZE(random_outs)
+      KV_SERIALIZE(wallet_scan)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // the pair a daemon owns, without the p2p and rpc layers on top
+  struct node
+  {
+    tx_memory_pool pool;
+    blockchain_storage bchs;
+
+    node() : pool(bchs), bchs(pool) {}
+
+    bool init(const std::string& data_dir)
+    {
+      return pool.init(data_dir) && bchs.init(data_dir, true);
+    }
+
+    void deinit()
+    {
+      pool.deinit();
+      bchs.deinit();
+    }
+  };
+
+  bool parse_mixins(const std::string& str, std::vector<size_t>& mixins)
+  {
+    std::vector<std::string> parts;
+    boost::split(parts, str, boost::is_any_of(","));
+    for (const std::string& part : parts)
+    {
+      size_t mixin;
+      if (!epee::string_tools::get_xtype_from_string(mixin, boost::trim_copy(part)))
+        return false;
+      mixins.push_back(mixin);
+    }
+    return !mixins.empty();
+  }
+
+  bool bench_sync(node& n, const generated_chain& chain, sync_report& report)
+  {
+    auto start = clock_type::now();
+    for (size_t i = 1; i < chain.blocks.size(); ++i)
+    {
+      // same order the protocol handler uses for blocks arriving with their transactions
+      for (const transaction& tx : chain.txs[i])
+      {
+        tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        n.pool.add_tx(tx, tvc, true);
+        CHECK_AND_ASSERT_MES(!tvc.m_verifivation_failed, false, "transaction " << get_transaction_hash(tx) << " failed to verify");
+      }
+      block_verification_context bvc = AUTO_VAL_INIT(bvc);
+      n.bchs.add_new_block(chain.blocks[i], bvc);
+      CHECK_AND_ASSERT_MES(bvc.m_added_to_main_chain && !bvc.m_verifivation_failed, false, "block " << i << " was not added to the main chain");
+    }
+    report.seconds = seconds_since(start);
+    report.blocks_per_second = per_second(chain.blocks.size() - 1, report.seconds);
+    report.transactions_per_second = per_second(chain.tx_count, report.seconds);
+    return true;
+  }
+
+  bool bench_mempool(node& n, chain_generator& generator, size_t count, mempool_report& report)
+  {
+    std::vector<transaction> txs;
+    for (size_t i = 0; i < count; ++i)
+    {
+      transaction tx;
+      if (!generator.make_tx(tx))
+        break;
+      txs.push_back(tx);
+    }
+    if (txs.size() < count)
+      LOG_PRINT_L0("Only " << txs.size() << " of " << count << " pool transactions could be made, the miner ran out of spendable outputs");
+
+    auto start = clock_type::now();
+    for (const transaction& tx : txs)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      n.pool.add_tx(tx, tvc, false);
+      CHECK_AND_ASSERT_MES(!tvc.m_verifivation_failed && tvc.m_added_to_pool, false, "pool rejected transaction " << get_transaction_hash(tx));
+    }
+    report.transactions = txs.size();
+    report.add_transactions_per_second = per_second(txs.size(), seconds_since(start));
+
+    block bl = AUTO_VAL_INIT(bl);
+    size_t total_size;
+    uint64_t fee;
+    start = clock_type::now();
+    CHECK_AND_ASSERT_MES(n.pool.fill_block_template(bl, CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE, 0, total_size, fee), false, "failed to fill block template");
+    report.template_fill_ms = seconds_since(start) * 1000;
+    report.template_transactions = bl.tx_hashes.size();
+    return true;
+  }
+
+  bool bench_storage(std::unique_ptr<node>& n, const std::string& data_dir, storage_report& report)
+  {
+    auto start = clock_type::now();
+    CHECK_AND_ASSERT_MES(n->bchs.store_blockchain(), false, "failed to store blockchain");
+    report.store_seconds = seconds_since(start);
+
+    boost::system::error_code ec;
+    report.file_bytes = boost::filesystem::file_size(data_dir + "/" CRYPTONOTE_BLOCKCHAINDATA_FILENAME, ec);
+    if (ec)
+      report.file_bytes = 0;
+
+    uint64_t height = n->bchs.get_current_blockchain_height();
+    n->deinit();
+    n.reset(new node());
+
+    start = clock_type::now();
+    CHECK_AND_ASSERT_MES(n->init(data_dir), false, "failed to load blockchain");
+    report.load_seconds = seconds_since(start);
+    CHECK_AND_ASSERT_MES(n->bchs.get_current_blockchain_height() == height, false, "loaded blockchain height " << n->bchs.get_current_blockchain_height() << ", expected " << height);
+    return true;
+  }
+
+  bool bench_random_outs(node& n, const generated_chain& chain, const std::vector<size_t>& mixins, size_t calls, latency_report& report)
+  {
+    std::set<uint64_t> amount_set;
+    for (size_t i = 0; i < chain.blocks.size(); ++i)
+    {
+      for (const tx_out& out : chain.blocks[i].miner_tx.vout)
+        amount_set.insert(out.amount);
+      for (const transaction& tx : chain.txs[i])
+        for (const tx_out& out : tx.vout)
+          amount_set.insert(out.amount);
+    }
+    std::vector<uint64_t> amounts(amount_set.begin(), amount_set.end());
+    CHECK_AND_ASSERT_MES(!amounts.empty(), false, "no outputs to query");
+
+    // what a wallet asks for when it builds a two input transaction with the largest ring
+    report.outs_count = *std::max_element(mixins.begin(), mixins.end()) + 1;
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<size_t> pick(0, amounts.size() - 1);
+    std::vector<double> latencies;
+    latencies.reserve(calls);
+    for (size_t i = 0; i < calls; ++i)
+    {
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request req = AUTO_VAL_INIT(req);
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response res = AUTO_VAL_INIT(res);
+      req.amounts.push_back(amounts[pick(rng)]);
+      req.amounts.push_back(amounts[pick(rng)]);
+      req.outs_count = report.outs_count;
+
+      auto start = clock_type::now();
+      CHECK_AND_ASSERT_MES(n.bchs.get_random_outs_for_amounts(req, res), false, "get_random_outs_for_amounts failed");
+      latencies.push_back(seconds_since(start) * 1e6);
+    }
+
+    report.calls = latencies.size();
+    report.mean_us = report.p50_us = report.p99_us = 0;
+    if (latencies.empty())
+      return true;
+    std::sort(latencies.begin(), latencies.end());
+    for (double l : latencies)
+      report.mean_us += l;
+    report.mean_us /= latencies.size();
+    report.p50_us = latencies[latencies.size() / 2];
+    report.p99_us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    return true;
+  }
+
+  // wallet2::refresh() needs a daemon, so this times the part of it that scales with the chain:
+  // checking every output of every transaction against the wallet's keys
+  void bench_wallet_scan(const generated_chain& chain, const account_base& acc, wallet_scan_report& report)
+  {
+    uint64_t tx_count = 0;
+    report.outputs_found = 0;
+    auto start = clock_type::now();
+    for (size_t i = 0; i < chain.blocks.size(); ++i)
+    {
+      std::vector<size_t> outs;
+      uint64_t money = 0;
+      lookup_acc_outs(acc.get_keys(), chain.blocks[i].miner_tx, outs, money);
+      report.outputs_found += outs.size();
+      ++tx_count;
+      for (const transaction& tx : chain.txs[i])
+      {
+        outs.clear();
+        lookup_acc_outs(acc.get_keys(), tx, outs, money);
+        report.outputs_found += outs.size();
+        ++tx_count;
+      }
+    }
+    double seconds = seconds_since(start);
+    report.blocks_per_second = per_second(chain.blocks.size(), seconds);
+    report.transactions_per_second = per_second(tx_count, seconds);
+  }
+
+  bool run(const po::variables_map& vm, const std::string& data_dir, benchmark_report& report)
+  {
+    chain_params params;
+    params.blocks = command_line::get_arg(vm, arg_blocks);
+    params.txs_per_block = command_line::get_arg(vm, arg_txs_per_block);
+    params.seed = command_line::get_arg(vm, arg_seed);
+    params.mixins.clear();
+    report.chain.mixins = command_line::get_arg(vm, arg_mixins);
+    CHECK_AND_ASSERT_MES(parse_mixins(report.chain.mixins, params.mixins), false, "invalid --mixins: " << report.chain.mixins);
+
+    LOG_PRINT_L0("Generating " << params.blocks << " blocks...");
+    chain_generator generator(params);
+    generated_chain chain;
+    auto start = clock_type::now();
+    CHECK_AND_ASSERT_MES(generator.generate(chain), false, "failed to generate chain");
+    report.chain.generate_seconds = seconds_since(start);
+    report.chain.blocks = chain.blocks.size();
+    report.chain.transactions = chain.tx_count;
+
+    std::unique_ptr<node> holder(new node());
+    CHECK_AND_ASSERT_MES(holder->init(data_dir), false, "failed to initialize blockchain in " << data_dir);
+    CHECK_AND_ASSERT_MES(get_block_hash(chain.blocks[0]) == holder->bchs.get_tail_id(), false, "unexpected genesis block");
+
+    LOG_PRINT_L0("Syncing...");
+    if (!bench_sync(*holder, chain, report.sync))
+      return false;
+    LOG_PRINT_L0("Filling the pool...");
+    if (!bench_mempool(*holder, generator, command_line::get_arg(vm, arg_pool_txs), report.mempool))
+      return false;
+    LOG_PRINT_L0("Storing and loading...");
+    if (!bench_storage(holder, data_dir, report.storage))
+      return false;
+    LOG_PRINT_L0("Querying random outputs...");
+    if (!bench_random_outs(*holder, chain, params.mixins, command_line::get_arg(vm, arg_queries), report.random_outs))
+      return false;
+    LOG_PRINT_L0("Scanning for wallet outputs...");
+    bench_wallet_scan(chain, generator.users().front(), report.wallet_scan);
+
+    holder->deinit();
+    return true;
+  }
+}
+
+unsigned int epee::g_test_dbg_lock_sleep = 0;
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+  epee::log_space::get_set_log_detalisation_level(true, LOG_LEVEL_0);
+  epee::log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL, LOG_LEVEL_0);
+
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_blocks);
+  command_line::add_arg(desc_options, arg_txs_per_block);
+  command_line::add_arg(desc_options, arg_mixins);
+  command_line::add_arg(desc_options, arg_pool_txs);
+  command_line::add_arg(desc_options, arg_queries);
+  command_line::add_arg(desc_options, arg_seed);
+  command_line::add_arg(desc_options, arg_data_dir);
+  command_line::add_arg(desc_options, arg_output);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  std::string data_dir = command_line::get_arg(vm, arg_data_dir);
+  if (data_dir.empty())
+    data_dir = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("core_benchmarks-%%%%-%%%%")).string();
+  boost::system::error_code ec;
+  CHECK_AND_ASSERT_MES(!boost::filesystem::exists(data_dir, ec), 1, "data directory " << data_dir << " already exists, refusing to reuse it");
+
+  benchmark_report report = AUTO_VAL_INIT(report);
+  r = run(vm, data_dir, report);
+  boost::filesystem::remove_all(data_dir, ec);
+  if (!r)
+    return 1;
+
+  std::string json = epee::serialization::store_t_to_json(report);
+  std::string output = command_line::get_arg(vm, arg_output);
+  if (output.empty())
+  {
+    std::cout << json << std::endl;
+  }
+  else if (!epee::file_io_utils::save_string_to_file(output, json))
+  {
+    LOG_ERROR("Failed to write " << output);
+    return 1;
+  }
+
+  return 0;
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -0,0 +1,307 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "include_base_utils.h"
+#include "net/http_client.h"
+#include "storages/http_abstract_invoke.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "daemon_ipc_handlers.h"
+
+#include "load_generator.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  const char* const op_names[op_count] = {
+    "blocks",
+    "random_outs",
+    "output_indexes",
+    "get_height",
+    "get_info",
+    "rpc_getblockcount",
+    "rpc_getheight"
+  };
+
+  bool is_rpc_op(size_t op)
+  {
+    return op == op_rpc_getblockcount || op == op_rpc_getheight;
+  }
+
+  // the same shape wallet2::get_short_chain_history() sends for a wallet synced to height
+  void short_chain_history(const std::vector<crypto::hash>& block_ids, size_t height, std::vector<crypto::hash>& ids)
+  {
+    size_t sz = height + 1;
+    size_t i = 0;
+    size_t current_multiplier = 1;
+    size_t current_back_offset = 1;
+    bool genesis_included = false;
+    while (current_back_offset < sz)
+    {
+      ids.push_back(block_ids[sz - current_back_offset]);
+      if (sz - current_back_offset == 0)
+        genesis_included = true;
+      if (i < 10)
+        ++current_back_offset;
+      else
+        current_back_offset += current_multiplier *= 2;
+      ++i;
+    }
+    if (!genesis_included)
+      ids.push_back(block_ids[0]);
+  }
+
+  bool uses_ops(const load_options& options, bool rpc)
+  {
+    for (size_t op = 0; op < op_count; ++op)
+    {
+      if (options.weights[op] && is_rpc_op(op) == rpc)
+        return true;
+    }
+    return false;
+  }
+
+  double percentile(const std::vector<double>& sorted, size_t p)
+  {
+    return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+  }
+}
+
+const char* load_op_name(load_op op)
+{
+  return op < op_count ? op_names[op] : "unknown";
+}
+//-----------------------------------------------------------------------------------------------------
+bool parse_load_mix(const std::string& mix, load_options& options)
+{
+  std::fill(options.weights, options.weights + op_count, 0);
+  std::vector<std::string> parts;
+  boost::split(parts, mix, boost::is_any_of(","));
+  for (const std::string& part : parts)
+  {
+    std::vector<std::string> kv;
+    boost::split(kv, part, boost::is_any_of("="));
+    CHECK_AND_ASSERT_MES(kv.size() == 2, false, "expected op=weight, got \"" << part << "\"");
+    const std::string name = boost::trim_copy(kv[0]);
+    const char* const* it = std::find(op_names, op_names + op_count, name);
+    CHECK_AND_ASSERT_MES(it != op_names + op_count, false, "unknown op \"" << name << "\"");
+    CHECK_AND_ASSERT_MES(epee::string_tools::get_xtype_from_string(options.weights[it - op_names], boost::trim_copy(kv[1])), false,
+      "invalid weight for " << name << ": \"" << kv[1] << "\"");
+  }
+  return std::any_of(options.weights, options.weights + op_count, [](unsigned w) { return w > 0; });
+}
+//-----------------------------------------------------------------------------------------------------
+load_generator::load_generator(const load_options& options, const workload& w)
+  : m_options(options)
+  , m_workload(w)
+  , m_stop(false)
+  , m_failed_connections(0)
+{
+  for (size_t i = 0; i < w.amounts.size(); ++i)
+  {
+    if (w.amount_outputs[i] >= options.outs_count)
+      m_amounts.push_back(w.amounts[i]);
+  }
+}
+//-----------------------------------------------------------------------------------------------------
+bool load_generator::run(load_report& report)
+{
+  CHECK_AND_ASSERT_MES(!uses_ops(m_options, true) || !m_options.rpc_host.empty(), false, "the mix has RPC ops but no RPC address was given");
+  CHECK_AND_ASSERT_MES(!m_options.weights[op_random_outs] || !m_amounts.empty(), false,
+    "no amount on the chain has " << m_options.outs_count << " outputs");
+  CHECK_AND_ASSERT_MES(m_options.threads > 0, false, "at least one thread is needed");
+
+  std::vector<thread_stats> stats(m_options.threads);
+  std::vector<boost::thread> threads;
+  m_stop = false;
+  m_failed_connections = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < m_options.threads; ++i)
+    threads.push_back(boost::thread(&load_generator::worker, this, i, boost::ref(stats[i])));
+
+  boost::this_thread::sleep_for(boost::chrono::seconds(m_options.duration_seconds));
+  m_stop = true;
+  for (boost::thread& th : threads)
+    th.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  CHECK_AND_ASSERT_MES(m_failed_connections < m_options.threads, false, "no thread could connect to the daemon");
+  if (m_failed_connections)
+    LOG_PRINT_L0(m_failed_connections << " of " << m_options.threads << " threads could not connect and did no work");
+
+  report = load_report();
+  report.threads = m_options.threads;
+  report.seconds = seconds;
+  report.calls = report.errors = 0;
+  for (size_t op = 0; op < op_count; ++op)
+  {
+    if (!m_options.weights[op])
+      continue;
+    std::vector<double> latencies;
+    op_report r = AUTO_VAL_INIT(r);
+    r.name = op_names[op];
+    for (const thread_stats& s : stats)
+    {
+      latencies.insert(latencies.end(), s.latencies_us[op].begin(), s.latencies_us[op].end());
+      r.errors += s.errors[op];
+    }
+    r.calls = latencies.size();
+    r.per_second = seconds > 0 ? r.calls / seconds : 0;
+    if (!latencies.empty())
+    {
+      std::sort(latencies.begin(), latencies.end());
+      for (double l : latencies)
+        r.mean_us += l;
+      r.mean_us /= latencies.size();
+      r.p50_us = percentile(latencies, 50);
+      r.p90_us = percentile(latencies, 90);
+      r.p99_us = percentile(latencies, 99);
+      r.max_us = latencies.back();
+    }
+    report.calls += r.calls;
+    report.errors += r.errors;
+    report.ops.push_back(r);
+  }
+  report.per_second = seconds > 0 ? report.calls / seconds : 0;
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+void load_generator::worker(unsigned index, thread_stats& stats)
+{
+  std::mt19937 rng(index);
+  std::discrete_distribution<size_t> pick_op(m_options.weights, m_options.weights + op_count);
+  std::uniform_int_distribution<size_t> pick_height(0, m_workload.block_ids.size() - 1);
+  std::uniform_int_distribution<size_t> pick_tx(0, m_workload.tx_ids.size() - 1);
+  std::uniform_int_distribution<size_t> pick_amount(0, m_amounts.empty() ? 0 : m_amounts.size() - 1);
+
+  wap_client_t* client = NULL;
+  epee::net_utils::http::http_simple_client http;
+  bool connected = true;
+  if (uses_ops(m_options, false))
+  {
+    // the server routes replies by identity, so every client needs its own
+    const std::string identity = "daemon_load_tests " + std::to_string(index);
+    client = wap_client_new();
+    connected = client && wap_client_connect(client, m_options.ipc_endpoint.c_str(), m_options.timeout_ms, identity.c_str()) >= 0
+      && wap_client_connected(client);
+  }
+  if (connected && uses_ops(m_options, true))
+    connected = http.connect(m_options.rpc_host, m_options.rpc_port, m_options.timeout_ms);
+  if (!connected)
+  {
+    ++m_failed_connections;
+    if (client)
+      wap_client_destroy(&client);
+    return;
+  }
+
+  while (!m_stop)
+  {
+    const size_t op = pick_op(rng);
+    if (is_rpc_op(op) && !http.is_connected())
+      http.connect(m_options.rpc_host, m_options.rpc_port, m_options.timeout_ms);
+
+    auto start = std::chrono::steady_clock::now();
+    bool r = false;
+    switch (op)
+    {
+    case op_blocks:
+      {
+        std::vector<crypto::hash> ids;
+        short_chain_history(m_workload.block_ids, pick_height(rng), ids);
+        std::vector<char> buffer(ids.size() * (crypto::HASH_SIZE + 1));
+        zlist_t *list = zlist_new();
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+          char* id = &buffer[i * (crypto::HASH_SIZE + 1)];
+          id[0] = crypto::HASH_SIZE;
+          memcpy(id + 1, ids[i].data, crypto::HASH_SIZE);
+          zlist_append(list, id);
+        }
+        r = wap_client_blocks(client, &list, 0, 0) >= 0 && wap_client_status(client) == IPC::STATUS_OK;
+        zlist_destroy(&list);
+      }
+      break;
+    case op_random_outs:
+      {
+        std::vector<uint64_t> amounts;
+        for (size_t i = 0; i < m_options.amounts_per_request; ++i)
+          amounts.push_back(m_amounts[pick_amount(rng)]);
+        zframe_t *amounts_frame = zframe_new(amounts.data(), amounts.size() * sizeof(uint64_t));
+        r = wap_client_random_outs(client, m_options.outs_count, &amounts_frame) >= 0 && wap_client_status(client) == IPC::STATUS_OK;
+      }
+      break;
+    case op_output_indexes:
+      {
+        const crypto::hash& tx_id = m_workload.tx_ids[pick_tx(rng)];
+        zchunk_t *tx_id_chunk = zchunk_new(tx_id.data, crypto::HASH_SIZE);
+        r = wap_client_output_indexes(client, &tx_id_chunk) >= 0 && wap_client_status(client) == IPC::STATUS_OK;
+      }
+      break;
+    case op_get_height:
+      r = wap_client_get_height(client) >= 0 && wap_client_status(client) == IPC::STATUS_OK;
+      break;
+    case op_get_info:
+      r = wap_client_get_info(client) >= 0 && wap_client_status(client) == IPC::STATUS_OK;
+      break;
+    case op_rpc_getblockcount:
+      {
+        COMMAND_RPC_GETBLOCKCOUNT::request req;
+        COMMAND_RPC_GETBLOCKCOUNT::response res = AUTO_VAL_INIT(res);
+        r = epee::net_utils::invoke_http_json_rpc(m_options.rpc_json_uri, "getblockcount", req, res, http, m_options.timeout_ms)
+          && res.status == CORE_RPC_STATUS_OK;
+      }
+      break;
+    case op_rpc_getheight:
+      {
+        COMMAND_RPC_GET_HEIGHT::request req = AUTO_VAL_INIT(req);
+        COMMAND_RPC_GET_HEIGHT::response res = AUTO_VAL_INIT(res);
+        r = epee::net_utils::invoke_http_json_remote_command2("/getheight", req, res, http, m_options.timeout_ms)
+          && res.status == CORE_RPC_STATUS_OK;
+      }
+      break;
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    if (r)
+      stats.latencies_us[op].push_back(us);
+    else
+      ++stats.errors[op];
+  }
+
+  if (client)
+    wap_client_destroy(&client);
+}
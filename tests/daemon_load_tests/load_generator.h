@@ -0,0 +1,142 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "serialization/keyvalue_serialization.h"
+
+#include "workload.h"
+
+enum load_op
+{
+  op_blocks = 0,           //!< IPC, a wallet refresh from a random height
+  op_random_outs,          //!< IPC, ring members for a transfer
+  op_output_indexes,       //!< IPC, global indices of a received transaction
+  op_get_height,           //!< IPC
+  op_get_info,             //!< IPC
+  op_rpc_getblockcount,    //!< HTTP JSON RPC, served by core_rpc_server and monero-rpc-deprecated
+  op_rpc_getheight,        //!< HTTP, core_rpc_server only
+  op_count
+};
+
+const char* load_op_name(load_op op);
+
+struct load_options
+{
+  std::string ipc_endpoint = "ipc://@/monero";
+  std::string rpc_host;                       //!< RPC ops are only allowed when set
+  std::string rpc_port;
+  std::string rpc_json_uri = "/json_rpc";
+  unsigned threads = 4;
+  unsigned duration_seconds = 30;
+  unsigned timeout_ms = 5000;
+  uint64_t outs_count = 4;                    //!< per amount, mixin + 1
+  size_t amounts_per_request = 2;
+  unsigned weights[op_count] = {20, 30, 40, 5, 5, 0, 0};
+};
+
+//! "blocks=20,random_outs=30,..." ops left out get weight 0
+bool parse_load_mix(const std::string& mix, load_options& options);
+
+struct op_report
+{
+  std::string name;
+  uint64_t calls;
+  uint64_t errors;
+  double per_second;
+  double mean_us;
+  double p50_us;
+  double p90_us;
+  double p99_us;
+  double max_us;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(name)
+    KV_SERIALIZE(calls)
+    KV_SERIALIZE(errors)
+    KV_SERIALIZE(per_second)
+    KV_SERIALIZE(mean_us)
+    KV_SERIALIZE(p50_us)
+    KV_SERIALIZE(p90_us)
+    KV_SERIALIZE(p99_us)
+    KV_SERIALIZE(max_us)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct load_report
+{
+  uint64_t threads;
+  double seconds;
+  uint64_t calls;
+  uint64_t errors;
+  double per_second;
+  std::vector<op_report> ops;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(threads)
+    KV_SERIALIZE(seconds)
+    KV_SERIALIZE(calls)
+    KV_SERIALIZE(errors)
+    KV_SERIALIZE(per_second)
+    KV_SERIALIZE(ops)
+  END_KV_SERIALIZE_MAP()
+};
+
+/************************************************************************/
+/* Closed loop load: every thread owns one IPC client and one HTTP      */
+/* connection and issues the next request, picked by weight, as soon as */
+/* the previous one returns.                                            */
+/************************************************************************/
+class load_generator
+{
+public:
+  load_generator(const load_options& options, const workload& w);
+
+  bool run(load_report& report);
+
+private:
+  struct thread_stats
+  {
+    std::vector<double> latencies_us[op_count];
+    uint64_t errors[op_count] = {};
+  };
+
+  void worker(unsigned index, thread_stats& stats);
+
+  const load_options& m_options;
+  const workload& m_workload;
+  std::vector<uint64_t> m_amounts;            //!< with at least outs_count outputs
+  std::atomic<bool> m_stop;
+  std::atomic<unsigned> m_failed_connections;
+};
@@ -0,0 +1,186 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#include <iostream>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
+#include "common/command_line.h"
+
+#include "load_generator.h"
+#include "workload.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_data_dir      = {"data-dir", "Daemon data directory holding the seeded chain and its workload", ""};
+  const command_line::arg_descriptor<bool>        arg_seed          = {"seed", "Generate a testnet chain into --data-dir and exit, then start the daemon with --testnet --data-dir"};
+  const command_line::arg_descriptor<size_t>      arg_blocks        = {"blocks", "Blocks carrying transactions when seeding", 1000};
+  const command_line::arg_descriptor<size_t>      arg_txs_per_block = {"txs-per-block", "Transactions per block when seeding", 4};
+  const command_line::arg_descriptor<std::string> arg_mixins        = {"mixins", "Comma separated mixin counts to pick from when seeding", "0,1,3,3,3,6,10"};
+  const command_line::arg_descriptor<std::string> arg_ipc_endpoint  = {"ipc-endpoint", "Daemon IPC endpoint", "ipc://@/monero"};
+  const command_line::arg_descriptor<std::string> arg_rpc_address   = {"rpc-address", "host:port of an HTTP RPC server, needed by the rpc_* ops", ""};
+  const command_line::arg_descriptor<std::string> arg_rpc_json_uri  = {"rpc-json-uri", "URI JSON RPC methods are posted to", "/json_rpc"};
+  const command_line::arg_descriptor<std::string> arg_mix           = {"mix", "op=weight list, ops: blocks, random_outs, output_indexes, get_height, get_info, rpc_getblockcount, rpc_getheight",
+                                                                       "blocks=20,random_outs=30,output_indexes=40,get_height=5,get_info=5"};
+  const command_line::arg_descriptor<unsigned>    arg_threads       = {"threads", "Concurrent clients", 4};
+  const command_line::arg_descriptor<unsigned>    arg_duration      = {"duration", "Seconds to run", 30};
+  const command_line::arg_descriptor<unsigned>    arg_timeout       = {"timeout", "Connect and RPC timeout, in ms", 5000};
+  const command_line::arg_descriptor<uint64_t>    arg_outs_count    = {"outs-count", "Outputs asked per amount by random_outs, mixin + 1", 4};
+  const command_line::arg_descriptor<std::string> arg_output        = {"output", "Write the JSON report here instead of stdout", ""};
+
+  bool parse_mixins(const std::string& str, std::vector<size_t>& mixins)
+  {
+    std::vector<std::string> parts;
+    boost::split(parts, str, boost::is_any_of(","));
+    for (const std::string& part : parts)
+    {
+      size_t mixin;
+      if (!epee::string_tools::get_xtype_from_string(mixin, boost::trim_copy(part)))
+        return false;
+      mixins.push_back(mixin);
+    }
+    return !mixins.empty();
+  }
+
+  int seed(const po::variables_map& vm, const std::string& data_dir)
+  {
+    chain_params params;
+    params.blocks = command_line::get_arg(vm, arg_blocks);
+    params.txs_per_block = command_line::get_arg(vm, arg_txs_per_block);
+    params.mixins.clear();
+    const std::string mixins = command_line::get_arg(vm, arg_mixins);
+    CHECK_AND_ASSERT_MES(parse_mixins(mixins, params.mixins), 1, "invalid --mixins: " << mixins);
+    if (!seed_data_dir(params, data_dir))
+      return 1;
+    std::cout << "Start the daemon with --testnet --data-dir " << data_dir << ", then run the load against the same --data-dir" << std::endl;
+    return 0;
+  }
+
+  int load(const po::variables_map& vm, const std::string& data_dir)
+  {
+    workload w;
+    if (!load_workload(data_dir, w))
+      return 1;
+
+    load_options options;
+    options.ipc_endpoint = command_line::get_arg(vm, arg_ipc_endpoint);
+    options.rpc_json_uri = command_line::get_arg(vm, arg_rpc_json_uri);
+    options.threads = command_line::get_arg(vm, arg_threads);
+    options.duration_seconds = command_line::get_arg(vm, arg_duration);
+    options.timeout_ms = command_line::get_arg(vm, arg_timeout);
+    options.outs_count = command_line::get_arg(vm, arg_outs_count);
+    const std::string mix = command_line::get_arg(vm, arg_mix);
+    CHECK_AND_ASSERT_MES(parse_load_mix(mix, options), 1, "invalid --mix: " << mix);
+    const std::string rpc_address = command_line::get_arg(vm, arg_rpc_address);
+    if (!rpc_address.empty())
+    {
+      size_t colon = rpc_address.rfind(':');
+      CHECK_AND_ASSERT_MES(colon != std::string::npos, 1, "--rpc-address must be host:port");
+      options.rpc_host = rpc_address.substr(0, colon);
+      options.rpc_port = rpc_address.substr(colon + 1);
+    }
+
+    LOG_PRINT_L0("Running " << options.threads << " clients for " << options.duration_seconds << " s...");
+    load_generator generator(options, w);
+    load_report report;
+    if (!generator.run(report))
+      return 1;
+
+    std::string json = epee::serialization::store_t_to_json(report);
+    std::string output = command_line::get_arg(vm, arg_output);
+    if (output.empty())
+    {
+      std::cout << json << std::endl;
+    }
+    else if (!epee::file_io_utils::save_string_to_file(output, json))
+    {
+      LOG_ERROR("Failed to write " << output);
+      return 1;
+    }
+    return report.errors ? 2 : 0;
+  }
+}
+
+unsigned int epee::g_test_dbg_lock_sleep = 0;
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+  epee::log_space::get_set_log_detalisation_level(true, LOG_LEVEL_0);
+  epee::log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL, LOG_LEVEL_0);
+
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_data_dir);
+  command_line::add_arg(desc_options, arg_seed);
+  command_line::add_arg(desc_options, arg_blocks);
+  command_line::add_arg(desc_options, arg_txs_per_block);
+  command_line::add_arg(desc_options, arg_mixins);
+  command_line::add_arg(desc_options, arg_ipc_endpoint);
+  command_line::add_arg(desc_options, arg_rpc_address);
+  command_line::add_arg(desc_options, arg_rpc_json_uri);
+  command_line::add_arg(desc_options, arg_mix);
+  command_line::add_arg(desc_options, arg_threads);
+  command_line::add_arg(desc_options, arg_duration);
+  command_line::add_arg(desc_options, arg_timeout);
+  command_line::add_arg(desc_options, arg_outs_count);
+  command_line::add_arg(desc_options, arg_output);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  const std::string data_dir = command_line::get_arg(vm, arg_data_dir);
+  CHECK_AND_ASSERT_MES(!data_dir.empty(), 1, "--data-dir is required");
+  if (command_line::get_arg(vm, arg_seed))
+    return seed(vm, data_dir);
+  return load(vm, data_dir);
+
+  CATCH_ENTRY_L0("main", 1);
+}
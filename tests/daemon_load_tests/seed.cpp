@@ -0,0 +1,128 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#include <map>
+
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "storages/portable_storage_template_helper.h"
+#include "cryptonote_core/blockchain_storage.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/tx_pool.h"
+
+#include "workload.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  void add_tx(const transaction& tx, workload& w, std::map<uint64_t, uint64_t>& outputs)
+  {
+    w.tx_ids.push_back(get_transaction_hash(tx));
+    for (const tx_out& out : tx.vout)
+      ++outputs[out.amount];
+  }
+}
+
+bool seed_data_dir(const chain_params& params, const std::string& data_dir)
+{
+  boost::system::error_code ec;
+  CHECK_AND_ASSERT_MES(!boost::filesystem::exists(data_dir + "/" CRYPTONOTE_BLOCKCHAINDATA_FILENAME, ec), false,
+    "refusing to overwrite the blockchain in " << data_dir);
+
+  LOG_PRINT_L0("Generating " << params.blocks << " blocks...");
+  chain_generator generator(params);
+  generated_chain chain;
+  CHECK_AND_ASSERT_MES(generator.generate(chain), false, "failed to generate chain");
+
+  {
+    // the pair a daemon owns, fed the way the protocol handler feeds it
+    struct node
+    {
+      tx_memory_pool pool;
+      blockchain_storage bchs;
+      node() : pool(bchs), bchs(pool) {}
+    } n;
+    CHECK_AND_ASSERT_MES(n.pool.init(data_dir) && n.bchs.init(data_dir, true), false, "failed to initialize blockchain in " << data_dir);
+    CHECK_AND_ASSERT_MES(n.bchs.get_current_blockchain_height() == 1, false, data_dir << " already holds a blockchain");
+
+    LOG_PRINT_L0("Adding " << chain.blocks.size() - 1 << " blocks to " << data_dir << "...");
+    for (size_t i = 1; i < chain.blocks.size(); ++i)
+    {
+      for (const transaction& tx : chain.txs[i])
+      {
+        tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        n.pool.add_tx(tx, tvc, true);
+        CHECK_AND_ASSERT_MES(!tvc.m_verifivation_failed, false, "transaction " << get_transaction_hash(tx) << " failed to verify");
+      }
+      block_verification_context bvc = AUTO_VAL_INIT(bvc);
+      n.bchs.add_new_block(chain.blocks[i], bvc);
+      CHECK_AND_ASSERT_MES(bvc.m_added_to_main_chain && !bvc.m_verifivation_failed, false, "block " << i << " was not added to the main chain");
+    }
+    n.pool.deinit();
+    CHECK_AND_ASSERT_MES(n.bchs.deinit(), false, "failed to store blockchain in " << data_dir);
+  }
+
+  workload w;
+  std::map<uint64_t, uint64_t> outputs;
+  for (size_t i = 0; i < chain.blocks.size(); ++i)
+  {
+    w.block_ids.push_back(get_block_hash(chain.blocks[i]));
+    add_tx(chain.blocks[i].miner_tx, w, outputs);
+    // the order the block lists them in, which is how the blockchain indexes their outputs
+    for (const crypto::hash& h : chain.blocks[i].tx_hashes)
+    {
+      for (const transaction& tx : chain.txs[i])
+      {
+        if (get_transaction_hash(tx) == h)
+          add_tx(tx, w, outputs);
+      }
+    }
+  }
+  for (const auto& o : outputs)
+  {
+    w.amounts.push_back(o.first);
+    w.amount_outputs.push_back(o.second);
+  }
+
+  const std::string path = data_dir + "/" DAEMON_LOAD_WORKLOAD_FILENAME;
+  CHECK_AND_ASSERT_MES(epee::serialization::store_t_to_json_file(w, path), false, "failed to write " << path);
+  LOG_PRINT_L0("Seeded " << data_dir << ": " << w.block_ids.size() << " blocks, " << w.tx_ids.size() << " transactions");
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+bool load_workload(const std::string& data_dir, workload& w)
+{
+  const std::string path = data_dir + "/" DAEMON_LOAD_WORKLOAD_FILENAME;
+  CHECK_AND_ASSERT_MES(epee::serialization::load_t_from_json_file(w, path), false, "failed to load " << path << ", seed the data directory first");
+  CHECK_AND_ASSERT_MES(!w.block_ids.empty() && !w.tx_ids.empty() && w.amounts.size() == w.amount_outputs.size(), false, path << " is not a valid workload");
+  return true;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "serialization/keyvalue_serialization.h"
+
+#include "../core_benchmarks/chain_generator.h"
+
+/************************************************************************/
+/* What the load generator needs to know about a seeded chain to make   */
+/* requests a wallet would make. Written next to blockchain.bin by      */
+/* seed_data_dir().                                                     */
+/************************************************************************/
+struct workload
+{
+  std::vector<crypto::hash> block_ids;        //!< by height
+  std::vector<crypto::hash> tx_ids;           //!< coinbase and regular, in blockchain order
+  std::vector<uint64_t> amounts;
+  std::vector<uint64_t> amount_outputs;       //!< outputs of amounts[i] on the chain
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+    KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tx_ids)
+    KV_SERIALIZE(amounts)
+    KV_SERIALIZE(amount_outputs)
+  END_KV_SERIALIZE_MAP()
+};
+
+#define DAEMON_LOAD_WORKLOAD_FILENAME "workload.json"
+
+//! generates a testnet chain, stores it as the blockchain of data_dir and writes the workload next to it
+bool seed_data_dir(const chain_params& params, const std::string& data_dir);
+bool load_workload(const std::string& data_dir, workload& w);
@@ -28,6 +28,13 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <fstream>
+
+#include <boost/program_options.hpp>
+
+#include "common/command_line.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
 #include "performance_tests.h"
 #include "performance_utils.h"
 
@@ -42,52 +49,169 @@
 #include "generate_key_image_helper.h"
 #include "is_out_to_acc.h"
 
+namespace po = boost::program_options;
+
+namespace
+{
+  const command_line::arg_descriptor<std::vector<std::string> > arg_filter = {"filter", "Only run tests whose name contains this, can be repeated"};
+  const command_line::arg_descriptor<size_t>      arg_samples      = {"samples", "Samples per test, the test's loop count is split between them", 10};
+  const command_line::arg_descriptor<unsigned>    arg_warm_up_ms   = {"warm-up-ms", "Busy loop before each test, in ms", 500};
+  const command_line::arg_descriptor<int>         arg_cpu          = {"cpu", "Pin to this CPU, -1 to leave the affinity alone", 1};
+  const command_line::arg_descriptor<bool>        arg_no_high_priority = {"no-high-priority", "Do not raise the thread priority"};
+  const command_line::arg_descriptor<std::string> arg_json         = {"json", "Write the results to this JSON file", ""};
+  const command_line::arg_descriptor<std::string> arg_csv          = {"csv", "Write the results to this CSV file", ""};
+  const command_line::arg_descriptor<std::string> arg_baseline     = {"baseline", "Compare medians against a JSON file written by --json", ""};
+  const command_line::arg_descriptor<double>      arg_threshold    = {"threshold", "Slowdown over the baseline median, in percent, reported as a regression", 10.0};
+
+  bool write_csv(const std::string& path, const test_results& results)
+  {
+    std::ofstream out(path);
+    if (!out)
+      return false;
+    out << "name,loop_count,samples,min_ns,median_ns,mean_ns,p90_ns,max_ns,stddev_ns\n";
+    out << std::fixed << std::setprecision(1);
+    for (const test_result& r : results.tests)
+    {
+      out << '"' << r.name << '"' << ',' << r.loop_count << ',' << r.samples << ',' << r.min_ns << ',' << r.median_ns << ','
+          << r.mean_ns << ',' << r.p90_ns << ',' << r.max_ns << ',' << r.stddev_ns << '\n';
+    }
+    return out.good();
+  }
+
+  // returns the number of tests slower than the baseline by more than threshold percent
+  size_t compare_to_baseline(const test_results& results, const test_results& baseline, double threshold)
+  {
+    size_t regressions = 0;
+    std::cout << "Comparison to baseline (median):" << std::endl;
+    const std::streamsize precision = std::cout.precision(1);
+    std::cout << std::fixed;
+    for (const test_result& r : results.tests)
+    {
+      auto it = std::find_if(baseline.tests.begin(), baseline.tests.end(), [&](const test_result& b) { return b.name == r.name; });
+      if (it == baseline.tests.end() || it->median_ns <= 0)
+      {
+        std::cout << "  " << r.name << ": not in baseline" << std::endl;
+        continue;
+      }
+      double change = (r.median_ns / it->median_ns - 1) * 100;
+      bool regressed = change > threshold;
+      regressions += regressed ? 1 : 0;
+      std::cout << "  " << r.name << ": " << it->median_ns << " -> " << r.median_ns << " ns/call ("
+                << (change >= 0 ? "+" : "") << change << "%)" << (regressed ? " REGRESSION" : "") << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+    return regressions;
+  }
+}
+
 unsigned int epee::g_test_dbg_lock_sleep = 0;
 
 int main(int argc, char** argv)
 {
-  set_process_affinity(1);
-  set_thread_high_priority();
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_filter);
+  command_line::add_arg(desc_options, arg_samples);
+  command_line::add_arg(desc_options, arg_warm_up_ms);
+  command_line::add_arg(desc_options, arg_cpu);
+  command_line::add_arg(desc_options, arg_no_high_priority);
+  command_line::add_arg(desc_options, arg_json);
+  command_line::add_arg(desc_options, arg_csv);
+  command_line::add_arg(desc_options, arg_baseline);
+  command_line::add_arg(desc_options, arg_threshold);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  test_results baseline;
+  const std::string baseline_path = command_line::get_arg(vm, arg_baseline);
+  if (!baseline_path.empty() && !epee::serialization::load_t_from_json_file(baseline, baseline_path))
+  {
+    std::cout << "Failed to load baseline " << baseline_path << std::endl;
+    return 1;
+  }
+
+  const int cpu = command_line::get_arg(vm, arg_cpu);
+  if (0 <= cpu)
+    set_process_affinity(cpu);
+  if (!command_line::get_arg(vm, arg_no_high_priority))
+    set_thread_high_priority();
+
+  test_session session;
+  if (command_line::has_arg(vm, arg_filter))
+    session.filters = command_line::get_arg(vm, arg_filter);
+  session.samples = command_line::get_arg(vm, arg_samples);
+  session.warm_up_ms = command_line::get_arg(vm, arg_warm_up_ms);
 
   performance_timer timer;
   timer.start();
 
-  TEST_PERFORMANCE2(test_construct_tx, 1, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 100);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 1000);
-
-  TEST_PERFORMANCE2(test_construct_tx, 2, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 100);
-
-  TEST_PERFORMANCE2(test_construct_tx, 10, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 100);
-
-  TEST_PERFORMANCE2(test_construct_tx, 100, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 100);
-
-  TEST_PERFORMANCE1(test_check_ring_signature, 1);
-  TEST_PERFORMANCE1(test_check_ring_signature, 2);
-  TEST_PERFORMANCE1(test_check_ring_signature, 10);
-  TEST_PERFORMANCE1(test_check_ring_signature, 100);
-
-  TEST_PERFORMANCE0(test_is_out_to_acc);
-  TEST_PERFORMANCE0(test_generate_key_image_helper);
-  TEST_PERFORMANCE0(test_generate_key_derivation);
-  TEST_PERFORMANCE0(test_generate_key_image);
-  TEST_PERFORMANCE0(test_derive_public_key);
-  TEST_PERFORMANCE0(test_derive_secret_key);
-
-  TEST_PERFORMANCE0(test_cn_slow_hash);
+  TEST_PERFORMANCE2(session, test_construct_tx, 1, 1);
+  TEST_PERFORMANCE2(session, test_construct_tx, 1, 2);
+  TEST_PERFORMANCE2(session, test_construct_tx, 1, 10);
+  TEST_PERFORMANCE2(session, test_construct_tx, 1, 100);
+  TEST_PERFORMANCE2(session, test_construct_tx, 1, 1000);
+
+  TEST_PERFORMANCE2(session, test_construct_tx, 2, 1);
+  TEST_PERFORMANCE2(session, test_construct_tx, 2, 2);
+  TEST_PERFORMANCE2(session, test_construct_tx, 2, 10);
+  TEST_PERFORMANCE2(session, test_construct_tx, 2, 100);
+
+  TEST_PERFORMANCE2(session, test_construct_tx, 10, 1);
+  TEST_PERFORMANCE2(session, test_construct_tx, 10, 2);
+  TEST_PERFORMANCE2(session, test_construct_tx, 10, 10);
+  TEST_PERFORMANCE2(session, test_construct_tx, 10, 100);
+
+  TEST_PERFORMANCE2(session, test_construct_tx, 100, 1);
+  TEST_PERFORMANCE2(session, test_construct_tx, 100, 2);
+  TEST_PERFORMANCE2(session, test_construct_tx, 100, 10);
+  TEST_PERFORMANCE2(session, test_construct_tx, 100, 100);
+
+  TEST_PERFORMANCE1(session, test_check_ring_signature, 1);
+  TEST_PERFORMANCE1(session, test_check_ring_signature, 2);
+  TEST_PERFORMANCE1(session, test_check_ring_signature, 10);
+  TEST_PERFORMANCE1(session, test_check_ring_signature, 100);
+
+  TEST_PERFORMANCE0(session, test_is_out_to_acc);
+  TEST_PERFORMANCE0(session, test_generate_key_image_helper);
+  TEST_PERFORMANCE0(session, test_generate_key_derivation);
+  TEST_PERFORMANCE0(session, test_generate_key_image);
+  TEST_PERFORMANCE0(session, test_derive_public_key);
+  TEST_PERFORMANCE0(session, test_derive_secret_key);
+
+  TEST_PERFORMANCE0(session, test_cn_slow_hash);
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
+  const std::string json_path = command_line::get_arg(vm, arg_json);
+  if (!json_path.empty() && !epee::serialization::store_t_to_json_file(session.results, json_path))
+  {
+    std::cout << "Failed to write " << json_path << std::endl;
+    return 1;
+  }
+  const std::string csv_path = command_line::get_arg(vm, arg_csv);
+  if (!csv_path.empty() && !write_csv(csv_path, session.results))
+  {
+    std::cout << "Failed to write " << csv_path << std::endl;
+    return 1;
+  }
+
+  if (!baseline_path.empty() && compare_to_baseline(session.results, baseline, command_line::get_arg(vm, arg_threshold)))
+    return 2;
+
   return 0;
 }
@@ -30,11 +30,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <boost/chrono.hpp>
 
+#include "serialization/keyvalue_serialization.h"
+
 class performance_timer
 {
 public:
@@ -56,23 +63,92 @@ public:
     return static_cast<int>(boost::chrono::duration_cast<boost::chrono::milliseconds>(elapsed).count());
   }
 
+  uint64_t elapsed_ns()
+  {
+    clock::duration elapsed = clock::now() - m_start;
+    return static_cast<uint64_t>(boost::chrono::duration_cast<boost::chrono::nanoseconds>(elapsed).count());
+  }
+
 private:
   clock::time_point m_base;
   clock::time_point m_start;
 };
 
+/**
+ * Per call timings of one test, in ns. Each sample times loop_count / samples
+ * calls, so a run costs about as many calls as before samples were introduced.
+ */
+struct test_result
+{
+  std::string name;
+  uint64_t loop_count;
+  uint64_t samples;
+  double min_ns;
+  double median_ns;
+  double mean_ns;
+  double p90_ns;
+  double max_ns;
+  double stddev_ns;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(name)
+    KV_SERIALIZE(loop_count)
+    KV_SERIALIZE(samples)
+    KV_SERIALIZE(min_ns)
+    KV_SERIALIZE(median_ns)
+    KV_SERIALIZE(mean_ns)
+    KV_SERIALIZE(p90_ns)
+    KV_SERIALIZE(max_ns)
+    KV_SERIALIZE(stddev_ns)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct test_results
+{
+  std::vector<test_result> tests;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(tests)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct test_session
+{
+  std::vector<std::string> filters;  ///<! run tests whose name contains one of these, all when empty
+  size_t samples = 10;
+  unsigned warm_up_ms = 500;
+  test_results results;
+
+  bool selected(const std::string& name) const
+  {
+    if (filters.empty())
+      return true;
+    for (const std::string& filter : filters)
+    {
+      if (name.find(filter) != std::string::npos)
+        return true;
+    }
+    return false;
+  }
+};
 
 template <typename T>
 class test_runner
 {
 public:
-  test_runner()
-    : m_elapsed(0)
+  test_runner(size_t samples, unsigned warm_up_ms)
+    : m_samples(samples)
+    , m_warm_up_ms(warm_up_ms)
   {
+    // loop_count is declared but never defined by the tests, so it must not be bound to a reference
+    const size_t loop_count = T::loop_count;
+    m_samples = std::max<size_t>(1, std::min(m_samples, loop_count));
   }
 
   bool run()
   {
+    static_assert(0 < T::loop_count, "T::loop_count must be greater than 0");
+
     T test;
     if (!test.init())
       return false;
@@ -80,25 +156,47 @@ public:
     performance_timer timer;
     timer.start();
     warm_up();
+    // one untimed call pulls the test's data into the caches
+    if (!test.test())
+      return false;
     std::cout << "Warm up: " << timer.elapsed_ms() << " ms" << std::endl;
 
-    timer.start();
-    for (size_t i = 0; i < T::loop_count; ++i)
+    const size_t calls_per_sample = T::loop_count / m_samples;
+    m_per_call_ns.clear();
+    m_per_call_ns.reserve(m_samples);
+    for (size_t s = 0; s < m_samples; ++s)
     {
-      if (!test.test())
-        return false;
+      timer.start();
+      for (size_t i = 0; i < calls_per_sample; ++i)
+      {
+        if (!test.test())
+          return false;
+      }
+      m_per_call_ns.push_back(static_cast<double>(timer.elapsed_ns()) / calls_per_sample);
     }
-    m_elapsed = timer.elapsed_ms();
+    std::sort(m_per_call_ns.begin(), m_per_call_ns.end());
 
     return true;
   }
 
-  int elapsed_time() const { return m_elapsed; }
-
-  int time_per_call() const
+  void get_result(test_result& result) const
   {
-    static_assert(0 < T::loop_count, "T::loop_count must be greater than 0");
-    return m_elapsed / T::loop_count;
+    const std::vector<double>& v = m_per_call_ns;
+    result.loop_count = T::loop_count;
+    result.samples = v.size();
+    result.min_ns = v.front();
+    result.max_ns = v.back();
+    result.median_ns = v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+    result.p90_ns = v[std::min(v.size() - 1, (v.size() * 90 + 99) / 100 - 1)];
+
+    double sum = 0;
+    for (double x : v)
+      sum += x;
+    result.mean_ns = sum / v.size();
+    double sq = 0;
+    for (double x : v)
+      sq += (x - result.mean_ns) * (x - result.mean_ns);
+    result.stddev_ns = v.size() > 1 ? std::sqrt(sq / (v.size() - 1)) : 0;
   }
 
 private:
@@ -107,30 +205,48 @@ private:
    */
   uint64_t warm_up()
   {
-    const size_t warm_up_rounds = 1000 * 1000 * 1000;
+    performance_timer timer;
+    timer.start();
     m_warm_up = 0;
-    for (size_t i = 0; i < warm_up_rounds; ++i)
+    while (timer.elapsed_ms() < static_cast<int>(m_warm_up_ms))
     {
-      ++m_warm_up;
+      for (size_t i = 0; i < 1000 * 1000; ++i)
+        ++m_warm_up;
     }
     return m_warm_up;
   }
 
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
-  int m_elapsed;
+  size_t m_samples;
+  unsigned m_warm_up_ms;
+  std::vector<double> m_per_call_ns;
 };
 
 template <typename T>
-void run_test(const char* test_name)
+void run_test(test_session& session, const std::string& test_name)
 {
-  test_runner<T> runner;
+  if (!session.selected(test_name))
+    return;
+
+  test_runner<T> runner(session.samples, session.warm_up_ms);
   if (runner.run())
   {
+    test_result result;
+    result.name = test_name;
+    runner.get_result(result);
+    session.results.tests.push_back(result);
+
     std::cout << test_name << " - OK:\n";
-    std::cout << "  loop count:    " << T::loop_count << '\n';
-    std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
-    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n" << std::endl;
+    std::cout << "  loop count:    " << result.loop_count << " in " << result.samples << " samples\n";
+    const std::streamsize precision = std::cout.precision(0);
+    std::cout << std::fixed;
+    std::cout << "  median:        " << result.median_ns << " ns/call\n";
+    std::cout << "  min / max:     " << result.min_ns << " / " << result.max_ns << " ns/call\n";
+    std::cout << "  p90:           " << result.p90_ns << " ns/call\n";
+    std::cout << "  stddev:        " << result.stddev_ns << " ns\n" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
   }
   else
   {
@@ -139,6 +255,6 @@ void run_test(const char* test_name)
 }
 
 #define QUOTEME(x) #x
-#define TEST_PERFORMANCE0(test_class)         run_test< test_class >(QUOTEME(test_class))
-#define TEST_PERFORMANCE1(test_class, a0)     run_test< test_class<a0> >(QUOTEME(test_class<a0>))
-#define TEST_PERFORMANCE2(test_class, a0, a1) run_test< test_class<a0, a1> >(QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ">")
+#define TEST_PERFORMANCE0(session, test_class)         run_test< test_class >(session, QUOTEME(test_class))
+#define TEST_PERFORMANCE1(session, test_class, a0)     run_test< test_class<a0> >(session, QUOTEME(test_class<a0>))
+#define TEST_PERFORMANCE2(session, test_class, a0, a1) run_test< test_class<a0, a1> >(session, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ">")
@@ -48,7 +48,7 @@ void set_process_affinity(int core)
   {
     mask <<= 1;
   }
-  ::SetProcessAffinityMask(::GetCurrentProcess(), core);
+  ::SetProcessAffinityMask(::GetCurrentProcess(), mask);
 #elif defined(BOOST_HAS_PTHREADS)
   cpu_set_t cpuset;
   CPU_ZERO(&cpuset);
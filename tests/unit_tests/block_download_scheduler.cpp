@@ -0,0 +1,325 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/uuid/random_generator.hpp>
+
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_protocol/block_download_scheduler.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  std::string make_block_blob(size_t i)
+  {
+    return "block " + std::to_string(i);
+  }
+
+  std::list<crypto::hash> make_ids(size_t count)
+  {
+    std::list<crypto::hash> ids;
+    for(size_t i = 0; i < count; ++i)
+      ids.push_back(get_blob_hash(make_block_blob(i)));
+    return ids;
+  }
+
+  std::list<block_complete_entry> make_blocks(size_t from, size_t count)
+  {
+    std::list<block_complete_entry> blocks;
+    for(size_t i = from; i < from + count; ++i)
+    {
+      block_complete_entry be;
+      be.block = make_block_blob(i);
+      blocks.push_back(be);
+    }
+    return blocks;
+  }
+
+  bool have_none(const crypto::hash&)
+  {
+    return false;
+  }
+}
+
+TEST(block_download_scheduler, connections_get_disjoint_spans)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> needed_a = make_ids(10), needed_b = make_ids(10);
+
+  std::list<crypto::hash> span_a, span_b;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 4, have_none, span_a));
+  ASSERT_TRUE(scheduler.reserve_span(b, needed_b, 4, have_none, span_b));
+  ASSERT_EQ(4, span_a.size());
+  ASSERT_EQ(4, span_b.size());
+  ASSERT_EQ(make_ids(1).front(), span_a.front());
+  ASSERT_EQ(get_blob_hash(make_block_blob(4)), span_b.front());
+  // ids taken by the other connection stay needed in case they stall
+  ASSERT_EQ(6, needed_a.size());
+  ASSERT_EQ(10 - 4, needed_b.size());
+}
+
+TEST(block_download_scheduler, drops_blocks_the_core_has)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::uuid a = boost::uuids::random_generator()();
+  std::list<crypto::hash> needed = make_ids(5);
+  crypto::hash first = needed.front();
+
+  std::list<crypto::hash> span;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed, 10, [&](const crypto::hash& id) { return id == first; }, span));
+  ASSERT_EQ(4, span.size());
+  ASSERT_TRUE(needed.empty());
+}
+
+TEST(block_download_scheduler, parks_connection_with_nothing_to_fetch)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> needed_a = make_ids(4), needed_b = make_ids(4);
+
+  std::list<crypto::hash> span_a, span_b;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 4, have_none, span_a));
+  ASSERT_FALSE(scheduler.reserve_span(b, needed_b, 4, have_none, span_b));
+  ASSERT_TRUE(span_b.empty());
+  ASSERT_EQ(4, needed_b.size());
+
+  std::list<block_download_scheduler::connection_id_type> parked;
+  scheduler.get_parked_connections(parked);
+  ASSERT_EQ(1, parked.size());
+  ASSERT_EQ(b, parked.front());
+  parked.clear();
+  scheduler.get_parked_connections(parked);
+  ASSERT_TRUE(parked.empty());
+}
+
+TEST(block_download_scheduler, stalled_span_is_taken_over)
+{
+  block_download_scheduler scheduler(BLOCKS_REORDER_BUFFER_MAX_SIZE, 0);
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> needed_a = make_ids(4), needed_b = make_ids(4);
+
+  std::list<crypto::hash> span_a, span_b;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 4, have_none, span_a));
+  ASSERT_TRUE(scheduler.reserve_span(b, needed_b, 4, have_none, span_b));
+  ASSERT_EQ(span_a, span_b);
+}
+
+TEST(block_download_scheduler, dead_connection_releases_its_span)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> needed_a = make_ids(4), needed_b = make_ids(4);
+
+  std::list<crypto::hash> span_a, span_b;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 4, have_none, span_a));
+  std::unordered_set<block_download_scheduler::connection_id_type, boost::hash<block_download_scheduler::connection_id_type> > live;
+  live.insert(b);
+  scheduler.remove_dead_connections(live);
+  ASSERT_TRUE(scheduler.reserve_span(b, needed_b, 4, have_none, span_b));
+  ASSERT_EQ(span_a, span_b);
+}
+
+TEST(block_download_scheduler, buffered_spans_pop_in_chain_order)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> ids = make_ids(6);
+  std::vector<crypto::hash> chain(ids.begin(), ids.end());
+
+  std::list<block_complete_entry> blocks = make_blocks(4, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(b, chain[3], blocks, 100));
+  blocks = make_blocks(2, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(a, chain[1], blocks, 100));
+  ASSERT_EQ(2, scheduler.get_buffered_spans_count());
+  ASSERT_EQ(200, scheduler.get_buffered_bytes());
+
+  // buffered ids are not handed out again
+  std::list<crypto::hash> needed(ids.begin(), ids.end()), span;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed, 10, have_none, span));
+  ASSERT_EQ(2, span.size());
+
+  size_t height = 2;
+  auto have_block = [&](const crypto::hash& id) {
+    return std::find(chain.begin(), chain.begin() + height, id) != chain.begin() + height;
+  };
+  block_download_scheduler::connection_id_type from;
+  std::list<block_complete_entry> ready;
+  ASSERT_TRUE(scheduler.pop_ready_span(have_block, from, ready));
+  ASSERT_EQ(a, from);
+  ASSERT_EQ(2, ready.size());
+  ASSERT_EQ(make_block_blob(2), ready.front().block);
+
+  ready.clear();
+  height = 4;
+  ASSERT_TRUE(scheduler.pop_ready_span(have_block, from, ready));
+  ASSERT_EQ(b, from);
+  ASSERT_EQ(make_block_blob(4), ready.front().block);
+  ASSERT_FALSE(scheduler.pop_ready_span(have_block, from, ready));
+  ASSERT_EQ(0, scheduler.get_buffered_bytes());
+}
+
+TEST(block_download_scheduler, full_buffer_refuses_spans)
+{
+  block_download_scheduler scheduler(150);
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> ids = make_ids(8);
+  std::vector<crypto::hash> chain(ids.begin(), ids.end());
+
+  std::list<block_complete_entry> blocks = make_blocks(6, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(a, chain[5], blocks, 100));
+  blocks = make_blocks(4, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(a, chain[3], blocks, 100));
+  ASSERT_TRUE(scheduler.is_buffer_full());
+  blocks = make_blocks(2, 2);
+  ASSERT_FALSE(scheduler.add_buffered_span(a, chain[1], blocks, 100));
+
+  // with a full buffer only the span extending the chain is handed out
+  std::list<crypto::hash> needed_a(ids.begin(), ids.end()), span_a;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 4, have_none, span_a));
+  ASSERT_EQ(4, span_a.size());
+  std::list<crypto::hash> needed_b(ids.begin(), ids.end()), span_b;
+  ASSERT_FALSE(scheduler.reserve_span(b, needed_b, 4, have_none, span_b));
+}
+
+TEST(block_download_scheduler, span_refused_by_full_buffer_waits_for_its_parent)
+{
+  block_download_scheduler scheduler(150);
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> ids = make_ids(8);
+  std::vector<crypto::hash> chain(ids.begin(), ids.end());
+
+  // b fetches the head of the chain, a the span after it
+  std::list<crypto::hash> needed_b(ids.begin(), ids.end()), span_b;
+  ASSERT_TRUE(scheduler.reserve_span(b, needed_b, 2, have_none, span_b));
+  std::list<crypto::hash> needed_a(ids.begin(), ids.end()), span_a;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 2, have_none, span_a));
+  ASSERT_EQ(chain[2], span_a.front());
+
+  // the buffer fills up before a's span arrives
+  std::list<block_complete_entry> blocks = make_blocks(6, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(b, chain[5], blocks, 200));
+  ASSERT_TRUE(scheduler.is_buffer_full());
+  scheduler.on_span_received(a, span_a, 100);
+  blocks = make_blocks(2, 2);
+  ASSERT_FALSE(scheduler.add_buffered_span(a, chain[1], blocks, 100));
+
+  block_download_scheduler::requeue_span(needed_a, chain[1], span_a);
+  ASSERT_TRUE(span_a.empty());
+  ASSERT_EQ(std::list<crypto::hash>(ids.begin(), ids.end()), needed_a);
+
+  // the refused span is not fetched again while its parent is still on the way
+  ASSERT_FALSE(scheduler.reserve_span(a, needed_a, 2, have_none, span_a));
+  ASSERT_TRUE(span_a.empty());
+}
+
+TEST(block_download_scheduler, stale_buffered_span_goes_back_to_its_connection)
+{
+  block_download_scheduler scheduler(BLOCKS_REORDER_BUFFER_MAX_SIZE, 0);
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> ids = make_ids(6);
+  std::vector<crypto::hash> chain(ids.begin(), ids.end());
+
+  std::list<crypto::hash> needed_a(ids.begin(), ids.end()), span_a;
+  needed_a.pop_front();
+  needed_a.pop_front();
+  ASSERT_TRUE(scheduler.reserve_span(a, needed_a, 2, have_none, span_a));
+  scheduler.on_span_received(a, span_a, 100);
+  std::list<block_complete_entry> blocks = make_blocks(2, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(a, chain[1], blocks, 100));
+  blocks = make_blocks(4, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(b, chain[3], blocks, 100));
+
+  // nobody fetches chain[1], the span after it only waits for a buffered parent
+  ASSERT_EQ(1, scheduler.evict_stale_spans());
+  ASSERT_EQ(1, scheduler.get_buffered_spans_count());
+  std::list<block_download_scheduler::connection_id_type> parked;
+  scheduler.get_parked_connections(parked);
+  ASSERT_EQ(1, parked.size());
+  ASSERT_EQ(a, parked.front());
+
+  scheduler.restore_evicted_spans(a, needed_a);
+  ASSERT_EQ(std::list<crypto::hash>(chain.begin() + 2, chain.end()), needed_a);
+  std::list<crypto::hash> needed_c(ids.begin(), ids.end()), span_c;
+  ASSERT_TRUE(scheduler.reserve_span(gen(), needed_c, 4, have_none, span_c));
+  ASSERT_EQ(chain[0], span_c.front());
+  ASSERT_EQ(4, span_c.size());
+
+  ASSERT_EQ(1, scheduler.evict_stale_spans());
+  ASSERT_EQ(0, scheduler.get_buffered_bytes());
+}
+
+TEST(block_download_scheduler, connection_waiting_for_buffer_is_woken_once_it_drains)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::random_generator gen;
+  boost::uuids::uuid a = gen(), b = gen();
+  std::list<crypto::hash> ids = make_ids(4);
+  std::vector<crypto::hash> chain(ids.begin(), ids.end());
+
+  std::list<block_complete_entry> blocks = make_blocks(2, 2);
+  ASSERT_TRUE(scheduler.add_buffered_span(b, chain[1], blocks, 100));
+  scheduler.park_connection(a);
+  std::list<block_download_scheduler::connection_id_type> parked;
+  scheduler.get_parked_connections(parked);
+  ASSERT_TRUE(parked.empty());
+
+  auto have_block = [&](const crypto::hash& id) { return id == chain[0] || id == chain[1]; };
+  block_download_scheduler::connection_id_type from;
+  std::list<block_complete_entry> ready;
+  ASSERT_TRUE(scheduler.pop_ready_span(have_block, from, ready));
+  scheduler.get_parked_connections(parked);
+  ASSERT_EQ(1, parked.size());
+  ASSERT_EQ(a, parked.front());
+}
+
+TEST(block_download_scheduler, span_size_follows_measured_speed)
+{
+  block_download_scheduler scheduler;
+  boost::uuids::uuid a = boost::uuids::random_generator()();
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, scheduler.get_span_size(a, 1000));
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_MIN_COUNT, scheduler.get_span_size(a, 1024 * 1024));
+
+  std::list<crypto::hash> needed = make_ids(300), span;
+  ASSERT_TRUE(scheduler.reserve_span(a, needed, 300, have_none, span));
+  scheduler.on_span_received(a, span, 1000000);
+  ASSERT_LT(0, scheduler.get_connection_speed(a));
+  // a fast peer gets at most twice as many blocks as last time
+  ASSERT_EQ(600, scheduler.get_span_size(a, 1000));
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_MAX_SIZE / 100000, scheduler.get_span_size(a, 100000));
+}
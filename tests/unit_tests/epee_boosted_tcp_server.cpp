@@ -29,6 +29,8 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <condition_variable>
+#include <map>
+#include <set>
 #include <chrono>
 #include <mutex>
 #include <thread>
@@ -133,3 +135,81 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+namespace
+{
+  // records the threads every connection's handlers ran on
+  struct thread_recording_protocol_handler : public test_protocol_handler
+  {
+    static std::mutex s_lock;
+    static std::map<const void*, std::set<std::thread::id> > s_threads;
+
+    thread_recording_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+      : test_protocol_handler(psnd_hndlr, config, conn_context)
+    {
+    }
+
+    bool handle_recv(const void* /*data*/, size_t /*size*/)
+    {
+      std::unique_lock<std::mutex> lock(s_lock);
+      s_threads[this].insert(std::this_thread::get_id());
+      return true;
+    }
+  };
+  std::mutex thread_recording_protocol_handler::s_lock;
+  std::map<const void*, std::set<std::thread::id> > thread_recording_protocol_handler::s_threads;
+}
+
+TEST(boosted_tcp_server, io_service_per_thread_pins_connections)
+{
+  const size_t connections_count = 8;
+  const size_t messages_count = 10;
+
+  epee::net_utils::boosted_tcp_server<thread_recording_protocol_handler> srv;
+  srv.set_io_service_per_thread(true);
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(4, false));
+
+  boost::asio::io_service client_io_service;
+  std::vector<std::unique_ptr<boost::asio::ip::tcp::socket> > clients;
+  boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(test_server_host), srv.get_binded_port());
+  for (size_t i = 0; i < connections_count; ++i)
+  {
+    clients.emplace_back(new boost::asio::ip::tcp::socket(client_io_service));
+    clients.back()->connect(endpoint);
+  }
+  for (size_t m = 0; m < messages_count; ++m)
+  {
+    for (auto& client : clients)
+    {
+      boost::asio::write(*client, boost::asio::buffer("ping", 4));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  std::set<std::thread::id> all_threads;
+  for (size_t i = 0; i < 100; ++i)
+  {
+    {
+      std::unique_lock<std::mutex> lock(thread_recording_protocol_handler::s_lock);
+      if (connections_count == thread_recording_protocol_handler::s_threads.size())
+        break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  {
+    std::unique_lock<std::mutex> lock(thread_recording_protocol_handler::s_lock);
+    ASSERT_EQ(connections_count, thread_recording_protocol_handler::s_threads.size());
+    for (const auto& c : thread_recording_protocol_handler::s_threads)
+    {
+      ASSERT_EQ(1, c.second.size());
+      all_threads.insert(*c.second.begin());
+    }
+  }
+  ASSERT_LT(1, all_threads.size());
+
+  clients.clear();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
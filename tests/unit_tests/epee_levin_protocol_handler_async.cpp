@@ -410,6 +410,69 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_compressed_notify)
+{
+  // Setup
+  const int expected_command = 4673262;
+
+  test_connection_ptr conn = create_connection();
+
+  std::string in_data;
+  for (size_t i = 0; in_data.size() < 3 * LEVIN_COMPRESSION_MIN_SIZE; ++i)
+    in_data += std::to_string(i % 100) + ' ';
+
+  epee::net_utils::shared_send_buffer packet = test_levin_protocol_handler::make_notify_packet(expected_command, in_data, true);
+  const epee::levin::bucket_head2& head = *reinterpret_cast<const epee::levin::bucket_head2*>(packet->data());
+  ASSERT_TRUE(0 != (head.m_flags & LEVIN_PACKET_COMPRESSED));
+  ASSERT_EQ(packet->size() - sizeof(head), head.m_cb);
+  ASSERT_LT(head.m_cb, in_data.size());
+
+  // Test
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(packet->data(), packet->size()));
+
+  // Check
+  ASSERT_EQ(1, m_commands_handler.notify_counter());
+  ASSERT_EQ(expected_command, m_commands_handler.last_command());
+  ASSERT_EQ(in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_compresses_response_only_when_enabled)
+{
+  // Setup
+  const int expected_command = 4673263;
+  const std::string expected_out_data(2 * LEVIN_COMPRESSION_MIN_SIZE, 'o');
+
+  test_connection_ptr conn = create_connection();
+  m_commands_handler.invoke_out_buf(expected_out_data);
+
+  epee::levin::bucket_head2 req_head;
+  req_head.m_signature = LEVIN_SIGNATURE;
+  req_head.m_cb = 0;
+  req_head.m_have_to_return_data = true;
+  req_head.m_command = expected_command;
+  req_head.m_flags = LEVIN_PACKET_REQUEST;
+  req_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+  std::string buf(reinterpret_cast<const char*>(&req_head), sizeof(req_head));
+
+  // Test
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(buf.data(), buf.size()));
+  std::string send_data = conn->last_send_data();
+  ASSERT_EQ(sizeof(req_head) + expected_out_data.size(), send_data.size());
+  ASSERT_EQ(0, reinterpret_cast<const epee::levin::bucket_head2*>(send_data.data())->m_flags & LEVIN_PACKET_COMPRESSED);
+
+  conn->reset_last_send_data();
+  conn->m_protocol_handler.enable_compression();
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(buf.data(), buf.size()));
+
+  // Check
+  send_data = conn->last_send_data();
+  const epee::levin::bucket_head2& resp_head = *reinterpret_cast<const epee::levin::bucket_head2*>(send_data.data());
+  ASSERT_TRUE(0 != (resp_head.m_flags & LEVIN_PACKET_COMPRESSED));
+  ASSERT_TRUE(0 != (resp_head.m_flags & LEVIN_PACKET_RESPONSE));
+  ASSERT_EQ(send_data.size() - sizeof(resp_head), resp_head.m_cb);
+  ASSERT_LT(send_data.size(), expected_out_data.size());
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
@@ -530,3 +593,26 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpe
 
   ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
 }
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_corrupted_compressed_body)
+{
+  m_req_head.m_flags |= LEVIN_PACKET_COMPRESSED;
+  uint32_t raw_size = static_cast<uint32_t>(m_in_data.size());
+  m_in_data.insert(0, reinterpret_cast<const char*>(&raw_size), sizeof(raw_size));
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_compressed_body_claiming_too_big_size)
+{
+  m_req_head.m_flags |= LEVIN_PACKET_COMPRESSED;
+  uint32_t raw_size = static_cast<uint32_t>(m_in_data.size() * epee::fast_lz::max_expansion + 1);
+  m_in_data.insert(0, reinterpret_cast<const char*>(&raw_size), sizeof(raw_size));
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(0, m_commands_handler.invoke_counter());
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "lock_profiler.h"
+
+using namespace epee::lock_profiler;
+
+namespace
+{
+  const site_summary* find_site(const std::vector<site_summary>& summary, const std::string& lock_name)
+  {
+    auto it = std::find_if(summary.begin(), summary.end(), [&](const site_summary& s) { return s.lock_name == lock_name; });
+    return it == summary.end() ? nullptr : &*it;
+  }
+}
+
+TEST(lock_profiler, histogram_buckets_by_power_of_two)
+{
+  duration_histogram h;
+  h.add(0);
+  h.add(1);
+  h.add(3);
+  h.add(1000);
+
+  ASSERT_EQ(2, h.m_buckets[0]);
+  ASSERT_EQ(1, h.m_buckets[1]);
+  ASSERT_EQ(1, h.m_buckets[9]);
+  ASSERT_EQ(4, h.m_count);
+  ASSERT_EQ(1004, h.m_total_ns);
+  ASSERT_EQ(1000, h.m_max_ns);
+}
+
+TEST(lock_profiler, summary_merges_identical_sites_and_sorts_by_wait)
+{
+  // sites are registered for the lifetime of the process, like the ones the macros create
+  static site a1("test_lock_a", "file.cpp", 10);
+  static site a2("test_lock_a", "file.cpp", 10);
+  static site b("test_lock_b", "file.cpp", 20);
+
+  for (size_t i = 0; i < 99; ++i)
+  {
+    a1.m_wait.add(100);
+    a1.m_hold.add(10);
+  }
+  a2.m_wait.add(100000);
+  a2.m_hold.add(10);
+  b.m_wait.add(1000000);
+  b.m_hold.add(10);
+
+  std::vector<site_summary> summary = get_summary();
+  const site_summary* sa = find_site(summary, "test_lock_a");
+  const site_summary* sb = find_site(summary, "test_lock_b");
+  ASSERT_TRUE(sa != nullptr);
+  ASSERT_TRUE(sb != nullptr);
+  ASSERT_LT(sb, sa);
+
+  ASSERT_EQ(100, sa->count);
+  ASSERT_EQ(99 * 100 + 100000, sa->wait.total_ns);
+  ASSERT_EQ(100000, sa->wait.max_ns);
+  ASSERT_LE(100, sa->wait.p50_ns);
+  ASSERT_GT(200, sa->wait.p50_ns);
+  ASSERT_EQ(10, sa->hold.max_ns);
+
+  reset();
+  ASSERT_TRUE(find_site(get_summary(), "test_lock_a") == nullptr);
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+
+namespace
+{
+  struct test_log_stream : public epee::log_space::ibase_log_stream
+  {
+    test_log_stream():m_hold(false), m_held(false) {}
+
+    virtual bool out_buffer(const char* buffer, int buffer_len, int log_level, int color, const char* plog_name = NULL)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_lines.push_back(std::string(buffer, buffer_len));
+      if (m_hold)
+      {
+        m_held = true;
+        m_cond.notify_all();
+        m_cond.wait(lock, [this]() { return !m_hold; });
+      }
+      return true;
+    }
+
+    std::vector<std::string> lines()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      return m_lines;
+    }
+
+    // the next writer blocks inside out_buffer() until release()
+    void hold()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_hold = true;
+      m_held = false;
+    }
+
+    void wait_held()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this]() { return m_held; });
+    }
+
+    void release()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_hold = false;
+      m_cond.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_hold;
+    bool m_held;
+    std::vector<std::string> m_lines;
+  };
+}
+
+TEST(log_ring, drops_when_full)
+{
+  epee::log_space::log_ring ring(2, 0);
+  epee::log_space::log_record rec;
+  rec.message = "1";
+  ASSERT_TRUE(ring.push(rec));
+  rec.message = "2";
+  ASSERT_TRUE(ring.push(rec));
+  rec.message = "3";
+  ASSERT_FALSE(ring.push(rec));
+  ASSERT_EQ(1, ring.take_dropped());
+  ASSERT_EQ(0, ring.take_dropped());
+
+  ASSERT_TRUE(ring.pop(rec));
+  ASSERT_EQ("1", rec.message);
+  ASSERT_TRUE(ring.pop(rec));
+  ASSERT_EQ("2", rec.message);
+  ASSERT_FALSE(ring.pop(rec));
+  ASSERT_EQ(0, ring.size());
+}
+
+TEST(log_async, writes_messages_of_all_threads_in_order)
+{
+  const size_t threads_count = 4;
+  const size_t messages_count = 100;
+
+  epee::log_space::logger lg;
+  test_log_stream* stream = new test_log_stream();
+  lg.add_logger(stream);
+  size_t lines_before = stream->lines().size();
+  ASSERT_TRUE(lg.start_async(messages_count));
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threads_count; ++t)
+  {
+    threads.push_back(std::thread([&lg, t, messages_count]() {
+      for (size_t i = 0; i < messages_count; ++i)
+        lg.do_log_message(std::to_string(t) + ":" + std::to_string(i), LOG_LEVEL_0, epee::log_space::console_color_default);
+    }));
+  }
+  for (auto& th : threads)
+    th.join();
+  lg.stop_async();
+
+  std::vector<std::string> lines = stream->lines();
+  ASSERT_EQ(lines_before + threads_count * messages_count, lines.size());
+  std::vector<size_t> next(threads_count, 0);
+  for (size_t i = lines_before; i < lines.size(); ++i)
+  {
+    size_t colon = lines[i].find(':');
+    ASSERT_NE(std::string::npos, colon);
+    size_t t = std::stoul(lines[i].substr(0, colon));
+    ASSERT_EQ(std::to_string(next[t]++), lines[i].substr(colon + 1));
+  }
+}
+
+TEST(log_async, reports_dropped_messages)
+{
+  const size_t ring_size = 4;
+  const size_t dropped_count = 10;
+
+  epee::log_space::logger lg;
+  test_log_stream* stream = new test_log_stream();
+  lg.add_logger(stream);
+  ASSERT_TRUE(lg.start_async(ring_size));
+
+  // keep the background writer busy with the first message, nothing drains the ring meanwhile
+  stream->hold();
+  ASSERT_TRUE(lg.do_log_message("first", LOG_LEVEL_0, epee::log_space::console_color_default));
+  stream->wait_held();
+
+  for (size_t i = 0; i < ring_size; ++i)
+    ASSERT_TRUE(lg.do_log_message("queued", LOG_LEVEL_0, epee::log_space::console_color_default));
+  for (size_t i = 0; i < dropped_count; ++i)
+    ASSERT_FALSE(lg.do_log_message("dropped", LOG_LEVEL_0, epee::log_space::console_color_default));
+
+  stream->release();
+  lg.stop_async();
+
+  std::vector<std::string> lines = stream->lines();
+  ASSERT_EQ(1 + ring_size + 1, lines.size());
+  ASSERT_EQ("first", lines.front());
+  for (size_t i = 1; i <= ring_size; ++i)
+    ASSERT_EQ("queued", lines[i]);
+  ASSERT_NE(std::string::npos, lines.back().find(std::to_string(dropped_count) + " log messages dropped"));
+}
+
+TEST(log_async, errors_are_written_right_away)
+{
+  epee::log_space::logger lg;
+  test_log_stream* stream = new test_log_stream();
+  lg.add_logger(stream);
+  ASSERT_TRUE(lg.start_async(16));
+
+  ASSERT_TRUE(lg.do_log_message("queued", LOG_LEVEL_0, epee::log_space::console_color_default));
+  ASSERT_TRUE(lg.do_log_message("error", LOG_LEVEL_0, epee::log_space::console_color_red));
+
+  // no flush or stop needed, the error and everything before it are out already
+  std::vector<std::string> lines = stream->lines();
+  ASSERT_EQ(2, lines.size());
+  ASSERT_EQ("queued", lines[0]);
+  ASSERT_EQ("error", lines[1]);
+  lg.stop_async();
+}
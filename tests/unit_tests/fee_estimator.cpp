@@ -0,0 +1,110 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_config.h"
+#include "cryptonote_core/fee_estimator.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  crypto::hash make_id(uint64_t n)
+  {
+    crypto::hash id;
+    memset(&id, 0, sizeof(id));
+    memcpy(&id, &n, sizeof(n));
+    return id;
+  }
+}
+
+TEST(fee_estimator, no_estimate_without_data)
+{
+  fee_estimator estimator;
+  ASSERT_EQ(0, estimator.estimate_fee_per_kb(1));
+  ASSERT_EQ(0, estimator.estimate_fee_per_kb(fee_estimator::max_target_blocks));
+}
+
+TEST(fee_estimator, picks_the_fee_that_made_it_in_time)
+{
+  // every block mines the well paying transaction received just before it,
+  // and the minimum fee transaction received 20 blocks earlier
+  fee_estimator estimator;
+  const uint64_t start = 100;
+  uint64_t n = 0;
+  std::vector<crypto::hash> low_fee_ids;
+  for (uint64_t height = start; height < start + 60; ++height)
+  {
+    crypto::hash high_fee_id = make_id(++n);
+    estimator.add_tx(high_fee_id, 10 * FEE_PER_KB, 1024, height);
+    low_fee_ids.push_back(make_id(++n));
+    estimator.add_tx(low_fee_ids.back(), FEE_PER_KB, 1024, height);
+
+    std::vector<crypto::hash> block_txs(1, high_fee_id);
+    if (height >= start + 19)
+      block_txs.push_back(low_fee_ids[height - start - 19]);
+    estimator.add_block(height, block_txs);
+  }
+
+  uint64_t fast = estimator.estimate_fee_per_kb(1);
+  ASSERT_GT(fast, 5 * FEE_PER_KB);
+  ASSERT_LE(fast, 10 * FEE_PER_KB);
+  ASSERT_EQ(FEE_PER_KB, estimator.estimate_fee_per_kb(25));
+  // out of range targets are clamped
+  ASSERT_EQ(fast, estimator.estimate_fee_per_kb(0));
+  ASSERT_EQ(FEE_PER_KB, estimator.estimate_fee_per_kb(1000));
+}
+
+TEST(fee_estimator, dropped_transactions_count_as_misses)
+{
+  fee_estimator estimator;
+  for (uint64_t n = 0; n < 10; ++n)
+  {
+    estimator.add_tx(make_id(n), 2 * FEE_PER_KB, 1024, 100);
+    estimator.remove_tx(make_id(n));
+  }
+  estimator.add_block(100, std::vector<crypto::hash>());
+  ASSERT_EQ(0, estimator.estimate_fee_per_kb(fee_estimator::max_target_blocks));
+}
+
+TEST(fee_estimator, ignores_transactions_below_the_minimum_fee)
+{
+  fee_estimator estimator;
+  std::vector<crypto::hash> ids;
+  for (uint64_t n = 0; n < 10; ++n)
+  {
+    ids.push_back(make_id(n));
+    estimator.add_tx(ids.back(), FEE_PER_KB / 2, 1024, 100);
+  }
+  estimator.add_block(100, ids);
+  ASSERT_EQ(0, estimator.estimate_fee_per_kb(1));
+}
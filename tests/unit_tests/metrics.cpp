@@ -0,0 +1,103 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "common/metrics.h"
+
+using namespace tools::metrics;
+
+TEST(metrics, histogram_counts_are_cumulative)
+{
+  histogram h({1.0, 2.0, 5.0});
+  h.observe(0.5);
+  h.observe(1.5);
+  h.observe(1.5);
+  h.observe(10.0);
+
+  std::vector<uint64_t> counts = h.cumulative_counts();
+  ASSERT_EQ(4, counts.size());
+  ASSERT_EQ(1, counts[0]);
+  ASSERT_EQ(3, counts[1]);
+  ASSERT_EQ(3, counts[2]);
+  ASSERT_EQ(4, counts[3]);
+  ASSERT_EQ(4, h.count());
+  ASSERT_DOUBLE_EQ(13.5, h.sum());
+}
+
+TEST(metrics, concurrent_updates_are_not_lost)
+{
+  counter c;
+  histogram h({1.0});
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([&]() {
+      for (size_t j = 0; j < 10000; ++j)
+      {
+        c.inc();
+        h.observe(0.5);
+      }
+    });
+  }
+  for (auto& t: threads)
+    t.join();
+
+  ASSERT_EQ(40000, c.value());
+  ASSERT_EQ(40000, h.count());
+  ASSERT_DOUBLE_EQ(20000.0, h.sum());
+}
+
+TEST(metrics, registry_returns_same_metric_for_same_labels)
+{
+  registry& r = registry::instance();
+  counter& a = r.get_counter("test_metrics_requests_total", "Requests", "method=\"a\"");
+  counter& b = r.get_counter("test_metrics_requests_total", "Requests", "method=\"b\"");
+  ASSERT_NE(&a, &b);
+  ASSERT_EQ(&a, &r.get_counter("test_metrics_requests_total", "Requests", "method=\"a\""));
+  ASSERT_THROW(r.get_gauge("test_metrics_requests_total", "Requests"), std::invalid_argument);
+}
+
+TEST(metrics, prometheus_text_format)
+{
+  registry& r = registry::instance();
+  r.get_gauge("test_metrics_pool_size", "Pool size").set(7);
+  r.get_histogram("test_metrics_latency_seconds", "Latency", "method=\"x\"", {0.5}).observe(0.25);
+
+  std::string text = r.to_prometheus();
+  ASSERT_NE(std::string::npos, text.find("# TYPE test_metrics_pool_size gauge\n"));
+  ASSERT_NE(std::string::npos, text.find("test_metrics_pool_size 7\n"));
+  ASSERT_NE(std::string::npos, text.find("# TYPE test_metrics_latency_seconds histogram\n"));
+  ASSERT_NE(std::string::npos, text.find("test_metrics_latency_seconds_bucket{method=\"x\",le=\"0.5\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("test_metrics_latency_seconds_bucket{method=\"x\",le=\"+Inf\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("test_metrics_latency_seconds_count{method=\"x\"} 1\n"));
+}
@@ -0,0 +1,173 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <ctime>
+#include <set>
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/blockchain_storage.h"
+#include "cryptonote_core/tx_pool.h"
+
+namespace cryptonote
+{
+  // fills the output index the way pushing blocks would, without building a chain
+  class random_outs_test
+  {
+  public:
+    static void set_height(blockchain_storage& bs, uint64_t height)
+    {
+      bs.m_blocks.resize(height);
+    }
+
+    static void add_output(blockchain_storage& bs, uint64_t amount, uint64_t height, uint64_t unlock_time)
+    {
+      blockchain_storage::output_data_t od = AUTO_VAL_INIT(od);
+      od.pubkey = crypto::rand<crypto::public_key>();
+      od.unlock_time = unlock_time;
+      od.height = height;
+      od.is_to_key = true;
+      bs.push_output_data(amount, od);
+    }
+
+    static size_t end_of_allowed_index(blockchain_storage& bs, uint64_t amount)
+    {
+      return bs.find_end_of_allowed_index(bs.m_output_data[amount]);
+    }
+
+    // the scan find_end_of_allowed_index used before it was a binary search
+    static size_t end_of_allowed_index_linear(blockchain_storage& bs, uint64_t amount)
+    {
+      const std::vector<blockchain_storage::output_data_t>& amount_outs = bs.m_output_data[amount];
+      if(!amount_outs.size())
+        return 0;
+      size_t i = amount_outs.size();
+      do
+      {
+        --i;
+        if(amount_outs[i].height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW <= bs.get_current_blockchain_height())
+          return i+1;
+      } while (i != 0);
+      return 0;
+    }
+
+    static std::set<uint64_t> random_outs(blockchain_storage& bs, uint64_t amount, uint64_t count)
+    {
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request req = AUTO_VAL_INIT(req);
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response res = AUTO_VAL_INIT(res);
+      req.amounts.push_back(amount);
+      req.outs_count = count;
+      std::set<uint64_t> indexes;
+      if(!bs.get_random_outs_for_amounts(req, res) || res.outs.size() != 1)
+        return indexes;
+      for(const auto& out: res.outs.front().outs)
+        indexes.insert(out.global_amount_index);
+      return indexes;
+    }
+  };
+}
+
+namespace
+{
+  const uint64_t amount = 1000;
+  const uint64_t locked_amount = 2000;
+
+  class random_outs : public ::testing::Test
+  {
+  protected:
+    random_outs() : m_pool(m_bs), m_bs(m_pool) {}
+
+    cryptonote::tx_memory_pool m_pool;
+    cryptonote::blockchain_storage m_bs;
+  };
+}
+
+TEST_F(random_outs, boundary_matches_linear_scan)
+{
+  // a few outputs per block, some blocks without any
+  for(uint64_t height = 0; height < 40; ++height)
+  {
+    for(uint64_t n = 0; n < height % 4; ++n)
+      cryptonote::random_outs_test::add_output(m_bs, amount, height, 0);
+  }
+
+  for(uint64_t height = 0; height < 40 + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW + 2; ++height)
+  {
+    cryptonote::random_outs_test::set_height(m_bs, height);
+    ASSERT_EQ(cryptonote::random_outs_test::end_of_allowed_index_linear(m_bs, amount),
+      cryptonote::random_outs_test::end_of_allowed_index(m_bs, amount)) << "height " << height;
+  }
+  ASSERT_EQ(0, cryptonote::random_outs_test::end_of_allowed_index(m_bs, locked_amount));
+}
+
+TEST_F(random_outs, locked_outputs_are_skipped)
+{
+  const uint64_t height = 100;
+  const uint64_t now = time(NULL);
+  // index 0, 1: plain outputs
+  cryptonote::random_outs_test::add_output(m_bs, amount, 1, 0);
+  cryptonote::random_outs_test::add_output(m_bs, amount, 2, 0);
+  // index 2: unlock height is exactly the last one spendable at this chain height
+  cryptonote::random_outs_test::add_output(m_bs, amount, 3, height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  // index 3: unlock height one block later
+  cryptonote::random_outs_test::add_output(m_bs, amount, 3, height + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  // index 4: timestamp in the past, 5: timestamp in the future
+  cryptonote::random_outs_test::add_output(m_bs, amount, 4, now - 1000);
+  cryptonote::random_outs_test::add_output(m_bs, amount, 4, now + 100000);
+  // index 6: the last block that is out of the unlock window
+  cryptonote::random_outs_test::add_output(m_bs, amount, height - CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW, 0);
+  // index 7: one block too fresh
+  cryptonote::random_outs_test::add_output(m_bs, amount, height - CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW + 1, 0);
+  cryptonote::random_outs_test::set_height(m_bs, height);
+
+  const std::set<uint64_t> usable = {0, 1, 2, 4, 6};
+  ASSERT_EQ(usable, cryptonote::random_outs_test::random_outs(m_bs, amount, 10));
+  ASSERT_EQ(usable, cryptonote::random_outs_test::random_outs(m_bs, amount, usable.size()));
+  for(int i = 0; i < 20; ++i)
+  {
+    std::set<uint64_t> picked = cryptonote::random_outs_test::random_outs(m_bs, amount, 3);
+    ASSERT_EQ(3, picked.size());
+    for(uint64_t index: picked)
+      ASSERT_EQ(1, usable.count(index)) << "index " << index;
+  }
+}
+
+TEST_F(random_outs, amount_with_only_locked_outputs)
+{
+  const uint64_t height = 100;
+  cryptonote::random_outs_test::add_output(m_bs, locked_amount, 1, height + 50);
+  cryptonote::random_outs_test::add_output(m_bs, locked_amount, 2, time(NULL) + 100000);
+  cryptonote::random_outs_test::add_output(m_bs, locked_amount, 3, height + 50);
+  cryptonote::random_outs_test::set_height(m_bs, height);
+
+  ASSERT_EQ(3, cryptonote::random_outs_test::end_of_allowed_index(m_bs, locked_amount));
+  ASSERT_TRUE(cryptonote::random_outs_test::random_outs(m_bs, locked_amount, 1).empty());
+  ASSERT_TRUE(cryptonote::random_outs_test::random_outs(m_bs, locked_amount, 10).empty());
+}
@@ -82,3 +82,190 @@ TEST(peer_list, merge_peer_lists)
 
 
 }
+
+TEST(peer_list, table_erase_keeps_indexes)
+{
+  nodetool::peerlist_table pt;
+  for(uint32_t i = 0; i != 100; ++i)
+  {
+    uint32_t group = i % 7;
+    nodetool::peerlist_entry ple = AUTO_VAL_INIT(ple);
+    ple.adr.ip = MAKE_IP(10, group, 0, i);
+    ple.adr.port = 8080;
+    ple.id = i;
+    ple.last_seen = i;
+    ASSERT_TRUE(pt.insert_or_update(ple));
+  }
+  ASSERT_EQ(100, pt.size());
+  ASSERT_EQ(7, pt.groups_count());
+
+  for(uint32_t i = 0; i < 100; i += 3)
+  {
+    uint32_t group = i % 7;
+    nodetool::net_address adr = {MAKE_IP(10, group, 0, i), 8080};
+    ASSERT_TRUE(pt.erase(adr));
+    ASSERT_FALSE(pt.erase(adr));
+  }
+  for(uint32_t i = 0; i != 100; ++i)
+  {
+    uint32_t group = i % 7;
+    nodetool::net_address adr = {MAKE_IP(10, group, 0, i), 8080};
+    const nodetool::peerlist_entry* pe = pt.find(adr);
+    if(i % 3)
+    {
+      ASSERT_TRUE(pe != NULL);
+      ASSERT_EQ(i, pe->id);
+    }
+    else
+    {
+      ASSERT_TRUE(pe == NULL);
+    }
+  }
+
+  for(size_t i = 0; i != 1000; ++i)
+  {
+    nodetool::peerlist_entry pe;
+    ASSERT_TRUE(pt.get_random(pe));
+    ASSERT_NE(0, pe.id % 3);
+  }
+
+  std::vector<nodetool::peerlist_entry> newest;
+  pt.get_newest(newest, 5);
+  ASSERT_EQ(5, newest.size());
+  ASSERT_EQ(98, newest.front().last_seen);
+  ASSERT_EQ(92, newest.back().last_seen);
+}
+
+TEST(peer_list, delta_store_replays_changes)
+{
+  std::string delta_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  std::stringstream full_store;
+
+  nodetool::peerlist_manager plm;
+  plm.init(false);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,1), 8080, 1, 100);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 100);
+  ADD_GRAY_NODE(MAKE_IP(123,43,12,3), 8080, 3, 100);
+  ASSERT_FALSE(plm.is_delta_store_enough());
+  {
+    boost::archive::binary_oarchive a(full_store);
+    a << plm;
+  }
+  ASSERT_FALSE(plm.is_delta_store_enough());
+  plm.commit_full_store();
+
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,3), 8080, 3, 200);
+  ADD_GRAY_NODE(MAKE_IP(123,43,12,4), 8080, 4, 200);
+  ASSERT_TRUE(plm.is_delta_store_enough());
+  ASSERT_TRUE(plm.store_delta(delta_path));
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 300);
+  ASSERT_TRUE(plm.store_delta(delta_path));
+
+  nodetool::peerlist_manager loaded;
+  loaded.init(false);
+  {
+    boost::archive::binary_iarchive a(full_store);
+    a >> loaded;
+  }
+  ASSERT_EQ(2, loaded.get_white_peers_count());
+  ASSERT_EQ(1, loaded.get_gray_peers_count());
+  ASSERT_TRUE(loaded.load_delta(delta_path));
+  ASSERT_EQ(3, loaded.get_white_peers_count());
+  ASSERT_EQ(1, loaded.get_gray_peers_count());
+
+  std::list<nodetool::peerlist_entry> gray, white;
+  loaded.get_peerlist_full(gray, white);
+  ASSERT_EQ(2, white.front().id);
+  ASSERT_EQ(300, white.front().last_seen);
+  ASSERT_EQ(4, gray.front().id);
+
+  boost::filesystem::remove(delta_path);
+}
+
+TEST(peer_list, uncommitted_full_store_keeps_the_delta)
+{
+  std::string delta_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  std::stringstream full_store, failed_store;
+
+  nodetool::peerlist_manager plm;
+  plm.init(false);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,1), 8080, 1, 100);
+  {
+    boost::archive::binary_oarchive a(full_store);
+    a << plm;
+  }
+  plm.commit_full_store();
+
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 200);
+  {
+    //a full store that never made it to disk
+    boost::archive::binary_oarchive a(failed_store);
+    a << plm;
+  }
+  ASSERT_TRUE(plm.store_delta(delta_path));
+
+  nodetool::peerlist_manager loaded;
+  loaded.init(false);
+  {
+    boost::archive::binary_iarchive a(full_store);
+    a >> loaded;
+  }
+  ASSERT_TRUE(loaded.load_delta(delta_path));
+  ASSERT_EQ(2, loaded.get_white_peers_count());
+
+  boost::filesystem::remove(delta_path);
+}
+
+TEST(peer_list, torn_delta_record_is_cut_off)
+{
+  std::string delta_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  std::stringstream full_store;
+
+  nodetool::peerlist_manager plm;
+  plm.init(false);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,1), 8080, 1, 100);
+  ADD_WHITE_NODE(MAKE_IP(123,43,12,2), 8080, 2, 100);
+  {
+    boost::archive::binary_oarchive a(full_store);
+    a << plm;
+  }
+  plm.commit_full_store();
+  ADD_GRAY_NODE(MAKE_IP(123,43,12,3), 8080, 3, 200);
+  ASSERT_TRUE(plm.store_delta(delta_path));
+  uint64_t good_size = boost::filesystem::file_size(delta_path);
+  {
+    std::ofstream torn(delta_path, std::ios_base::binary | std::ios_base::app);
+    torn.write("\x01\x02\x03", 3);
+  }
+
+  nodetool::peerlist_manager loaded;
+  loaded.init(false);
+  {
+    boost::archive::binary_iarchive a(full_store);
+    a >> loaded;
+  }
+  ASSERT_TRUE(loaded.load_delta(delta_path));
+  ASSERT_EQ(1, loaded.get_gray_peers_count());
+  ASSERT_EQ(good_size, boost::filesystem::file_size(delta_path));
+
+  //the next delta lines up behind the good records again
+  nodetool::peerlist_entry ple;
+  ple.adr.ip = MAKE_IP(123,43,12,4);
+  ple.adr.port = 8080;
+  ple.id = 4;
+  ple.last_seen = 300;
+  loaded.append_with_peer_white(ple);
+  ASSERT_TRUE(loaded.store_delta(delta_path));
+  nodetool::peerlist_manager reloaded;
+  reloaded.init(false);
+  {
+    std::stringstream again(full_store.str());
+    boost::archive::binary_iarchive a(again);
+    a >> reloaded;
+  }
+  ASSERT_TRUE(reloaded.load_delta(delta_path));
+  ASSERT_EQ(3, reloaded.get_white_peers_count());
+  ASSERT_EQ(1, reloaded.get_gray_peers_count());
+
+  boost::filesystem::remove(delta_path);
+}
@@ -33,6 +33,7 @@
 #include "include_base_utils.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "storages/portable_storage_template_helper.h"
+#include "storages/portable_storage_view.h"
 
 TEST(protocol_pack, protocol_pack_command) 
 {
@@ -53,3 +54,66 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+TEST(protocol_pack, storage_view_loads_same_as_portable_storage)
+{
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  r.current_blockchain_height = 12345;
+  r.txs.push_back(std::string(100, 't'));
+  for(size_t i = 0; i < 200; ++i)
+  {
+    cryptonote::block_complete_entry bce;
+    bce.block = std::string(1000 + i, char(i));
+    for(size_t j = 0; j < i % 5; ++j)
+      bce.txs.push_back(std::string(300 + j, char(j)));
+    r.blocks.push_back(bce);
+  }
+  r.missed_ids.resize(3, boost::value_initialized<crypto::hash>());
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+
+  epee::serialization::portable_storage_view view;
+  ASSERT_TRUE(view.load_from_binary(buff));
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r2;
+  ASSERT_TRUE(r2.load(view));
+
+  ASSERT_EQ(r.current_blockchain_height, r2.current_blockchain_height);
+  ASSERT_TRUE(r.txs == r2.txs);
+  ASSERT_EQ(r.missed_ids.size(), r2.missed_ids.size());
+  ASSERT_EQ(r.blocks.size(), r2.blocks.size());
+  auto it2 = r2.blocks.begin();
+  for(const auto& bce: r.blocks)
+  {
+    ASSERT_EQ(bce.block, it2->block);
+    ASSERT_TRUE(bce.txs == it2->txs);
+    ++it2;
+  }
+
+  cryptonote::NOTIFY_NEW_BLOCK::request nb;
+  nb.b = r.blocks.back();
+  nb.current_blockchain_height = 7;
+  nb.hop = 2;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(nb, buff));
+  ASSERT_TRUE(view.load_from_binary(buff));
+  cryptonote::NOTIFY_NEW_BLOCK::request nb2;
+  ASSERT_TRUE(nb2.load(view));
+  ASSERT_EQ(nb.b.block, nb2.b.block);
+  ASSERT_TRUE(nb.b.txs == nb2.b.txs);
+  ASSERT_EQ(7, nb2.current_blockchain_height);
+  ASSERT_EQ(2, nb2.hop);
+}
+
+TEST(protocol_pack, storage_view_rejects_truncated_blob)
+{
+  cryptonote::NOTIFY_NEW_BLOCK::request nb;
+  nb.b.block = std::string(500, 'b');
+  nb.b.txs.push_back(std::string(200, 't'));
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(nb, buff));
+
+  epee::serialization::portable_storage_view view;
+  for(size_t size = 0; size < buff.size(); size += 7)
+    ASSERT_FALSE(view.load_from_binary(buff.data(), size));
+  ASSERT_TRUE(view.load_from_binary(buff));
+}
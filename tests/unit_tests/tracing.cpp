@@ -0,0 +1,121 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "common/tracing.h"
+
+namespace
+{
+  size_t count_occurrences(const std::string& s, const std::string& what)
+  {
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1))
+      ++n;
+    return n;
+  }
+}
+
+TEST(tracing, spans_are_only_recorded_while_enabled)
+{
+  tools::tracing::stop();
+  {
+    TRACE_SPAN("test", "before_start");
+  }
+  tools::tracing::start(16);
+  {
+    TRACE_SPAN("test", "outer");
+    TRACE_SPAN("test", "inner");
+  }
+  tools::tracing::stop();
+  {
+    TRACE_SPAN("test", "after_stop");
+  }
+
+  std::string trace = tools::tracing::to_chrome_trace();
+  ASSERT_EQ(0, count_occurrences(trace, "before_start"));
+  ASSERT_EQ(0, count_occurrences(trace, "after_stop"));
+  ASSERT_EQ(1, count_occurrences(trace, "\"name\":\"outer\",\"cat\":\"test\",\"ph\":\"X\""));
+  ASSERT_EQ(1, count_occurrences(trace, "\"name\":\"inner\""));
+}
+
+TEST(tracing, full_buffer_keeps_the_newest_spans)
+{
+  tools::tracing::start(2);
+  {
+    TRACE_SPAN("test", "first");
+  }
+  {
+    TRACE_SPAN("test", "second");
+  }
+  {
+    TRACE_SPAN("test", "third");
+  }
+  tools::tracing::stop();
+
+  std::string trace = tools::tracing::to_chrome_trace();
+  ASSERT_EQ(0, count_occurrences(trace, "\"first\""));
+  ASSERT_LT(trace.find("\"second\""), trace.find("\"third\""));
+}
+
+TEST(tracing, spans_of_exited_threads_are_exported)
+{
+  tools::tracing::start(16);
+  std::thread t([]() { TRACE_SPAN("test", "worker"); });
+  t.join();
+  tools::tracing::stop();
+
+  ASSERT_EQ(1, count_occurrences(tools::tracing::to_chrome_trace(), "\"worker\""));
+
+  tools::tracing::start(16);
+  tools::tracing::stop();
+  ASSERT_EQ(0, count_occurrences(tools::tracing::to_chrome_trace(), "\"worker\""));
+}
+
+TEST(tracing, exited_threads_share_one_ring)
+{
+  tools::tracing::start(4);
+  for (int i = 0; i < 3; ++i)
+  {
+    std::thread t([]() {
+      TRACE_SPAN("test", "old");
+      TRACE_SPAN("test", "older");
+    });
+    t.join();
+  }
+  std::thread t([]() { TRACE_SPAN("test", "last"); });
+  t.join();
+  tools::tracing::stop();
+
+  std::string trace = tools::tracing::to_chrome_trace();
+  ASSERT_EQ(4, count_occurrences(trace, "\"cat\":\"test\""));
+  ASSERT_EQ(1, count_occurrences(trace, "\"last\""));
+}
@@ -0,0 +1,224 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/blockchain_storage.h"
+#include "cryptonote_core/tx_pool.h"
+
+namespace cryptonote
+{
+  // adds and removes pool entries the way add_tx/take_tx do, without valid transactions
+  class tx_pool_delta_test
+  {
+  public:
+    static crypto::hash add(tx_memory_pool& pool, uint64_t fee)
+    {
+      crypto::hash id = crypto::rand<crypto::hash>();
+      add(pool, id, fee);
+      return id;
+    }
+
+    static void add(tx_memory_pool& pool, const crypto::hash& id, uint64_t fee)
+    {
+      tx_memory_pool::tx_details txd = AUTO_VAL_INIT(txd);
+      txd.blob_size = 100;
+      txd.fee = fee;
+      pool.m_transactions[id] = txd;
+      pool.journal_add(id);
+    }
+
+    static void remove(tx_memory_pool& pool, const crypto::hash& id)
+    {
+      pool.m_transactions.erase(id);
+      pool.journal_remove(id);
+    }
+  };
+}
+
+using cryptonote::tx_pool_delta_test;
+
+namespace
+{
+  class tx_pool_delta : public ::testing::Test
+  {
+  protected:
+    tx_pool_delta() : m_pool(m_bs), m_bs(m_pool) {}
+
+    virtual void SetUp()
+    {
+      m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+    }
+
+    bool get_delta(uint64_t epoch, uint64_t since_version)
+    {
+      return m_pool.get_pool_delta(epoch, since_version, m_added, m_removed, m_delta_version);
+    }
+
+    cryptonote::tx_memory_pool m_pool;
+    cryptonote::blockchain_storage m_bs;
+    std::vector<cryptonote::tx_memory_pool::tx_pool_entry> m_entries;
+    uint64_t m_epoch;
+    uint64_t m_version;
+    std::vector<cryptonote::tx_memory_pool::tx_pool_entry> m_added;
+    std::vector<crypto::hash> m_removed;
+    uint64_t m_delta_version;
+  };
+
+  bool contains(const std::vector<crypto::hash>& ids, const crypto::hash& id)
+  {
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+  }
+}
+
+TEST_F(tx_pool_delta, up_to_date)
+{
+  tx_pool_delta_test::add(m_pool, 10);
+  m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+
+  ASSERT_TRUE(get_delta(m_epoch, m_version));
+  ASSERT_TRUE(m_added.empty());
+  ASSERT_TRUE(m_removed.empty());
+  ASSERT_EQ(m_version, m_delta_version);
+}
+
+TEST_F(tx_pool_delta, adds_and_removes)
+{
+  crypto::hash kept = tx_pool_delta_test::add(m_pool, 10);
+  crypto::hash removed = tx_pool_delta_test::add(m_pool, 20);
+  m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+
+  crypto::hash added = tx_pool_delta_test::add(m_pool, 30);
+  tx_pool_delta_test::remove(m_pool, removed);
+
+  ASSERT_TRUE(get_delta(m_epoch, m_version));
+  ASSERT_EQ(m_version + 2, m_delta_version);
+  ASSERT_EQ(1, m_added.size());
+  ASSERT_EQ(added, m_added.front().id);
+  ASSERT_EQ(30, m_added.front().fee);
+  ASSERT_EQ(1, m_removed.size());
+  ASSERT_EQ(removed, m_removed.front());
+  ASSERT_FALSE(contains(m_removed, kept));
+}
+
+TEST_F(tx_pool_delta, other_epoch_needs_snapshot)
+{
+  tx_pool_delta_test::add(m_pool, 10);
+
+  ASSERT_FALSE(get_delta(m_epoch + 1, m_version));
+  ASSERT_TRUE(m_added.empty());
+  ASSERT_TRUE(m_removed.empty());
+}
+
+TEST_F(tx_pool_delta, version_from_the_future_needs_snapshot)
+{
+  tx_pool_delta_test::add(m_pool, 10);
+  m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+
+  ASSERT_FALSE(get_delta(m_epoch, m_version + 1));
+  ASSERT_EQ(m_version, m_delta_version);
+}
+
+TEST_F(tx_pool_delta, version_out_of_journal_needs_snapshot)
+{
+  crypto::hash id = tx_pool_delta_test::add(m_pool, 10);
+  m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+
+  // 16384 changes are kept: all of those after m_version, but not the one at it
+  for(size_t i = 0; i < 16384 / 2; ++i)
+  {
+    tx_pool_delta_test::remove(m_pool, id);
+    tx_pool_delta_test::add(m_pool, id, 10);
+  }
+  ASSERT_TRUE(get_delta(m_epoch, m_version));
+  ASSERT_FALSE(get_delta(m_epoch, m_version - 1));
+
+  // one more pushes the first change after m_version out
+  tx_pool_delta_test::remove(m_pool, id);
+  ASSERT_FALSE(get_delta(m_epoch, m_version));
+  ASSERT_TRUE(get_delta(m_epoch, m_version + 1));
+  ASSERT_TRUE(m_added.empty());
+  ASSERT_EQ(1, m_removed.size());
+  ASSERT_EQ(id, m_removed.front());
+}
+
+TEST_F(tx_pool_delta, add_then_remove_coalesces_to_remove)
+{
+  crypto::hash id = tx_pool_delta_test::add(m_pool, 10);
+  tx_pool_delta_test::remove(m_pool, id);
+
+  // the caller may have seen neither change, removing an unknown id is harmless
+  ASSERT_TRUE(get_delta(m_epoch, m_version));
+  ASSERT_TRUE(m_added.empty());
+  ASSERT_EQ(1, m_removed.size());
+  ASSERT_EQ(id, m_removed.front());
+}
+
+TEST_F(tx_pool_delta, remove_then_readd_coalesces_to_add)
+{
+  crypto::hash id = tx_pool_delta_test::add(m_pool, 10);
+  m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+
+  tx_pool_delta_test::remove(m_pool, id);
+  tx_pool_delta_test::add(m_pool, id, 40);
+
+  ASSERT_TRUE(get_delta(m_epoch, m_version));
+  ASSERT_TRUE(m_removed.empty());
+  ASSERT_EQ(1, m_added.size());
+  ASSERT_EQ(id, m_added.front().id);
+  ASSERT_EQ(40, m_added.front().fee);
+}
+
+TEST_F(tx_pool_delta, init_resets_the_journal)
+{
+  boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("tx_pool_delta_%%%%-%%%%-%%%%");
+  boost::filesystem::create_directories(dir);
+
+  ASSERT_TRUE(m_pool.init(dir.string()));
+  tx_pool_delta_test::add(m_pool, 10);
+  m_pool.get_pool_snapshot(m_entries, m_epoch, m_version);
+  ASSERT_TRUE(m_pool.deinit());
+
+  // reloading the pool file keeps the epoch but moves past the journal
+  ASSERT_TRUE(m_pool.init(dir.string()));
+  uint64_t epoch;
+  uint64_t version;
+  m_pool.get_pool_snapshot(m_entries, epoch, version);
+  ASSERT_EQ(m_epoch, epoch);
+  ASSERT_LT(m_version, version);
+  ASSERT_FALSE(get_delta(m_epoch, m_version));
+  ASSERT_TRUE(get_delta(epoch, version));
+
+  boost::system::error_code e;
+  boost::filesystem::remove_all(dir, e);
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "wallet/wallet2.h"
+
+namespace tools
+{
+  // reaches into the wallet cache the way refresh() would, without a daemon
+  class wallet_journal_test
+  {
+  public:
+    static void add_transfer(wallet2& w, uint64_t amount)
+    {
+      crypto::hash block_id = crypto::rand<crypto::hash>();
+      w.m_blockchain.push_back(block_id);
+      w.m_local_bc_height = w.m_blockchain.size();
+
+      wallet2::transfer_details td = AUTO_VAL_INIT(td);
+      td.m_block_height = w.m_blockchain.size() - 1;
+      td.m_tx.vout.resize(1);
+      td.m_tx.vout[0].amount = amount;
+      td.m_tx.vout[0].target = cryptonote::txout_to_key(crypto::rand<crypto::public_key>());
+      td.m_internal_output_index = 0;
+      td.m_global_output_index = w.m_transfers.size();
+      td.m_spent = false;
+      td.m_key_image = crypto::rand<crypto::key_image>();
+      w.m_transfers.push_back(td);
+      w.m_key_images[td.m_key_image] = w.m_transfers.size() - 1;
+    }
+
+    static void set_spent(wallet2& w, size_t idx)
+    {
+      w.m_transfers[idx].m_spent = true;
+    }
+
+    static std::string journal_file(const wallet2& w)
+    {
+      return w.journal_file_name();
+    }
+  };
+}
+
+using tools::wallet2;
+using tools::wallet_journal_test;
+
+namespace
+{
+  const char WALLET_PASSWORD[] = "journal";
+
+  class wallet_journal : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet_journal_%%%%-%%%%-%%%%");
+      boost::filesystem::create_directories(m_dir);
+      m_wallet_file = (m_dir / "wallet").string();
+    }
+
+    virtual void TearDown()
+    {
+      boost::system::error_code e;
+      boost::filesystem::remove_all(m_dir, e);
+    }
+
+    // genesis snapshot, then two journal records: two new transfers, then a third one plus the first spent
+    void write_two_records(wallet2& w)
+    {
+      w.generate(m_wallet_file, WALLET_PASSWORD);
+
+      wallet_journal_test::add_transfer(w, 1000);
+      wallet_journal_test::add_transfer(w, 2000);
+      w.store();
+      m_first_journal_size = boost::filesystem::file_size(wallet_journal_test::journal_file(w));
+
+      wallet_journal_test::add_transfer(w, 3000);
+      wallet_journal_test::set_spent(w, 0);
+      w.store();
+    }
+
+    boost::filesystem::path m_dir;
+    std::string m_wallet_file;
+    uint64_t m_first_journal_size;
+  };
+
+  bool same_transfers(const wallet2::transfer_container& a, const wallet2::transfer_container& b)
+  {
+    if(a.size() != b.size())
+      return false;
+    for(size_t i = 0; i < a.size(); ++i)
+    {
+      if(a[i].m_block_height != b[i].m_block_height || a[i].amount() != b[i].amount() ||
+        a[i].m_spent != b[i].m_spent || a[i].m_key_image != b[i].m_key_image)
+        return false;
+    }
+    return true;
+  }
+}
+
+TEST_F(wallet_journal, replays_records_on_load)
+{
+  wallet2 w;
+  write_two_records(w);
+  ASSERT_TRUE(boost::filesystem::exists(wallet_journal_test::journal_file(w)));
+
+  wallet2::transfer_container stored;
+  w.get_transfers(stored);
+
+  wallet2 loaded;
+  loaded.load(m_wallet_file, WALLET_PASSWORD);
+  wallet2::transfer_container recovered;
+  loaded.get_transfers(recovered);
+
+  ASSERT_EQ(3, recovered.size());
+  ASSERT_TRUE(same_transfers(stored, recovered));
+  ASSERT_TRUE(recovered[0].m_spent);
+  ASSERT_FALSE(recovered[2].m_spent);
+  ASSERT_EQ(w.get_blockchain_current_height(), loaded.get_blockchain_current_height());
+  ASSERT_EQ(5000, loaded.balance());
+}
+
+TEST_F(wallet_journal, drops_truncated_last_record)
+{
+  wallet2 w;
+  write_two_records(w);
+
+  // a crash in the middle of the second append leaves a torn record behind
+  const std::string journal_file = wallet_journal_test::journal_file(w);
+  const uint64_t journal_size = boost::filesystem::file_size(journal_file);
+  ASSERT_LT(m_first_journal_size, journal_size);
+  boost::filesystem::resize_file(journal_file, journal_size - 1);
+
+  wallet2 loaded;
+  loaded.load(m_wallet_file, WALLET_PASSWORD);
+  wallet2::transfer_container recovered;
+  loaded.get_transfers(recovered);
+
+  ASSERT_EQ(2, recovered.size());
+  ASSERT_EQ(1000, recovered[0].amount());
+  ASSERT_EQ(2000, recovered[1].amount());
+  ASSERT_FALSE(recovered[0].m_spent);
+  ASSERT_FALSE(recovered[1].m_spent);
+  ASSERT_EQ(3, loaded.get_blockchain_current_height());
+  ASSERT_EQ(m_first_journal_size, boost::filesystem::file_size(journal_file));
+}
+
+TEST_F(wallet_journal, snapshot_folds_journal_into_cache)
+{
+  wallet2 w;
+  write_two_records(w);
+  w.store_snapshot();
+  ASSERT_FALSE(boost::filesystem::exists(wallet_journal_test::journal_file(w)));
+
+  wallet2::transfer_container stored;
+  w.get_transfers(stored);
+
+  wallet2 loaded;
+  loaded.load(m_wallet_file, WALLET_PASSWORD);
+  wallet2::transfer_container recovered;
+  loaded.get_transfers(recovered);
+
+  ASSERT_TRUE(same_transfers(stored, recovered));
+}